@@ -0,0 +1,204 @@
+// Store-and-forward backlog through a cloud outage, on the in-memory SPIFFS and NVS.
+// One upload frame is parked every upload interval for the whole outage, with a reboot
+// halfway through; then the backlog is replayed oldest-first in batched requests and every
+// frame is checked against what was stored. A day-long outage checks segment rotation and
+// a torn append checks recovery after a power cut.
+//
+//   ./bench_backlog_outage [outage_hours]
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "config.h"
+#include "compressor.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+#include "bench_support.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+typedef std::vector<uint8_t> frame_t;
+
+// One upload interval of inverter readings as the [0x00][compressed] frame the scheduler sends
+static frame_t make_upload_frame(void) {
+    static int32_t level[READ_REGISTER_COUNT] = {2300, 52, 5000, 3600, 3550, 41, 39, 352, 50, 1200};
+    const size_t samples_per_upload = UPLOAD_INTERVAL_MS / POLL_INTERVAL_MS;
+    register_reading_t samples[UPLOAD_INTERVAL_MS / POLL_INTERVAL_MS];
+    for (size_t i = 0; i < samples_per_upload; i++) {
+        level[0] += rng_range(-12, 12);
+        level[1] += rng_range(-3, 3);
+        level[3] += rng_range(-20, 20);
+        level[4] += rng_range(-20, 20);
+        level[9] = 1200 + rng_range(-60, 60);
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            samples[i].values[reg] = clamp16(level[reg]);
+        }
+    }
+
+    frame_t frame(1 + compress_bound(samples_per_upload, COMPRESSION_METHOD));
+    frame[0] = 0x00; // Raw flag
+    compression_metrics_t metrics = compress_with_method(samples, samples_per_upload, frame.data() + 1,
+                                                         frame.size() - 1, COMPRESSION_METHOD);
+    frame.resize(1 + metrics.compressed_payload_size);
+    return frame;
+}
+
+typedef struct {
+    size_t requests;
+    size_t frames;
+    size_t mismatches;
+} replay_result_t;
+
+// Drain the backlog the way replay_upload_backlog does and compare with expected[first..]
+static replay_result_t replay_all(const std::vector<frame_t>& expected, size_t first) {
+    replay_result_t result = {0, 0, 0};
+    uint8_t batch[BACKLOG_REPLAY_MAX_BYTES - 2];
+    size_t index = first;
+
+    while (upload_backlog_pending() > 0) {
+        size_t batch_len = 0;
+        size_t frames = 0;
+        backlog_cursor_t next;
+        size_t records = upload_backlog_read(batch, sizeof(batch), 255, &batch_len, &frames, &next);
+        if (records == 0) {
+            break;
+        }
+
+        // A failed request leaves the backlog as it was: the same frames come back
+        if (result.requests == 3) {
+            size_t again_len = 0;
+            size_t again_frames = 0;
+            backlog_cursor_t again_next;
+            uint8_t again[sizeof(batch)];
+            upload_backlog_read(again, sizeof(again), 255, &again_len, &again_frames, &again_next);
+            if (again_len != batch_len || memcmp(again, batch, batch_len) != 0) {
+                result.mismatches++;
+            }
+        }
+
+        size_t pos = 0;
+        for (size_t f = 0; f < frames; f++) {
+            size_t length = ((size_t)batch[pos] << 8) | batch[pos + 1];
+            pos += 2;
+            if (index >= expected.size() || expected[index].size() != length ||
+                memcmp(expected[index].data(), batch + pos, length) != 0) {
+                result.mismatches++;
+            }
+            pos += length;
+            index++;
+        }
+        upload_backlog_commit(&next, records);
+        result.requests++;
+        result.frames += frames;
+    }
+    if (index != expected.size()) {
+        result.mismatches++;
+    }
+    return result;
+}
+
+static void reset_storage(void) {
+    host_spiffs_reset();
+    host_nvs_reset();
+    upload_backlog_init();
+}
+
+static int run_outage(double hours, bool reboot_halfway) {
+    reset_storage();
+    host_clock_set_us(0);
+    uint32_t nvs_writes_before = host_nvs_write_count();
+    backlog_stats_t before = upload_backlog_get_stats();
+
+    size_t uploads = (size_t)(hours * 3600000.0 / UPLOAD_INTERVAL_MS);
+    std::vector<frame_t> sent;
+    sent.reserve(uploads);
+    size_t peak_bytes = 0;
+    size_t peak_segments = 0;
+    int failures = 0;
+
+    for (size_t i = 0; i < uploads; i++) {
+        host_clock_advance_ms(UPLOAD_INTERVAL_MS);
+        sent.push_back(make_upload_frame());
+        if (!upload_backlog_append(sent.back().data(), sent.back().size())) {
+            printf("FAIL frame %zu was not stored\n", i);
+            failures++;
+        }
+        if (reboot_halfway && i == uploads / 2) {
+            upload_backlog_init();  // RAM state is gone; NVS and SPIFFS survive
+        }
+        if (upload_backlog_bytes() > peak_bytes) peak_bytes = upload_backlog_bytes();
+        if (upload_backlog_segments() > peak_segments) peak_segments = upload_backlog_segments();
+    }
+
+    backlog_stats_t stats = upload_backlog_get_stats();
+    size_t dropped = stats.frames_dropped - before.frames_dropped;
+    size_t pending = upload_backlog_pending();
+    if (pending + dropped != uploads) {
+        printf("FAIL %zu pending + %zu dropped != %zu stored\n", pending, dropped, uploads);
+        failures++;
+    }
+
+    // Rotation only ever drops the oldest frames, so the newest `pending` survive
+    replay_result_t replay = replay_all(sent, uploads - pending);
+    if (replay.mismatches > 0 || replay.frames != pending) {
+        printf("FAIL replay: %zu mismatches, %zu of %zu frames\n", replay.mismatches, replay.frames, pending);
+        failures++;
+    }
+    if (upload_backlog_pending() != 0 || upload_backlog_bytes() != 0) {
+        printf("FAIL backlog not empty after replay\n");
+        failures++;
+    }
+
+    printf("%6.1f h %7zu %7zu %7zu %8zu %5zu %7zu %9.1f %7u %s\n", hours, uploads, dropped, peak_bytes / 1024,
+           peak_segments, (size_t)(stats.segments_rotated - before.segments_rotated), replay.requests,
+           replay.requests ? (double)replay.frames / replay.requests : 0.0,
+           host_nvs_write_count() - nvs_writes_before, failures ? "FAIL" : "ok");
+    return failures;
+}
+
+// A power cut mid-append leaves a partial record at the end of the tail segment
+static int run_torn_append(void) {
+    reset_storage();
+    std::vector<frame_t> sent;
+    for (int i = 0; i < 10; i++) {
+        sent.push_back(make_upload_frame());
+        upload_backlog_append(sent.back().data(), sent.back().size());
+    }
+
+    char path[24];
+    snprintf(path, sizeof(path), "/backlog_%08lx.bin", 0ul);  // First segment after a reset
+    File file = SPIFFS.open(path, FILE_APPEND);
+    const uint8_t partial[] = {0x00, 0x40, 0x12, 0x34, 0x00, 0x07};
+    file.write(partial, sizeof(partial));
+    file.close();
+
+    upload_backlog_init();
+    for (int i = 0; i < 10; i++) {
+        sent.push_back(make_upload_frame());
+        upload_backlog_append(sent.back().data(), sent.back().size());
+    }
+
+    replay_result_t replay = replay_all(sent, 0);
+    bool ok = replay.mismatches == 0 && replay.frames == sent.size();
+    printf("torn append: %zu/%zu frames replayed in order: %s\n", replay.frames, sent.size(), ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    double hours = argc > 1 ? strtod(argv[1], nullptr) : 6.0;
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+
+    printf("Segments of %d B, at most %d; replay requests of up to %d B\n",
+           BACKLOG_SEGMENT_SIZE, BACKLOG_MAX_SEGMENTS, BACKLOG_REPLAY_MAX_BYTES);
+    printf("%8s %7s %7s %7s %8s %5s %7s %9s %7s\n", "outage", "frames", "dropped", "peak KB",
+           "segments", "rot", "replays", "frm/req", "nvs wr");
+
+    int failures = 0;
+    failures += run_outage(hours, true);
+    failures += run_outage(24.0, false);
+    failures += run_torn_append();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Handling one upload response: four independent parses against parse_cloud_response().
+// The old path ran extract_command, validate_upload_response, config_process_cloud_response
+// (two deserializeJson calls) and parse_fota_manifest_from_response on the same String.
+// The new path parses once and hands each section to its handler. Reports heap allocations,
+// the peak of live heap bytes and the time per response, for several response shapes.
+//
+//   ./bench_cloud_response [iterations]
+
+#include <Arduino.h>
+#include "config.h"
+#include "config_manager.h"
+#include "cloudAPI_handler.h"
+#include "command_parse.h"
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_support.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Defined with the register tables in scheduler.cpp, which this bench does not link
+const PROGMEM uint16_t READ_REGISTERS[READ_REGISTER_COUNT] = {0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009};
+
+typedef struct {
+    const char* name;
+    const char* body;
+} response_shape_t;
+
+static const response_shape_t shapes[] = {
+    {"ack", "{\"status\":\"success\",\"message\":\"Data stored\"}"},
+    {"loose ack", "{\"status\":\"stored\",\"message\":\"upload success\"}"},
+    {"ack+command",
+     "{\"status\":\"success\",\"command\":{\"action\":\"write_register\",\"target_register\":\"8\",\"value\":50}}"},
+    {"ack+config",
+     "{\"status\":\"success\",\"config_update\":{\"sampling_interval\":5,\"upload_interval\":30,"
+     "\"registers\":[\"voltage\",\"current\",\"frequency\"]}}"},
+    {"ack+fota",
+     "{\"status\":\"success\",\"fota\":{\"job_id\":12,\"fwUrl\":\"https://eco-watt-cloud.vercel.app/fw/1.0.1.bin\","
+     "\"fwSize\":1048576,\"shaExpected\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\","
+     "\"signature\":\"MEUCIQDv2k2mZ0xW3l0bq8e7Yh1k1Zk3oQ8yX4o6lHq8yJ3p4wIgQ5m2tq0\"}}"},
+    {"all four",
+     "{\"status\":\"success\",\"command\":{\"action\":\"write_register\",\"target_register\":\"8\",\"value\":50},"
+     "\"config_update\":{\"sampling_interval\":5,\"upload_interval\":30,\"registers\":[\"voltage\",\"current\"]},"
+     "\"fota\":{\"job_id\":12,\"fwUrl\":\"https://eco-watt-cloud.vercel.app/fw/1.0.1.bin\",\"fwSize\":1048576,"
+     "\"shaExpected\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\","
+     "\"signature\":\"MEUCIQDv2k2mZ0xW3l0bq8e7Yh1k1Zk3oQ8yX4o6lHq8yJ3p4wIgQ5m2tq0\"}}"},
+};
+
+typedef struct {
+    bool acked;
+    bool command;
+    uint16_t target_register;
+    uint16_t value;
+    bool config;
+    bool fota;
+    int job_id;
+} handled_t;
+
+// What the upload path did before: every consumer scans or parses the String itself
+static handled_t handle_four_parses(const String& response) {
+    handled_t handled = {};
+    String action;
+    handled.command = extract_command(response, action, handled.target_register, handled.value);
+    handled.acked = validate_upload_response(response);
+    if (handled.acked) {
+        handled.config = config_process_cloud_response(response).length() > 0;
+        String fwUrl, shaExpected, signature;
+        size_t fwSize = 0;
+        handled.fota = parse_fota_manifest_from_response(response, handled.job_id, fwUrl, fwSize, shaExpected, signature);
+    }
+    return handled;
+}
+
+static handled_t handle_single_parse(const String& response) {
+    handled_t handled = {};
+    cloud_response_t parsed;
+    handled.acked = parse_cloud_response(response, &parsed);
+    String action;
+    handled.command = parse_command_from_json(parsed.command, action, handled.target_register, handled.value);
+    if (handled.acked) {
+        handled.config = config_process_config_update(parsed.config_update).length() > 0;
+        String fwUrl, shaExpected, signature;
+        size_t fwSize = 0;
+        handled.fota = parse_fota_manifest_from_json(parsed.fota, handled.job_id, fwUrl, fwSize, shaExpected, signature);
+    }
+    return handled;
+}
+
+typedef struct {
+    double us;
+    double allocations;
+    size_t peak;
+    handled_t handled;
+} run_result_t;
+
+// Serial's capture buffer is emptied before each response and keeps its capacity, so after
+// the first iterations neither the counts nor the peak include it
+static run_result_t run(handled_t (*handle)(const String&), const String& response, int iterations) {
+    run_result_t result = {};
+    size_t allocations_before = allocation_count;
+    double elapsed_us = 0;
+    for (int i = 0; i < iterations; i++) {
+        Serial.clear_captured();
+        size_t live_before = live_bytes;
+        peak_bytes = live_bytes;
+        auto start = std::chrono::steady_clock::now();
+        result.handled = handle(response);
+        elapsed_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        result.peak = peak_bytes - live_before;
+    }
+    result.us = elapsed_us / iterations;
+    result.allocations = (double)(allocation_count - allocations_before) / iterations;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    Serial.set_echo(false);
+    config_manager_init();
+
+    printf("%-12s %-12s %10s %10s %10s\n", "response", "path", "us/resp", "allocs", "peak B");
+    int failures = 0;
+    for (const response_shape_t& shape : shapes) {
+        const String response(shape.body);
+        run_result_t before = run(handle_four_parses, response, iterations);
+        run_result_t after = run(handle_single_parse, response, iterations);
+        printf("%-12s %-12s %10.2f %10.1f %10zu\n", shape.name, "four parses", before.us, before.allocations, before.peak);
+        printf("%-12s %-12s %10.2f %10.1f %10zu\n", "", "single parse", after.us, after.allocations, after.peak);
+
+        const handled_t& a = before.handled;
+        const handled_t& b = after.handled;
+        if (a.acked != b.acked || a.command != b.command || a.target_register != b.target_register ||
+            a.value != b.value || a.config != b.config || a.fota != b.fota || a.job_id != b.job_id) {
+            printf("FAIL %s: the two paths handled the response differently\n", shape.name);
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
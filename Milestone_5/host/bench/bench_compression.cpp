@@ -0,0 +1,233 @@
+// Compression methods compared on the same register buffers: payload size, ratio and time.
+// Every output is decoded again and checked against the input.
+//
+//   ./bench_compression [iterations]
+
+#include <Arduino.h>
+#include "config.h"
+#include "compressor.h"
+#include "bench_support.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef std::vector<register_reading_t> samples_t;
+
+// Register map as in REGISTER_GAINS / REGISTER_UNITS: V, A, Hz, V, V, A, A, degC, %, W
+static samples_t make_inverter_samples(size_t count) {
+    samples_t samples(count);
+    int32_t level[READ_REGISTER_COUNT] = {2300, 52, 5000, 3600, 3550, 41, 39, 352, 50, 1200};
+    for (size_t i = 0; i < count; i++) {
+        level[0] += rng_range(-12, 12);                       // grid voltage, +-1.2 V
+        level[1] += rng_range(-3, 3);                         // grid current
+        if (rng_range(0, 9) == 0) level[2] += rng_range(-1, 1);  // frequency, almost constant
+        level[3] += rng_range(-20, 20);                       // PV1 voltage
+        level[4] += rng_range(-20, 20);                       // PV2 voltage
+        level[5] += rng_range(-2, 2);                         // PV1 current
+        level[6] += rng_range(-2, 2);                         // PV2 current
+        if (i % 8 == 7) level[7] += 1;                        // temperature, slow drift
+        // level[8] export power %, constant
+        level[9] = 1200 + rng_range(-60, 60);                 // output power, noisy around a mean
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            samples[i].values[reg] = clamp16(level[reg]);
+        }
+    }
+    return samples;
+}
+
+static samples_t make_flat_samples(size_t count) {
+    samples_t samples(count);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            samples[i].values[reg] = (uint16_t)(1000 + reg);
+        }
+    }
+    return samples;
+}
+
+static samples_t make_random_samples(size_t count) {
+    samples_t samples(count);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            samples[i].values[reg] = (uint16_t)rng_range(0, 65535);
+        }
+    }
+    return samples;
+}
+
+// ---------------- Reference decoder ----------------
+
+static bool read_varint(const uint8_t* data, size_t size, size_t* pos, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (*pos >= size) return false;
+        uint8_t b = data[(*pos)++];
+        *value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool decode_register(uint8_t codec, const uint8_t* data, size_t size, size_t* pos,
+                            size_t count, size_t reg, samples_t* out) {
+    if (codec == REGISTER_CODEC_RAW) {
+        if (*pos + count * 2 > size) return false;
+        for (size_t i = 0; i < count; i++, *pos += 2) {
+            (*out)[i].values[reg] = (uint16_t)((data[*pos] << 8) | data[*pos + 1]);
+        }
+        return true;
+    }
+
+    if (*pos + 2 > size) return false;
+    uint16_t value = (uint16_t)((data[*pos] << 8) | data[*pos + 1]);
+    *pos += 2;
+    (*out)[0].values[reg] = value;
+    if (codec == REGISTER_CODEC_CONSTANT) {
+        for (size_t i = 1; i < count; i++) (*out)[i].values[reg] = value;
+        return true;
+    }
+
+    int32_t delta = 0;
+    size_t i = 1;
+    while (i < count) {
+        if (*pos >= size) return false;
+        uint32_t run = 0;
+        int32_t step = 0;
+        if (data[*pos] == 0x00) {
+            (*pos)++;
+            if (codec == REGISTER_CODEC_DELTA_RLE) {
+                if (*pos >= size) return false;
+                run = data[(*pos)++];
+            } else if (!read_varint(data, size, pos, &run)) {
+                return false;
+            }
+        } else if (codec == REGISTER_CODEC_DELTA_RLE) {
+            if (data[*pos] != 0x01 || *pos + 3 > size) return false;
+            step = (int16_t)((data[*pos + 1] << 8) | data[*pos + 2]);
+            *pos += 3;
+        } else if (codec == REGISTER_CODEC_VARINT || codec == REGISTER_CODEC_DELTA_OF_DELTA) {
+            uint32_t zz = 0;
+            if (!read_varint(data, size, pos, &zz)) return false;
+            step = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        } else {
+            return false;
+        }
+
+        // A run repeats a zero step; for delta-of-delta that means repeating the last delta
+        uint32_t repeat = run > 0 ? run : 1;
+        for (uint32_t r = 0; r < repeat && i < count; r++) {
+            if (codec == REGISTER_CODEC_DELTA_OF_DELTA) {
+                delta = (int16_t)(delta + step);
+            } else {
+                delta = step;
+            }
+            value = (uint16_t)(value + delta);
+            (*out)[i++].values[reg] = value;
+        }
+    }
+    return true;
+}
+
+static bool decode(const uint8_t* frame, size_t frame_size, samples_t* out) {
+    if (frame_size < COMPRESSION_HEADER_SIZE) return false;
+    size_t count = ((size_t)frame[0] << 8) | frame[1];
+    uint8_t method = frame[2] >> 4;
+    size_t reg_count = frame[2] & 0x0F;
+    size_t payload_size = ((size_t)frame[3] << 8) | frame[4];
+    if (reg_count != READ_REGISTER_COUNT || payload_size + COMPRESSION_HEADER_SIZE != frame_size) return false;
+
+    const uint8_t* data = frame + COMPRESSION_HEADER_SIZE;
+    size_t pos = 0;
+    uint8_t codecs[READ_REGISTER_COUNT];
+    for (size_t reg = 0; reg < reg_count; reg++) {
+        if (method == COMPRESSION_METHOD_DELTA_RLE) {
+            codecs[reg] = REGISTER_CODEC_DELTA_RLE;
+        } else if (method == COMPRESSION_METHOD_VARINT) {
+            codecs[reg] = REGISTER_CODEC_VARINT;
+        } else if (method == COMPRESSION_METHOD_ADAPTIVE) {
+            codecs[reg] = (reg % 2 == 0) ? (data[reg / 2] >> 4) : (data[reg / 2] & 0x0F);
+        } else {
+            return false;
+        }
+    }
+    if (method == COMPRESSION_METHOD_ADAPTIVE) {
+        pos = (reg_count + 1) / 2;
+    }
+
+    out->assign(count, register_reading_t());
+    for (size_t reg = 0; reg < reg_count; reg++) {
+        if (!decode_register(codecs[reg], data, payload_size, &pos, count, reg, out)) return false;
+    }
+    return pos == payload_size;
+}
+
+static const uint8_t methods[] = {COMPRESSION_METHOD_DELTA_RLE, COMPRESSION_METHOD_VARINT, COMPRESSION_METHOD_ADAPTIVE};
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    static const size_t sizes[] = {5, 10, 20, 30, 60, 100};
+
+    Serial.set_capture(false);
+
+    struct {
+        const char* name;
+        samples_t (*make)(size_t count);
+    } datasets[] = {
+        {"inverter", make_inverter_samples},
+        {"flat", make_flat_samples},
+        {"random", make_random_samples},
+    };
+
+    printf("%-9s %7s %-14s %8s %8s %7s %10s\n", "data", "samples", "method", "raw B", "frame B", "ratio", "ns/call");
+    bool ok = true;
+    for (auto& dataset : datasets) {
+        for (size_t size : sizes) {
+            samples_t samples = dataset.make(size);
+
+            for (uint8_t method : methods) {
+                std::vector<uint8_t> frame(compress_bound(size, method));
+                uint8_t* output = frame.data();
+                compression_metrics_t metrics = compress_with_method(samples.data(), size, output, frame.size(), method);
+
+                samples_t decoded;
+                if (metrics.compressed_payload_size < COMPRESSION_HEADER_SIZE ||
+                    !decode(output, metrics.compressed_payload_size, &decoded) ||
+                    memcmp(decoded.data(), samples.data(), size * sizeof(register_reading_t)) != 0) {
+                    printf("FAIL %s/%zu/%s: round trip mismatch\n", dataset.name, size, metrics.compression_method);
+                    ok = false;
+                    continue;
+                }
+
+                // One byte short of the frame must be reported, not overrun
+                std::vector<uint8_t> short_frame(metrics.compressed_payload_size - 1);
+                compression_metrics_t short_metrics = compress_with_method(samples.data(), size, short_frame.data(),
+                                                                           short_frame.size(), method);
+                if (!short_metrics.truncated || short_metrics.compressed_payload_size != 0) {
+                    printf("FAIL %s/%zu/%s: truncation not reported\n", dataset.name, size, metrics.compression_method);
+                    ok = false;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                for (size_t it = 0; it < iterations; it++) {
+                    metrics = compress_with_method(samples.data(), size, output, frame.size(), method);
+                }
+                auto stop = std::chrono::steady_clock::now();
+                double ns = std::chrono::duration<double, std::nano>(stop - start).count() / (double)iterations;
+
+                printf("%-9s %7zu %-14s %8zu %8zu %7.2f %10.0f", dataset.name, size, metrics.compression_method,
+                       metrics.original_payload_size, metrics.compressed_payload_size, metrics.compression_ratio, ns);
+                if (method == COMPRESSION_METHOD_ADAPTIVE) {
+                    // Winning codec and bytes per register
+                    printf("  ");
+                    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+                        printf(" %s:%u", register_codec_name(metrics.register_codecs[reg]), metrics.register_bytes[reg]);
+                    }
+                }
+                printf("\n");
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
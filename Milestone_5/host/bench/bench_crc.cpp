@@ -0,0 +1,128 @@
+// CRC-16/MODBUS engines against the original bit-by-bit loop, 8 B to 4 KB inputs.
+//
+//   ./bench_crc [total_bytes_per_case]
+
+#include "calculateCRC.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef uint16_t (*crc_update_fn)(uint16_t crc, const uint8_t* data, size_t length);
+
+// The calculateCRC() loop this engine replaced, kept as the reference
+static uint16_t crc16_update_bitwise(uint16_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            if (crc & 0x0001) {
+                crc >>= 1;
+                crc ^= 0xA001;
+            } else {
+                crc >>= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+typedef struct {
+    const char* name;
+    crc_update_fn update;
+} crc_engine_t;
+
+static const crc_engine_t engines[] = {
+    {"bitwise", crc16_update_bitwise},
+    {"table", crc16_update_table},
+    {"slice4", crc16_update_slice4},
+    {"slice8", crc16_update_slice8},
+};
+static const size_t engine_count = sizeof(engines) / sizeof(engines[0]);
+
+static bool check_engines(const std::vector<uint8_t>& data) {
+    static const uint8_t check_input[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    bool ok = true;
+
+    for (size_t e = 0; e < engine_count; e++) {
+        // Standard check value for CRC-16/MODBUS
+        uint16_t check = engines[e].update(CRC16_MODBUS_INIT, check_input, sizeof(check_input));
+        if (check != 0x4B37) {
+            printf("FAIL %s: check value 0x%04X, expected 0x4B37\n", engines[e].name, check);
+            ok = false;
+        }
+
+        // Every length and every split point must agree with the reference
+        for (size_t len = 0; len <= 64; len++) {
+            uint16_t expected = crc16_update_bitwise(CRC16_MODBUS_INIT, data.data(), len);
+            for (size_t split = 0; split <= len; split++) {
+                uint16_t crc = engines[e].update(CRC16_MODBUS_INIT, data.data(), split);
+                crc = engines[e].update(crc, data.data() + split, len - split);
+                if (crc != expected) {
+                    printf("FAIL %s: len %zu split %zu -> 0x%04X, expected 0x%04X\n",
+                           engines[e].name, len, split, crc, expected);
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    uint16_t incremental = crc16_final(crc16_update(crc16_update(crc16_init(), data.data(), 3), data.data() + 3, 9));
+    if (incremental != calculateCRC(data.data(), 12)) {
+        printf("FAIL incremental API does not match calculateCRC()\n");
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    size_t bytes_per_case = argc > 1 ? strtoul(argv[1], nullptr, 10) : 32u * 1024u * 1024u;
+    static const size_t sizes[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+    std::vector<uint8_t> data(4096);
+    uint32_t seed = 0x12345678u;
+    for (size_t i = 0; i < data.size(); i++) {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(seed >> 24);
+    }
+
+    if (!check_engines(data)) {
+        return 1;
+    }
+    printf("All engines match the bitwise reference (check value 0x4B37)\n\n");
+
+    printf("%8s", "bytes");
+    for (size_t e = 0; e < engine_count; e++) {
+        printf(" %11s", engines[e].name);
+    }
+    printf("   ns/call (speed-up vs bitwise)\n");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t len = sizes[s];
+        size_t iterations = bytes_per_case / len;
+        if (iterations == 0) {
+            iterations = 1;
+        }
+
+        double bitwise_ns = 0;
+        printf("%8zu", len);
+        for (size_t e = 0; e < engine_count; e++) {
+            volatile uint16_t sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                sink = sink ^ engines[e].update(CRC16_MODBUS_INIT, data.data(), len);
+            }
+            auto stop = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(stop - start).count() / (double)iterations;
+            if (e == 0) {
+                bitwise_ns = ns;
+                printf(" %11.1f", ns);
+            } else {
+                printf(" %6.1f(%3.0fx)", ns, bitwise_ns / ns);
+            }
+        }
+        printf("\n");
+    }
+    return 0;
+}
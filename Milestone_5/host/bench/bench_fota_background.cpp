@@ -0,0 +1,232 @@
+// Sampling during a firmware update, on the virtual clock. The stand-in cloud puts a FOTA
+// manifest in its upload ACKs after the first minute, and serves a 1.6 MB image over a
+// 100 KB/s link into flash with typical erase and program times. Each scenario runs in a
+// child process, since the scheduler keeps its state in statics:
+//
+//   blocking    the update runs inside the loop, as it did from the upload task
+//   background  the update runs in its own task, at the default budget or without one
+//
+// For each scenario the bench reports how long the update took, and the polls, missed
+// polls, late reads and longest gap between reads while it ran. It also reports the
+// uploads the cloud acknowledged meanwhile, and checks the partition holds the image.
+//
+//   ./bench_fota_background [minutes]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "fota.h"
+#include "modbus_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include <mbedtls/sha256.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+NonceManager nonceManager;
+
+static const char* FW_URL = "https://fw.example.com/fw/ecowatt-v1.0.1.bin";
+static const size_t IMAGE_SIZE = 1600000;
+static const unsigned long MANIFEST_FROM_MS = 60000;
+
+static std::string image;
+static std::string manifest_json;
+static bool send_manifest = true;
+static std::vector<unsigned long> polls;  // First request of every poll, ms
+static uint32_t polls_seen = 0;
+static std::vector<unsigned long> acks;   // Upload ACKs, ms
+static unsigned long fota_started_ms = 0;
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    unsigned long now = millis();
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        uint32_t started = scheduler_get_sample_stats().polls;
+        if (started != polls_seen) {
+            polls_seen = started;
+            polls.push_back(now);
+        }
+        uint8_t frame[64];
+        size_t n = 0;
+        frame[n++] = SLAVE_ADDRESS;
+        frame[n++] = FUNCTION_CODE_READ;
+        frame[n++] = READ_REGISTER_COUNT * 2;
+        for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+            uint16_t value = (uint16_t)(2300 + i);
+            frame[n++] = value >> 8;
+            frame[n++] = value & 0xFF;
+        }
+        n = modbus_append_crc(frame, n, sizeof(frame));
+        char hex[160];
+        modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+        return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+    }
+    if (request.url == FW_URL) {
+        if (fota_started_ms == 0) {
+            fota_started_ms = now;
+        }
+        return host_http_response_t{200, image};
+    }
+    if (request.url.find("/api/cloud/write") != std::string::npos) {
+        acks.push_back(now);
+        if (send_manifest && now >= MANIFEST_FROM_MS) {
+            return host_http_response_t{200, "{\"status\":\"success\",\"fota\":" + manifest_json + "}"};
+        }
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+static std::string sha256_hex(const std::string& data) {
+    unsigned char hash[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    mbedtls_sha256_update_ret(&ctx, (const unsigned char*)data.data(), data.size());
+    mbedtls_sha256_finish_ret(&ctx, hash);
+    mbedtls_sha256_free(&ctx);
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", hash[i]);
+    }
+    return std::string(hex);
+}
+
+typedef enum {
+    RUN_BLOCKING,
+    RUN_BACKGROUND
+} run_mode_t;
+
+typedef struct {
+    const char* name;
+    run_mode_t mode;
+    uint32_t budget;  // Bytes per second, background only
+} scenario_t;
+
+// Runs one scenario in this process and prints its row; returns the number of failures
+static int run(const scenario_t& scenario, unsigned long end_ms) {
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    host_http_set_link(100 * 1024, 5744);
+    host_partitions_set_timing(45000, 2800);
+    fota_set_background_budget(scenario.budget);
+    send_manifest = scenario.mode == RUN_BACKGROUND;
+    error_handler_init();
+    nonceManager.begin();
+    upload_backlog_init();
+    api_init();
+    scheduler_init();
+    init_tasks_last_run(millis());
+
+    unsigned long start_ms = millis();
+    unsigned long fota_done_ms = 0;
+    bool blocking_done = false;
+    while (millis() - start_ms < end_ms && host_esp_restart_count() == 0) {
+        scheduler_run();
+        if (scenario.mode == RUN_BLOCKING && !blocking_done && millis() - start_ms >= MANIFEST_FROM_MS) {
+            // What the upload task used to do with the manifest in its ACK
+            blocking_done = true;
+            if (perform_FOTA_with_manifest(9, FW_URL, IMAGE_SIZE, sha256_hex(image).c_str(), "c2lnbmF0dXJl")) {
+                fota_done_ms = millis();
+                break;
+            }
+        }
+        delay(10);
+    }
+    if (host_esp_restart_count() > 0) {
+        fota_done_ms = millis() - 2000;  // The scheduler waits 2 s before restarting
+    }
+
+    // Reads while the update ran
+    unsigned long from = fota_started_ms, until = fota_done_ms;
+    unsigned long max_gap = 0;
+    uint32_t during = 0, missed = 0, late = 0, acked = 0;
+    for (size_t i = 1; i < polls.size(); i++) {
+        if (polls[i] < from || polls[i] > until) {
+            continue;
+        }
+        during++;
+        unsigned long gap = polls[i] - polls[i - 1];
+        max_gap = gap > max_gap ? gap : max_gap;
+        missed += gap / POLL_INTERVAL_MS > 1 ? gap / POLL_INTERVAL_MS - 1 : 0;
+        late += gap > POLL_INTERVAL_MS + POLL_INTERVAL_MS / 2 ? 1 : 0;
+    }
+    if (polls.back() < until) {
+        // The loop may still have been stuck when the update ended
+        unsigned long gap = until - polls.back();
+        max_gap = gap > max_gap ? gap : max_gap;
+        missed += gap / POLL_INTERVAL_MS;
+    }
+    for (unsigned long t : acks) {
+        acked += t >= from && t <= until ? 1 : 0;
+    }
+
+    const esp_partition_t* app1 = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, nullptr);
+    std::vector<char> flash(IMAGE_SIZE);
+    bool image_ok = esp_partition_read(app1, 0, flash.data(), flash.size()) == ESP_OK &&
+                    memcmp(flash.data(), image.data(), IMAGE_SIZE) == 0 && esp_ota_get_boot_partition() == app1;
+    bool done = fota_started_ms > 0 && fota_done_ms > 0 && image_ok;
+    printf("%-12s %8u %9.1f %7u %7u %7u %8lu %6u\n", scenario.name, scenario.budget / 1024,
+           done ? (until - from) / 1000.0 : 0.0, during, missed, late, max_gap, acked);
+    if (!done) {
+        printf("FAIL %s: the update did not finish with the image set to boot\n", scenario.name);
+        return 1;
+    }
+    if (scenario.mode == RUN_BACKGROUND && (missed > 0 || late > 0)) {
+        printf("FAIL %s: reads fell behind their %d ms cadence during the update\n", scenario.name, POLL_INTERVAL_MS);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long minutes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10;
+
+    image.resize(IMAGE_SIZE);
+    std::mt19937 image_rng(42);
+    for (char& c : image) {
+        c = (char)(image_rng() & 0xFF);
+    }
+    manifest_json = "{\"job_id\":9,\"fwUrl\":\"" + std::string(FW_URL) + "\",\"fwSize\":" +
+                    std::to_string(IMAGE_SIZE) + ",\"shaExpected\":\"" + sha256_hex(image) +
+                    "\",\"signature\":\"c2lnbmF0dXJl\"}";
+
+    const scenario_t scenarios[] = {
+        {"blocking", RUN_BLOCKING, 0},
+        {"background", RUN_BACKGROUND, FOTA_MAX_BYTES_PER_S},
+        {"background", RUN_BACKGROUND, 0},
+    };
+
+    printf("%lu KB image over a 100 KB/s link, poll every %d ms, upload every %d ms\n", IMAGE_SIZE / 1024,
+           POLL_INTERVAL_MS, UPLOAD_INTERVAL_MS);
+    printf("%-12s %8s %9s %7s %7s %7s %8s %6s\n", "update", "KB/s cap", "seconds", "polls", "missed", "late",
+           "max gap", "acks");
+    fflush(stdout);
+
+    int failures = 0;
+    for (const scenario_t& scenario : scenarios) {
+        pid_t child = fork();
+        if (child == 0) {
+            int result = run(scenario, minutes * 60000UL);
+            fflush(stdout);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// Firmware download time with and without the writer task. The stand-in server sends the
+// image over a link of fixed bandwidth into a TCP receive window, and the flash partitions
+// take datasheet-typical time to erase and program. With one buffer the download waits
+// while each chunk is flashed; with two or more the next chunk downloads meanwhile.
+// Reports the update time and throughput for several chunk sizes and buffer counts, and
+// the progress lines printed. Each run checks the partition holds the image.
+//
+// The shim sleeps in real time, so all times are divided by a scale factor to keep the
+// bench short; reported times are scaled back to device time. Progress lines are rate
+// limited on the scaled clock, so they too are fewer than on the device.
+//
+//   ./bench_fota_pipeline [link KB/s] [TCP window B] [image KB] [scale]
+
+#include <Arduino.h>
+#include "config.h"
+#include "fota.h"
+#include "host_shims.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include <mbedtls/sha256.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char* FW_URL = "https://fw.example.com/fw/ecowatt-v1.0.1.bin";
+static const uint32_t ERASE_US_PER_SECTOR = 45000;  // 4 KB sector erase, typical
+static const uint32_t WRITE_US_PER_KB = 2800;       // 0.7 ms per 256-byte page, typical
+
+static std::string image;
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    if (request.url.find("/api/fota/log") != std::string::npos) {
+        return host_http_response_t{200, "{\"status\":\"success\"}"};
+    }
+    if (request.url != FW_URL) {
+        return host_http_response_t{404, ""};
+    }
+    return host_http_response_t{200, image};
+}
+
+static String sha256_hex(const std::string& data) {
+    unsigned char hash[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    mbedtls_sha256_update_ret(&ctx, (const unsigned char*)data.data(), data.size());
+    mbedtls_sha256_finish_ret(&ctx, hash);
+    mbedtls_sha256_free(&ctx);
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", hash[i]);
+    }
+    return String(hex);
+}
+
+static size_t count_lines(const std::string& text, const char* prefix) {
+    size_t count = 0;
+    for (size_t at = text.find(prefix); at != std::string::npos; at = text.find(prefix, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    uint32_t link_kbps = argc > 1 ? (uint32_t)atoi(argv[1]) : 100;
+    size_t window = argc > 2 ? (size_t)atoi(argv[2]) : 5744;  // lwIP default on the ESP32
+    size_t image_kb = argc > 3 ? (size_t)atoi(argv[3]) : 256;
+    uint32_t scale = argc > 4 ? (uint32_t)atoi(argv[4]) : 5;
+    Serial.set_echo(false);
+
+    image.resize(image_kb * 1024);
+    std::mt19937 image_rng(42);
+    for (char& c : image) {
+        c = (char)(image_rng() & 0xFF);
+    }
+    String sha = sha256_hex(image);
+    host_http_set_handler(stand_in_server);
+
+    printf("image %zu KB, link %u KB/s, window %zu B, flash %u ms/sector erase + %u us/KB write\n",
+           image_kb, link_kbps, window, ERASE_US_PER_SECTOR / 1000, WRITE_US_PER_KB);
+    printf("%-8s %-8s %10s %10s %10s\n", "chunk B", "buffers", "seconds", "KB/s", "progress");
+
+    const size_t chunk_sizes[] = {1024, 4096, 8192};
+    const uint8_t buffer_counts[] = {1, 2, 3};
+    int failures = 0;
+    for (size_t chunk : chunk_sizes) {
+        for (uint8_t buffers : buffer_counts) {
+            host_partitions_reset();
+            host_nvs_reset();
+            host_spiffs_reset();
+            host_partitions_set_timing(ERASE_US_PER_SECTOR / scale, WRITE_US_PER_KB / scale);
+            host_http_set_link(link_kbps * 1024 * scale, window);
+            fota_set_pipeline(chunk, buffers);
+            Serial.clear_captured();
+
+            auto start = std::chrono::steady_clock::now();
+            bool done = perform_FOTA_with_manifest(1, FW_URL, image.size(), sha, "c2lnbmF0dXJl");
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * scale;
+            host_http_set_link(0, 0);
+
+            const esp_partition_t* app1 = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, nullptr);
+            std::vector<char> flash(image.size());
+            bool image_ok = esp_partition_read(app1, 0, flash.data(), flash.size()) == ESP_OK &&
+                            memcmp(flash.data(), image.data(), image.size()) == 0;
+
+            printf("%-8zu %-8u %10.2f %10.1f %10zu\n", chunk, buffers, seconds, image_kb / seconds,
+                   count_lines(Serial.captured(), "[FOTA] Progress"));
+            if (!done || !image_ok) {
+                printf("FAIL chunk %zu, %u buffers: update %s, image %s\n", chunk, buffers,
+                       done ? "done" : "failed", image_ok ? "ok" : "corrupt");
+                failures++;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
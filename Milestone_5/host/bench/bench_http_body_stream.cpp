@@ -0,0 +1,177 @@
+// Reading HTTP response bodies in api_client: the inverter reply is hex-decoded out of the
+// socket in HTTP_READ_CHUNK pieces instead of through getString() and a JsonDocument.
+// Compares the old path, rebuilt here on the same shim, with api_send_frame() for replies
+// of several sizes, with and without Content-Length. Reports heap allocations and the
+// peak of live heap bytes per request, and checks that a body over HTTP_MAX_BODY_BYTES
+// is refused.
+//
+//   ./bench_http_body_stream [iterations]
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include "config.h"
+#include "api_client.h"
+#include "modbus_handler.h"
+#include "host_shims.h"
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_support.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static std::string reply_body;
+static bool reply_chunked = false;
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    (void)request;
+    host_http_response_t response{200, reply_body};
+    response.chunked = reply_chunked;
+    return response;
+}
+
+// A read reply carrying `registers` registers, with `padding` bytes of extra members
+// after the frame, as a server adding diagnostics would send
+static std::string read_reply(int registers, size_t padding, std::vector<uint8_t>* expected) {
+    uint8_t frame[MODBUS_MAX_FRAME_SIZE];
+    size_t n = 0;
+    frame[n++] = SLAVE_ADDRESS;
+    frame[n++] = FUNCTION_CODE_READ;
+    frame[n++] = (uint8_t)(registers * 2);
+    for (int i = 0; i < registers; i++) {
+        frame[n++] = (uint8_t)(0x08 + i);
+        frame[n++] = (uint8_t)(0xFC - i);
+    }
+    n = modbus_append_crc(frame, n, sizeof(frame));
+    expected->assign(frame, frame + n);
+    char hex[MODBUS_MAX_FRAME_SIZE * 2 + 1];
+    modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+    std::string body = std::string("{\"frame\":\"") + hex + "\"";
+    if (padding > 0) {
+        body += ",\"diagnostics\":\"" + std::string(padding, 'x') + "\"";
+    }
+    return body + ",\"status\":\"ok\"}";
+}
+
+// What api_send_frame() did before: the whole body as a String, then a JsonDocument
+static bool read_with_get_string(const char* url, const uint8_t* request, size_t request_length,
+                                 uint8_t* response, size_t response_size, size_t* response_length) {
+    char frame_hex[MODBUS_MAX_FRAME_SIZE * 2 + 1];
+    modbus_bytes_to_hex(request, request_length, frame_hex, sizeof(frame_hex));
+    char body[MODBUS_MAX_FRAME_SIZE * 2 + 16];
+    snprintf(body, sizeof(body), "{\"frame\":\"%s\"}", frame_hex);
+
+    HTTPClient http;
+    http.begin(url);
+    http.addHeader("Content-Type", "application/json");
+    http.addHeader("Authorization", API_KEY);
+    int code = http.POST((uint8_t*)body, strlen(body));
+    if (code != HTTP_CODE_OK) {
+        http.end();
+        return false;
+    }
+    String text = http.getString();
+    http.end();
+    JsonDocument doc;
+    if (deserializeJson(doc, text)) {
+        return false;
+    }
+    if (!doc["frame"].is<const char*>()) {
+        return false;
+    }
+    String hex = doc["frame"].as<String>();
+    *response_length = modbus_hex_to_bytes(hex.c_str(), hex.length(), response, response_size);
+    return *response_length > 0;
+}
+
+typedef struct {
+    double allocations;
+    size_t peak;
+    bool ok;
+    std::vector<uint8_t> frame;
+} run_result_t;
+
+static run_result_t run(bool streamed, const char* url, const uint8_t* request, size_t request_length, int iterations) {
+    run_result_t result = {};
+    size_t allocations_before = allocation_count;
+    result.ok = true;
+    for (int i = 0; i < iterations; i++) {
+        Serial.clear_captured();
+        uint8_t response[MODBUS_MAX_FRAME_SIZE];
+        size_t response_length = 0;
+        size_t live_before = live_bytes;
+        peak_bytes = live_bytes;
+        bool ok = streamed
+            ? api_send_frame(url, API_KEY, request, request_length, response, sizeof(response), &response_length)
+            : read_with_get_string(url, request, request_length, response, sizeof(response), &response_length);
+        if (peak_bytes - live_before > result.peak) {
+            result.peak = peak_bytes - live_before;
+        }
+        result.ok = result.ok && ok;
+        result.frame.assign(response, response + response_length);
+    }
+    result.allocations = (double)(allocation_count - allocations_before) / iterations;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    api_init();
+
+    const String url = String(API_BASE_URL) + "/api/inverter/read";
+    uint8_t request[8];
+    size_t request_length = modbus_build_request(request, sizeof(request), SLAVE_ADDRESS, FUNCTION_CODE_READ, 0, 2);
+
+    typedef struct {
+        const char* name;
+        int registers;
+        size_t padding;
+    } reply_shape_t;
+    const reply_shape_t shapes[] = {
+        {"2 regs", 2, 0},
+        {"10 regs", 10, 0},
+        {"60 regs", 60, 0},
+        {"10 regs+1K", 10, 1024},
+    };
+
+    printf("%-12s %-8s %-11s %10s %10s\n", "reply", "length", "path", "allocs", "peak B");
+    int failures = 0;
+    for (const reply_shape_t& shape : shapes) {
+        std::vector<uint8_t> expected;
+        reply_body = read_reply(shape.registers, shape.padding, &expected);
+        for (int chunked = 0; chunked < 2; chunked++) {
+            reply_chunked = chunked != 0;
+            run_result_t before = run(false, url.c_str(), request, request_length, iterations);
+            run_result_t after = run(true, url.c_str(), request, request_length, iterations);
+            const char* length = reply_chunked ? "chunked" : "known";
+            printf("%-12s %-8s %-11s %10.1f %10zu\n", shape.name, length, "getString", before.allocations, before.peak);
+            printf("%-12s %-8s %-11s %10.1f %10zu\n", "", "", "streamed", after.allocations, after.peak);
+            if (!before.ok || !after.ok || before.frame != expected || after.frame != expected) {
+                printf("FAIL %s (%s): decoded frame differs\n", shape.name, length);
+                failures++;
+            }
+        }
+    }
+
+    // A body over HTTP_MAX_BODY_BYTES, with the frame behind the padding, is refused
+    std::vector<uint8_t> expected;
+    std::string padded = read_reply(10, 0, &expected);
+    reply_body = "{\"diagnostics\":\"" + std::string(HTTP_MAX_BODY_BYTES, 'x') + "\"," + padded.substr(1);
+    for (int chunked = 0; chunked < 2; chunked++) {
+        reply_chunked = chunked != 0;
+        run_result_t oversized = run(true, url.c_str(), request, request_length, 1);
+        printf("\n%zu-byte body, %s length: %s, peak %zu B", reply_body.size(), reply_chunked ? "chunked" : "known",
+               oversized.ok ? "accepted" : "refused", oversized.peak);
+        if (oversized.ok) {
+            printf("\nFAIL body over HTTP_MAX_BODY_BYTES was accepted");
+            failures++;
+        }
+    }
+    printf("\n");
+    return failures == 0 ? 0 : 1;
+}
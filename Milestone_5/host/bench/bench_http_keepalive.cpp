@@ -0,0 +1,139 @@
+// Connection reuse in api_client against the in-process HTTP stand-in.
+// Replays the device's traffic pattern on the virtual clock: an inverter poll every
+// POLL_INTERVAL_MS and a cloud upload every UPLOAD_INTERVAL_MS. The stand-in server closes
+// idle connections periodically and refuses connections for a while, so lazy reconnects
+// are exercised. Reports per-host reuse and the connections opened per request.
+//
+//   ./bench_http_keepalive [minutes] [server_idle_close_s]
+
+#include <Arduino.h>
+#include "config.h"
+#include "api_client.h"
+#include "modbus_handler.h"
+#include "host_shims.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static bool server_down = false;
+static bool server_times_out = false;
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    if (server_down) {
+        return host_http_response_t{HTTPC_ERROR_CONNECTION_REFUSED, ""};
+    }
+    if (server_times_out) {
+        // The request arrived but no reply came back in time
+        return host_http_response_t{HTTPC_ERROR_READ_TIMEOUT, ""};
+    }
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        uint8_t frame[32];
+        size_t n = 0;
+        frame[n++] = SLAVE_ADDRESS;
+        frame[n++] = FUNCTION_CODE_READ;
+        frame[n++] = 4;
+        frame[n++] = 0x08; frame[n++] = 0xFC;
+        frame[n++] = 0x00; frame[n++] = 0x34;
+        n = modbus_append_crc(frame, n, sizeof(frame));
+        char hex[80];
+        modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+        return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+int main(int argc, char** argv) {
+    unsigned long minutes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 60;
+    unsigned long idle_close_s = argc > 2 ? strtoul(argv[2], nullptr, 10) : 300;
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    host_http_reset_stats();
+    api_init();
+
+    const String read_url = String(API_BASE_URL) + "/api/inverter/read";
+    const String upload_url = String(UPLOAD_API_BASE_URL) + "/api/cloud/write";
+    const unsigned long end_ms = minutes * 60000UL;
+    const unsigned long outage_start_ms = end_ms / 2;
+    const unsigned long outage_end_ms = outage_start_ms + 60000UL;
+
+    uint32_t per_request_reused[API_HOST_COUNT] = {0};
+    uint32_t succeeded = 0;
+    uint32_t failed = 0;
+    unsigned long next_upload_ms = UPLOAD_INTERVAL_MS;
+    unsigned long next_close_ms = idle_close_s * 1000UL;
+
+    for (unsigned long now = POLL_INTERVAL_MS; now <= end_ms; now += POLL_INTERVAL_MS) {
+        host_clock_set_us((uint64_t)now * 1000);
+        server_down = now >= outage_start_ms && now < outage_end_ms;
+        if (idle_close_s > 0 && now >= next_close_ms) {
+            host_http_drop_connections();
+            next_close_ms += idle_close_s * 1000UL;
+        }
+
+        uint8_t request[8];
+        size_t request_len = modbus_build_request(request, sizeof(request), SLAVE_ADDRESS, FUNCTION_CODE_READ, 0, 2);
+        uint8_t response[32];
+        size_t response_len = 0;
+        bool ok = api_send_frame(read_url.c_str(), API_KEY, request, request_len, response, sizeof(response), &response_len);
+        api_request_info_t info = api_get_last_request();
+        per_request_reused[info.host] += info.reused ? 1 : 0;
+        ok ? succeeded++ : failed++;
+
+        if (now >= next_upload_ms) {
+            const uint8_t payload[48] = {0};
+            String reply = upload_api_send_request(upload_url, "POST", UPLOAD_API_KEY, payload, sizeof(payload), "1", "mac", "aes-256-cbc");
+            info = api_get_last_request();
+            per_request_reused[info.host] += info.reused ? 1 : 0;
+            reply.length() > 0 ? succeeded++ : failed++;
+            next_upload_ms += UPLOAD_INTERVAL_MS;
+        }
+    }
+
+    printf("%lu min, server closes idle connections every %lus, refuses connections for 60 s at %lu min\n",
+           minutes, idle_close_s, outage_start_ms / 60000UL);
+    printf("HTTP_KEEP_ALIVE=%d\n\n", HTTP_KEEP_ALIVE);
+    printf("%-9s %8s %8s %8s %6s %8s %8s\n", "host", "requests", "reused", "connects", "stale", "failures", "reuse %");
+
+    int failures = 0;
+    const char* names[API_HOST_COUNT] = {"inverter", "cloud", "other"};
+    for (int host = 0; host < API_HOST_OTHER; host++) {
+        api_connection_stats_t stats = api_get_connection_stats((api_host_t)host);
+        printf("%-9s %8u %8u %8u %6u %8u %7.1f%%\n", names[host], stats.requests, stats.reused, stats.connects,
+               stats.stale, stats.failures, stats.requests ? 100.0 * stats.reused / stats.requests : 0.0);
+        if (stats.reused != per_request_reused[host]) {
+            printf("FAIL %s: per-request reuse count %u differs from the pool's %u\n", names[host],
+                   per_request_reused[host], stats.reused);
+            failures++;
+        }
+    }
+
+    host_http_stats_t server = host_http_get_stats();
+    printf("\nstand-in server: %u requests on %u connections (%.2f connections per request)\n", server.requests,
+           server.connections_opened, server.requests ? (double)server.connections_opened / server.requests : 0.0);
+    printf("requests: %u succeeded, %u failed during the outage\n", succeeded, failed);
+
+    // Only the outage may fail; every idle close must have been recovered transparently
+    uint32_t outage_requests = (uint32_t)(60000UL / POLL_INTERVAL_MS + 60000UL / UPLOAD_INTERVAL_MS);
+    if (failed > outage_requests) {
+        printf("FAIL %u requests failed outside the outage\n", failed - outage_requests);
+        failures++;
+    }
+
+    // A reply that times out on a kept-alive connection must not be sent again: the server
+    // may already have stored the upload
+    const uint8_t payload[48] = {0};
+    upload_api_send_request(upload_url, "POST", UPLOAD_API_KEY, payload, sizeof(payload), "1", "mac", "aes-256-cbc");
+    uint32_t requests_before = host_http_get_stats().requests;
+    server_times_out = true;
+    String reply = upload_api_send_request(upload_url, "POST", UPLOAD_API_KEY, payload, sizeof(payload), "1", "mac", "aes-256-cbc");
+    server_times_out = false;
+    uint32_t sent = host_http_get_stats().requests - requests_before;
+    printf("upload timing out on a reused connection: %u request(s) reached the server\n", sent);
+    if (sent != 1 || reply.length() > 0) {
+        printf("FAIL the timed-out upload was sent %u times\n", sent);
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// Heap allocations and time per Modbus poll: the hex-String API against the binary frame API.
+// Covers building the request, the JSON body / response text at the HTTP boundary and
+// decoding the registers. The HTTP transport itself is not included.
+//
+//   ./bench_modbus_alloc [polls]
+
+#include <Arduino.h>
+#include "config.h"
+#include "modbus_handler.h"
+#include "calculateCRC.h"
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_support.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Response JSON as the inverter API returns it, for READ_REGISTER_COUNT registers
+static std::string make_response_json(void) {
+    uint8_t frame[MODBUS_MAX_FRAME_SIZE];
+    size_t length = 0;
+    frame[length++] = SLAVE_ADDRESS;
+    frame[length++] = FUNCTION_CODE_READ;
+    frame[length++] = READ_REGISTER_COUNT * 2;
+    for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+        uint16_t value = (uint16_t)(2300 + i * 37);
+        frame[length++] = value >> 8;
+        frame[length++] = value & 0xFF;
+    }
+    length = modbus_append_crc(frame, length, sizeof(frame));
+
+    char hex[MODBUS_MAX_FRAME_SIZE * 2 + 1];
+    modbus_bytes_to_hex(frame, length, hex, sizeof(hex));
+    return std::string("{\"frame\":\"") + hex + "\"}";
+}
+
+// The String-based path, as execute_read_task() and api_send_request() did it
+static size_t poll_string_api(const String& response_text, uint16_t* values) {
+    String frame = format_request_frame(SLAVE_ADDRESS, FUNCTION_CODE_READ, 0, READ_REGISTER_COUNT);
+    frame = append_crc_to_frame(frame);
+
+    String request_body;
+    request_body.reserve(frame.length() + 20);
+    request_body = F("{\"frame\":\"");
+    request_body += frame;
+    request_body += F("\"}");
+
+    int start = response_text.indexOf(F("\"frame\":\""));
+    start += 9;
+    int end = response_text.indexOf('\"', start);
+    String frame_hex = response_text.substring(start, end);
+
+    size_t actual_count = 0;
+    decode_response_registers(frame_hex, values, READ_REGISTER_COUNT, &actual_count);
+    return actual_count + request_body.length();
+}
+
+// The binary path, as execute_read_task() and api_send_frame() do it now
+static size_t poll_binary_api(const String& response_text, uint16_t* values) {
+    uint8_t frame[MODBUS_REQUEST_FRAME_SIZE];
+    size_t frame_length = modbus_build_request(frame, sizeof(frame), SLAVE_ADDRESS, FUNCTION_CODE_READ, 0, READ_REGISTER_COUNT);
+
+    static const char body_prefix[] = "{\"frame\":\"";
+    char request_body[sizeof(body_prefix) + 2 + MODBUS_MAX_FRAME_SIZE * 2];
+    size_t body_length = sizeof(body_prefix) - 1;
+    memcpy(request_body, body_prefix, body_length);
+    body_length += modbus_bytes_to_hex(frame, frame_length, request_body + body_length, sizeof(request_body) - body_length);
+    memcpy(request_body + body_length, "\"}", 3);
+    body_length += 2;
+
+    const char* start = strstr(response_text.c_str(), "\"frame\":\"") + 9;
+    const char* end = strchr(start, '\"');
+    uint8_t response[MODBUS_MAX_FRAME_SIZE];
+    size_t response_length = modbus_hex_to_bytes(start, end - start, response, sizeof(response));
+
+    size_t actual_count = 0;
+    modbus_decode_registers(response, response_length, values, READ_REGISTER_COUNT, &actual_count);
+    return actual_count + body_length;
+}
+
+typedef size_t (*poll_fn)(const String& response_text, uint16_t* values);
+
+static void run(const char* name, poll_fn poll, const String& response_text, size_t polls) {
+    uint16_t values[READ_REGISTER_COUNT];
+    volatile size_t sink = 0;
+
+    // Warm-up poll, so one-time setup is not counted
+    sink = sink + poll(response_text, values);
+
+    size_t count_before = allocation_count;
+    size_t bytes_before = allocation_bytes;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < polls; i++) {
+        sink = sink + poll(response_text, values);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / (double)polls;
+    printf("%-8s %10.2f allocs/poll %10.1f bytes/poll %10.1f ns/poll\n", name,
+           (double)(allocation_count - count_before) / (double)polls,
+           (double)(allocation_bytes - bytes_before) / (double)polls, ns);
+}
+
+static bool check_equivalence(const String& response_text) {
+    uint16_t string_values[READ_REGISTER_COUNT] = {0};
+    uint16_t binary_values[READ_REGISTER_COUNT] = {0};
+    poll_string_api(response_text, string_values);
+    poll_binary_api(response_text, binary_values);
+    if (memcmp(string_values, binary_values, sizeof(string_values)) != 0) {
+        printf("FAIL: decoded registers differ\n");
+        return false;
+    }
+
+    // Request frames must match byte for byte
+    uint8_t frame[MODBUS_REQUEST_FRAME_SIZE];
+    char hex[MODBUS_REQUEST_FRAME_SIZE * 2 + 1];
+    size_t length = modbus_build_request(frame, sizeof(frame), SLAVE_ADDRESS, FUNCTION_CODE_WRITE, EXPORT_POWER_REGISTER, 55);
+    modbus_bytes_to_hex(frame, length, hex, sizeof(hex));
+    String legacy = append_crc_to_frame(format_request_frame(SLAVE_ADDRESS, FUNCTION_CODE_WRITE, EXPORT_POWER_REGISTER, 55));
+    if (legacy != hex) {
+        printf("FAIL: request frame %s, expected %s\n", hex, legacy.c_str());
+        return false;
+    }
+
+    // A corrupted CRC and an exception frame must both be rejected
+    uint8_t bad[MODBUS_MAX_FRAME_SIZE];
+    const char* start = strstr(response_text.c_str(), "\"frame\":\"") + 9;
+    size_t bad_length = modbus_hex_to_bytes(start, strchr(start, '\"') - start, bad, sizeof(bad));
+    bad[bad_length - 1] ^= 0x01;
+    size_t count = 0;
+    uint8_t exception[5] = {SLAVE_ADDRESS, FUNCTION_CODE_READ | 0x80, 0x02, 0, 0};
+    modbus_append_crc(exception, 3, sizeof(exception));
+    if (modbus_decode_registers(bad, bad_length, binary_values, READ_REGISTER_COUNT, &count) ||
+        modbus_decode_registers(exception, sizeof(exception), binary_values, READ_REGISTER_COUNT, &count) ||
+        modbus_exception_code(exception, sizeof(exception)) != 0x02) {
+        printf("FAIL: corrupted or exception frame accepted\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t polls = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+
+    // Keep the serial log from allocating while counting
+    Serial.set_capture(false);
+    Serial.set_echo(false);
+
+    String response_text(make_response_json().c_str());
+    if (!check_equivalence(response_text)) {
+        return 1;
+    }
+    printf("String and binary paths agree on %d registers\n\n", READ_REGISTER_COUNT);
+
+    run("string", poll_string_api, response_text, polls);
+    run("binary", poll_binary_api, response_text, polls);
+    return 0;
+}
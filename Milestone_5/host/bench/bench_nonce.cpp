@@ -0,0 +1,136 @@
+// NonceManager against the in-memory SPIFFS stand-in. Reports the flash writes and bytes
+// per nonce compared with rewriting the counter on every upload, and the time per nonce.
+// Then cuts the power at each flash mutation of a block reservation, and at random points
+// over many reboots, and checks that no nonce is ever handed out twice.
+//
+//   ./bench_nonce [nonces] [reboots]
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "config.h"
+#include "encryptionAndSecurity.h"
+#include "host_shims.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Previous behaviour with a real counter: rewrite the file for every nonce
+static uint32_t naive_nonce(uint32_t* counter) {
+    uint32_t nonce = ++*counter;
+    File file = SPIFFS.open("/nonce_naive.txt", "w");
+    file.print(nonce);
+    file.close();
+    return nonce;
+}
+
+typedef struct {
+    uint32_t issued;       // Nonces handed out
+    uint32_t highest;      // Largest nonce handed out
+    uint32_t violations;   // Nonces not above every earlier one
+} nonce_log_t;
+
+static void take(NonceManager& manager, nonce_log_t* log, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t nonce = manager.getAndIncrementNonce();
+        if (nonce == 0) {
+            return;  // Reservation failed: nothing handed out
+        }
+        if (nonce <= log->highest) {
+            log->violations++;
+        }
+        log->highest = nonce;
+        log->issued++;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t nonces = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    uint32_t reboots = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000;
+    Serial.set_echo(false);
+    int failures = 0;
+
+    // Flash wear and time per nonce
+    host_spiffs_reset();
+    SPIFFS.begin(true);
+    uint32_t counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nonces; i++) {
+        naive_nonce(&counter);
+    }
+    double naive_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    uint32_t naive_bytes = host_spiffs_bytes_written();
+
+    host_spiffs_reset();
+    NonceManager manager;
+    manager.begin();
+    nonce_log_t log = {};
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nonces; i++) {
+        Serial.clear_captured();
+        take(manager, &log, 1);
+    }
+    double block_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u nonces          %12s %12s %10s\n", nonces, "flash writes", "bytes", "us/nonce");
+    printf("%-24s %12u %12u %10.3f\n", "rewrite per nonce", nonces, naive_bytes, naive_us / nonces);
+    printf("%-24s %12u %12u %10.3f\n", "block reservation", manager.getFlashWrites(), host_spiffs_bytes_written(),
+           block_us / nonces);
+    if (log.issued != nonces || log.violations > 0 || manager.getFlashWrites() != (nonces + NONCE_BLOCK_SIZE - 1) / NONCE_BLOCK_SIZE) {
+        printf("FAIL expected %u monotonic nonces from one write per %d\n", nonces, NONCE_BLOCK_SIZE);
+        failures++;
+    }
+    if (manager.peekNonce() != log.highest + 1) {
+        printf("FAIL peekNonce() is %u after nonce %u\n", manager.peekNonce(), log.highest);
+        failures++;
+    }
+
+    // Power cut at each mutation of one reservation (create the file, write it) and after it
+    printf("\npower cut during a block reservation:\n");
+    for (int cut = 0; cut <= 2; cut++) {
+        host_spiffs_reset();
+        nonce_log_t cut_log = {};
+        {
+            NonceManager before;
+            before.begin();
+            take(before, &cut_log, NONCE_BLOCK_SIZE);  // Exactly the first block
+            host_spiffs_cut_power_after(cut);
+            take(before, &cut_log, 10);
+        }
+        host_spiffs_restore_power();
+        NonceManager after;
+        after.begin();
+        uint32_t resumed = after.peekNonce();
+        take(after, &cut_log, 1);
+        bool ok = cut_log.violations == 0 && resumed > NONCE_BLOCK_SIZE;
+        printf("  after %d mutations: %u issued before the reboot, resumed at %u: %s\n", cut,
+               cut_log.issued - 1, resumed, ok ? "ok" : "REUSED");
+        failures += ok ? 0 : 1;
+    }
+
+    // Random cuts over many reboots, one nonce log across all of them
+    srand(11);
+    host_spiffs_reset();
+    nonce_log_t run_log = {};
+    uint32_t skipped = 0;
+    uint32_t cuts = 0;
+    for (uint32_t boot = 0; boot < reboots; boot++) {
+        NonceManager device;
+        device.begin();
+        skipped += device.peekNonce() - (run_log.highest + 1);
+        if (rand() % 2) {
+            host_spiffs_cut_power_after(rand() % 8);
+            cuts++;
+        }
+        take(device, &run_log, (uint32_t)(rand() % (3 * NONCE_BLOCK_SIZE)));
+        host_spiffs_restore_power();
+    }
+    printf("\n%u reboots (%u with a power cut): %u nonces, highest %u, %u duplicates or reversals,"
+           " %.0f nonces skipped per reboot\n", reboots, cuts, run_log.issued, run_log.highest, run_log.violations,
+           (double)skipped / reboots);
+    if (run_log.violations > 0) {
+        printf("FAIL a nonce was handed out twice\n");
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// The acquisition/upload pipeline against everything in loop(), on the simulation
+// harness. The saved config polls every 50 ms and uploads every second. The stand-in
+// inverter answers in 2-8 ms, and the stand-in cloud takes 20-150 ms to ACK an upload; one
+// upload in eight stalls for 600 ms, as on a slow handshake. Both scenarios run for the
+// same virtual time, each in a child process, since the scheduler keeps its state in statics:
+//
+//   loop       scheduler_run(); polls wait while an upload is under way
+//   pipeline   acquisition and upload tasks, sharing the sample ring; they take turns on
+//              the virtual clock, so a poll runs while the upload waits for the cloud
+//
+// For each scenario the bench reports the polls and readings stored per second, the
+// missed polls, the mean and worst start of a poll after its deadline, the longest gap
+// between polls and the readings dropped because the ring was full.
+//
+//   ./bench_pipeline [seconds]
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "scheduler.h"
+#include "sim_harness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const uint32_t SAMPLING_MS = 50;
+static const uint32_t UPLOAD_MS = 1000;
+
+// The intervals the cloud would have pushed, as ConfigManager finds them at boot
+static void save_config(void) {
+    uint16_t registers[MAX_REGISTERS];
+    for (int i = 0; i < MAX_REGISTERS; i++) {
+        registers[i] = (uint16_t)i;
+    }
+    Preferences prefs;
+    prefs.begin("device_config", false);
+    prefs.putUInt("sampling_ms", SAMPLING_MS);
+    prefs.putUInt("upload_ms", UPLOAD_MS);
+    prefs.putUChar("slave_addr", SLAVE_ADDRESS);
+    prefs.putUChar("reg_count", READ_REGISTER_COUNT);
+    prefs.putBytes("registers", registers, sizeof(registers));
+    prefs.end();
+}
+
+static int run(bool pipeline, unsigned long run_ms) {
+    Serial.set_capture(false);
+    save_config();
+    sim_backend_t backend = sim_default_backend();
+    backend.read_ms_min = 2;
+    backend.read_ms_max = 8;
+    backend.upload_ms_min = 20;
+    backend.upload_ms_max = 150;
+    backend.read_fail_per_mille = 0;
+    backend.upload_fail_per_mille = 0;
+    backend.upload_stall_every = 8;
+    backend.upload_stall_ms = 600;
+    sim_init(backend);
+
+    uint64_t start_ms = sim_now_ms();
+    if (pipeline) {
+        if (!sim_run_pipeline_for(run_ms)) {
+            printf("FAIL pipeline: tasks did not start\n");
+            return 1;
+        }
+    } else {
+        sim_run_for(run_ms);
+    }
+    double seconds = (sim_now_ms() - start_ms) / 1000.0;
+
+    uint32_t reads_answered = 0;
+    uint32_t uploads_acked = 0;
+    for (const sim_event_t& event : sim_timeline()) {
+        reads_answered += event.type == SIM_EVENT_READ && event.value > 0 ? 1 : 0;
+        uploads_acked += event.type == SIM_EVENT_UPLOAD && event.value > 0 ? 1 : 0;
+    }
+
+    sample_stats_t stats = scheduler_get_sample_stats();
+    task_timing_t timing = scheduler_get_task_timing(TASK_READ_REGISTERS);
+    printf("%-9s %7u %7.1f %7.1f %7u %8.1f %8u %8u %7u %7u\n", pipeline ? "pipeline" : "loop",
+           stats.polls, stats.polls / seconds, stats.stored / seconds, stats.missed_polls,
+           timing.runs ? (double)timing.total_lateness_ms / timing.runs : 0.0, timing.max_lateness_ms,
+           stats.max_read_gap_ms, stats.dropped_full, uploads_acked);
+
+    if (!pipeline) {
+        return 0;
+    }
+    // Thread wake-ups on a busy host can be late now and then, but the ring must not overflow
+    if (stats.dropped_full > 0 || stats.missed_polls > stats.polls / 100) {
+        printf("FAIL pipeline: %u polls missed, %u readings dropped\n", stats.missed_polls, stats.dropped_full);
+        return 1;
+    }
+    if (stats.stored < reads_answered) {
+        printf("FAIL pipeline: %u readings answered but only %u stored\n", reads_answered, stats.stored);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 60;
+
+    printf("%lu s per scenario, poll every %u ms, upload every %u ms (20-150 ms, 1 in 8 stalls 600 ms)\n",
+           seconds, SAMPLING_MS, UPLOAD_MS);
+    printf("%-9s %7s %7s %7s %7s %8s %8s %8s %7s %7s\n", "mode", "polls", "polls/s", "saved/s", "missed",
+           "late ms", "max late", "max gap", "dropped", "uploads");
+    fflush(stdout);
+
+    int failures = 0;
+    for (bool pipeline : {false, true}) {
+        pid_t child = fork();
+        if (child == 0) {
+            int result = run(pipeline, seconds * 1000UL);
+            fflush(stdout);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+// Read cadence of the scheduler while requests fail and retry, on the virtual clock.
+// The cloud answers 503 for a stretch in the middle of the run, so every upload and its
+// retries fail. Later the inverter stops answering for a shorter stretch. Failed requests
+// back off through their api_retry_t while the loop keeps running. The bench records when
+// each poll reached the inverter and prints the gaps between polls as a histogram, per phase.
+//
+//   ./bench_read_cadence [minutes]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "modbus_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+NonceManager nonceManager;
+
+static unsigned long cloud_down_from_ms = 0;
+static unsigned long cloud_down_until_ms = 0;
+static unsigned long inverter_down_from_ms = 0;
+static unsigned long inverter_down_until_ms = 0;
+static std::vector<unsigned long> polls;  // First request of every poll, ms
+static uint32_t polls_seen = 0;
+
+static bool within(unsigned long t, unsigned long from, unsigned long until) {
+    return t >= from && t < until;
+}
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    unsigned long now = millis();
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        // Retries repeat the poll's request; only the first request of a poll is timed
+        uint32_t started = scheduler_get_sample_stats().polls;
+        if (started != polls_seen) {
+            polls_seen = started;
+            polls.push_back(now);
+        }
+        if (within(now, inverter_down_from_ms, inverter_down_until_ms)) {
+            return host_http_response_t{HTTPC_ERROR_READ_TIMEOUT, ""};
+        }
+        uint8_t frame[64];
+        size_t n = 0;
+        frame[n++] = SLAVE_ADDRESS;
+        frame[n++] = FUNCTION_CODE_READ;
+        frame[n++] = READ_REGISTER_COUNT * 2;
+        for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+            uint16_t value = (uint16_t)(2300 + i);
+            frame[n++] = value >> 8;
+            frame[n++] = value & 0xFF;
+        }
+        n = modbus_append_crc(frame, n, sizeof(frame));
+        char hex[160];
+        modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+        return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+    }
+    if (within(now, cloud_down_from_ms, cloud_down_until_ms)) {
+        return host_http_response_t{503, ""};
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+typedef struct {
+    const char* name;
+    unsigned long from_ms;
+    unsigned long until_ms;
+} phase_t;
+
+// Gap histogram of the polls that started inside [from, until)
+static void print_phase(const phase_t& phase, unsigned long interval_ms, unsigned long* late) {
+    const double edges[] = {1.1, 1.5, 2.0, 4.0};
+    uint32_t buckets[5] = {0};
+    unsigned long max_gap = 0;
+    size_t gaps = 0;
+    for (size_t i = 1; i < polls.size(); i++) {
+        if (!within(polls[i], phase.from_ms, phase.until_ms)) {
+            continue;
+        }
+        unsigned long gap = polls[i] - polls[i - 1];
+        size_t b = 0;
+        while (b < 4 && gap > edges[b] * interval_ms) {
+            b++;
+        }
+        buckets[b]++;
+        gaps++;
+        if (gap > max_gap) {
+            max_gap = gap;
+        }
+        if (gap > interval_ms + interval_ms / 2) {
+            (*late)++;
+        }
+    }
+    printf("%-14s %6zu %7u %7u %7u %7u %7u %8lu\n", phase.name, gaps, buckets[0], buckets[1], buckets[2],
+           buckets[3], buckets[4], max_gap);
+}
+
+int main(int argc, char** argv) {
+    unsigned long minutes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 60;
+    const unsigned long end_ms = minutes * 60000UL;
+    cloud_down_from_ms = end_ms / 6;
+    cloud_down_until_ms = end_ms / 2;
+    inverter_down_from_ms = end_ms * 2 / 3;
+    inverter_down_until_ms = inverter_down_from_ms + 20000UL;
+
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    error_handler_init();
+    nonceManager.begin();
+    upload_backlog_init();
+    api_init();
+    scheduler_init();
+    init_tasks_last_run(millis());
+
+    while (millis() < end_ms) {
+        scheduler_run();
+        delay(10);
+    }
+
+    printf("%lu min, poll every %d ms, upload every %d ms\n", minutes, POLL_INTERVAL_MS, UPLOAD_INTERVAL_MS);
+    printf("cloud down %lu-%lu s, inverter down %lu-%lu s\n\n", cloud_down_from_ms / 1000, cloud_down_until_ms / 1000,
+           inverter_down_from_ms / 1000, inverter_down_until_ms / 1000);
+    printf("%-14s %6s %7s %7s %7s %7s %7s %8s\n", "phase", "gaps", "<=1.1x", "<=1.5x", "<=2x", "<=4x", ">4x",
+           "max ms");
+
+    const phase_t phases[] = {
+        {"normal", 0, cloud_down_from_ms},
+        {"cloud down", cloud_down_from_ms, cloud_down_until_ms},
+        {"recovery", cloud_down_until_ms, inverter_down_from_ms},
+        {"inverter down", inverter_down_from_ms, inverter_down_until_ms},
+        {"after", inverter_down_until_ms, end_ms},
+    };
+    unsigned long late = 0;
+    for (const phase_t& phase : phases) {
+        print_phase(phase, POLL_INTERVAL_MS, &late);
+    }
+
+    sample_stats_t stats = scheduler_get_sample_stats();
+    backlog_stats_t backlog = upload_backlog_get_stats();
+    printf("\npolls %zu, stored %u, missed polls %u, late reads %u (max gap %u ms)\n", polls.size(), stats.stored,
+           stats.missed_polls, stats.late_reads, stats.max_read_gap_ms);
+    printf("backlog: %u frames parked, %u replayed, %zu pending\n", backlog.frames_stored, backlog.frames_replayed,
+           upload_backlog_pending());
+
+    int failures = 0;
+    if (stats.missed_polls > 0 || late > 0) {
+        printf("FAIL reads fell behind their %d ms cadence\n", POLL_INTERVAL_MS);
+        failures++;
+    }
+    if (upload_backlog_pending() > 0) {
+        printf("FAIL backlog not drained after the outage\n");
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+// Samples lost while uploads stall, on the simulation harness. Every fourth upload takes
+// 20 s to be ACKed, longer than the upload interval, so the samples taken meanwhile have
+// to fit in the ring next to the batch awaiting its ACK. The bench runs the scheduler
+// from loop(), where polls wait for the upload, and as the two-task pipeline, where they
+// go on, each in a child process since the scheduler keeps its state in statics. It
+// reports the polls, the readings stored, those dropped because the ring was full or
+// overwritten, the polls missed, and all losses as a share of the polls due.
+// SAMPLE_DOUBLE_BUFFERING decides how much room the ring has; build with it set to 0
+// and to 1 to compare.
+//
+//   ./bench_sample_loss [minutes]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "sim_harness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int run(bool pipeline, unsigned long minutes) {
+    Serial.set_capture(false);
+    sim_backend_t backend = sim_default_backend();
+    backend.read_fail_per_mille = 0;
+    backend.upload_fail_per_mille = 0;
+    backend.upload_stall_every = 4;
+    backend.upload_stall_ms = 20000;
+    sim_init(backend);
+
+    uint64_t run_ms = minutes * 60000ULL;
+    if (pipeline) {
+        if (!sim_run_pipeline_for(run_ms)) {
+            printf("FAIL pipeline: tasks did not start\n");
+            return 1;
+        }
+    } else {
+        sim_run_for(run_ms);
+    }
+
+    sample_stats_t stats = scheduler_get_sample_stats();
+    uint32_t due = (uint32_t)(run_ms / POLL_INTERVAL_MS);
+    uint32_t lost = stats.dropped_full + stats.overwritten + stats.missed_polls;
+    printf("%-9s %7u %7u %8u %11u %7u %7.2f%%\n", pipeline ? "pipeline" : "loop", stats.polls, stats.stored,
+           stats.dropped_full, stats.overwritten, stats.missed_polls, 100.0 * lost / due);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long minutes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 360;
+
+    printf("%lu min, poll every %d ms, upload every %d ms, 1 upload in 4 takes 20 s\n", minutes, POLL_INTERVAL_MS,
+           UPLOAD_INTERVAL_MS);
+    printf("SAMPLE_DOUBLE_BUFFERING=%d\n\n", SAMPLE_DOUBLE_BUFFERING);
+    printf("%-9s %7s %7s %8s %11s %7s %8s\n", "mode", "polls", "stored", "dropped", "overwritten", "missed", "lost");
+    fflush(stdout);
+
+    int failures = 0;
+    for (bool pipeline : {false, true}) {
+        pid_t child = fork();
+        if (child == 0) {
+            int result = run(pipeline, minutes);
+            fflush(stdout);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
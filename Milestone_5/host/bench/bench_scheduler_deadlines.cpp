@@ -0,0 +1,147 @@
+// A day of scheduler time on the virtual clock. The stand-in inverter takes 60-250 ms to
+// answer a read and times out now and then; the stand-in cloud takes 0.3-1.5 s to
+// acknowledge an upload. Each task should still start on its own grid of deadlines
+// (start + k x period) however long the runs take. The bench reports, per task, the runs
+// against the deadlines in the day, the skipped periods, the mean and maximum lateness
+// and the jitter. It also reports how far the last read is from its grid, and how often
+// the loop woke up. A last stretch with both intervals at the 1 h the config allows checks
+// that the loop still feeds the watchdog while it waits for such a deadline.
+//
+//   ./bench_scheduler_deadlines [hours] [seed]
+
+#include <Arduino.h>
+#include "config.h"
+#include "config_manager.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "modbus_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+NonceManager nonceManager;
+
+static std::mt19937 rng;
+static unsigned long last_poll_ms = 0;  // First request of the latest poll
+static uint32_t polls_seen = 0;
+
+static unsigned long service_time(unsigned long min_ms, unsigned long max_ms) {
+    return min_ms + rng() % (max_ms - min_ms + 1);
+}
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        uint32_t started = scheduler_get_sample_stats().polls;
+        if (started != polls_seen) {
+            polls_seen = started;
+            last_poll_ms = millis();
+        }
+        if (rng() % 200 == 0) {
+            host_clock_advance_ms(1000);
+            return host_http_response_t{HTTPC_ERROR_READ_TIMEOUT, ""};
+        }
+        host_clock_advance_ms(service_time(60, 250));
+        uint8_t frame[64];
+        size_t n = 0;
+        frame[n++] = SLAVE_ADDRESS;
+        frame[n++] = FUNCTION_CODE_READ;
+        frame[n++] = READ_REGISTER_COUNT * 2;
+        for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+            uint16_t value = (uint16_t)(2300 + i);
+            frame[n++] = value >> 8;
+            frame[n++] = value & 0xFF;
+        }
+        n = modbus_append_crc(frame, n, sizeof(frame));
+        char hex[160];
+        modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+        return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+    }
+    host_clock_advance_ms(service_time(300, 1500));
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+static bool print_task(const char* name, task_type_t type, unsigned long period_ms, unsigned long run_ms) {
+    task_timing_t timing = scheduler_get_task_timing(type);
+    unsigned long deadlines = run_ms / period_ms;
+    printf("%-8s %8lu %8lu %8u %8u %9.1f %8u %8u\n", name, period_ms, deadlines, timing.runs,
+           timing.skipped_periods, timing.runs ? (double)timing.total_lateness_ms / timing.runs : 0.0,
+           timing.max_lateness_ms, timing.max_jitter_ms);
+    return timing.runs + timing.skipped_periods == deadlines && timing.skipped_periods == 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long hours = argc > 1 ? strtoul(argv[1], nullptr, 10) : 24;
+    rng.seed(argc > 2 ? (unsigned)atoi(argv[2]) : 1);
+    const unsigned long run_ms = hours * 3600000UL;
+
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    error_handler_init();
+    nonceManager.begin();
+    upload_backlog_init();
+    api_init();
+    config_manager_init();
+    scheduler_init();
+    unsigned long start_ms = millis();
+    init_tasks_last_run(start_ms);
+    host_watchdog_reset_stats();
+
+    uint64_t wakeups = 0;
+    while (millis() - start_ms <= run_ms) {
+        scheduler_run();
+        wakeups++;
+        Serial.clear_captured();
+    }
+
+    printf("%lu h, read every %d ms taking 60-250 ms, upload every %d ms taking 0.3-1.5 s\n\n", hours,
+           POLL_INTERVAL_MS, UPLOAD_INTERVAL_MS);
+    printf("%-8s %8s %8s %8s %8s %9s %8s %8s\n", "task", "period", "due", "runs", "skipped", "mean late",
+           "max late", "jitter");
+    bool on_grid = print_task("read", TASK_READ_REGISTERS, POLL_INTERVAL_MS, run_ms);
+    on_grid = print_task("upload", TASK_UPLOAD_DATA, UPLOAD_INTERVAL_MS, run_ms) && on_grid;
+
+    unsigned long offset = (last_poll_ms - start_ms) % POLL_INTERVAL_MS;
+    sample_stats_t stats = scheduler_get_sample_stats();
+    printf("\nlast read %lu ms after its grid point, %u late reads (max gap %u ms)\n", offset, stats.late_reads,
+           stats.max_read_gap_ms);
+    printf("loop woke %.1f times per minute, asleep %.1f%% of the time in %u light sleeps\n",
+           wakeups * 60000.0 / run_ms, host_light_sleep_total_us() / 10.0 / run_ms,
+           host_light_sleep_count());
+
+    // Deadlines an hour apart: every wait, awake or after a light sleep, must end in time
+    // to feed the watchdog
+    JsonDocument update;
+    update["sampling_interval"] = 3600;
+    update["upload_interval"] = 3600;
+    config_process_config_update(update.as<JsonObject>());
+    config_apply_pending_changes();
+    unsigned long long_start_ms = millis();
+    while (millis() - long_start_ms <= 3 * 3600000UL) {
+        scheduler_run();
+        Serial.clear_captured();
+    }
+    uint32_t watchdog_gap_ms = host_watchdog_longest_gap_ms();
+    printf("longest awake gap between watchdog feeds %u ms (timeout %d s), with 1 h intervals too\n",
+           watchdog_gap_ms, WATCHDOG_TIMEOUT_S);
+
+    if (watchdog_gap_ms >= WATCHDOG_TIMEOUT_S * 1000UL) {
+        printf("FAIL the loop waited past the watchdog timeout\n");
+        return 1;
+    }
+    if (!on_grid) {
+        printf("FAIL tasks missed deadlines on their grid\n");
+        return 1;
+    }
+    if (offset > (unsigned long)POLL_INTERVAL_MS / 2) {
+        printf("FAIL reads drifted off their grid\n");
+        return 1;
+    }
+    return 0;
+}
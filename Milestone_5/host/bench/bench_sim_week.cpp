@@ -0,0 +1,119 @@
+// A week of device operation through the simulation harness. The stand-in backends answer
+// with realistic delays and occasional failures. The cloud is down for two hours on day 3
+// and the inverter for 15 minutes on day 5. The bench prints one row per day: reads
+// answered and failed, uploads accepted and refused, bytes uploaded, light sleeps and time
+// asleep, and samples dropped and polls missed. It then prints the wall time, the speed-up
+// over real time and a digest of the timeline; an unchanged build reproduces the digest.
+// With a file argument the timeline is written there as CSV.
+//
+//   ./bench_sim_week [days] [timeline.csv]
+
+#include "sim_harness.h"
+#include "config.h"
+#include "upload_backlog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static const uint64_t DAY_MS = 24ULL * 3600 * 1000;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t reads_failed;
+    uint32_t uploads;
+    uint32_t uploads_refused;
+    uint64_t upload_bytes;
+    uint32_t sleeps;
+    uint64_t sleep_ms;
+    uint32_t dropped;
+    uint32_t missed_polls;
+} day_totals_t;
+
+int main(int argc, char** argv) {
+    unsigned days = argc > 1 ? (unsigned)atoi(argv[1]) : 7;
+    const char* timeline_path = argc > 2 ? argv[2] : nullptr;
+
+    sim_backend_t backend = sim_default_backend();
+    backend.cloud_down_from_ms = 2 * DAY_MS + 10 * 3600 * 1000ULL;
+    backend.cloud_down_until_ms = backend.cloud_down_from_ms + 2 * 3600 * 1000ULL;
+    backend.inverter_down_from_ms = 4 * DAY_MS + 15 * 3600 * 1000ULL;
+    backend.inverter_down_until_ms = backend.inverter_down_from_ms + 15 * 60 * 1000ULL;
+
+    auto wall_start = std::chrono::steady_clock::now();
+    sim_init(backend);
+    sim_run_for(days * DAY_MS);
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::vector<day_totals_t> totals(days);
+    for (const sim_event_t& event : sim_timeline()) {
+        if (event.at_ms >= days * DAY_MS) {
+            continue;
+        }
+        day_totals_t& day = totals[event.at_ms / DAY_MS];
+        switch (event.type) {
+            case SIM_EVENT_READ:
+                day.reads++;
+                day.reads_failed += event.value == 0 ? 1 : 0;
+                break;
+            case SIM_EVENT_UPLOAD:
+                day.uploads++;
+                day.uploads_refused += event.value == 0 ? 1 : 0;
+                day.upload_bytes += event.value;
+                break;
+            case SIM_EVENT_SLEEP:
+                day.sleeps++;
+                day.sleep_ms += event.value;
+                break;
+            case SIM_EVENT_DROPPED:
+                day.dropped += event.value;
+                break;
+            case SIM_EVENT_MISSED_POLL:
+                day.missed_polls += event.value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    printf("%u days, read every %d ms, upload every %d ms; cloud down day 3 10:00-12:00, inverter day 5 15:00-15:15\n\n",
+           days, POLL_INTERVAL_MS, UPLOAD_INTERVAL_MS);
+    printf("%-4s %7s %6s %7s %7s %9s %7s %7s %8s %7s\n", "day", "reads", "failed", "uploads", "refused", "KB up",
+           "sleeps", "asleep", "dropped", "missed");
+    int failures = 0;
+    const uint32_t polls_per_day = (uint32_t)(DAY_MS / POLL_INTERVAL_MS);
+    for (unsigned d = 0; d < days; d++) {
+        const day_totals_t& day = totals[d];
+        printf("%-4u %7u %6u %7u %7u %9.1f %7u %6.1f%% %8u %7u\n", d + 1, day.reads, day.reads_failed, day.uploads,
+               day.uploads_refused, day.upload_bytes / 1024.0, day.sleeps, 100.0 * day.sleep_ms / DAY_MS,
+               day.dropped, day.missed_polls);
+        // Polls while the inverter is down cannot be answered
+        uint64_t from = d * DAY_MS, until = from + DAY_MS;
+        uint64_t down_from = backend.inverter_down_from_ms > from ? backend.inverter_down_from_ms : from;
+        uint64_t down_until = backend.inverter_down_until_ms < until ? backend.inverter_down_until_ms : until;
+        uint32_t answerable = polls_per_day - (down_until > down_from ? (uint32_t)((down_until - down_from) / POLL_INTERVAL_MS) : 0);
+        if (day.reads - day.reads_failed < answerable * 99 / 100) {
+            printf("FAIL day %u: only %u of %u polls answered\n", d + 1, day.reads - day.reads_failed, answerable);
+            failures++;
+        }
+    }
+
+    printf("\n%zu events, %.2f s wall time (%.0fx real time), timeline digest %016llx\n", sim_timeline().size(),
+           wall_s, days * DAY_MS / 1000.0 / wall_s, (unsigned long long)sim_timeline_digest());
+    if (upload_backlog_pending() > 0) {
+        printf("FAIL %zu frames still in the backlog\n", upload_backlog_pending());
+        failures++;
+    }
+
+    if (timeline_path != nullptr) {
+        FILE* out = fopen(timeline_path, "w");
+        if (out == nullptr) {
+            printf("FAIL cannot write %s\n", timeline_path);
+            return 1;
+        }
+        sim_write_timeline(out);
+        fclose(out);
+        printf("timeline written to %s\n", timeline_path);
+    }
+    return failures == 0 ? 0 : 1;
+}
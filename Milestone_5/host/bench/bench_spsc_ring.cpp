@@ -0,0 +1,158 @@
+// Sample ring throughput: readings moved from a producer thread to a consumer thread
+// through spsc_ring_t, one at a time and in peeked batches, against the same ring guarded
+// by a mutex, as a locked buffer shared by two tasks would be. The capacity is the
+// firmware's ring (two uploads of SAMPLE_BUFFER_MAX samples). A single-thread push/pop
+// pair gives the cost without cache-line traffic between cores.
+//
+//   ./bench_spsc_ring [readings]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const uint32_t CAPACITY = SAMPLE_BUFFER_MAX * 2;
+static const size_t BATCH = 32;
+
+// The same ring with both sides behind one lock
+typedef struct {
+    std::mutex lock;
+    spsc_ring_t<register_reading_t> ring;
+} locked_ring_t;
+
+static bool locked_push(locked_ring_t* locked, const register_reading_t* reading) {
+    std::lock_guard<std::mutex> guard(locked->lock);
+    return spsc_ring_push(&locked->ring, reading);
+}
+
+static bool locked_pop(locked_ring_t* locked, register_reading_t* reading) {
+    std::lock_guard<std::mutex> guard(locked->lock);
+    return spsc_ring_pop(&locked->ring, reading);
+}
+
+static void fill(uint32_t seq, register_reading_t* reading) {
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        reading->values[reg] = (uint16_t)(seq + reg);
+    }
+}
+
+// Runs producer against consumer and returns ns per reading; sum checks nothing was lost
+template <typename Push, typename Consume>
+static double run_threads(uint32_t readings, Push push, Consume consume, uint64_t* sum) {
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        register_reading_t reading;
+        for (uint32_t seq = 0; seq < readings; seq++) {
+            fill(seq, &reading);
+            while (!push(&reading)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t received = 0;
+    *sum = 0;
+    while (received < readings) {
+        size_t n = consume(sum);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        received += (uint32_t)n;
+    }
+    producer.join();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / readings;
+}
+
+int main(int argc, char** argv) {
+    uint32_t readings = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 5000000u;
+
+    uint64_t expected = 0;
+    for (uint32_t seq = 0; seq < readings; seq++) {
+        expected += (uint16_t)seq;
+    }
+
+    std::vector<register_reading_t> arena(CAPACITY);
+    spsc_ring_t<register_reading_t> ring;
+    locked_ring_t locked;
+
+    printf("%u readings of %zu bytes, ring of %u\n", readings, sizeof(register_reading_t), CAPACITY);
+    printf("%-28s %10s %12s\n", "case", "ns/reading", "Mreadings/s");
+
+    int failures = 0;
+    auto report = [&](const char* name, double ns, uint64_t sum) {
+        bool ok = sum == expected;
+        printf("%-28s %10.1f %12.2f%s\n", name, ns, 1000.0 / ns, ok ? "" : "  FAIL: readings lost");
+        fflush(stdout);
+        failures += ok ? 0 : 1;
+    };
+
+    // Both sides on one thread: the cost of the ring itself
+    {
+        spsc_ring_init(&ring, arena.data(), CAPACITY);
+        register_reading_t reading;
+        uint64_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t seq = 0; seq < readings; seq++) {
+            fill(seq, &reading);
+            spsc_ring_push(&ring, &reading);
+            spsc_ring_pop(&ring, &reading);
+            sum += reading.values[0];
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / readings;
+        report("push+pop, one thread", ns, sum);
+    }
+
+    uint64_t sum = 0;
+    spsc_ring_init(&ring, arena.data(), CAPACITY);
+    double ns = run_threads(
+        readings, [&](const register_reading_t* r) { return spsc_ring_push(&ring, r); },
+        [&](uint64_t* s) -> size_t {
+            register_reading_t reading;
+            if (!spsc_ring_pop(&ring, &reading)) {
+                return 0;
+            }
+            *s += reading.values[0];
+            return 1;
+        },
+        &sum);
+    report("lock-free pop", ns, sum);
+
+    spsc_ring_init(&ring, arena.data(), CAPACITY);
+    ns = run_threads(
+        readings, [&](const register_reading_t* r) { return spsc_ring_push(&ring, r); },
+        [&](uint64_t* s) -> size_t {
+            const register_reading_t* first;
+            const register_reading_t* second;
+            size_t first_count;
+            size_t count = spsc_ring_peek(&ring, 0, BATCH, &first, &first_count, &second);
+            for (size_t i = 0; i < count; i++) {
+                *s += (i < first_count ? &first[i] : &second[i - first_count])->values[0];
+            }
+            spsc_ring_commit(&ring, count);
+            return count;
+        },
+        &sum);
+    report("lock-free peek+commit x32", ns, sum);
+
+    spsc_ring_init(&locked.ring, arena.data(), CAPACITY);
+    ns = run_threads(
+        readings, [&](const register_reading_t* r) { return locked_push(&locked, r); },
+        [&](uint64_t* s) -> size_t {
+            register_reading_t reading;
+            if (!locked_pop(&locked, &reading)) {
+                return 0;
+            }
+            *s += reading.values[0];
+            return 1;
+        },
+        &sum);
+    report("mutex pop", ns, sum);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// The sample ring under load: a producer thread pushes numbered readings as fast as it can
+// while the consumer thread mixes the three ways the firmware takes them out:
+//
+//   pop            one reading at a time
+//   peek + commit  a batch peeked in place, then only part of it committed, as when an
+//                  upload is ACKed after more samples arrived (the rest is peeked again)
+//   offset peek    readings past the oldest ones, as the stream encoder reads them
+//
+// Every reading carries its sequence number and a hash of it in the other registers, so a
+// lost, repeated, reordered or torn reading fails the run. Capacities include ones that
+// are not a power of two, and 1, where the ring is full after every push.
+//
+//   ./bench_spsc_ring_stress [readings_per_capacity]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static void make_reading(uint32_t seq, register_reading_t* reading) {
+    reading->values[0] = (uint16_t)(seq & 0xFFFF);
+    reading->values[1] = (uint16_t)(seq >> 16);
+    uint32_t h = seq * 2654435761u;
+    for (size_t reg = 2; reg < READ_REGISTER_COUNT; reg++) {
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        reading->values[reg] = (uint16_t)(h >> 16);
+    }
+}
+
+static bool reading_is(const register_reading_t* reading, uint32_t seq) {
+    register_reading_t expected;
+    make_reading(seq, &expected);
+    return memcmp(reading, &expected, sizeof(expected)) == 0;
+}
+
+typedef struct {
+    uint64_t pops;
+    uint64_t batches;
+    uint64_t offset_peeks;
+    uint64_t repeeked;  // Readings peeked again because only part of a batch was committed
+    uint64_t full;      // Pushes refused because the ring was full
+    bool ok;
+} stress_result_t;
+
+static stress_result_t run_capacity(uint32_t capacity, uint32_t readings) {
+    std::vector<register_reading_t> arena(capacity);
+    spsc_ring_t<register_reading_t> ring;
+    spsc_ring_init(&ring, arena.data(), capacity);
+
+    stress_result_t result = {0, 0, 0, 0, 0, true};
+    std::atomic<bool> failed(false);
+
+    std::thread producer([&]() {
+        register_reading_t reading;
+        for (uint32_t seq = 0; seq < readings && !failed; seq++) {
+            make_reading(seq, &reading);
+            while (!spsc_ring_push(&ring, &reading)) {
+                result.full++;
+                if (failed) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            if (spsc_ring_size(&ring) > capacity) {
+                printf("FAIL capacity %u: producer sees %zu readings\n", capacity, spsc_ring_size(&ring));
+                failed = true;
+            }
+        }
+    });
+
+    uint32_t next = 0;  // Sequence number of the oldest reading still in the ring
+    uint32_t rng = 0x9E3779B9u ^ capacity;
+    while (next < readings && !failed) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+
+        const register_reading_t* first;
+        const register_reading_t* second;
+        size_t first_count;
+        size_t seen = 0;  // Readings this round looked at; none means the producer is behind
+        switch (rng % 3) {
+            case 0: {
+                register_reading_t reading;
+                if (spsc_ring_pop(&ring, &reading)) {
+                    if (!reading_is(&reading, next)) {
+                        printf("FAIL capacity %u: popped reading %u is wrong\n", capacity, next);
+                        failed = true;
+                    }
+                    next++;
+                    result.pops++;
+                    seen = 1;
+                }
+                break;
+            }
+            case 1: {
+                size_t max = 1 + (rng >> 8) % capacity;
+                size_t count = spsc_ring_peek(&ring, 0, max, &first, &first_count, &second);
+                for (size_t i = 0; i < count && !failed; i++) {
+                    if (!reading_is(i < first_count ? &first[i] : &second[i - first_count], next + (uint32_t)i)) {
+                        printf("FAIL capacity %u: batch reading %u is wrong\n", capacity, next + (uint32_t)i);
+                        failed = true;
+                    }
+                }
+                size_t committed = count == 0 ? 0 : 1 + (rng >> 16) % count;
+                spsc_ring_commit(&ring, committed);
+                next += (uint32_t)committed;
+                result.repeeked += count - committed;
+                result.batches++;
+                seen = count;
+                break;
+            }
+            default: {
+                size_t waiting = spsc_ring_size(&ring);
+                if (waiting > capacity) {
+                    printf("FAIL capacity %u: consumer sees %zu readings\n", capacity, waiting);
+                    failed = true;
+                    break;
+                }
+                size_t offset = waiting == 0 ? 0 : (rng >> 8) % waiting;
+                size_t count = spsc_ring_peek(&ring, offset, capacity, &first, &first_count, &second);
+                for (size_t i = 0; i < count && !failed; i++) {
+                    uint32_t seq = next + (uint32_t)(offset + i);
+                    if (!reading_is(i < first_count ? &first[i] : &second[i - first_count], seq)) {
+                        printf("FAIL capacity %u: reading %u at offset %zu is wrong\n", capacity, seq, offset);
+                        failed = true;
+                    }
+                }
+                result.offset_peeks++;
+                seen = count;
+                break;
+            }
+        }
+        if (seen == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    if (!failed && spsc_ring_size(&ring) != 0) {
+        printf("FAIL capacity %u: %zu readings left over\n", capacity, spsc_ring_size(&ring));
+        failed = true;
+    }
+    result.ok = !failed;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    uint32_t readings = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 500000u;
+    static const uint32_t capacities[] = {1, 2, 3, 7, 16, 21, 64, 101, 200};
+
+    printf("%u readings per capacity, producer and consumer on separate threads\n", readings);
+    printf("%8s %10s %10s %12s %12s %12s %8s\n", "capacity", "pops", "batches", "offset peeks", "re-peeked",
+           "full pushes", "ms");
+
+    int failures = 0;
+    for (uint32_t capacity : capacities) {
+        auto start = std::chrono::steady_clock::now();
+        stress_result_t result = run_capacity(capacity, readings);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%8u %10llu %10llu %12llu %12llu %12llu %8.0f%s\n", capacity, (unsigned long long)result.pops,
+               (unsigned long long)result.batches, (unsigned long long)result.offset_peeks,
+               (unsigned long long)result.repeeked, (unsigned long long)result.full, ms, result.ok ? "" : "  FAIL");
+        fflush(stdout);
+        failures += result.ok ? 0 : 1;
+    }
+    if (failures == 0) {
+        printf("Every reading arrived once, in order and intact\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
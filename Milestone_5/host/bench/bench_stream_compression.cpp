@@ -0,0 +1,127 @@
+// Upload critical path: batch compression of the whole buffer versus flushing the
+// streaming compressor that was fed one sample at a time from store_register_reading.
+// Streamed frames are checked byte for byte against the batch encoder.
+//
+//   ./bench_stream_compression [iterations]
+
+#include <Arduino.h>
+#include "config.h"
+#include "compressor.h"
+#include "bench_support.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+typedef std::vector<register_reading_t> samples_t;
+
+// Same register behaviour as the inverter dataset in bench_compression
+static samples_t make_inverter_samples(size_t count) {
+    samples_t samples(count);
+    int32_t level[READ_REGISTER_COUNT] = {2300, 52, 5000, 3600, 3550, 41, 39, 352, 50, 1200};
+    for (size_t i = 0; i < count; i++) {
+        level[0] += rng_range(-12, 12);
+        level[1] += rng_range(-3, 3);
+        if (rng_range(0, 9) == 0) level[2] += rng_range(-1, 1);
+        level[3] += rng_range(-20, 20);
+        level[4] += rng_range(-20, 20);
+        level[5] += rng_range(-2, 2);
+        level[6] += rng_range(-2, 2);
+        if (i % 8 == 7) level[7] += 1;
+        level[9] = 1200 + rng_range(-60, 60);
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            samples[i].values[reg] = clamp16(level[reg]);
+        }
+    }
+    return samples;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start, size_t iterations) {
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / (double)iterations;
+}
+
+static bool check_circular_wrap(void) {
+    samples_t samples = make_inverter_samples(6);
+    stream_compressor_t sc = {0};
+    if (!stream_compressor_init(&sc, 5, COMPRESSION_METHOD_DELTA_RLE)) return false;
+    for (size_t i = 0; i < 5; i++) stream_compressor_add(&sc, &samples[i]);
+    bool before = stream_compressor_matches(&sc, 5);
+    stream_compressor_add(&sc, &samples[5]);
+    bool after = stream_compressor_matches(&sc, 5);
+    stream_compressor_free(&sc);
+    return before && !after;
+}
+
+static const uint8_t methods[] = {COMPRESSION_METHOD_DELTA_RLE, COMPRESSION_METHOD_VARINT};
+static const size_t sizes[] = {5, 30, 100};
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    Serial.set_echo(false);
+
+    int failures = 0;
+    if (!check_circular_wrap()) {
+        printf("FAIL circular wrap did not invalidate the stream\n");
+        failures++;
+    }
+
+    printf("%7s %-14s %8s %12s %12s %12s\n", "samples", "method", "frame B", "batch ns", "flush ns", "add ns/smp");
+
+    for (size_t size : sizes) {
+        samples_t samples = make_inverter_samples(size);
+        for (uint8_t method : methods) {
+            std::vector<uint8_t> stream_frame(compress_bound(size, method));
+            std::vector<uint8_t> batch_frame(compress_bound(size, method));
+            stream_compressor_t sc = {0};
+            if (!stream_compressor_init(&sc, size, method)) {
+                printf("FAIL %zu/%u: stream_compressor_init\n", size, method);
+                failures++;
+                continue;
+            }
+
+            // Cost spread over the acquisition period, one add per poll
+            auto start = std::chrono::steady_clock::now();
+            for (size_t it = 0; it < iterations; it++) {
+                stream_compressor_reset(&sc);
+                for (size_t i = 0; i < size; i++) stream_compressor_add(&sc, &samples[i]);
+            }
+            double add_ns = elapsed_ns(start, iterations * size);
+
+            compression_metrics_t streamed = stream_compressor_finish(&sc, stream_frame.data(), stream_frame.size());
+            if (streamed.compressed_payload_size == 0) {
+                printf("FAIL %zu/%s: stream flush produced no frame\n", size, streamed.compression_method);
+                failures++;
+                stream_compressor_free(&sc);
+                continue;
+            }
+
+            // Cost left on the upload path
+            start = std::chrono::steady_clock::now();
+            for (size_t it = 0; it < iterations; it++) {
+                stream_compressor_finish(&sc, stream_frame.data(), stream_frame.size());
+            }
+            double flush_ns = elapsed_ns(start, iterations);
+
+            compression_metrics_t batch = compress_with_method(samples.data(), size, batch_frame.data(),
+                                                               batch_frame.size(), method);
+            if (batch.compressed_payload_size != streamed.compressed_payload_size ||
+                memcmp(batch_frame.data(), stream_frame.data(), batch.compressed_payload_size) != 0) {
+                printf("FAIL %zu/%s: streamed frame differs from batch\n", size, streamed.compression_method);
+                failures++;
+            }
+            start = std::chrono::steady_clock::now();
+            for (size_t it = 0; it < iterations; it++) {
+                compress_with_method(samples.data(), size, batch_frame.data(), batch_frame.size(), method);
+            }
+            double batch_ns = elapsed_ns(start, iterations);
+
+            printf("%7zu %-14s %8zu %12.0f %12.0f %12.1f\n", size, streamed.compression_method,
+                   streamed.compressed_payload_size, batch_ns, flush_ns, add_ns);
+            stream_compressor_free(&sc);
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#ifndef BENCH_SUPPORT_H
+#define BENCH_SUPPORT_H
+
+// Fixtures shared by the host benches. Each bench is a single translation unit, so the
+// definitions live here. A bench that reports heap use defines BENCH_COUNT_ALLOCATIONS
+// before including this header, which replaces the global operator new with a counting one.
+
+#include <cstddef>
+#include <cstdint>
+
+// xorshift32 with a fixed seed, so every run sees the same data
+static uint32_t rng_state = 0x9E3779B9u;
+
+// Uniform in [lo, hi]
+static inline int32_t rng_range(int32_t lo, int32_t hi) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return lo + (int32_t)(rng_state % (uint32_t)(hi - lo + 1));
+}
+
+static inline uint16_t clamp16(int32_t v) {
+    return (uint16_t)(v < 0 ? 0 : (v > 65535 ? 65535 : v));
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+// Calls to operator new, the bytes they asked for, and the heap bytes live now and at peak
+static size_t allocation_count = 0;
+static size_t allocation_bytes = 0;
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    allocation_count++;
+    allocation_bytes += size;
+    live_bytes += malloc_usable_size(p);
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+static void release(void* p) {
+    if (p != nullptr) {
+        live_bytes -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+// Chunked uploads and backlog batches as a cloud would have to read them. A buffer too
+// large for one frame goes through build_upload_batch() and send_upload_batch() to a
+// stand-in cloud that decrypts every request, parses the 0x02 chunk frame
+// ([0x02][seq][total][compressed samples]) and decodes the samples. It refuses some chunks
+// the first time, so the resend path runs too. A second buffer is refused entirely, parked
+// in the backlog with park_upload_batch() and replayed by replay_upload_backlog(), so the
+// cloud also parses 0x03 batches ([0x03][n] then n x [len_hi][len_lo][frame]).
+// The samples put back together from each path must equal the buffer, each chunk
+// arriving once.
+//
+//   ./bench_upload_chunks [samples]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "compressor.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+#include <mbedtls/gcm.h>
+#include <mbedtls/sha256.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+NonceManager nonceManager;
+
+typedef std::vector<register_reading_t> samples_t;
+
+static bool cloud_down = false;
+static uint32_t refuse_every = 0;  // Refuse every n-th chunk request, 0 for none
+static uint32_t chunk_requests = 0;
+static uint32_t batch_requests = 0;
+static uint32_t malformed = 0;
+static std::map<uint8_t, samples_t> received;  // Decoded chunks by seq
+static uint8_t chunk_total = 0;  // total field of the chunks received
+static uint32_t duplicates = 0;
+
+static std::string header(const host_http_request_t& request, const char* name) {
+    auto it = request.headers.find(name);
+    return it == request.headers.end() ? "" : it->second;
+}
+
+// GCM upload: IV (12), ciphertext, tag (16), with the nonce header as associated data
+static bool open_gcm(const std::string& body, const std::string& nonce, std::vector<uint8_t>* frame) {
+    if (body.size() < GCM_IV_LENGTH + GCM_TAG_LENGTH) {
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)body.data();
+    size_t length = body.size() - GCM_IV_LENGTH - GCM_TAG_LENGTH;
+    uint8_t key[32];
+    mbedtls_sha256_ret((const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK), key, 0);
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 256);
+    frame->resize(length);
+    int ret = mbedtls_gcm_auth_decrypt(&gcm, length, p, GCM_IV_LENGTH, (const uint8_t*)nonce.data(), nonce.size(),
+                                       p + GCM_IV_LENGTH + length, GCM_TAG_LENGTH, p + GCM_IV_LENGTH, frame->data());
+    mbedtls_gcm_free(&gcm);
+    return ret == 0;
+}
+
+// Delta+RLE compression frame: 5-byte header, then per register the first value and
+// 0x00 [run] or 0x01 [delta_hi][delta_lo] tokens
+static bool decode_delta_rle(const uint8_t* frame, size_t length, samples_t* out) {
+    if (length < COMPRESSION_HEADER_SIZE) {
+        return false;
+    }
+    size_t count = ((size_t)frame[0] << 8) | frame[1];
+    size_t payload_size = ((size_t)frame[3] << 8) | frame[4];
+    if ((frame[2] >> 4) != COMPRESSION_METHOD_DELTA_RLE || (frame[2] & 0x0F) != READ_REGISTER_COUNT ||
+        payload_size + COMPRESSION_HEADER_SIZE != length || count == 0) {
+        return false;
+    }
+    const uint8_t* data = frame + COMPRESSION_HEADER_SIZE;
+    size_t pos = 0;
+    out->assign(count, register_reading_t());
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        if (pos + 2 > payload_size) {
+            return false;
+        }
+        uint16_t value = (uint16_t)((data[pos] << 8) | data[pos + 1]);
+        pos += 2;
+        (*out)[0].values[reg] = value;
+        int16_t delta = 0;
+        for (size_t i = 1; i < count;) {
+            if (pos + 2 <= payload_size && data[pos] == 0x00) {
+                for (uint8_t run = data[pos + 1]; run > 0 && i < count; run--) {
+                    (*out)[i++].values[reg] = value;
+                }
+                pos += 2;
+            } else if (pos + 3 <= payload_size && data[pos] == 0x01) {
+                delta = (int16_t)((data[pos + 1] << 8) | data[pos + 2]);
+                value = (uint16_t)(value + delta);
+                (*out)[i++].values[reg] = value;
+                pos += 3;
+            } else {
+                return false;
+            }
+        }
+    }
+    return pos == payload_size;
+}
+
+// [0x02][seq][total][compressed samples]
+static bool accept_chunk(const uint8_t* frame, size_t length) {
+    samples_t samples;
+    if (length < 3 || frame[0] != 0x02 || frame[1] >= frame[2] ||
+        !decode_delta_rle(frame + 3, length - 3, &samples)) {
+        return false;
+    }
+    duplicates += received.count(frame[1]);
+    received[frame[1]] = samples;
+    chunk_total = frame[2];
+    return true;
+}
+
+// [0x03][n] followed by n x [len_hi][len_lo][frame]
+static bool accept_backlog_batch(const uint8_t* frame, size_t length) {
+    if (length < 2 || frame[0] != 0x03) {
+        return false;
+    }
+    size_t pos = 2;
+    for (uint8_t i = 0; i < frame[1]; i++) {
+        if (pos + 2 > length) {
+            return false;
+        }
+        size_t frame_length = ((size_t)frame[pos] << 8) | frame[pos + 1];
+        pos += 2;
+        if (pos + frame_length > length || !accept_chunk(frame + pos, frame_length)) {
+            return false;
+        }
+        pos += frame_length;
+    }
+    return pos == length;
+}
+
+static host_http_response_t stand_in_cloud(const host_http_request_t& request) {
+    if (request.url.find("/api/cloud/write") == std::string::npos) {
+        return host_http_response_t{200, "{\"status\":\"success\"}"};
+    }
+    if (cloud_down) {
+        return host_http_response_t{503, ""};
+    }
+    std::vector<uint8_t> frame;
+    if (header(request, "encryption") != "aes-256-gcm" || !open_gcm(request.body, header(request, "nonce"), &frame) ||
+        frame.empty()) {
+        malformed++;
+        return host_http_response_t{400, ""};
+    }
+    bool ok;
+    if (frame[0] == 0x02) {
+        chunk_requests++;
+        if (refuse_every > 0 && chunk_requests % refuse_every == 0) {
+            return host_http_response_t{503, ""};
+        }
+        ok = accept_chunk(frame.data(), frame.size());
+    } else {
+        batch_requests++;
+        ok = accept_backlog_batch(frame.data(), frame.size());
+    }
+    if (!ok) {
+        malformed++;
+        return host_http_response_t{400, ""};
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+static samples_t make_samples(size_t count, uint32_t seed) {
+    samples_t samples(count);
+    uint32_t state = seed;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            // Mostly small steps, some flat stretches, as inverter registers move
+            uint16_t previous = i > 0 ? samples[i - 1].values[reg] : (uint16_t)(1000 + reg * 250);
+            samples[i].values[reg] = (state & 3) == 0 ? previous : (uint16_t)(previous + (int)(state % 41) - 20);
+        }
+    }
+    return samples;
+}
+
+// The received chunks, in seq order, must be the buffer
+static bool reassembled(const samples_t& expected, uint8_t total) {
+    samples_t joined;
+    for (uint8_t seq = 0; seq < total; seq++) {
+        auto it = received.find(seq);
+        if (it == received.end()) {
+            return false;
+        }
+        joined.insert(joined.end(), it->second.begin(), it->second.end());
+    }
+    return received.size() == total && joined.size() == expected.size() &&
+           memcmp(joined.data(), expected.data(), joined.size() * sizeof(register_reading_t)) == 0;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : SAMPLE_BUFFER_MAX;
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_cloud);
+    error_handler_init();
+    nonceManager.begin();
+    crypto_init();
+    upload_backlog_init();
+    api_init();
+    scheduler_init();
+    int failures = 0;
+
+    printf("%zu samples, chunks of at most %d bytes, cloud decodes Delta+RLE\n\n", count, MAX_PAYLOAD_SIZE);
+    printf("%-8s %7s %9s %9s %9s %11s %9s\n", "path", "chunks", "requests", "resent", "batches", "duplicates",
+           "samples");
+
+    // Direct: every third chunk request refused once, then the rest resent
+    samples_t samples = make_samples(count, 1);
+    if (!build_upload_batch(samples.data(), samples.size())) {
+        printf("FAIL build_upload_batch\n");
+        return 1;
+    }
+    refuse_every = 3;
+    int sends = 1;
+    bool done = send_upload_batch();
+    refuse_every = 0;
+    while (!done && sends < 5) {
+        sends++;
+        done = send_upload_batch();
+    }
+    bool ok = done && reassembled(samples, chunk_total) && duplicates == 0 && malformed == 0;
+    printf("%-8s %7u %9u %9u %9u %11u %9s\n", "direct", chunk_total, chunk_requests, chunk_requests - chunk_total, 0,
+           duplicates, ok ? "equal" : "DIFFER");
+    if (!ok) {
+        printf("FAIL chunks sent directly did not reassemble into the buffer once each\n");
+        failures++;
+    }
+
+    // Backlog: the whole batch refused, parked, then replayed in 0x03 batches
+    received.clear();
+    chunk_total = 0;
+    duplicates = 0;
+    chunk_requests = 0;
+    samples = make_samples(count, 2);
+    if (!build_upload_batch(samples.data(), samples.size())) {
+        printf("FAIL build_upload_batch\n");
+        return 1;
+    }
+    cloud_down = true;
+    bool sent_while_down = send_upload_batch();
+    bool parked = park_upload_batch();
+    cloud_down = false;
+    done = replay_upload_backlog();
+    ok = !sent_while_down && parked && done && reassembled(samples, chunk_total) && duplicates == 0 && malformed == 0;
+    printf("%-8s %7u %9u %9u %9u %11u %9s\n", "backlog", chunk_total, chunk_requests, 0, batch_requests, duplicates,
+           ok ? "equal" : "DIFFER");
+    if (!ok) {
+        printf("FAIL parked chunks did not replay into the buffer once each\n");
+        failures++;
+    }
+    if (malformed > 0) {
+        printf("FAIL %u requests did not parse\n", malformed);
+    }
+    return failures == 0 ? 0 : 1;
+}
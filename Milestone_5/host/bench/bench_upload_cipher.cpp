@@ -0,0 +1,294 @@
+// Upload sealing in the two encryption modes. CBC makes three passes over a frame: CRC,
+// padded AES-256-CBC and an HMAC sent in the mac header. GCM encrypts and tags it in one
+// pass with no padding. For several frame sizes the bench reports the bytes each mode puts
+// on the wire (body plus authentication headers) and the CPU time to seal one upload.
+// It then runs the scheduler against a stand-in cloud that verifies every upload. The cloud
+// answers one GCM upload with a 400 that is not about encryption, which must not cause a
+// fallback, then refuses GCM with 415 for a while: uploads fall back to CBC, and GCM is tried
+// again every UPLOAD_CIPHER_REPROBE_MS until the cloud takes it again.
+//
+//   ./bench_upload_cipher [iterations] [minutes]
+
+#include <Arduino.h>
+#include "config.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "calculateCRC.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "modbus_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+#include <mbedtls/aes.h>
+#include <mbedtls/gcm.h>
+#include <mbedtls/sha256.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+NonceManager nonceManager;
+
+// Length of one header line as sent: "name: value\r\n"
+static size_t header_bytes(const char* name, size_t value_length) {
+    return strlen(name) + 2 + value_length + 2;
+}
+
+static size_t seal_cbc(const uint8_t* frame, size_t length, uint8_t* sealed, char* mac_hex) {
+    uint8_t with_crc[length + 2];
+    memcpy(with_crc, frame, length);
+    uint16_t crc = calculateCRC(frame, (int)length);
+    with_crc[length] = crc & 0xFF;
+    with_crc[length + 1] = crc >> 8;
+    size_t encrypted_len = 0;
+    if (!encryptPayloadAES_CBC(with_crc, length + 2, sealed + 16, &encrypted_len, sealed)) {
+        return 0;
+    }
+    mac_context_t mac;
+    if (!mac_init_upload(&mac)) {
+        return 0;
+    }
+#if UPLOAD_MAC_VERSION == MAC_VERSION_BASE64
+    bool fed = mac_update_base64(&mac, sealed, 16 + encrypted_len);
+#else
+    bool fed = mac_update(&mac, sealed, 16 + encrypted_len);
+#endif
+    if (!fed || !mac_final(&mac, mac_hex)) {
+        return 0;
+    }
+    return 16 + encrypted_len;
+}
+
+static size_t seal_gcm(const uint8_t* frame, size_t length, uint8_t* sealed, const char* aad) {
+    if (!encryptPayloadAES_GCM(frame, length, (const uint8_t*)aad, strlen(aad), sealed + GCM_IV_LENGTH, sealed,
+                               sealed + GCM_IV_LENGTH + length)) {
+        return 0;
+    }
+    return GCM_IV_LENGTH + length + GCM_TAG_LENGTH;
+}
+
+static void derive_key(uint8_t* key) {
+    mbedtls_sha256_ret((const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK), key, 0);
+}
+
+// Server side of a GCM upload: tag over IV, ciphertext and the nonce header
+static bool open_gcm(const std::string& body, const std::string& nonce, std::vector<uint8_t>* frame) {
+    if (body.size() < GCM_IV_LENGTH + GCM_TAG_LENGTH) {
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)body.data();
+    size_t length = body.size() - GCM_IV_LENGTH - GCM_TAG_LENGTH;
+    uint8_t key[32];
+    derive_key(key);
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 256);
+    frame->resize(length);
+    int ret = mbedtls_gcm_auth_decrypt(&gcm, length, p, GCM_IV_LENGTH, (const uint8_t*)nonce.data(), nonce.size(),
+                                       p + GCM_IV_LENGTH + length, GCM_TAG_LENGTH, p + GCM_IV_LENGTH, frame->data());
+    mbedtls_gcm_free(&gcm);
+    return ret == 0;
+}
+
+// Server side of a CBC upload: MAC in the configured version, then decrypt, unpad and check the CRC
+static bool open_cbc(const std::string& body, const std::string& mac, std::vector<uint8_t>* frame) {
+    if (body.size() < 32 || (body.size() - 16) % 16 != 0) {
+        return false;
+    }
+#if UPLOAD_MAC_VERSION == MAC_VERSION_BASE64
+    String expected = generateMAC(encodeBase64((const uint8_t*)body.data(), body.size()));
+#else
+    String expected = generateMAC((const uint8_t*)body.data(), body.size());
+#endif
+    if (expected != mac.c_str()) {
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)body.data();
+    size_t length = body.size() - 16;
+    uint8_t key[32];
+    uint8_t iv[16];
+    derive_key(key);
+    memcpy(iv, p, 16);
+    std::vector<uint8_t> plain(length);
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_dec(&aes, key, 256);
+    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, length, iv, p + 16, plain.data());
+    mbedtls_aes_free(&aes);
+    size_t pad = plain.back();
+    if (pad == 0 || pad > 16 || pad + 2 > length) {
+        return false;
+    }
+    size_t frame_length = length - pad - 2;
+    uint16_t crc = calculateCRC(plain.data(), (int)frame_length);
+    if (plain[frame_length] != (crc & 0xFF) || plain[frame_length + 1] != (crc >> 8)) {
+        return false;
+    }
+    frame->assign(plain.begin(), plain.begin() + frame_length);
+    return true;
+}
+
+static bool refuse_gcm = false;
+static bool bad_request = false;  // Answer the next GCM upload with a 400 not about encryption
+static uint32_t verified_gcm = 0;
+static uint32_t verified_cbc = 0;
+static uint32_t refused_gcm = 0;
+static uint32_t rejected = 0;
+
+static std::string header(const host_http_request_t& request, const char* name) {
+    auto it = request.headers.find(name);
+    return it == request.headers.end() ? "" : it->second;
+}
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        uint8_t frame[64];
+        size_t n = 0;
+        frame[n++] = SLAVE_ADDRESS;
+        frame[n++] = FUNCTION_CODE_READ;
+        frame[n++] = READ_REGISTER_COUNT * 2;
+        for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+            uint16_t value = (uint16_t)(2300 + i * 17 + (millis() / 1000) % 50);
+            frame[n++] = value >> 8;
+            frame[n++] = value & 0xFF;
+        }
+        n = modbus_append_crc(frame, n, sizeof(frame));
+        char hex[160];
+        modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+        return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+    }
+    if (request.url.find("/api/cloud/write") == std::string::npos) {
+        return host_http_response_t{200, "{\"status\":\"success\"}"};
+    }
+
+    std::string encryption = header(request, "encryption");
+    std::vector<uint8_t> frame;
+    if (encryption == "aes-256-gcm") {
+        if (refuse_gcm) {
+            refused_gcm++;
+            return host_http_response_t{415, "{\"error\":\"unsupported encryption\"}"};
+        }
+        if (bad_request) {
+            bad_request = false;
+            return host_http_response_t{400, "{\"error\":\"malformed request\"}"};
+        }
+        if (!open_gcm(request.body, header(request, "nonce"), &frame) || !header(request, "mac").empty()) {
+            rejected++;
+            return host_http_response_t{401, ""};
+        }
+        verified_gcm++;
+    } else if (encryption == "aes-256-cbc") {
+        if (!open_cbc(request.body, header(request, "mac"), &frame)) {
+            rejected++;
+            return host_http_response_t{401, ""};
+        }
+        verified_cbc++;
+    } else {
+        rejected++;
+        return host_http_response_t{400, ""};
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 5000;
+    unsigned long minutes = argc > 2 ? strtoul(argv[2], nullptr, 10) : 3 * UPLOAD_CIPHER_REPROBE_MS / 60000UL;
+    Serial.set_echo(false);
+    int failures = 0;
+    crypto_init();
+
+    printf("%-6s %-5s %8s %8s %8s %10s\n", "frame", "mode", "body B", "auth B", "wire B", "us/upload");
+    const size_t sizes[] = {24, 64, MAX_PAYLOAD_SIZE + 1, 1024};
+    for (size_t size : sizes) {
+        std::vector<uint8_t> frame(size);
+        for (size_t i = 0; i < size; i++) {
+            frame[i] = (uint8_t)(i * 13 + 5);
+        }
+        std::vector<uint8_t> sealed(size + 34);
+        char mac_hex[MAC_HEX_LENGTH + 1];
+
+        size_t cbc_len = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            Serial.clear_captured();
+            cbc_len = seal_cbc(frame.data(), size, sealed.data(), mac_hex);
+        }
+        double cbc_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::vector<uint8_t> opened;
+        if (!open_cbc(std::string((const char*)sealed.data(), cbc_len), mac_hex, &opened) ||
+            opened != frame) {
+            printf("FAIL CBC round trip, %zu bytes\n", size);
+            failures++;
+        }
+
+        size_t gcm_len = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            Serial.clear_captured();
+            gcm_len = seal_gcm(frame.data(), size, sealed.data(), "12345");
+        }
+        double gcm_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::string body((const char*)sealed.data(), gcm_len);
+        if (!open_gcm(body, "12345", &opened) || opened != frame) {
+            printf("FAIL GCM round trip, %zu bytes\n", size);
+            failures++;
+        }
+        std::string tampered = body;
+        tampered[GCM_IV_LENGTH] ^= 0x01;
+        if (open_gcm(tampered, "12345", &opened) || open_gcm(body, "12346", &opened)) {
+            printf("FAIL GCM accepted a modified body or nonce, %zu bytes\n", size);
+            failures++;
+        }
+
+        // mac and mac-version headers in CBC mode; the encryption header is the same length in both
+        size_t cbc_auth = header_bytes("mac", MAC_HEX_LENGTH) + header_bytes("mac-version", 1);
+        printf("%-6zu %-5s %8zu %8zu %8zu %10.2f\n", size, "CBC", cbc_len, cbc_auth, cbc_len + cbc_auth,
+               cbc_us / iterations);
+        printf("%-6s %-5s %8zu %8d %8zu %10.2f\n", "", "GCM", gcm_len, 0, gcm_len, gcm_us / iterations);
+    }
+
+    // Uploads from the scheduler: GCM, a 400 about something else, then CBC after a 415 and
+    // GCM again once a re-probe is accepted. The cloud refuses GCM over [R/2, 2R), so the
+    // probe at 3R/2 is refused too and the one at 5R/2 succeeds.
+    host_clock_use_virtual(true);
+    host_http_set_handler(stand_in_server);
+    error_handler_init();
+    nonceManager.begin();
+    upload_backlog_init();
+    api_init();
+    scheduler_init();
+    init_tasks_last_run(millis());
+    const unsigned long end_ms = minutes * 60000UL;
+    const unsigned long refuse_start_ms = UPLOAD_CIPHER_REPROBE_MS / 2;
+    const unsigned long refuse_end_ms = 2 * UPLOAD_CIPHER_REPROBE_MS;
+    bad_request = true;
+    uint32_t cbc_before_refusal = 0;
+    uint32_t gcm_before_refusal = 0;
+    while (millis() < end_ms) {
+        refuse_gcm = millis() >= refuse_start_ms && millis() < refuse_end_ms;
+        if (millis() < refuse_start_ms) {
+            cbc_before_refusal = verified_cbc;
+            gcm_before_refusal = verified_gcm;
+        }
+        scheduler_run();
+        delay(10);
+    }
+    printf("\nscheduler, %lu min: GCM refused over %lu-%lu min, re-probe every %lu min\n", minutes,
+           refuse_start_ms / 60000UL, refuse_end_ms / 60000UL, UPLOAD_CIPHER_REPROBE_MS / 60000UL);
+    printf("  before: %u GCM and %u CBC uploads verified, one GCM upload answered 400 (%s)\n", gcm_before_refusal,
+           cbc_before_refusal, bad_request ? "not sent" : "sent");
+    printf("  after:  %u GCM and %u CBC uploads verified, %u refused with 415, %u rejected\n",
+           verified_gcm - gcm_before_refusal, verified_cbc - cbc_before_refusal, refused_gcm, rejected);
+    if (bad_request || cbc_before_refusal > 0) {
+        printf("FAIL a 400 that was not about encryption made uploads fall back to CBC\n");
+        failures++;
+    }
+    if (gcm_before_refusal == 0 || verified_cbc == 0 || refused_gcm != 2 || rejected > 0 ||
+        verified_gcm == gcm_before_refusal) {
+        printf("FAIL uploads did not fall back to CBC once refused and return to GCM after a re-probe\n");
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+// Crypto time per upload: IV, AES-256-CBC and MAC for one sealed frame.
+// The old path, rebuilt here, derived the AES key from UPLOAD_PSK, seeded a fresh
+// entropy/CTR-DRBG pair for the IV, expanded the key schedule and keyed a new HMAC on
+// every upload. The new path uses the state crypto_init() keeps. Times depend on the
+// mbedTLS the bench is linked with; the setup work removed from each upload is printed too. Several threads then
+// seal frames at once through the shared state; every frame is decrypted and its MAC
+// recomputed to check that the lock keeps them apart.
+//
+//   ./bench_upload_crypto [iterations] [threads]
+
+#include <Arduino.h>
+#include "config.h"
+#include "encryptionAndSecurity.h"
+#include <mbedtls/aes.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/sha256.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// encryptPayloadAES_CBC and the upload MAC as they were before crypto_init(), logging included
+static bool seal_per_upload_setup(const uint8_t* plaintext, size_t length, uint8_t* ciphertext, uint8_t* iv, char* mac_hex) {
+    uint8_t aes_key[32];
+    mbedtls_sha256_ret((const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK), aes_key, 0);
+    Serial.println(F("[ENCRYPTION] AES-256 key derived from PSK"));
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    const char* personalization = "EcoWatt_AES_IV";
+    bool ok = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
+                                    (const uint8_t*)personalization, strlen(personalization)) == 0 &&
+              mbedtls_ctr_drbg_random(&ctr_drbg, iv, 16) == 0;
+    Serial.print(F("[ENCRYPTION] Generated IV: "));
+    for (int i = 0; i < 16; i++) {
+        if (iv[i] < 0x10) Serial.print("0");
+        Serial.print(iv[i], HEX);
+    }
+    Serial.println();
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+
+    size_t padded = length + 16 - length % 16;
+    Serial.printf("[ENCRYPTION] Plaintext: %u bytes, Padded: %u bytes (padding: %u)\n", (unsigned)length,
+                  (unsigned)padded, (unsigned)(padded - length));
+    uint8_t buffer[padded];
+    memcpy(buffer, plaintext, length);
+    memset(buffer + length, (int)(padded - length), padded - length);
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    uint8_t iv_copy[16];
+    memcpy(iv_copy, iv, 16);
+    ok = ok && mbedtls_aes_setkey_enc(&aes, aes_key, 256) == 0 &&
+         mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, padded, iv_copy, buffer, ciphertext) == 0;
+    mbedtls_aes_free(&aes);
+    Serial.printf("[ENCRYPTION] Encryption successful: %u bytes ciphertext\n", (unsigned)padded);
+
+    mac_context_t mac;
+    ok = ok && mac_init(&mac, (const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK)) && mac_update(&mac, iv, 16) &&
+         mac_update(&mac, ciphertext, padded) && mac_final(&mac, mac_hex);
+    return ok;
+}
+
+static bool seal_cached(const uint8_t* plaintext, size_t length, uint8_t* ciphertext, uint8_t* iv, char* mac_hex) {
+    size_t ciphertext_len = 0;
+    if (!encryptPayloadAES_CBC(plaintext, length, ciphertext, &ciphertext_len, iv)) {
+        return false;
+    }
+    mac_context_t mac;
+    return mac_init_upload(&mac) && mac_update(&mac, iv, 16) && mac_update(&mac, ciphertext, ciphertext_len) &&
+           mac_final(&mac, mac_hex);
+}
+
+// Decrypt with an independently derived key and recompute the MAC
+static bool verify_sealed(const uint8_t* plaintext, size_t length, const uint8_t* ciphertext, const uint8_t* iv,
+                          const char* mac_hex) {
+    uint8_t aes_key[32];
+    mbedtls_sha256_ret((const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK), aes_key, 0);
+    size_t padded = length + 16 - length % 16;
+    uint8_t decrypted[padded];
+    uint8_t iv_copy[16];
+    memcpy(iv_copy, iv, 16);
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_dec(&aes, aes_key, 256);
+    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, padded, iv_copy, ciphertext, decrypted);
+    mbedtls_aes_free(&aes);
+
+    std::vector<uint8_t> sent(iv, iv + 16);
+    sent.insert(sent.end(), ciphertext, ciphertext + padded);
+    String expected = generateMAC(sent.data(), sent.size());
+    return memcmp(decrypted, plaintext, length) == 0 && decrypted[padded - 1] == padded - length &&
+           expected == mac_hex;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    Serial.set_echo(false);
+    int failures = 0;
+
+    if (!crypto_init()) {
+        printf("FAIL crypto_init\n");
+        return 1;
+    }
+
+    printf("setup per upload: before 1 key derivation, 1 DRBG seed, 1 AES key expansion, 1 HMAC keying;\n"
+           "                  now none (DRBG reseeded every %d IVs)\n\n", CRYPTO_RESEED_INTERVAL);
+    printf("%-8s %-20s %10s\n", "frame", "path", "us/upload");
+    const size_t sizes[] = {48, 200, 1024};
+    for (size_t size : sizes) {
+        std::vector<uint8_t> frame(size);
+        for (size_t i = 0; i < size; i++) {
+            frame[i] = (uint8_t)(i * 7);
+        }
+        std::vector<uint8_t> ciphertext(size + 16);
+        uint8_t iv[16];
+        char mac_hex[MAC_HEX_LENGTH + 1];
+
+        bool (*paths[])(const uint8_t*, size_t, uint8_t*, uint8_t*, char*) = {seal_per_upload_setup, seal_cached};
+        const char* names[] = {"per-upload setup", "cached context"};
+        for (int p = 0; p < 2; p++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                Serial.clear_captured();
+                paths[p](frame.data(), size, ciphertext.data(), iv, mac_hex);
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (!verify_sealed(frame.data(), size, ciphertext.data(), iv, mac_hex)) {
+                printf("FAIL %s: %zu-byte frame does not decrypt or verify\n", names[p], size);
+                failures++;
+            }
+            printf("%-8s %-20s %10.2f\n", p == 0 ? std::to_string(size).c_str() : "", names[p], us / iterations);
+        }
+    }
+
+    // Concurrent sealing through the shared context
+    Serial.clear_captured();
+    std::atomic<int> bad{0};
+    std::vector<std::set<std::string>> ivs(threads);
+    std::vector<std::thread> workers;
+    const int per_thread = iterations / 4 > 0 ? iterations / 4 : 1;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            uint8_t frame[120];
+            uint8_t ciphertext[sizeof(frame) + 16];
+            uint8_t iv[16];
+            char mac_hex[MAC_HEX_LENGTH + 1];
+            for (int i = 0; i < per_thread; i++) {
+                memset(frame, t * 31 + i, sizeof(frame));
+                if (!seal_cached(frame, sizeof(frame), ciphertext, iv, mac_hex) ||
+                    !verify_sealed(frame, sizeof(frame), ciphertext, iv, mac_hex)) {
+                    bad++;
+                }
+                ivs[t].insert(std::string((const char*)iv, 16));
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::set<std::string> all;
+    for (const auto& set : ivs) {
+        all.insert(set.begin(), set.end());
+    }
+    size_t sealed = (size_t)threads * per_thread;
+    crypto_stats_t stats = crypto_get_stats();
+    printf("\n%d threads sealed %zu frames: %d failed to verify, %zu distinct IVs\n", threads, sealed, bad.load(),
+           all.size());
+    printf("%u IVs drawn, DRBG reseeded %u times (every %d IVs)\n", stats.ivs, stats.reseeds, CRYPTO_RESEED_INTERVAL);
+    if (bad > 0 || all.size() != sealed) {
+        printf("FAIL concurrent uploads interfered through the shared context\n");
+        failures++;
+    }
+    if (stats.reseeds != (stats.ivs - 1) / CRYPTO_RESEED_INTERVAL) {
+        printf("FAIL DRBG was not reseeded every %d IVs\n", CRYPTO_RESEED_INTERVAL);
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
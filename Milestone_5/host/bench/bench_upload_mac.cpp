@@ -0,0 +1,147 @@
+// Upload MAC computed incrementally over the binary payload, checked against references.
+// RFC 4231 vectors and MACs from Python's hmac module (for UPLOAD_PSK) are fed to the
+// mac_* context split at every position. Random IV + ciphertext payloads are then checked
+// against generateMAC() for both mac-version formats. Last, the cost of one upload MAC:
+// the old encodeBase64() + generateMAC(String) path against mac_init/update/final.
+//
+//   ./bench_upload_mac [iterations]
+
+#include <Arduino.h>
+#include "config.h"
+#include "encryptionAndSecurity.h"
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_support.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+typedef struct {
+    const char* name;
+    std::string key;
+    std::string message;
+    bool base64;
+    const char* expected;
+} vector_t;
+
+static std::string counting_bytes(size_t n) {
+    std::string s;
+    for (size_t i = 0; i < n; i++) {
+        s += (char)i;
+    }
+    return s;
+}
+
+// Feed the message in two pieces split at `split` (Base64 mode takes it whole)
+static std::string incremental_mac(const vector_t& v, size_t split) {
+    mac_context_t ctx;
+    char hex[MAC_HEX_LENGTH + 1];
+    const uint8_t* m = (const uint8_t*)v.message.data();
+    if (!mac_init(&ctx, (const uint8_t*)v.key.data(), v.key.size())) {
+        return "";
+    }
+    bool fed = v.base64 ? mac_update_base64(&ctx, m, v.message.size())
+                        : mac_update(&ctx, m, split) && mac_update(&ctx, m + split, v.message.size() - split);
+    if (!mac_final(&ctx, hex) || !fed) {
+        return "";
+    }
+    return hex;
+}
+
+static std::string sealed_mac(const uint8_t* sealed, size_t length, int version) {
+    mac_context_t ctx;
+    char hex[MAC_HEX_LENGTH + 1];
+    mac_init(&ctx, (const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK));
+    if (version == MAC_VERSION_BASE64) {
+        mac_update_base64(&ctx, sealed, length);
+    } else {
+        mac_update(&ctx, sealed, 16);
+        mac_update(&ctx, sealed + 16, length - 16);
+    }
+    mac_final(&ctx, hex);
+    return hex;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    Serial.set_echo(false);
+    int failures = 0;
+
+    const vector_t vectors[] = {
+        {"RFC 4231 #1", std::string(20, '\x0b'), "Hi There", false,
+         "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+        {"RFC 4231 #2", "Jefe", "what do ya want for nothing?", false,
+         "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+        {"RFC 4231 #6", std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First", false,
+         "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+        // hmac.new(UPLOAD_PSK, bytes(range(80)), sha256) and the same over base64.b64encode()
+        {"PSK binary", UPLOAD_PSK, counting_bytes(80), false,
+         "6492ea559b2abca7d0cf476e99e4b374283c07ae3e0c67802245fabd2eafea81"},
+        {"PSK base64", UPLOAD_PSK, counting_bytes(80), true,
+         "46ad926884d9393641d344c7a9fa55509e2c2fa8c4b1ca733c32eeba3af8a763"},
+    };
+    for (const vector_t& v : vectors) {
+        size_t mismatches = 0;
+        size_t splits = v.base64 ? 1 : v.message.size() + 1;
+        for (size_t split = 0; split < splits; split++) {
+            mismatches += incremental_mac(v, split) != v.expected;
+        }
+        printf("%-12s %3zu splits: %s\n", v.name, splits, mismatches == 0 ? "match" : "MISMATCH");
+        failures += mismatches > 0;
+    }
+
+    // Sealed payloads as seal_upload_frame builds them: 16-byte IV and a whole number of blocks
+    srand(7);
+    size_t compared = 0;
+    for (size_t blocks = 1; blocks <= 64; blocks++) {
+        std::vector<uint8_t> sealed(16 + blocks * 16);
+        for (uint8_t& b : sealed) {
+            b = (uint8_t)rand();
+        }
+        String binary = generateMAC(sealed.data(), sealed.size());
+        String text = generateMAC(encodeBase64(sealed.data(), sealed.size()));
+        if (sealed_mac(sealed.data(), sealed.size(), MAC_VERSION_BINARY) != binary.c_str() ||
+            sealed_mac(sealed.data(), sealed.size(), MAC_VERSION_BASE64) != text.c_str()) {
+            printf("FAIL %zu-byte payload: incremental MAC differs from generateMAC()\n", sealed.size());
+            failures++;
+        }
+        compared++;
+    }
+    printf("%zu sealed payloads match generateMAC() in both formats\n\n", compared);
+
+    printf("%-8s %-22s %10s %10s\n", "payload", "path", "us/MAC", "allocs");
+    const size_t sizes[] = {64, 256, 1024};
+    for (size_t size : sizes) {
+        std::vector<uint8_t> sealed(size, 0x5A);
+        volatile size_t sink = 0;
+
+        size_t allocations_before = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            String mac = generateMAC(encodeBase64(sealed.data(), sealed.size()));
+            sink += mac.length();
+        }
+        double old_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        double old_allocs = (double)(allocation_count - allocations_before) / iterations;
+
+        allocations_before = allocation_count;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            mac_context_t ctx;
+            char hex[MAC_HEX_LENGTH + 1];
+            mac_init(&ctx, (const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK));
+            mac_update(&ctx, sealed.data(), 16);
+            mac_update(&ctx, sealed.data() + 16, sealed.size() - 16);
+            mac_final(&ctx, hex);
+            sink += hex[0];
+        }
+        double new_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        double new_allocs = (double)(allocation_count - allocations_before) / iterations;
+
+        printf("%-8zu %-22s %10.2f %10.1f\n", size, "base64 + generateMAC", old_us / iterations, old_allocs);
+        printf("%-8s %-22s %10.2f %10.1f\n", "", "incremental, binary", new_us / iterations, new_allocs);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host (Linux) stand-in for the ESP32 Arduino core.
+// Only the surface used by Milestone_5/lib is provided; see host_shims.h for the test hooks.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "pgmspace.h"
+#include "WString.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+#include "esp_err.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// Timing (backed by the shim clock, real or virtual)
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield(void);
+
+// Random numbers
+long random(long max_value);
+long random(long min_value, long max_value);
+void randomSeed(unsigned long seed);
+
+// NTP configuration is a no-op on the host; time() keeps following the host clock
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+uint32_t getCpuFrequencyMhz(void);
+uint32_t getApbFrequency(void);
+
+class EspClass {
+public:
+    void restart(void);
+    uint32_t getFreeHeap(void);
+    uint32_t getMinFreeHeap(void);
+    uint32_t getHeapSize(void);
+};
+
+extern EspClass ESP;
+
+#endif
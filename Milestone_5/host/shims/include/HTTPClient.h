@@ -0,0 +1,78 @@
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+// Host HTTPClient: requests are answered in-process by the handler installed with
+// host_http_set_handler(). Connection reuse is modelled per client object and host.
+
+#include <map>
+#include <memory>
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_NO_CONTENT = 204,
+    HTTP_CODE_PARTIAL_CONTENT = 206,
+    HTTP_CODE_BAD_REQUEST = 400,
+    HTTP_CODE_UNAUTHORIZED = 401,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_RANGE_NOT_SATISFIABLE = 416,
+    HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+    HTTP_CODE_SERVICE_UNAVAILABLE = 503
+} t_http_codes;
+
+class HTTPClient {
+public:
+    HTTPClient();
+    ~HTTPClient();
+
+    bool begin(String url);
+    bool begin(WiFiClient& client, String url);
+    void end(void);
+    bool connected(void);
+
+    void setReuse(bool reuse) { reuse_ = reuse; }
+    void setTimeout(uint16_t timeout_ms) { timeout_ms_ = timeout_ms; }
+    void setConnectTimeout(int32_t timeout_ms) { (void)timeout_ms; }
+    void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+
+    int GET();
+    int POST(uint8_t* payload, size_t size);
+    int POST(const String& payload);
+    int PUT(uint8_t* payload, size_t size);
+    int sendRequest(const char* type, uint8_t* payload = nullptr, size_t size = 0);
+
+    int getSize(void);
+    String getString(void);
+    WiFiClient& getStream(void);
+    WiFiClient* getStreamPtr(void);
+    int writeToStream(Stream* stream);
+
+    static String errorToString(int error);
+
+private:
+    WiFiClient* client_;
+    std::unique_ptr<WiFiClient> owned_client_;
+    std::string url_;
+    std::string host_;
+    std::string connected_host_;
+    std::map<std::string, std::string> headers_;
+    int response_size_;
+    bool response_chunked_;
+    uint16_t timeout_ms_;
+    bool reuse_;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+// Serial on the host appends everything to a capture buffer (optionally echoed to stdout).
+// Writes are serialized, as the device driver does, so several tasks can log at once.
+
+#include <mutex>
+#include <string>
+#include "Print.h"
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud);
+    void end(void) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+
+    operator bool() const { return true; }
+
+    // Host-only capture access
+    const std::string& captured() const { return captured_; }
+    void clear_captured() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        captured_.clear();
+    }
+    void set_echo(bool echo) { echo_ = echo; }
+    void set_capture(bool capture) { capture_ = capture; }
+
+private:
+    std::mutex mutex_;
+    std::string captured_;
+    bool echo_ = false;
+    bool capture_ = true;
+};
+
+extern HardwareSerial Serial;
+
+#endif
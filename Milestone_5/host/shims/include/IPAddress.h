@@ -0,0 +1,17 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <cstdint>
+#include "Print.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets_{a, b, c, d} {}
+    String toString() const;
+    size_t printTo(Print& p) const override;
+
+private:
+    uint8_t octets_[4];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// Host Preferences: an in-memory NVS shared by every Preferences instance in the process.
+
+#include <Arduino.h>
+
+class Preferences {
+public:
+    Preferences() : namespace_(), started_(false), read_only_(false) {}
+    ~Preferences() { end(); }
+
+    bool begin(const char* name, bool read_only = false, const char* partition_label = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+    size_t freeEntries();
+
+    size_t putChar(const char* key, int8_t value);
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putShort(const char* key, int16_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putInt(const char* key, int32_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putLong(const char* key, int32_t value);
+    size_t putULong(const char* key, uint32_t value);
+    size_t putLong64(const char* key, int64_t value);
+    size_t putULong64(const char* key, uint64_t value);
+    size_t putFloat(const char* key, float value);
+    size_t putBool(const char* key, bool value);
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value);
+    size_t putBytes(const char* key, const void* value, size_t len);
+
+    int8_t getChar(const char* key, int8_t default_value = 0);
+    uint8_t getUChar(const char* key, uint8_t default_value = 0);
+    int16_t getShort(const char* key, int16_t default_value = 0);
+    uint16_t getUShort(const char* key, uint16_t default_value = 0);
+    int32_t getInt(const char* key, int32_t default_value = 0);
+    uint32_t getUInt(const char* key, uint32_t default_value = 0);
+    int32_t getLong(const char* key, int32_t default_value = 0);
+    uint32_t getULong(const char* key, uint32_t default_value = 0);
+    int64_t getLong64(const char* key, int64_t default_value = 0);
+    uint64_t getULong64(const char* key, uint64_t default_value = 0);
+    float getFloat(const char* key, float default_value = NAN);
+    bool getBool(const char* key, bool default_value = false);
+    String getString(const char* key, const String& default_value = String());
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t max_len);
+
+private:
+    size_t put_raw(const char* key, const void* value, size_t len);
+    bool get_raw(const char* key, void* value, size_t len);
+
+    std::string namespace_;
+    bool started_;
+    bool read_only_;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+public:
+    SPIFFSFS();
+    bool begin(bool format_on_fail = false, const char* base_path = "/spiffs",
+               uint8_t max_open_files = 10, const char* partition_label = nullptr);
+    bool format();
+    size_t totalBytes();
+    size_t usedBytes();
+    void end();
+};
+
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
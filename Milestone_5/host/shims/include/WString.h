@@ -0,0 +1,131 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+// Host replacement for the Arduino String class.
+// Backed by std::string so heap traffic is visible to allocation counters in benchmarks.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class __FlashStringHelper;
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper*>(pstr_pointer))
+#define F(string_literal) (FPSTR(string_literal))
+
+class String {
+public:
+    String(const char* cstr = "");
+    String(const char* cstr, size_t length);
+    String(const String& other) = default;
+    String(String&& other) noexcept = default;
+    String(const __FlashStringHelper* pstr);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimal_places = 2);
+    explicit String(double value, unsigned int decimal_places = 2);
+
+    String& operator=(const String& rhs) = default;
+    String& operator=(String&& rhs) noexcept = default;
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* pstr);
+
+    // Memory management
+    bool reserve(unsigned int size);
+    unsigned int length() const { return (unsigned int)buffer_.length(); }
+    bool isEmpty() const { return buffer_.empty(); }
+    const char* c_str() const { return buffer_.c_str(); }
+
+    // Concatenation
+    bool concat(const String& str);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(const uint8_t* cstr, unsigned int length);
+    bool concat(char c);
+    bool concat(unsigned char num);
+    bool concat(int num);
+    bool concat(unsigned int num);
+    bool concat(long num);
+    bool concat(unsigned long num);
+    bool concat(float num);
+    bool concat(double num);
+    bool concat(const __FlashStringHelper* str);
+
+    template <typename T>
+    String& operator+=(const T& rhs) {
+        concat(rhs);
+        return *this;
+    }
+    String& operator+=(const char* cstr) {
+        concat(cstr);
+        return *this;
+    }
+
+    // Comparison
+    int compareTo(const String& s) const;
+    bool equals(const String& s) const { return buffer_ == s.buffer_; }
+    bool equals(const char* cstr) const;
+    bool equalsIgnoreCase(const String& s) const;
+    bool startsWith(const String& prefix) const;
+    bool startsWith(const String& prefix, unsigned int offset) const;
+    bool endsWith(const String& suffix) const;
+
+    bool operator==(const String& rhs) const { return equals(rhs); }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator!=(const String& rhs) const { return !equals(rhs); }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+    bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+
+    // Character access
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+    void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+        getBytes((unsigned char*)buf, bufsize, index);
+    }
+
+    // Search
+    int indexOf(char ch) const;
+    int indexOf(char ch, unsigned int from_index) const;
+    int indexOf(const String& str) const;
+    int indexOf(const String& str, unsigned int from_index) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const String& str) const;
+    String substring(unsigned int begin_index) const;
+    String substring(unsigned int begin_index, unsigned int end_index) const;
+
+    // Modification
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase(void);
+    void toUpperCase(void);
+    void trim(void);
+
+    // Parsing
+    long toInt(void) const;
+    float toFloat(void) const;
+    double toDouble(void) const;
+
+    // Host-only access to the backing store
+    const std::string& str() const { return buffer_; }
+
+private:
+    std::string buffer_;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+String operator+(const String& lhs, const __FlashStringHelper* rhs);
+
+#endif
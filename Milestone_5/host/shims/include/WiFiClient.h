@@ -0,0 +1,47 @@
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+// Host WiFiClient: a Stream over a response body delivered by the HTTP stand-in.
+
+#include <string>
+#include "Print.h"
+
+class WiFiClient : public Stream {
+public:
+    virtual ~WiFiClient() {}
+
+    virtual int connect(const char* host, uint16_t port);
+    virtual void stop();
+    virtual uint8_t connected();
+    operator bool() { return connected(); }
+
+    size_t write(uint8_t c) override { (void)c; return 1; }
+    size_t write(const uint8_t* buffer, size_t size) override { (void)buffer; return size; }
+    using Print::write;
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    using Stream::readBytes;
+    int read(uint8_t* buffer, size_t size) { return (int)readBytes((char*)buffer, size); }
+
+    // Host-only: load the bytes the next reads will return
+    void host_set_rx(const std::string& data);
+    // Host-only: the peer closed the connection; bytes already received stay readable
+    void host_peer_close() { connected_ = false; }
+    // Host-only: the peer dropped this connection without the client noticing yet
+    bool host_is_stale() const;
+
+protected:
+    void host_receive();
+
+    std::string rx_;
+    size_t rx_pos_ = 0;
+    size_t rx_arrived_ = 0;       // Bytes of rx_ that have come in over the link
+    uint64_t rx_clock_us_ = 0;    // Link time accounted for up to rx_arrived_
+    bool connected_ = false;
+    uint32_t generation_ = 0;
+};
+
+#endif
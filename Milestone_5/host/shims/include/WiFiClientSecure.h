@@ -0,0 +1,12 @@
+#ifndef HOST_WIFI_CLIENT_SECURE_H
+#define HOST_WIFI_CLIENT_SECURE_H
+
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setCACert(const char* root_ca) { (void)root_ca; }
+    void setInsecure() {}
+};
+
+#endif
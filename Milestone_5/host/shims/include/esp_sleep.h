@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+// Light sleep on the host advances the shim clock by the armed timer wakeup.
+
+#include <cstdint>
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+esp_err_t esp_light_sleep_start(void);
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef HOST_SHIMS_H
+#define HOST_SHIMS_H
+
+// Hooks for driving the Arduino/ESP-IDF shims from host benchmarks and harnesses.
+// None of this exists on the device; firmware code must not include this header.
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+// ---------------- Clock ----------------
+// The shim clock follows the host monotonic clock until virtual mode is enabled.
+// In virtual mode time only moves through delay(), light sleep or the advance hooks,
+// so delay() returns immediately and hours of firmware time can run in milliseconds.
+// Tasks created on the virtual clock take turns without preemption: one runs until it
+// waits in delay() or on a queue or semaphore, then the task due first runs next.
+void host_clock_use_virtual(bool enabled);
+bool host_clock_is_virtual(void);
+uint64_t host_clock_now_us(void);
+void host_clock_set_us(uint64_t now_us);
+void host_clock_advance_us(uint64_t delta_us);
+void host_clock_advance_ms(uint32_t delta_ms);
+
+// ---------------- System ----------------
+uint32_t host_esp_restart_count(void);
+uint32_t host_light_sleep_count(void);
+uint64_t host_light_sleep_total_us(void);
+// Called as each light sleep starts, with the time the wake-up timer was set for
+typedef std::function<void(uint64_t duration_us)> host_sleep_observer_t;
+void host_light_sleep_set_observer(host_sleep_observer_t observer);
+// Longest awake time between two watchdog feeds from any task, up to now; light sleep,
+// where the watchdog timer stops, does not count
+uint32_t host_watchdog_longest_gap_ms(void);
+void host_watchdog_reset_stats(void);
+
+// ---------------- WiFi ----------------
+void host_wifi_set_connected(bool connected);
+
+// ---------------- HTTP ----------------
+typedef struct {
+    std::string method;
+    std::string url;
+    std::string host;    // scheme://host:port, used as the connection key
+    std::map<std::string, std::string> headers;
+    std::string body;
+} host_http_request_t;
+
+typedef struct {
+    int status;          // HTTP status, or a negative HTTPC_ERROR_* code
+    std::string body;
+    bool chunked;        // Sent without Content-Length: getSize() is -1, read it with writeToStream()
+    size_t drop_after;   // Non-zero: the peer closes the connection after this many body bytes
+} host_http_response_t;
+
+typedef std::function<host_http_response_t(const host_http_request_t&)> host_http_handler_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t connections_opened;
+    uint64_t bytes_received;  // Response body bytes the clients read
+} host_http_stats_t;
+
+// Installs the stand-in server; without one every request fails with HTTPC_ERROR_CONNECTION_REFUSED
+void host_http_set_handler(host_http_handler_t handler);
+host_http_stats_t host_http_get_stats(void);
+void host_http_reset_stats(void);
+// Silently drops every open connection, as a server idle timeout or NAT expiry would.
+// Clients still think they are connected; the next request on such a socket fails
+// with HTTPC_ERROR_CONNECTION_LOST.
+void host_http_drop_connections(void);
+// Slow link for response bodies: bytes arrive at bytes_per_second into a receive window of
+// window_bytes (the socket buffer), which keeps filling while the firmware does other work.
+// readBytes() waits in shim time until it has what it asked for. 0 bytes/s: instant.
+void host_http_set_link(uint32_t bytes_per_second, size_t window_bytes);
+
+// ---------------- NVS (Preferences) ----------------
+void host_nvs_reset(void);
+uint32_t host_nvs_write_count(void);
+
+// ---------------- SPIFFS ----------------
+void host_spiffs_reset(void);
+uint32_t host_spiffs_bytes_written(void);
+void host_spiffs_set_capacity(size_t total_bytes);
+// Simulated power loss: the next `mutations` writes, removes and renames go through, the
+// one after that is torn (a write keeps half its bytes) and every later one fails, until
+// host_spiffs_restore_power(). A negative count disarms it.
+void host_spiffs_cut_power_after(int mutations);
+void host_spiffs_restore_power(void);
+bool host_spiffs_power_lost(void);
+
+// ---------------- Flash partitions ----------------
+void host_partitions_reset(void);
+// Simulated power loss on flash: the next `bytes` bytes written go through, the write that
+// crosses the limit is torn there and every later write or erase fails, until
+// host_partitions_restore_power(). A negative count disarms it.
+void host_partitions_cut_power_after(long bytes);
+void host_partitions_restore_power(void);
+// Time taken by erases and writes, spent in shim time. 0 (the default): instant.
+void host_partitions_set_timing(uint32_t erase_us_per_sector, uint32_t write_us_per_kb);
+
+#endif
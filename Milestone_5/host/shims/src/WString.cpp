@@ -0,0 +1,320 @@
+#include "WString.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+static std::string format_unsigned(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) {
+        base = 10;
+    }
+    char digits[65];
+    size_t pos = sizeof(digits);
+    digits[--pos] = '\0';
+    do {
+        unsigned digit = (unsigned)(value % base);
+        digits[--pos] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value > 0);
+    return std::string(&digits[pos]);
+}
+
+static std::string format_signed(long long value, unsigned char base) {
+    if (value < 0 && base == 10) {
+        return "-" + format_unsigned((unsigned long long)(-(value + 1)) + 1, base);
+    }
+    return format_unsigned((unsigned long long)value, base);
+}
+
+static std::string format_double(double value, unsigned int decimal_places) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimal_places, value);
+    return std::string(buf);
+}
+
+String::String(const char* cstr) : buffer_(cstr ? cstr : "") {}
+String::String(const char* cstr, size_t length) : buffer_(cstr ? std::string(cstr, length) : std::string()) {}
+String::String(const __FlashStringHelper* pstr) : buffer_(pstr ? reinterpret_cast<const char*>(pstr) : "") {}
+String::String(char c) : buffer_(1, c) {}
+String::String(unsigned char value, unsigned char base) : buffer_(format_unsigned(value, base)) {}
+String::String(int value, unsigned char base)
+    : buffer_(base == 10 ? format_signed(value, base) : format_unsigned((unsigned int)value, base)) {}
+String::String(unsigned int value, unsigned char base) : buffer_(format_unsigned(value, base)) {}
+String::String(long value, unsigned char base)
+    : buffer_(base == 10 ? format_signed(value, base) : format_unsigned((unsigned long)value, base)) {}
+String::String(unsigned long value, unsigned char base) : buffer_(format_unsigned(value, base)) {}
+String::String(long long value, unsigned char base)
+    : buffer_(base == 10 ? format_signed(value, base) : format_unsigned((unsigned long long)value, base)) {}
+String::String(unsigned long long value, unsigned char base) : buffer_(format_unsigned(value, base)) {}
+String::String(float value, unsigned int decimal_places) : buffer_(format_double(value, decimal_places)) {}
+String::String(double value, unsigned int decimal_places) : buffer_(format_double(value, decimal_places)) {}
+
+String& String::operator=(const char* cstr) {
+    buffer_ = cstr ? cstr : "";
+    return *this;
+}
+
+String& String::operator=(const __FlashStringHelper* pstr) {
+    buffer_ = pstr ? reinterpret_cast<const char*>(pstr) : "";
+    return *this;
+}
+
+bool String::reserve(unsigned int size) {
+    buffer_.reserve(size);
+    return true;
+}
+
+bool String::concat(const String& str) {
+    buffer_ += str.buffer_;
+    return true;
+}
+
+bool String::concat(const char* cstr) {
+    if (!cstr) {
+        return false;
+    }
+    buffer_ += cstr;
+    return true;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+    if (!cstr) {
+        return false;
+    }
+    buffer_.append(cstr, length);
+    return true;
+}
+
+bool String::concat(const uint8_t* cstr, unsigned int length) {
+    return concat((const char*)cstr, length);
+}
+
+bool String::concat(char c) {
+    buffer_ += c;
+    return true;
+}
+
+bool String::concat(unsigned char num) { buffer_ += format_unsigned(num, 10); return true; }
+bool String::concat(int num) { buffer_ += format_signed(num, 10); return true; }
+bool String::concat(unsigned int num) { buffer_ += format_unsigned(num, 10); return true; }
+bool String::concat(long num) { buffer_ += format_signed(num, 10); return true; }
+bool String::concat(unsigned long num) { buffer_ += format_unsigned(num, 10); return true; }
+bool String::concat(float num) { buffer_ += format_double(num, 2); return true; }
+bool String::concat(double num) { buffer_ += format_double(num, 2); return true; }
+
+bool String::concat(const __FlashStringHelper* str) {
+    return concat(reinterpret_cast<const char*>(str));
+}
+
+int String::compareTo(const String& s) const {
+    return buffer_.compare(s.buffer_);
+}
+
+bool String::equals(const char* cstr) const {
+    return buffer_ == (cstr ? cstr : "");
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+    return buffer_.length() == s.buffer_.length() && strcasecmp(buffer_.c_str(), s.buffer_.c_str()) == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+    return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+    if (offset > buffer_.length() || prefix.buffer_.length() > buffer_.length() - offset) {
+        return false;
+    }
+    return buffer_.compare(offset, prefix.buffer_.length(), prefix.buffer_) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    if (suffix.buffer_.length() > buffer_.length()) {
+        return false;
+    }
+    return buffer_.compare(buffer_.length() - suffix.buffer_.length(), suffix.buffer_.length(), suffix.buffer_) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+    return index < buffer_.length() ? buffer_[index] : '\0';
+}
+
+void String::setCharAt(unsigned int index, char c) {
+    if (index < buffer_.length()) {
+        buffer_[index] = c;
+    }
+}
+
+char String::operator[](unsigned int index) const {
+    return charAt(index);
+}
+
+char& String::operator[](unsigned int index) {
+    static char dummy_writable_char;
+    if (index >= buffer_.length()) {
+        dummy_writable_char = '\0';
+        return dummy_writable_char;
+    }
+    return buffer_[index];
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+    if (!bufsize || !buf) {
+        return;
+    }
+    if (index >= buffer_.length()) {
+        buf[0] = '\0';
+        return;
+    }
+    size_t n = std::min<size_t>(bufsize - 1, buffer_.length() - index);
+    memcpy(buf, buffer_.data() + index, n);
+    buf[n] = '\0';
+}
+
+int String::indexOf(char ch) const {
+    return indexOf(ch, 0);
+}
+
+int String::indexOf(char ch, unsigned int from_index) const {
+    size_t pos = buffer_.find(ch, from_index);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str) const {
+    return indexOf(str, 0);
+}
+
+int String::indexOf(const String& str, unsigned int from_index) const {
+    if (from_index >= buffer_.length()) {
+        return -1;
+    }
+    size_t pos = buffer_.find(str.buffer_, from_index);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char ch) const {
+    size_t pos = buffer_.rfind(ch);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(const String& str) const {
+    size_t pos = buffer_.rfind(str.buffer_);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int begin_index) const {
+    return substring(begin_index, length());
+}
+
+String String::substring(unsigned int begin_index, unsigned int end_index) const {
+    if (begin_index > end_index) {
+        std::swap(begin_index, end_index);
+    }
+    if (begin_index >= buffer_.length()) {
+        return String();
+    }
+    if (end_index > buffer_.length()) {
+        end_index = (unsigned int)buffer_.length();
+    }
+    return String(buffer_.data() + begin_index, end_index - begin_index);
+}
+
+void String::replace(char find, char replace) {
+    for (char& c : buffer_) {
+        if (c == find) {
+            c = replace;
+        }
+    }
+}
+
+void String::replace(const String& find, const String& replace) {
+    if (find.buffer_.empty()) {
+        return;
+    }
+    size_t pos = 0;
+    while ((pos = buffer_.find(find.buffer_, pos)) != std::string::npos) {
+        buffer_.replace(pos, find.buffer_.length(), replace.buffer_);
+        pos += replace.buffer_.length();
+    }
+}
+
+void String::remove(unsigned int index) {
+    if (index < buffer_.length()) {
+        buffer_.erase(index);
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index < buffer_.length()) {
+        buffer_.erase(index, count);
+    }
+}
+
+void String::toLowerCase(void) {
+    for (char& c : buffer_) {
+        c = (char)tolower((unsigned char)c);
+    }
+}
+
+void String::toUpperCase(void) {
+    for (char& c : buffer_) {
+        c = (char)toupper((unsigned char)c);
+    }
+}
+
+void String::trim(void) {
+    size_t begin = 0;
+    while (begin < buffer_.length() && isspace((unsigned char)buffer_[begin])) {
+        begin++;
+    }
+    size_t end = buffer_.length();
+    while (end > begin && isspace((unsigned char)buffer_[end - 1])) {
+        end--;
+    }
+    buffer_ = buffer_.substr(begin, end - begin);
+}
+
+long String::toInt(void) const {
+    return atol(buffer_.c_str());
+}
+
+float String::toFloat(void) const {
+    return (float)atof(buffer_.c_str());
+}
+
+double String::toDouble(void) const {
+    return atof(buffer_.c_str());
+}
+
+String operator+(const String& lhs, const String& rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String& lhs, char rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String& lhs, const __FlashStringHelper* rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
@@ -0,0 +1,556 @@
+// Clock, sleep, watchdog, FreeRTOS and ESP object shims for the host build.
+
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+#include "host_shims.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ---------------- Clock ----------------
+
+static bool clock_virtual = false;
+static std::atomic<uint64_t> virtual_now_us(0);
+
+static uint64_t real_now_us(void) {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+// ---------------- Tasks on the virtual clock ----------------
+// With more than one task on the virtual clock, tasks take turns as on one core without
+// preemption: the running task keeps going until it waits (delay, or a queue or semaphore
+// that is not ready), then the waiting task due first runs, the clock jumping ahead to its
+// wake-up if need be. Only one thread runs at a time, so firmware and shims see no races.
+
+typedef struct {
+    uint64_t wake_us;
+    uint64_t order;   // Creation order, to break ties
+} sim_task_t;
+
+static std::mutex sim_mutex;
+static std::condition_variable sim_turn;
+static std::vector<sim_task_t*> sim_tasks;   // Waiting or running, not yet finished
+static sim_task_t* sim_running = nullptr;
+static uint64_t sim_next_order = 0;
+static thread_local sim_task_t* sim_self = nullptr;
+
+static bool sim_active(void) {
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    return clock_virtual && sim_self != nullptr && sim_tasks.size() > 1;
+}
+
+// Hands the turn to the task due first; called with sim_mutex held
+static void sim_dispatch(void) {
+    sim_task_t* next = nullptr;
+    for (sim_task_t* task : sim_tasks) {
+        if (next == nullptr || task->wake_us < next->wake_us ||
+            (task->wake_us == next->wake_us && task->order < next->order)) {
+            next = task;
+        }
+    }
+    sim_running = next;
+    if (next != nullptr && next->wake_us > virtual_now_us.load()) {
+        virtual_now_us.store(next->wake_us);
+    }
+    sim_turn.notify_all();
+}
+
+static void sim_wait_until(uint64_t wake_us) {
+    std::unique_lock<std::mutex> lock(sim_mutex);
+    sim_self->wake_us = wake_us;
+    sim_dispatch();
+    sim_turn.wait(lock, [] { return sim_running == sim_self; });
+}
+
+// Registers a new task, due now; the creator keeps running. The first task created makes
+// its creator (normally the main thread) a task too.
+static sim_task_t* sim_add_task(void) {
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    if (sim_self == nullptr) {
+        sim_self = new sim_task_t{virtual_now_us.load(), sim_next_order++};
+        sim_tasks.push_back(sim_self);
+        sim_running = sim_self;
+    }
+    sim_task_t* task = new sim_task_t{virtual_now_us.load(), sim_next_order++};
+    sim_tasks.push_back(task);
+    return task;
+}
+
+static void sim_start_task(sim_task_t* task) {
+    std::unique_lock<std::mutex> lock(sim_mutex);
+    sim_self = task;
+    sim_turn.wait(lock, [task] { return sim_running == task; });
+}
+
+static void sim_end_task(void) {
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    sim_tasks.erase(std::find(sim_tasks.begin(), sim_tasks.end(), sim_self));
+    delete sim_self;
+    sim_self = nullptr;
+    sim_dispatch();
+}
+
+void host_clock_use_virtual(bool enabled) {
+    if (enabled && !clock_virtual) {
+        virtual_now_us.store(real_now_us());
+    }
+    clock_virtual = enabled;
+}
+
+bool host_clock_is_virtual(void) {
+    return clock_virtual;
+}
+
+uint64_t host_clock_now_us(void) {
+    return clock_virtual ? virtual_now_us.load() : real_now_us();
+}
+
+void host_clock_set_us(uint64_t now_us) {
+    clock_virtual = true;
+    virtual_now_us.store(now_us);
+}
+
+void host_clock_advance_us(uint64_t delta_us) {
+    if (!clock_virtual) {
+        std::this_thread::sleep_for(std::chrono::microseconds(delta_us));
+    } else if (sim_active()) {
+        sim_wait_until(virtual_now_us.load() + delta_us);
+    } else {
+        virtual_now_us += delta_us;
+    }
+}
+
+void host_clock_advance_ms(uint32_t delta_ms) {
+    host_clock_advance_us((uint64_t)delta_ms * 1000ULL);
+}
+
+// unsigned long is 64-bit on the host, so these do not wrap like the 32-bit device counters
+unsigned long millis(void) {
+    return (unsigned long)(host_clock_now_us() / 1000ULL);
+}
+
+unsigned long micros(void) {
+    return (unsigned long)host_clock_now_us();
+}
+
+void delay(uint32_t ms) {
+    host_clock_advance_ms(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+    host_clock_advance_us(us);
+}
+
+void yield(void) {
+    if (!clock_virtual) {
+        std::this_thread::yield();
+    }
+}
+
+// ---------------- Random ----------------
+
+static uint32_t random_state = 0x2545F491u;
+
+static uint32_t next_random(void) {
+    // xorshift32: deterministic across runs so simulations are reproducible
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) {
+        random_state = (uint32_t)seed;
+    }
+}
+
+long random(long max_value) {
+    if (max_value <= 0) {
+        return 0;
+    }
+    return (long)(next_random() % (uint32_t)max_value);
+}
+
+long random(long min_value, long max_value) {
+    if (min_value >= max_value) {
+        return min_value;
+    }
+    return min_value + random(max_value - min_value);
+}
+
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char* server1,
+                const char* server2, const char* server3) {
+    (void)gmt_offset_sec;
+    (void)daylight_offset_sec;
+    (void)server1;
+    (void)server2;
+    (void)server3;
+}
+
+uint32_t getCpuFrequencyMhz(void) { return 240; }
+uint32_t getApbFrequency(void) { return 80000000; }
+
+// ---------------- ESP object ----------------
+
+EspClass ESP;
+static uint32_t restart_count = 0;
+
+void EspClass::restart(void) {
+    // The host process keeps running; harnesses observe restarts through the counter
+    restart_count++;
+}
+
+uint32_t EspClass::getFreeHeap(void) { return 200 * 1024; }
+uint32_t EspClass::getMinFreeHeap(void) { return 200 * 1024; }
+uint32_t EspClass::getHeapSize(void) { return 320 * 1024; }
+
+uint32_t host_esp_restart_count(void) {
+    return restart_count;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_OTA_VALIDATE_FAILED: return "ESP_ERR_OTA_VALIDATE_FAILED";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+// ---------------- Sleep ----------------
+
+static uint64_t sleep_timer_us = 0;
+static uint32_t light_sleep_count = 0;
+static uint64_t light_sleep_total_us = 0;
+static host_sleep_observer_t sleep_observer;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    sleep_timer_us = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start(void) {
+    light_sleep_count++;
+    light_sleep_total_us += sleep_timer_us;
+    if (sleep_observer) {
+        sleep_observer(sleep_timer_us);
+    }
+    if (clock_virtual) {
+        virtual_now_us += sleep_timer_us;  // Every task sleeps with the chip
+    } else {
+        host_clock_advance_us(sleep_timer_us);
+    }
+    return ESP_OK;
+}
+
+void host_light_sleep_set_observer(host_sleep_observer_t observer) {
+    sleep_observer = observer;
+}
+
+uint32_t host_light_sleep_count(void) {
+    return light_sleep_count;
+}
+
+uint64_t host_light_sleep_total_us(void) {
+    return light_sleep_total_us;
+}
+
+// ---------------- Watchdog ----------------
+// Only awake time counts towards a feed gap: the watchdog timer stops in light sleep.
+
+static uint64_t watchdog_fed_us = 0;
+static uint64_t watchdog_fed_sleep_us = 0;  // light_sleep_total_us at the last feed
+static uint64_t watchdog_longest_gap_us = 0;
+
+static uint64_t watchdog_gap_us(void) {
+    return host_clock_now_us() - watchdog_fed_us - (light_sleep_total_us - watchdog_fed_sleep_us);
+}
+
+static void watchdog_feed(void) {
+    uint64_t gap = watchdog_gap_us();
+    if (gap > watchdog_longest_gap_us) {
+        watchdog_longest_gap_us = gap;
+    }
+    watchdog_fed_us = host_clock_now_us();
+    watchdog_fed_sleep_us = light_sleep_total_us;
+}
+
+esp_err_t esp_task_wdt_init(uint32_t timeout_s, bool panic) {
+    (void)timeout_s;
+    (void)panic;
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_add(TaskHandle_t handle) {
+    (void)handle;
+    watchdog_feed();
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reset(void) {
+    watchdog_feed();
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_delete(TaskHandle_t handle) {
+    (void)handle;
+    return ESP_OK;
+}
+
+uint32_t host_watchdog_longest_gap_ms(void) {
+    uint64_t gap = watchdog_gap_us();
+    return (uint32_t)((gap > watchdog_longest_gap_us ? gap : watchdog_longest_gap_us) / 1000);
+}
+
+void host_watchdog_reset_stats(void) {
+    watchdog_longest_gap_us = 0;
+    watchdog_fed_us = host_clock_now_us();
+    watchdog_fed_sleep_us = light_sleep_total_us;
+}
+
+// ---------------- FreeRTOS ----------------
+
+// A task's notification count. Handles are never freed, so a notification sent after the
+// task ended is harmless, as on the device once the handle has been created.
+struct host_task {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+    sim_task_t* waiting = nullptr;  // Its turn on the virtual clock while in ulTaskNotifyTake()
+};
+
+static thread_local host_task* task_self = nullptr;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (task_self == nullptr) {
+        task_self = new host_task();  // The main thread, or a thread the shims did not start
+    }
+    return task_self;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task == nullptr) {
+        return pdFAIL;
+    }
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+        task->notified.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    if (task->waiting != nullptr && task->waiting->wake_us > virtual_now_us.load()) {
+        task->waiting->wake_us = virtual_now_us.load();  // Runs once the notifier waits
+    }
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    host_task* self = xTaskGetCurrentTaskHandle();
+    auto notified = [self] {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        return self->notifications > 0;
+    };
+    if (sim_active()) {
+        uint64_t deadline = ticks_to_wait == portMAX_DELAY
+                                ? UINT64_MAX
+                                : virtual_now_us.load() + (uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000ULL;
+        while (!notified() && virtual_now_us.load() < deadline) {
+            self->waiting = sim_self;
+            sim_wait_until(deadline);
+            self->waiting = nullptr;
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(self->mutex);
+        auto ready = [self] { return self->notifications > 0; };
+        if (ticks_to_wait == portMAX_DELAY) {
+            self->notified.wait(lock, ready);
+        } else {
+            self->notified.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS), ready);
+        }
+    }
+    std::lock_guard<std::mutex> lock(self->mutex);
+    uint32_t count = self->notifications;
+    if (count > 0) {
+        self->notifications = clear_on_exit ? 0 : count - 1;
+    }
+    return count;
+}
+
+struct host_semaphore {
+    std::timed_mutex mutex;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return new host_semaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    if (semaphore == nullptr) {
+        return pdFALSE;
+    }
+    if (sim_active()) {
+        for (TickType_t waited = 0; !semaphore->mutex.try_lock(); waited++) {
+            if (ticks_to_wait != portMAX_DELAY && waited >= ticks_to_wait) {
+                return pdFALSE;
+            }
+            host_clock_advance_us(portTICK_PERIOD_MS * 1000ULL);
+        }
+        return pdTRUE;
+    }
+    if (ticks_to_wait == portMAX_DELAY) {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks_to_wait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore == nullptr) {
+        return pdFALSE;
+    }
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+struct host_queue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) {
+        return nullptr;
+    }
+    host_queue* queue = new host_queue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+// Waits on the queue's condition until ready() holds, for at most ticks_to_wait
+// On the virtual clock with other tasks, waiting gives them the turn one tick at a time.
+template <typename Ready>
+static bool queue_wait(host_queue* queue, std::unique_lock<std::mutex>& lock, TickType_t ticks_to_wait, Ready ready) {
+    if (sim_active()) {
+        for (TickType_t waited = 0; !ready(); waited++) {
+            if (ticks_to_wait != portMAX_DELAY && waited >= ticks_to_wait) {
+                return false;
+            }
+            lock.unlock();
+            host_clock_advance_us(portTICK_PERIOD_MS * 1000ULL);
+            lock.lock();
+        }
+        return true;
+    }
+    if (ticks_to_wait == portMAX_DELAY) {
+        queue->changed.wait(lock, ready);
+        return true;
+    }
+    return queue->changed.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), ready);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    if (queue == nullptr) {
+        return pdFALSE;
+    }
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue_wait(queue, lock, ticks_to_wait, [queue] { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    if (queue == nullptr) {
+        return pdFALSE;
+    }
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue_wait(queue, lock, ticks_to_wait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    if (queue == nullptr) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)queue->items.size();
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core_id) {
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    (void)core_id;
+    host_task* handle = new host_task();
+    if (clock_virtual) {
+        sim_task_t* task = sim_add_task();
+        std::thread([function, parameters, task, handle] {
+            task_self = handle;
+            sim_start_task(task);
+            function(parameters);
+            sim_end_task();
+        }).detach();
+    } else {
+        std::thread([function, parameters, handle] {
+            task_self = handle;
+            function(parameters);
+        }).detach();
+    }
+    if (created != nullptr) {
+        *created = handle;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* created) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    (void)task;  // The thread ends when the task function returns
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)millis();
+}
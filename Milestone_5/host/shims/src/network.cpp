@@ -0,0 +1,386 @@
+// WiFi, WiFiClient and HTTPClient shims. Requests are served by the in-process
+// stand-in installed through host_http_set_handler().
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "host_shims.h"
+
+#include <atomic>
+#include <mutex>
+
+// ---------------- WiFi ----------------
+
+WiFiClass WiFi;
+static bool wifi_connected = true;
+
+void host_wifi_set_connected(bool connected) {
+    wifi_connected = connected;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+    (void)ssid;
+    (void)passphrase;
+    return status();
+}
+
+bool WiFiClass::disconnect(bool wifioff) {
+    (void)wifioff;
+    return true;
+}
+
+wl_status_t WiFiClass::status(void) {
+    return wifi_connected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP(void) {
+    return wifi_connected ? IPAddress(192, 168, 4, 2) : IPAddress();
+}
+
+// ---------------- WiFiClient ----------------
+
+static std::atomic<uint32_t> connection_generation(0);  // Bumped by host_http_drop_connections()
+static host_http_stats_t http_stats = {0, 0, 0};
+static std::mutex http_stats_mutex;  // Requests can come from several tasks
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    (void)host;
+    (void)port;
+    connected_ = wifi_connected;
+    generation_ = connection_generation;
+    return connected_ ? 1 : 0;
+}
+
+bool WiFiClient::host_is_stale() const {
+    return connected_ && generation_ != connection_generation;
+}
+
+void WiFiClient::stop() {
+    connected_ = false;
+    rx_.clear();
+    rx_pos_ = 0;
+    rx_arrived_ = 0;
+}
+
+uint8_t WiFiClient::connected() {
+    // Like lwIP, buffered bytes stay readable after the peer goes away
+    return (connected_ && wifi_connected) || rx_pos_ < rx_.size();
+}
+
+static uint32_t link_bytes_per_second = 0;
+static size_t link_window = 0;
+
+void host_http_set_link(uint32_t bytes_per_second, size_t window_bytes) {
+    link_bytes_per_second = bytes_per_second;
+    link_window = window_bytes;
+}
+
+// Moves bytes from the peer into the receive window at the link rate. While the window is
+// full or the body is all in, the link idles and earns no credit.
+void WiFiClient::host_receive() {
+    if (link_bytes_per_second == 0) {
+        rx_arrived_ = rx_.size();
+        return;
+    }
+    uint64_t now = host_clock_now_us();
+    size_t limit = std::min(rx_.size(), rx_pos_ + link_window);
+    if (rx_arrived_ < limit) {
+        uint64_t credit = (now - rx_clock_us_) * link_bytes_per_second / 1000000ULL;
+        size_t step = (size_t)std::min<uint64_t>(credit, limit - rx_arrived_);
+        rx_arrived_ += step;
+        rx_clock_us_ += (uint64_t)step * 1000000ULL / link_bytes_per_second;
+    }
+    if (rx_arrived_ >= limit) {
+        rx_clock_us_ = now;
+    }
+}
+
+int WiFiClient::available() {
+    host_receive();
+    return (int)(rx_arrived_ - rx_pos_);
+}
+
+int WiFiClient::read() {
+    host_receive();
+    if (rx_pos_ >= rx_arrived_) {
+        return -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(http_stats_mutex);
+        http_stats.bytes_received++;
+    }
+    return (uint8_t)rx_[rx_pos_++];
+}
+
+int WiFiClient::peek() {
+    host_receive();
+    if (rx_pos_ >= rx_arrived_) {
+        return -1;
+    }
+    return (uint8_t)rx_[rx_pos_];
+}
+
+// Like Stream::readBytes: waits until length bytes are in or the body ends
+size_t WiFiClient::readBytes(char* buffer, size_t length) {
+    size_t got = 0;
+    while (true) {
+        host_receive();
+        size_t n = std::min(length - got, rx_arrived_ - rx_pos_);
+        memcpy(buffer + got, rx_.data() + rx_pos_, n);
+        rx_pos_ += n;
+        got += n;
+        if (got == length || rx_arrived_ == rx_.size()) {
+            break;
+        }
+        // Everything that arrived was taken, so the whole window is free
+        size_t wanted = std::min(std::min(length - got, rx_.size() - rx_arrived_), link_window);
+        host_clock_advance_us(std::max<uint64_t>(1, (uint64_t)wanted * 1000000ULL / link_bytes_per_second));
+    }
+    {
+        std::lock_guard<std::mutex> lock(http_stats_mutex);
+        http_stats.bytes_received += got;
+    }
+    return got;
+}
+
+void WiFiClient::host_set_rx(const std::string& data) {
+    rx_ = data;
+    rx_pos_ = 0;
+    rx_arrived_ = 0;
+    rx_clock_us_ = host_clock_now_us();
+    host_receive();
+}
+
+// ---------------- HTTP stand-in ----------------
+
+static host_http_handler_t http_handler;
+
+void host_http_set_handler(host_http_handler_t handler) {
+    http_handler = handler;
+}
+
+host_http_stats_t host_http_get_stats(void) {
+    std::lock_guard<std::mutex> lock(http_stats_mutex);
+    return http_stats;
+}
+
+void host_http_reset_stats(void) {
+    std::lock_guard<std::mutex> lock(http_stats_mutex);
+    http_stats.requests = 0;
+    http_stats.connections_opened = 0;
+    http_stats.bytes_received = 0;
+}
+
+void host_http_drop_connections(void) {
+    connection_generation++;
+}
+
+// Returns "scheme://host:port" for use as a connection key
+static std::string connection_key(const std::string& url) {
+    size_t scheme_end = url.find("://");
+    std::string scheme = scheme_end == std::string::npos ? "http" : url.substr(0, scheme_end);
+    size_t host_begin = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+    size_t host_end = url.find('/', host_begin);
+    std::string authority = url.substr(host_begin, host_end == std::string::npos ? std::string::npos : host_end - host_begin);
+    if (authority.find(':') == std::string::npos) {
+        authority += scheme == "https" ? ":443" : ":80";
+    }
+    return scheme + "://" + authority;
+}
+
+// ---------------- HTTPClient ----------------
+
+HTTPClient::HTTPClient()
+    : client_(nullptr), response_size_(-1), response_chunked_(false), timeout_ms_(5000), reuse_(true) {}
+
+HTTPClient::~HTTPClient() {
+    if (client_ != nullptr && client_ == owned_client_.get()) {
+        client_->stop();
+    }
+}
+
+bool HTTPClient::begin(String url) {
+    if (!owned_client_) {
+        owned_client_.reset(new WiFiClient());
+    }
+    return begin(*owned_client_, url);
+}
+
+bool HTTPClient::begin(WiFiClient& client, String url) {
+    if (url.indexOf("://") < 0) {
+        return false;
+    }
+    client_ = &client;
+    url_ = url.str();
+    host_ = connection_key(url_);
+    headers_.clear();
+    response_size_ = -1;
+    return true;
+}
+
+void HTTPClient::end(void) {
+    if (client_ == nullptr) {
+        return;
+    }
+    if (!reuse_) {
+        client_->stop();
+        connected_host_.clear();
+    }
+}
+
+bool HTTPClient::connected(void) {
+    return client_ != nullptr && client_->connected();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+    (void)first;
+    std::string key = name.str();
+    if (!replace && headers_.count(key)) {
+        headers_[key] += ", " + value.str();
+    } else {
+        headers_[key] = value.str();
+    }
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET");
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::PUT(uint8_t* payload, size_t size) {
+    return sendRequest("PUT", payload, size);
+}
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+    if (client_ == nullptr) {
+        return HTTPC_ERROR_NOT_CONNECTED;
+    }
+
+    // Reuse the socket only if it is still open to the same host
+    bool reuse_socket = reuse_ && client_->connected() && connected_host_ == host_;
+    if (reuse_socket && client_->host_is_stale()) {
+        // Writing to a socket the peer already dropped
+        client_->stop();
+        connected_host_.clear();
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    if (!reuse_socket) {
+        client_->stop();
+        if (!client_->connect(host_.c_str(), 0)) {
+            connected_host_.clear();
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        connected_host_ = host_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(http_stats_mutex);
+        http_stats.connections_opened += reuse_socket ? 0 : 1;
+        http_stats.requests++;
+    }
+
+    host_http_request_t request;
+    request.method = type;
+    request.url = url_;
+    request.host = host_;
+    request.headers = headers_;
+    if (payload != nullptr && size > 0) {
+        request.body.assign((const char*)payload, size);
+    }
+
+    host_http_response_t response = {HTTPC_ERROR_CONNECTION_REFUSED, std::string()};
+    if (http_handler) {
+        response = http_handler(request);
+    }
+
+    if (response.status < 0) {
+        client_->stop();
+        connected_host_.clear();
+        return response.status;
+    }
+
+    response_chunked_ = response.chunked;
+    response_size_ = response.chunked ? -1 : (int)response.body.size();
+    if (response.drop_after > 0 && response.drop_after < response.body.size()) {
+        // Content-Length still announces the whole body
+        client_->host_set_rx(response.body.substr(0, response.drop_after));
+        client_->host_peer_close();
+        connected_host_.clear();
+    } else {
+        client_->host_set_rx(response.body);
+    }
+    return response.status;
+}
+
+int HTTPClient::getSize(void) {
+    return response_size_;
+}
+
+String HTTPClient::getString(void) {
+    if (client_ == nullptr) {
+        return String();
+    }
+    int remaining = client_->available();
+    String body;
+    if (remaining > 0) {
+        body.reserve((unsigned int)remaining);
+        char chunk[256];
+        size_t n;
+        while ((n = client_->readBytes(chunk, sizeof(chunk))) > 0) {
+            body.concat(chunk, (unsigned int)n);
+        }
+    }
+    return body;
+}
+
+WiFiClient& HTTPClient::getStream(void) {
+    return *client_;
+}
+
+WiFiClient* HTTPClient::getStreamPtr(void) {
+    return client_;
+}
+
+// Like the ESP32 client: the body goes to stream in blocks (transfer encoding already
+// removed) and a short write ends the transfer and closes the connection
+int HTTPClient::writeToStream(Stream* stream) {
+    if (client_ == nullptr || stream == nullptr) {
+        return HTTPC_ERROR_NO_STREAM;
+    }
+    char block[1436];
+    size_t n;
+    int written = 0;
+    while ((n = client_->readBytes(block, sizeof(block))) > 0) {
+        size_t accepted = stream->write((const uint8_t*)block, n);
+        written += (int)accepted;
+        if (accepted != n) {
+            client_->stop();
+            connected_host_.clear();
+            return HTTPC_ERROR_STREAM_WRITE;
+        }
+    }
+    return written;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED: return F("connection refused");
+        case HTTPC_ERROR_SEND_HEADER_FAILED: return F("send header failed");
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return F("send payload failed");
+        case HTTPC_ERROR_NOT_CONNECTED: return F("not connected");
+        case HTTPC_ERROR_CONNECTION_LOST: return F("connection lost");
+        case HTTPC_ERROR_NO_STREAM: return F("no stream");
+        case HTTPC_ERROR_NO_HTTP_SERVER: return F("no HTTP server");
+        case HTTPC_ERROR_TOO_LESS_RAM: return F("too less ram");
+        case HTTPC_ERROR_ENCODING: return F("Transfer-Encoding not supported");
+        case HTTPC_ERROR_STREAM_WRITE: return F("Stream write error");
+        case HTTPC_ERROR_READ_TIMEOUT: return F("read Timeout");
+        default: return String();
+    }
+}
@@ -0,0 +1,664 @@
+// In-memory NVS (Preferences), SPIFFS and flash partition shims.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <SPIFFS.h>
+#include <esp_ota_ops.h>
+#include "host_shims.h"
+
+#include <map>
+#include <vector>
+
+// ---------------- NVS ----------------
+
+typedef std::map<std::string, std::vector<uint8_t>> nvs_namespace_t;
+static std::map<std::string, nvs_namespace_t> nvs_store;
+static uint32_t nvs_writes = 0;
+
+void host_nvs_reset(void) {
+    nvs_store.clear();
+    nvs_writes = 0;
+}
+
+uint32_t host_nvs_write_count(void) {
+    return nvs_writes;
+}
+
+bool Preferences::begin(const char* name, bool read_only, const char* partition_label) {
+    (void)partition_label;
+    if (started_ || name == nullptr || strlen(name) > 15) {
+        return false;
+    }
+    namespace_ = name;
+    read_only_ = read_only;
+    started_ = true;
+    if (!read_only_) {
+        nvs_store[namespace_];
+    }
+    return true;
+}
+
+void Preferences::end() {
+    started_ = false;
+}
+
+bool Preferences::clear() {
+    if (!started_ || read_only_) {
+        return false;
+    }
+    nvs_store[namespace_].clear();
+    nvs_writes++;
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!started_ || read_only_ || key == nullptr) {
+        return false;
+    }
+    nvs_writes++;
+    return nvs_store[namespace_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!started_ || key == nullptr) {
+        return false;
+    }
+    auto ns = nvs_store.find(namespace_);
+    return ns != nvs_store.end() && ns->second.count(key) > 0;
+}
+
+size_t Preferences::freeEntries() {
+    return 630;
+}
+
+size_t Preferences::put_raw(const char* key, const void* value, size_t len) {
+    if (!started_ || read_only_ || key == nullptr || strlen(key) > 15) {
+        return 0;
+    }
+    const uint8_t* bytes = (const uint8_t*)value;
+    nvs_store[namespace_][key].assign(bytes, bytes + len);
+    nvs_writes++;
+    return len;
+}
+
+bool Preferences::get_raw(const char* key, void* value, size_t len) {
+    if (!started_ || key == nullptr) {
+        return false;
+    }
+    auto ns = nvs_store.find(namespace_);
+    if (ns == nvs_store.end()) {
+        return false;
+    }
+    auto entry = ns->second.find(key);
+    if (entry == ns->second.end() || entry->second.size() != len) {
+        return false;
+    }
+    memcpy(value, entry->second.data(), len);
+    return true;
+}
+
+#define HOST_PREFS_TYPED(put_name, get_name, type)                          \
+    size_t Preferences::put_name(const char* key, type value) {             \
+        return put_raw(key, &value, sizeof(value));                         \
+    }                                                                       \
+    type Preferences::get_name(const char* key, type default_value) {       \
+        type value;                                                         \
+        return get_raw(key, &value, sizeof(value)) ? value : default_value; \
+    }
+
+HOST_PREFS_TYPED(putChar, getChar, int8_t)
+HOST_PREFS_TYPED(putUChar, getUChar, uint8_t)
+HOST_PREFS_TYPED(putShort, getShort, int16_t)
+HOST_PREFS_TYPED(putUShort, getUShort, uint16_t)
+HOST_PREFS_TYPED(putInt, getInt, int32_t)
+HOST_PREFS_TYPED(putUInt, getUInt, uint32_t)
+HOST_PREFS_TYPED(putLong, getLong, int32_t)
+HOST_PREFS_TYPED(putULong, getULong, uint32_t)
+HOST_PREFS_TYPED(putLong64, getLong64, int64_t)
+HOST_PREFS_TYPED(putULong64, getULong64, uint64_t)
+HOST_PREFS_TYPED(putFloat, getFloat, float)
+HOST_PREFS_TYPED(putBool, getBool, bool)
+
+#undef HOST_PREFS_TYPED
+
+size_t Preferences::putString(const char* key, const char* value) {
+    return put_raw(key, value, strlen(value) + 1);
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+    return putString(key, value.c_str());
+}
+
+String Preferences::getString(const char* key, const String& default_value) {
+    size_t len = getBytesLength(key);
+    if (len == 0) {
+        return default_value;
+    }
+    std::vector<char> buf(len);
+    getBytes(key, buf.data(), len);
+    return String(buf.data());
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    return put_raw(key, value, len);
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!started_ || key == nullptr) {
+        return 0;
+    }
+    auto ns = nvs_store.find(namespace_);
+    if (ns == nvs_store.end()) {
+        return 0;
+    }
+    auto entry = ns->second.find(key);
+    return entry == ns->second.end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t max_len) {
+    size_t len = getBytesLength(key);
+    if (len == 0 || buf == nullptr || len > max_len) {
+        return 0;
+    }
+    memcpy(buf, nvs_store[namespace_][key].data(), len);
+    return len;
+}
+
+// ---------------- SPIFFS ----------------
+
+namespace fs {
+
+class FSImpl {
+public:
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+    size_t capacity = 0xB0000;   // spiffs partition size in partitions_ota.csv
+    bool mounted = false;
+
+    size_t used() const {
+        size_t total = 0;
+        for (const auto& entry : files) {
+            total += entry.second->size();
+        }
+        return total;
+    }
+};
+
+struct FileImpl {
+    std::shared_ptr<FSImpl> fs;
+    std::string path;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t position = 0;
+    bool writable = false;
+    bool append = false;
+    bool open = false;
+    bool directory = false;
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>>::iterator next_entry;
+};
+
+} // namespace fs
+
+static uint32_t spiffs_written = 0;
+static std::shared_ptr<fs::FSImpl> spiffs_impl = std::make_shared<fs::FSImpl>();
+static int spiffs_mutations_left = -1;   // Until the power cut; -1: no cut armed
+static bool spiffs_power_lost = false;
+
+// Called before each mutation; false once the power is gone. *torn is set for the
+// mutation the power fails during.
+static bool spiffs_mutation_allowed(bool* torn) {
+    *torn = false;
+    if (spiffs_power_lost) {
+        return false;
+    }
+    if (spiffs_mutations_left == 0) {
+        spiffs_power_lost = true;
+        spiffs_mutations_left = -1;
+        *torn = true;
+        return true;
+    }
+    if (spiffs_mutations_left > 0) {
+        spiffs_mutations_left--;
+    }
+    return true;
+}
+
+fs::SPIFFSFS SPIFFS;
+
+void host_spiffs_reset(void) {
+    spiffs_impl->files.clear();
+    spiffs_written = 0;
+}
+
+uint32_t host_spiffs_bytes_written(void) {
+    return spiffs_written;
+}
+
+void host_spiffs_set_capacity(size_t total_bytes) {
+    spiffs_impl->capacity = total_bytes;
+}
+
+void host_spiffs_cut_power_after(int mutations) {
+    spiffs_mutations_left = mutations;
+}
+
+void host_spiffs_restore_power(void) {
+    spiffs_power_lost = false;
+    spiffs_mutations_left = -1;
+}
+
+bool host_spiffs_power_lost(void) {
+    return spiffs_power_lost;
+}
+
+namespace fs {
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+    if (!impl_ || !impl_->open || !impl_->writable) {
+        return 0;
+    }
+    if (impl_->fs->used() + size > impl_->fs->capacity) {
+        return 0;   // SPIFFS full
+    }
+    bool torn = false;
+    if (!spiffs_mutation_allowed(&torn)) {
+        return 0;
+    }
+    if (torn) {
+        size /= 2;
+    }
+    std::vector<uint8_t>& data = *impl_->data;
+    if (impl_->append) {
+        impl_->position = data.size();
+    }
+    if (impl_->position + size > data.size()) {
+        data.resize(impl_->position + size);
+    }
+    memcpy(data.data() + impl_->position, buf, size);
+    impl_->position += size;
+    spiffs_written += (uint32_t)size;
+    return size;
+}
+
+int File::available() {
+    if (!impl_ || !impl_->open || impl_->directory) {
+        return 0;
+    }
+    return (int)(impl_->data->size() - impl_->position);
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+    if (available() <= 0) {
+        return -1;
+    }
+    return (*impl_->data)[impl_->position];
+}
+
+void File::flush() {}
+
+size_t File::read(uint8_t* buf, size_t size) {
+    int remaining = available();
+    if (remaining <= 0) {
+        return 0;
+    }
+    size_t n = std::min(size, (size_t)remaining);
+    memcpy(buf, impl_->data->data() + impl_->position, n);
+    impl_->position += n;
+    return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl_ || !impl_->open) {
+        return false;
+    }
+    size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? impl_->position : impl_->data->size());
+    if (base + pos > impl_->data->size()) {
+        return false;
+    }
+    impl_->position = base + pos;
+    return true;
+}
+
+size_t File::position() const {
+    return impl_ ? impl_->position : 0;
+}
+
+size_t File::size() const {
+    return impl_ && impl_->data ? impl_->data->size() : 0;
+}
+
+void File::close() {
+    if (impl_) {
+        impl_->open = false;
+    }
+}
+
+File::operator bool() const {
+    return impl_ && impl_->open;
+}
+
+const char* File::path() const {
+    return impl_ ? impl_->path.c_str() : nullptr;
+}
+
+const char* File::name() const {
+    if (!impl_) {
+        return nullptr;
+    }
+    size_t slash = impl_->path.rfind('/');
+    return impl_->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+bool File::isDirectory(void) {
+    return impl_ && impl_->directory;
+}
+
+File File::openNextFile(const char* mode) {
+    if (!impl_ || !impl_->directory) {
+        return File();
+    }
+    std::string prefix = impl_->path;
+    if (prefix.empty() || prefix.back() != '/') {
+        prefix += '/';
+    }
+    auto& files = impl_->fs->files;
+    while (impl_->next_entry != files.end()) {
+        auto entry = impl_->next_entry++;
+        if (entry->first.compare(0, prefix.size(), prefix) == 0) {
+            return FS(impl_->fs).open(entry->first.c_str(), mode);
+        }
+    }
+    return File();
+}
+
+void File::rewindDirectory(void) {
+    if (impl_ && impl_->directory) {
+        impl_->next_entry = impl_->fs->files.begin();
+    }
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+    (void)create;
+    if (!impl_->mounted || path == nullptr || mode == nullptr) {
+        return File();
+    }
+    std::string key = path;
+    auto impl = std::make_shared<FileImpl>();
+    impl->fs = impl_;
+    impl->path = key;
+
+    auto existing = impl_->files.find(key);
+    if (mode[0] == 'r' && existing == impl_->files.end()) {
+        // Opening a prefix of existing paths for reading yields a directory handle
+        bool is_dir = key == "/";
+        for (const auto& entry : impl_->files) {
+            if (entry.first.compare(0, key.size(), key) == 0 && entry.first.size() > key.size()
+                && (key.back() == '/' || entry.first[key.size()] == '/')) {
+                is_dir = true;
+                break;
+            }
+        }
+        if (!is_dir) {
+            return File();
+        }
+        impl->directory = true;
+        impl->open = true;
+        impl->data = std::make_shared<std::vector<uint8_t>>();
+        impl->next_entry = impl_->files.begin();
+        return File(impl);
+    }
+
+    if (mode[0] == 'w' || existing == impl_->files.end()) {
+        // Creating or truncating is a mutation; cut mid-way it leaves an empty file
+        bool torn = false;
+        if (!spiffs_mutation_allowed(&torn)) {
+            return File();
+        }
+        impl->data = std::make_shared<std::vector<uint8_t>>();
+        impl_->files[key] = impl->data;
+        if (torn) {
+            return File();
+        }
+    } else {
+        impl->data = existing->second;
+    }
+    impl->writable = mode[0] != 'r' || strchr(mode, '+') != nullptr;
+    impl->append = mode[0] == 'a';
+    impl->position = impl->append ? impl->data->size() : 0;
+    impl->open = true;
+    return File(impl);
+}
+
+bool FS::exists(const char* path) {
+    return impl_->mounted && path != nullptr && impl_->files.count(path) > 0;
+}
+
+bool FS::remove(const char* path) {
+    bool torn = false;
+    if (!impl_->mounted || path == nullptr || !spiffs_mutation_allowed(&torn) || torn) {
+        return false;
+    }
+    return impl_->files.erase(path) > 0;
+}
+
+bool FS::rename(const char* path_from, const char* path_to) {
+    bool torn = false;
+    if (!impl_->mounted || path_from == nullptr || path_to == nullptr || !spiffs_mutation_allowed(&torn) || torn) {
+        return false;
+    }
+    auto entry = impl_->files.find(path_from);
+    if (entry == impl_->files.end()) {
+        return false;
+    }
+    auto data = entry->second;
+    impl_->files.erase(entry);
+    impl_->files[path_to] = data;
+    return true;
+}
+
+SPIFFSFS::SPIFFSFS() : FS(spiffs_impl) {}
+
+bool SPIFFSFS::begin(bool format_on_fail, const char* base_path, uint8_t max_open_files,
+                     const char* partition_label) {
+    (void)format_on_fail;
+    (void)base_path;
+    (void)max_open_files;
+    (void)partition_label;
+    impl_->mounted = true;
+    return true;
+}
+
+bool SPIFFSFS::format() {
+    impl_->files.clear();
+    return true;
+}
+
+size_t SPIFFSFS::totalBytes() {
+    return impl_->capacity;
+}
+
+size_t SPIFFSFS::usedBytes() {
+    return impl_->used();
+}
+
+void SPIFFSFS::end() {
+    impl_->mounted = false;
+}
+
+} // namespace fs
+
+// ---------------- Flash partitions ----------------
+
+static const esp_partition_t host_partitions[] = {
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 0x1A0000, "app0", false},
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x1B0000, 0x1A0000, "app1", false},
+    {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x350000, 0xB0000, "spiffs", false},
+};
+static const size_t HOST_PARTITION_COUNT = sizeof(host_partitions) / sizeof(host_partitions[0]);
+
+static std::map<const esp_partition_t*, std::vector<uint8_t>> partition_flash;
+static const esp_partition_t* boot_partition = &host_partitions[0];
+
+typedef struct {
+    const esp_partition_t* partition;
+    size_t written;
+    bool active;
+} host_ota_session_t;
+
+static std::map<esp_ota_handle_t, host_ota_session_t> ota_sessions;
+static esp_ota_handle_t next_ota_handle = 1;
+
+static std::vector<uint8_t>& flash_of(const esp_partition_t* partition) {
+    std::vector<uint8_t>& flash = partition_flash[partition];
+    if (flash.size() != partition->size) {
+        flash.assign(partition->size, 0xFF);
+    }
+    return flash;
+}
+
+static long flash_bytes_left = -1;  // Until the power cut; -1: no cut armed
+static bool flash_power_lost = false;
+static uint32_t flash_erase_us_per_sector = 0;
+static uint32_t flash_write_us_per_kb = 0;
+
+void host_partitions_reset(void) {
+    partition_flash.clear();
+    ota_sessions.clear();
+    boot_partition = &host_partitions[0];
+    flash_bytes_left = -1;
+    flash_power_lost = false;
+    flash_erase_us_per_sector = 0;
+    flash_write_us_per_kb = 0;
+}
+
+void host_partitions_set_timing(uint32_t erase_us_per_sector, uint32_t write_us_per_kb) {
+    flash_erase_us_per_sector = erase_us_per_sector;
+    flash_write_us_per_kb = write_us_per_kb;
+}
+
+void host_partitions_cut_power_after(long bytes) {
+    flash_bytes_left = bytes < 0 ? -1 : bytes;
+    flash_power_lost = false;
+}
+
+void host_partitions_restore_power(void) {
+    flash_bytes_left = -1;
+    flash_power_lost = false;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char* label) {
+    for (size_t i = 0; i < HOST_PARTITION_COUNT; i++) {
+        const esp_partition_t* p = &host_partitions[i];
+        if (p->type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p->subtype != subtype) continue;
+        if (label != nullptr && strcmp(label, p->label) != 0) continue;
+        return p;
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    if (partition == nullptr || dst == nullptr) return ESP_ERR_INVALID_ARG;
+    if (src_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, flash_of(partition).data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    if (partition == nullptr || src == nullptr) return ESP_ERR_INVALID_ARG;
+    if (dst_offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    if (flash_power_lost) return ESP_FAIL;
+    size_t length = size;
+    if (flash_bytes_left >= 0) {
+        if ((size_t)flash_bytes_left < size) {
+            length = (size_t)flash_bytes_left;
+            flash_power_lost = true;
+        }
+        flash_bytes_left -= (long)length;
+    }
+    if (flash_write_us_per_kb > 0) {
+        host_clock_advance_us((uint64_t)length * flash_write_us_per_kb / 1024);
+    }
+    // NOR flash semantics: writes can only clear bits
+    std::vector<uint8_t>& flash = flash_of(partition);
+    const uint8_t* bytes = (const uint8_t*)src;
+    for (size_t i = 0; i < length; i++) {
+        flash[dst_offset + i] &= bytes[i];
+    }
+    return flash_power_lost ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (partition == nullptr) return ESP_ERR_INVALID_ARG;
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) return ESP_ERR_INVALID_ARG;
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    if (flash_power_lost) return ESP_FAIL;
+    if (flash_erase_us_per_sector > 0) {
+        host_clock_advance_us((uint64_t)(size / SPI_FLASH_SEC_SIZE) * flash_erase_us_per_sector);
+    }
+    std::vector<uint8_t>& flash = flash_of(partition);
+    memset(flash.data() + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+    return &host_partitions[0];
+}
+
+const esp_partition_t* esp_ota_get_boot_partition(void) {
+    return boot_partition;
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    const esp_partition_t* from = start_from ? start_from : esp_ota_get_running_partition();
+    return from == &host_partitions[0] ? &host_partitions[1] : &host_partitions[0];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    if (partition == nullptr || out_handle == nullptr) return ESP_ERR_INVALID_ARG;
+    if (partition == esp_ota_get_running_partition()) return ESP_ERR_INVALID_ARG;
+    if (image_size != OTA_SIZE_UNKNOWN && image_size > partition->size) return ESP_ERR_INVALID_SIZE;
+    size_t erase_size = image_size == OTA_SIZE_UNKNOWN ? partition->size
+        : ((image_size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE) * SPI_FLASH_SEC_SIZE;
+    esp_partition_erase_range(partition, 0, erase_size);
+    *out_handle = next_ota_handle++;
+    ota_sessions[*out_handle] = {partition, 0, true};
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    auto session = ota_sessions.find(handle);
+    if (session == ota_sessions.end() || !session->second.active) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = esp_partition_write(session->second.partition, session->second.written, data, size);
+    if (err == ESP_OK) {
+        session->second.written += size;
+    }
+    return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    auto session = ota_sessions.find(handle);
+    if (session == ota_sessions.end()) return ESP_ERR_NOT_FOUND;
+    bool empty = session->second.written == 0;
+    ota_sessions.erase(session);
+    return empty ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    return ota_sessions.erase(handle) > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    if (partition == nullptr || partition->type != ESP_PARTITION_TYPE_APP) return ESP_ERR_INVALID_ARG;
+    boot_partition = partition;
+    return ESP_OK;
+}
@@ -0,0 +1,197 @@
+// Host simulation harness: firmware scheduler plus stand-in backends on the virtual clock.
+
+#include "sim_harness.h"
+
+#include <Arduino.h>
+#include "config.h"
+#include "config_manager.h"
+#include "scheduler.h"
+#include "api_client.h"
+#include "encryptionAndSecurity.h"
+#include "error_handler.h"
+#include "modbus_handler.h"
+#include "upload_backlog.h"
+#include "host_shims.h"
+
+#include <random>
+#include <string>
+
+NonceManager nonceManager;
+
+static sim_backend_t backend;
+static std::mt19937 rng;
+static uint64_t start_ms = 0;
+static uint32_t uploads = 0;  // Upload requests the cloud answered, for the stalls
+static std::vector<sim_event_t> timeline;
+static sample_stats_t last_stats = {0};
+
+static const char* const EVENT_NAMES[SIM_EVENT_TYPE_COUNT] = {
+    "read", "upload", "sleep", "dropped", "missed_poll"
+};
+
+static void record(sim_event_type_t type, uint32_t value) {
+    timeline.push_back(sim_event_t{sim_now_ms(), type, value});
+}
+
+// Sample losses since the last look, stamped now; called at every request, sleep and loop pass
+static void record_sample_losses(void) {
+    sample_stats_t stats = scheduler_get_sample_stats();
+    uint32_t dropped = (stats.dropped_full - last_stats.dropped_full) +
+                       (stats.overwritten - last_stats.overwritten);
+    uint32_t missed = stats.missed_polls - last_stats.missed_polls;
+    if (dropped > 0) {
+        record(SIM_EVENT_DROPPED, dropped);
+    }
+    if (missed > 0) {
+        record(SIM_EVENT_MISSED_POLL, missed);
+    }
+    last_stats = stats;
+}
+
+static bool within(uint64_t t, uint64_t from, uint64_t until) {
+    return t >= from && t < until;
+}
+
+static uint32_t service_time(uint32_t min_ms, uint32_t max_ms) {
+    return max_ms > min_ms ? min_ms + rng() % (max_ms - min_ms + 1) : min_ms;
+}
+
+static host_http_response_t inverter_response(void) {
+    uint8_t frame[64];
+    size_t n = 0;
+    frame[n++] = SLAVE_ADDRESS;
+    frame[n++] = FUNCTION_CODE_READ;
+    frame[n++] = READ_REGISTER_COUNT * 2;
+    for (int i = 0; i < READ_REGISTER_COUNT; i++) {
+        uint16_t value = (uint16_t)(2300 + i * 10 + rng() % 8);
+        frame[n++] = value >> 8;
+        frame[n++] = value & 0xFF;
+    }
+    n = modbus_append_crc(frame, n, sizeof(frame));
+    char hex[160];
+    modbus_bytes_to_hex(frame, n, hex, sizeof(hex));
+    return host_http_response_t{200, std::string("{\"frame\":\"") + hex + "\"}"};
+}
+
+static host_http_response_t stand_in_server(const host_http_request_t& request) {
+    record_sample_losses();
+    uint64_t now = sim_now_ms();
+    if (request.url.find("/api/inverter/read") != std::string::npos) {
+        if (within(now, backend.inverter_down_from_ms, backend.inverter_down_until_ms) ||
+            rng() % 1000 < backend.read_fail_per_mille) {
+            record(SIM_EVENT_READ, 0);
+            host_clock_advance_ms(backend.fail_ms);
+            return host_http_response_t{HTTPC_ERROR_READ_TIMEOUT, ""};
+        }
+        record(SIM_EVENT_READ, 1);
+        host_clock_advance_ms(service_time(backend.read_ms_min, backend.read_ms_max));
+        return inverter_response();
+    }
+
+    bool upload = request.url.find("/api/cloud/write") != std::string::npos;
+    if (within(now, backend.cloud_down_from_ms, backend.cloud_down_until_ms) ||
+        (upload && rng() % 1000 < backend.upload_fail_per_mille)) {
+        if (upload) {
+            record(SIM_EVENT_UPLOAD, 0);
+        }
+        host_clock_advance_ms(backend.fail_ms);
+        return host_http_response_t{503, ""};
+    }
+    if (upload) {
+        record(SIM_EVENT_UPLOAD, (uint32_t)request.body.size());
+        uploads++;
+        bool stall = backend.upload_stall_every > 0 && uploads % backend.upload_stall_every == 0;
+        host_clock_advance_ms(stall ? backend.upload_stall_ms
+                                    : service_time(backend.upload_ms_min, backend.upload_ms_max));
+    }
+    return host_http_response_t{200, "{\"status\":\"success\"}"};
+}
+
+sim_backend_t sim_default_backend(void) {
+    sim_backend_t defaults = {};
+    defaults.seed = 1;
+    defaults.read_ms_min = 60;
+    defaults.read_ms_max = 250;
+    defaults.upload_ms_min = 300;
+    defaults.upload_ms_max = 1500;
+    defaults.read_fail_per_mille = 5;
+    defaults.upload_fail_per_mille = 5;
+    defaults.fail_ms = 1000;
+    return defaults;
+}
+
+void sim_init(const sim_backend_t& config) {
+    backend = config;
+    rng.seed(config.seed);
+    Serial.set_echo(false);
+    host_clock_use_virtual(true);
+    start_ms = host_clock_now_us() / 1000;
+    host_http_set_handler(stand_in_server);
+    host_light_sleep_set_observer([](uint64_t duration_us) {
+        record_sample_losses();
+        record(SIM_EVENT_SLEEP, (uint32_t)(duration_us / 1000));
+    });
+
+    error_handler_init();
+    nonceManager.begin();
+    upload_backlog_init();
+    api_init();
+    config_manager_init();
+    scheduler_init();
+    init_tasks_last_run(millis());
+    last_stats = scheduler_get_sample_stats();
+}
+
+void sim_run_for(uint64_t duration_ms) {
+    uint64_t until = sim_now_ms() + duration_ms;
+    while (sim_now_ms() < until) {
+        scheduler_run();
+        record_sample_losses();
+        // Nobody reads the serial log here; keep it from growing for days
+        Serial.clear_captured();
+    }
+}
+
+bool sim_run_pipeline_for(uint64_t duration_ms) {
+    if (!scheduler_start_pipeline()) {
+        return false;
+    }
+    delay((uint32_t)duration_ms);
+    scheduler_stop_pipeline();
+    record_sample_losses();
+    Serial.clear_captured();
+    return true;
+}
+
+uint64_t sim_now_ms(void) {
+    return host_clock_now_us() / 1000 - start_ms;
+}
+
+const std::vector<sim_event_t>& sim_timeline(void) {
+    return timeline;
+}
+
+const char* sim_event_name(sim_event_type_t type) {
+    return type < SIM_EVENT_TYPE_COUNT ? EVENT_NAMES[type] : "unknown";
+}
+
+void sim_write_timeline(FILE* out) {
+    fprintf(out, "at_ms,event,value\n");
+    for (const sim_event_t& event : timeline) {
+        fprintf(out, "%llu,%s,%u\n", (unsigned long long)event.at_ms, sim_event_name(event.type), event.value);
+    }
+}
+
+uint64_t sim_timeline_digest(void) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const sim_event_t& event : timeline) {
+        uint64_t fields[3] = {event.at_ms, (uint64_t)event.type, event.value};
+        for (uint64_t field : fields) {
+            for (int i = 0; i < 8; i++) {
+                hash ^= (field >> (8 * i)) & 0xFF;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
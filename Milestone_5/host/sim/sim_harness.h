@@ -0,0 +1,77 @@
+#ifndef SIM_HARNESS_H
+#define SIM_HARNESS_H
+
+// Runs the firmware scheduler, its read and upload tasks and stand-in inverter and cloud
+// backends on the shim's virtual clock, and records what happened as a timeline. The
+// firmware keeps calling millis(), delay() and esp_light_sleep_start(); in the host build
+// those move virtual time, so days of operation run in seconds.
+//
+// The harness defines the firmware's global NonceManager, so a program using it must not.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+typedef enum {
+    SIM_EVENT_READ,            // A poll reached the inverter; value: 1 answered, 0 failed
+    SIM_EVENT_UPLOAD,          // An upload request reached the cloud; value: body bytes, 0 refused
+    SIM_EVENT_SLEEP,           // Light sleep started; value: ms
+    SIM_EVENT_DROPPED,         // Samples rejected or overwritten in the buffer; value: count
+    SIM_EVENT_MISSED_POLL,     // Read deadlines that passed without a poll; value: count
+    SIM_EVENT_TYPE_COUNT
+} sim_event_type_t;
+
+typedef struct {
+    uint64_t at_ms;            // Virtual time since sim_init()
+    sim_event_type_t type;
+    uint32_t value;
+} sim_event_t;
+
+// Stand-in backends. Response times are drawn uniformly from [min, max]; failures are
+// a read timeout from the inverter and a 503 from the cloud. Every upload_stall_every-th
+// upload takes upload_stall_ms instead, as on a slow handshake.
+typedef struct {
+    unsigned seed;
+    uint32_t read_ms_min;
+    uint32_t read_ms_max;
+    uint32_t upload_ms_min;
+    uint32_t upload_ms_max;
+    uint32_t read_fail_per_mille;
+    uint32_t upload_fail_per_mille;
+    uint32_t fail_ms;                 // Time a failed request takes to give up
+    uint32_t upload_stall_every;      // 0 for no stalls
+    uint32_t upload_stall_ms;
+    uint64_t inverter_down_from_ms;   // Every read fails in [from, until)
+    uint64_t inverter_down_until_ms;
+    uint64_t cloud_down_from_ms;      // Every request to the cloud fails in [from, until)
+    uint64_t cloud_down_until_ms;
+} sim_backend_t;
+
+// 60-250 ms reads, 0.3-1.5 s uploads, 0.5% failures each taking 1 s, and no outages
+sim_backend_t sim_default_backend(void);
+
+// Switches to the virtual clock, installs the backends and brings up the firmware modules
+// as setup() does, with the task deadlines anchored at the current time. The device config
+// is whatever is in NVS, as at boot. Call once.
+void sim_init(const sim_backend_t& backend);
+
+// Runs the scheduler until duration_ms of virtual time have passed since the call
+void sim_run_for(uint64_t duration_ms);
+
+// The same with the acquisition and upload tasks of scheduler_start_pipeline(). On the
+// virtual clock they take turns as on one core: one runs until it waits (for a response,
+// its next deadline or a notification), so the harness and backends see no races.
+// False if the tasks could not be started.
+bool sim_run_pipeline_for(uint64_t duration_ms);
+
+uint64_t sim_now_ms(void);
+const std::vector<sim_event_t>& sim_timeline(void);
+const char* sim_event_name(sim_event_type_t type);
+
+// One "at_ms,event,value" line per event, after a header
+void sim_write_timeline(FILE* out);
+
+// FNV-1a over the events, to compare timelines across builds without storing them
+uint64_t sim_timeline_digest(void);
+
+#endif
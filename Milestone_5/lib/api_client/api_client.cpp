@@ -2,25 +2,404 @@
 #include "config.h"
 #include "error_handler.h"
 #include "cloudAPI_handler.h"
+#include "modbus_handler.h"
+#include "json_scan.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <atomic>
+
+// One pooled client per host; see api_connection_begin()
+typedef struct {
+    HTTPClient http;
+    api_connection_stats_t stats;
+    api_request_info_t last_request;
+    SemaphoreHandle_t lock;  // Held from begin to end, as tasks on both cores send requests
+} api_connection_t;
+
+static api_connection_t connections[API_HOST_COUNT];
+static std::atomic<api_host_t> last_host(API_HOST_OTHER);  // Host of the most recent request, from any task
+
+static api_host_t api_host_for(const char* url) {
+    if (strncmp(url, API_BASE_URL, sizeof(API_BASE_URL) - 1) == 0) {
+        return API_HOST_INVERTER;
+    }
+    if (strncmp(url, UPLOAD_API_BASE_URL, sizeof(UPLOAD_API_BASE_URL) - 1) == 0) {
+        return API_HOST_CLOUD;
+    }
+    return API_HOST_OTHER;
+}
+
+// Point the host's client at url. With HTTP_KEEP_ALIVE the connection left open by the
+// previous request to the same host is used again; nothing is opened until the request is sent.
+// A request already under way to the host is waited for; every path must end the connection.
+static api_connection_t* api_connection_begin(const char* url) {
+    api_host_t host = api_host_for(url);
+    api_connection_t* connection = &connections[host];
+    HTTPClient& http = connection->http;
+
+    if (connection->lock != nullptr) {
+        xSemaphoreTake(connection->lock, portMAX_DELAY);
+    }
+
+    http.setReuse(HTTP_KEEP_ALIVE && host != API_HOST_OTHER);
+    http.begin(url);
+    http.setTimeout(HTTP_TIMEOUT_MS);
+    connection->last_request.host = host;
+    connection->last_request.encryption_unsupported = false;
+    last_host = host;
+    return connection;
+}
+
+// True for the errors HTTPClient reports when writing the request failed, before the
+// server could have seen it. Timeouts and losses while waiting for the reply are not
+// among them: the request may have been acted on, and an upload must not arrive twice.
+static bool api_request_not_sent(int http_code) {
+    return http_code == HTTPC_ERROR_SEND_HEADER_FAILED || http_code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+           http_code == HTTPC_ERROR_CONNECTION_LOST;
+}
+
+// Send the prepared request. If the server dropped a kept-alive connection while it was
+// idle, the write fails; the request then goes out once more on a new connection. Any
+// other error is returned as it is.
+static int api_connection_send(api_connection_t* connection, const char* method, const uint8_t* payload, size_t size) {
+    HTTPClient& http = connection->http;
+    unsigned long start_us = micros();
+
+    bool reused = http.connected();
+    int http_code = http.sendRequest(method, (uint8_t*)payload, size);
+    if (reused && api_request_not_sent(http_code)) {
+        Serial.println(F("[HTTP] Kept-alive connection was closed by the server, reconnecting"));
+        connection->stats.stale++;
+        reused = false;
+        http_code = http.sendRequest(method, (uint8_t*)payload, size);
+    }
+
+    connection->stats.requests++;
+    if (reused) {
+        connection->stats.reused++;
+    } else {
+        connection->stats.connects++;
+    }
+    if (http_code < 0) {
+        connection->stats.failures++;
+    }
+
+    connection->last_request.reused = reused;
+    connection->last_request.http_code = http_code;
+    connection->last_request.duration_us = micros() - start_us;
+    return http_code;
+}
+
+// Finish the request; the connection stays open for the next one if the server allows it
+static void api_connection_end(api_connection_t* connection) {
+    connection->http.end();
+    if (connection->lock != nullptr) {
+        xSemaphoreGive(connection->lock);
+    }
+}
+
+// Receives the response body piece by piece; returns false once it needs no more
+typedef bool (*api_body_sink_fn)(void* context, const char* chunk, size_t length);
+
+// Adapts a sink to the Stream that HTTPClient::writeToStream() writes to
+class ApiBodyStream : public Stream {
+public:
+    ApiBodyStream(api_body_sink_fn sink, void* context) : sink_(sink), context_(context), bytes_(0), stopped_(false), oversized_(false) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (stopped_ || bytes_ + size > HTTP_MAX_BODY_BYTES) {
+            oversized_ = !stopped_;
+            return 0;  // Ends the transfer
+        }
+        bytes_ += size;
+        for (size_t offset = 0; offset < size && !stopped_; offset += HTTP_READ_CHUNK) {
+            size_t length = size - offset < HTTP_READ_CHUNK ? size - offset : HTTP_READ_CHUNK;
+            stopped_ = !sink_(context_, (const char*)buffer + offset, length);
+        }
+        return size;
+    }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    bool stopped() const { return stopped_; }
+    bool oversized() const { return oversized_; }
+
+private:
+    api_body_sink_fn sink_;
+    void* context_;
+    size_t bytes_;
+    bool stopped_;
+    bool oversized_;
+};
+
+// Stream the response body to sink in HTTP_READ_CHUNK pieces, so it is never held whole.
+// Bodies over HTTP_MAX_BODY_BYTES are refused. When the sink stops early, a short
+// remainder is read and dropped so the kept-alive connection stays usable; otherwise
+// the connection is closed.
+static bool api_read_body(api_connection_t* connection, api_body_sink_fn sink, void* context) {
+    HTTPClient& http = connection->http;
+    int size = http.getSize();
+
+    if (size < 0) {
+        // Chunked or unknown length: let HTTPClient remove the transfer encoding
+        ApiBodyStream body(sink, context);
+        int written = http.writeToStream(&body);
+        if (body.stopped()) {
+            return true;
+        }
+        if (written < 0) {
+            if (body.oversized()) {
+                log_error(ERROR_INVALID_RESPONSE, "Response body too large");
+            } else {
+                log_error(ERROR_HTTP_FAILED, "Response body cut short");
+            }
+            return false;
+        }
+        return true;
+    }
+
+    if (size > HTTP_MAX_BODY_BYTES) {
+        log_error(ERROR_INVALID_RESPONSE, "Response body too large");
+        http.setReuse(false);  // The unread body would be left in the socket
+        return false;
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    if (stream == nullptr) {
+        log_error(ERROR_HTTP_FAILED, "No response stream");
+        return false;
+    }
+
+    char chunk[HTTP_READ_CHUNK];
+    size_t remaining = (size_t)size;
+    bool wanted = true;
+    unsigned long last_data = millis();
+    while (remaining > 0) {
+        if (!wanted && remaining > HTTP_READ_CHUNK) {
+            http.setReuse(false);  // Cheaper to reconnect than to drain
+            break;
+        }
+        if (stream->available() <= 0) {
+            if (!stream->connected() || millis() - last_data > HTTP_TIMEOUT_MS) {
+                log_error(ERROR_HTTP_TIMEOUT, "Response body cut short");
+                http.setReuse(false);
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        size_t n = stream->readBytes(chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (n == 0) {
+            continue;
+        }
+        remaining -= n;
+        last_data = millis();
+        if (wanted) {
+            wanted = sink(context, chunk, n);
+        }
+    }
+    return true;
+}
+
+// Collects the body into a String, reserved once from Content-Length when it is known
+static bool api_string_sink(void* context, const char* chunk, size_t length) {
+    ((String*)context)->concat(chunk, (unsigned int)length);
+    return true;
+}
+
+static String api_read_body_string(api_connection_t* connection) {
+    String body;
+    int size = connection->http.getSize();
+    if (size > 0 && size <= HTTP_MAX_BODY_BYTES) {
+        body.reserve(size);
+    }
+    if (!api_read_body(connection, api_string_sink, &body)) {
+        return "";
+    }
+    return body;
+}
+
+static bool api_scan_sink(void* context, const char* chunk, size_t length) {
+    return json_scan_feed((json_scanner_t*)context, chunk, length);
+}
+
+// The "frame" member of an inverter response, hex-decoded as it streams past
+typedef struct {
+    uint8_t* out;
+    size_t out_size;
+    size_t length;
+    int high_nibble;  // First digit of a byte split across pieces, or -1
+    bool found;
+    bool bad;
+} api_frame_decode_t;
+
+static bool api_decode_frame_value(void* context, const char* key, uint8_t depth, const char* chunk, size_t length, bool last) {
+    api_frame_decode_t* decode = (api_frame_decode_t*)context;
+    if (depth != 1 || strcmp(key, "frame") != 0) {
+        return true;
+    }
+    for (size_t i = 0; i < length && !decode->bad; i++) {
+        char c = chunk[i];
+        int digit = (c >= '0' && c <= '9') ? c - '0'
+                  : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+                  : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            decode->bad = true;
+        } else if (decode->high_nibble < 0) {
+            decode->high_nibble = digit;
+        } else if (decode->length >= decode->out_size) {
+            decode->bad = true;
+        } else {
+            decode->out[decode->length++] = (uint8_t)((decode->high_nibble << 4) | digit);
+            decode->high_nibble = -1;
+        }
+    }
+    if (decode->bad) {
+        return false;
+    }
+    if (last) {
+        decode->found = true;
+        return false;  // Nothing else in the body is needed
+    }
+    return true;
+}
+
+// The "frame" member of an inverter response as hex text, for the String API
+typedef struct {
+    String* hex;
+    bool found;
+} api_frame_text_t;
+
+static bool api_copy_frame_value(void* context, const char* key, uint8_t depth, const char* chunk, size_t length, bool last) {
+    api_frame_text_t* text = (api_frame_text_t*)context;
+    if (depth != 1 || strcmp(key, "frame") != 0) {
+        return true;
+    }
+    text->hex->concat(chunk, (unsigned int)length);
+    if (last) {
+        text->found = true;
+        return false;
+    }
+    return true;
+}
 
 bool api_init(void) {
+    for (size_t i = 0; i < API_HOST_COUNT; i++) {
+        if (connections[i].lock == nullptr) {
+            connections[i].lock = xSemaphoreCreateMutex();
+        }
+        if (connections[i].lock == nullptr) {
+            Serial.println(F("[HTTP] Failed to create connection mutex"));
+            return false;
+        }
+    }
     Serial.println(F("API client initialized"));
     return true;
 }
 
+api_connection_stats_t api_get_connection_stats(api_host_t host) {
+    return connections[host].stats;
+}
+
+api_request_info_t api_get_last_request(void) {
+    return connections[last_host].last_request;
+}
+
+api_request_info_t api_get_last_request_to(api_host_t host) {
+    return connections[host].last_request;
+}
+
+void api_close_connections(void) {
+    for (size_t i = 0; i < API_HOST_COUNT; i++) {
+        if (connections[i].lock != nullptr) {
+            xSemaphoreTake(connections[i].lock, portMAX_DELAY);
+        }
+        connections[i].http.setReuse(false);
+        connections[i].http.end();
+        if (connections[i].lock != nullptr) {
+            xSemaphoreGive(connections[i].lock);
+        }
+    }
+}
+
+void api_retry_start(api_retry_t* retry, unsigned long now_ms) {
+    retry->state = API_RETRY_WAITING;
+    retry->attempts = 0;
+    retry->next_attempt_ms = now_ms;
+    retry->last_error = ERROR_NONE;
+}
+
+bool api_retry_due(const api_retry_t* retry, unsigned long now_ms) {
+    return retry->state == API_RETRY_WAITING && (long)(now_ms - retry->next_attempt_ms) >= 0;
+}
+
+bool api_retry_poll(api_retry_t* retry, unsigned long now_ms) {
+    if (!api_retry_due(retry, now_ms)) {
+        return false;
+    }
+    // Try to reconnect WiFi if needed
+    if (retry->attempts > 0 && retry->last_error == ERROR_WIFI_DISCONNECTED) {
+        handle_wifi_reconnection();
+    }
+    return true;
+}
+
+api_retry_state_t api_retry_record(api_retry_t* retry, bool success, unsigned long now_ms, const char* url) {
+    retry->attempts++;
+    if (success) {
+        retry->state = API_RETRY_DONE;
+        return retry->state;
+    }
+
+    // Get the last error for retry decision
+    if (WiFi.status() != WL_CONNECTED) {
+        retry->last_error = ERROR_WIFI_DISCONNECTED;
+    } else {
+        retry->last_error = ERROR_HTTP_FAILED;
+    }
+
+    if (!should_retry(retry->last_error, retry->attempts - 1)) {
+        char error_msg[64];
+        snprintf(error_msg, sizeof(error_msg), "Max retries exceeded for %s", url);
+        log_error(ERROR_MAX_RETRIES_EXCEEDED, error_msg);
+        retry->state = API_RETRY_FAILED;
+        return retry->state;
+    }
+
+    unsigned long delay_ms = get_retry_delay(retry->attempts - 1);
+    retry->next_attempt_ms = now_ms + delay_ms;
+
+    Serial.print(F("Retrying API request in "));
+    Serial.print(delay_ms);
+    Serial.println(F(" ms..."));
+    return retry->state;
+}
+
+// Blocking wait for the *_with_retry functions below
+static void api_retry_wait(api_retry_t* retry) {
+    unsigned long now = millis();
+    if ((long)(retry->next_attempt_ms - now) > 0) {
+        delay(retry->next_attempt_ms - now);
+    }
+    api_retry_poll(retry, millis());
+}
+
 String api_send_request(const String& url, const String& method, const String& api_key, const String& frame) {
     if (WiFi.status() != WL_CONNECTED) {
         log_error(ERROR_WIFI_DISCONNECTED, "WiFi not connected for API request");
         return "";
     }
 
-    HTTPClient http;
+    if (method != "POST" && method != "GET") {
+        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
+        return "";
+    }
 
     // Begin the HTTP request
-    http.begin(url);
-    http.setTimeout(HTTP_TIMEOUT_MS);
+    api_connection_t* connection = api_connection_begin(url.c_str());
+    HTTPClient& http = connection->http;
     http.addHeader(F("Content-Type"), F("application/json"));
     http.addHeader(F("Authorization"), api_key);
 
@@ -33,38 +412,31 @@ String api_send_request(const String& url, const String& method, const String& a
     
     int http_code;
     if (method == "POST") {
-        http_code = http.POST(request_body);
-    } else if (method == "GET") {
-        http_code = http.GET();
+        http_code = api_connection_send(connection, "POST", (const uint8_t*)request_body.c_str(), request_body.length());
     } else {
-        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
-        http.end();
-        return "";
+        http_code = api_connection_send(connection, "GET", nullptr, 0);
     }
 
     if (http_code == HTTP_CODE_OK) {
-        String response = http.getString();
-
-        // Parse JSON response more robustly
-        int start = response.indexOf(F("\"frame\":\""));
-        if (start >= 0) {
-            start += 9; // Length of "\"frame\":\""
-            int end = response.indexOf('\"', start);
-
-            if (end > start) {
-                String frame_hex = response.substring(start, end);
-                http.end();
-
-                // Basic validation of hex string
-                if (frame_hex.length() > 0 && frame_hex.length() % 2 == 0) {
-                    return frame_hex;
-                } else {
-                    log_error(ERROR_INVALID_RESPONSE, "Invalid frame format in response");
-                }
+        String frame_hex;
+        frame_hex.reserve(MODBUS_MAX_FRAME_SIZE * 2);
+        api_frame_text_t text = {&frame_hex, false};
+        json_scanner_t scanner;
+        json_scan_init(&scanner, api_copy_frame_value, &text);
+        bool read = api_read_body(connection, api_scan_sink, &scanner);
+        api_connection_end(connection);
+
+        if (read && text.found) {
+            // Basic validation of hex string
+            if (frame_hex.length() > 0 && frame_hex.length() % 2 == 0) {
+                return frame_hex;
+            } else {
+                log_error(ERROR_INVALID_RESPONSE, "Invalid frame format in response");
             }
-        } else {
+        } else if (read) {
             log_error(ERROR_INVALID_RESPONSE, "Frame not found in response");
         }
+        return "";
     } else if (http_code > 0) {
         char error_msg[64];
         snprintf(error_msg, sizeof(error_msg), "HTTP error: %d", http_code);
@@ -73,39 +445,104 @@ String api_send_request(const String& url, const String& method, const String& a
         log_error(ERROR_HTTP_TIMEOUT, "HTTP request timeout");
     }
 
-    http.end();
+    api_connection_end(connection);
     return "";
 }
 
-String upload_api_send_request(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac) {
+bool api_send_frame(const char* url, const char* api_key, const uint8_t* frame, size_t frame_length, uint8_t* response, size_t response_size, size_t* response_length) {
+    *response_length = 0;
+
     if (WiFi.status() != WL_CONNECTED) {
         log_error(ERROR_WIFI_DISCONNECTED, "WiFi not connected for API request");
-        return "";
+        return false;
     }
 
-    HTTPClient http;
+    // Build {"frame":"<hex>"} in one pass on the stack
+    static const char body_prefix[] = "{\"frame\":\"";
+    static const char body_suffix[] = "\"}";
+    char request_body[sizeof(body_prefix) + sizeof(body_suffix) + MODBUS_MAX_FRAME_SIZE * 2];
+    size_t body_length = sizeof(body_prefix) - 1;
+    memcpy(request_body, body_prefix, body_length);
+
+    size_t hex_length = modbus_bytes_to_hex(frame, frame_length, request_body + body_length, sizeof(request_body) - body_length);
+    if (hex_length == 0) {
+        log_error(ERROR_INVALID_RESPONSE, "Request frame too large");
+        return false;
+    }
+    body_length += hex_length;
+    memcpy(request_body + body_length, body_suffix, sizeof(body_suffix));
+    body_length += sizeof(body_suffix) - 1;
+
+    api_connection_t* connection = api_connection_begin(url);
+    HTTPClient& http = connection->http;
+    http.addHeader(F("Content-Type"), F("application/json"));
+    http.addHeader(F("Authorization"), api_key);
+
+    int http_code = api_connection_send(connection, "POST", (const uint8_t*)request_body, body_length);
+
+    if (http_code == HTTP_CODE_OK) {
+        // Decode the hex frame straight out of the socket; the body is never stored
+        api_frame_decode_t decode = {response, response_size, 0, -1, false, false};
+        json_scanner_t scanner;
+        json_scan_init(&scanner, api_decode_frame_value, &decode);
+        bool read = api_read_body(connection, api_scan_sink, &scanner);
+        api_connection_end(connection);
+
+        if (!read) {
+            return false;
+        }
+        if (!decode.found && !decode.bad) {
+            log_error(ERROR_INVALID_RESPONSE, "Frame not found in response");
+            return false;
+        }
+        size_t decoded = decode.bad || decode.high_nibble >= 0 ? 0 : decode.length;
+        if (decoded == 0) {
+            log_error(ERROR_INVALID_RESPONSE, "Invalid frame format in response");
+            return false;
+        }
+
+        *response_length = decoded;
+        return true;
+    } else if (http_code > 0) {
+        char error_msg[64];
+        snprintf(error_msg, sizeof(error_msg), "HTTP error: %d", http_code);
+        log_error(ERROR_HTTP_FAILED, error_msg);
+    } else {
+        log_error(ERROR_HTTP_TIMEOUT, "HTTP request timeout");
+    }
+
+    api_connection_end(connection);
+    return false;
+}
+
+String upload_api_send_request(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac, const char* encryption) {
+    if (WiFi.status() != WL_CONNECTED) {
+        log_error(ERROR_WIFI_DISCONNECTED, "WiFi not connected for API request");
+        return "";
+    }
+    if (method != "POST") {
+        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
+        return "";
+    }
 
     Serial.println(url);
     // Begin the HTTP request
-    http.begin(url);
-    http.setTimeout(HTTP_TIMEOUT_MS);
+    api_connection_t* connection = api_connection_begin(url.c_str());
+    HTTPClient& http = connection->http;
     http.addHeader(F("Content-Type"), F("application/octet-stream"));
     http.addHeader(F("Authorization"), api_key);
-    http.addHeader(F("encryption"), "aes-256-cbc");
+    http.addHeader(F("encryption"), encryption);
     http.addHeader(F("nonce"), nonce);
-    http.addHeader(F("mac"), mac);
-    
-    int http_code;
-    if (method == "POST") {
-        http_code = http.POST((uint8_t*)frame, frame_length);
-    } else {
-        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
-        http.end();
-        return "";
+    if (mac.length() > 0) {
+        http.addHeader(F("mac"), mac);
+        http.addHeader(F("mac-version"), String(UPLOAD_MAC_VERSION));
     }
+    
+    int http_code = api_connection_send(connection, "POST", frame, frame_length);
 
     if (http_code == HTTP_CODE_OK) {
-        String response = http.getString();
+        String response = api_read_body_string(connection);
+        api_connection_end(connection);
 
         return response;
 
@@ -117,6 +554,11 @@ String upload_api_send_request(const String& url, const String& method, const St
         //     log_error(ERROR_INVALID_RESPONSE, "Upload response validation failed");
         // }
     } else if (http_code > 0) {
+        if (http_code == HTTP_CODE_BAD_REQUEST) {
+            // A 400 is only an encryption refusal if the body says so
+            String body = api_read_body_string(connection);
+            connection->last_request.encryption_unsupported = body.indexOf("unsupported encryption") >= 0;
+        }
         char error_msg[64];
         snprintf(error_msg, sizeof(error_msg), "HTTP error: %d", http_code);
         log_error(ERROR_HTTP_FAILED, error_msg);
@@ -124,95 +566,32 @@ String upload_api_send_request(const String& url, const String& method, const St
         log_error(ERROR_HTTP_TIMEOUT, "HTTP request timeout");
     }
 
-    http.end();
+    api_connection_end(connection);
     return "";
 }
 
 String api_send_request_with_retry(const String& url, const String& method, const String& api_key, const String& frame) {
-    int retry_count = 0;
-    error_code_t last_error_code = ERROR_NONE;
-
-    while (retry_count <= MAX_RETRIES) {
+    api_retry_t retry;
+    api_retry_start(&retry, millis());
+    for (;;) {
         String response = api_send_request(url, method, api_key, frame);
-        if (response.length() > 0) {
-            // Success
+        if (api_retry_record(&retry, response.length() > 0, millis(), url.c_str()) != API_RETRY_WAITING) {
             return response;
         }
-
-        // Get the last error for retry decision
-        if (WiFi.status() != WL_CONNECTED) {
-            last_error_code = ERROR_WIFI_DISCONNECTED;
-        } else {
-            last_error_code = ERROR_HTTP_FAILED;
-        }
-
-        if (!should_retry(last_error_code, retry_count)) {
-            char error_msg[64];
-            snprintf(error_msg, sizeof(error_msg), "Max retries exceeded for %s", url.c_str());
-            log_error(ERROR_MAX_RETRIES_EXCEEDED, error_msg);
-            break;
-        }
-
-        retry_count++;
-        unsigned long delay_ms = get_retry_delay(retry_count - 1);
-
-        Serial.print(F("Retrying API request in "));
-        Serial.print(delay_ms);
-        Serial.println(F(" ms..."));
-
-        delay(delay_ms);
-
-        // Try to reconnect WiFi if needed
-        if (last_error_code == ERROR_WIFI_DISCONNECTED) {
-            handle_wifi_reconnection();
-        }
+        api_retry_wait(&retry);
     }
-
-    return "";
 }
 
-String upload_api_send_request_with_retry(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac) {
-    int retry_count = 0;
-    error_code_t last_error_code = ERROR_NONE;
-
-    while (retry_count <= MAX_RETRIES) {
-        String response = upload_api_send_request(url, method, api_key, frame, frame_length, nonce, mac);
-
-        if (response.length() > 0) {
-            // Success
-            return response;
-        }
-
-        // Get the last error for retry decision
-        if (WiFi.status() != WL_CONNECTED) {
-            last_error_code = ERROR_WIFI_DISCONNECTED;
-        } else {
-            last_error_code = ERROR_HTTP_FAILED;
-        }
-
-        if (!should_retry(last_error_code, retry_count)) {
-            char error_msg[64];
-            snprintf(error_msg, sizeof(error_msg), "Max retries exceeded for %s", url.c_str());
-            log_error(ERROR_MAX_RETRIES_EXCEEDED, error_msg);
-            break;
-        }
-
-        retry_count++;
-        unsigned long delay_ms = get_retry_delay(retry_count - 1);
-
-        Serial.print(F("Retrying API request in "));
-        Serial.print(delay_ms);
-        Serial.println(F(" ms..."));
-
-        delay(delay_ms);
-
-        // Try to reconnect WiFi if needed
-        if (last_error_code == ERROR_WIFI_DISCONNECTED) {
-            handle_wifi_reconnection();
+bool api_send_frame_with_retry(const char* url, const char* api_key, const uint8_t* frame, size_t frame_length, uint8_t* response, size_t response_size, size_t* response_length) {
+    api_retry_t retry;
+    api_retry_start(&retry, millis());
+    for (;;) {
+        bool ok = api_send_frame(url, api_key, frame, frame_length, response, response_size, response_length);
+        if (api_retry_record(&retry, ok, millis(), url) != API_RETRY_WAITING) {
+            return ok;
         }
+        api_retry_wait(&retry);
     }
-
-    return "";
 }
 
 String json_api_send_request(const String& url, const String& method, const String& api_key, const String& json_body) {
@@ -221,28 +600,27 @@ String json_api_send_request(const String& url, const String& method, const Stri
         return "";
     }
 
-    HTTPClient http;
+    if (method != "POST" && method != "GET") {
+        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
+        return "";
+    }
 
     // Begin the HTTP request
-    http.begin(url);
-    http.setTimeout(HTTP_TIMEOUT_MS);
+    api_connection_t* connection = api_connection_begin(url.c_str());
+    HTTPClient& http = connection->http;
     http.addHeader(F("Content-Type"), F("application/json"));
     http.addHeader(F("Authorization"), api_key);
     
     int http_code;
     if (method == "POST") {
-        http_code = http.POST(json_body);
-    } else if (method == "GET") {
-        http_code = http.GET();
+        http_code = api_connection_send(connection, "POST", (const uint8_t*)json_body.c_str(), json_body.length());
     } else {
-        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
-        http.end();
-        return "";
+        http_code = api_connection_send(connection, "GET", nullptr, 0);
     }
 
     String response = "";
     if (http_code == HTTP_CODE_OK) {
-        response = http.getString();
+        response = api_read_body_string(connection);
         Serial.print(F("[JSON API] Success: "));
         Serial.println(response);
     } else if (http_code > 0) {
@@ -253,7 +631,7 @@ String json_api_send_request(const String& url, const String& method, const Stri
         log_error(ERROR_HTTP_TIMEOUT, "JSON API HTTP request timeout");
     }
 
-    http.end();
+    api_connection_end(connection);
     return response;
 }
 
@@ -264,33 +642,32 @@ String api_command_request(const String& url, const String& method, const String
         return "";
     }
 
-    HTTPClient http;
+    if (method != "POST" && method != "GET") {
+        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
+        return "";
+    }
 
     // Begin the HTTP request
-    http.begin(url);
-    http.setTimeout(HTTP_TIMEOUT_MS);
+    api_connection_t* connection = api_connection_begin(url.c_str());
+    HTTPClient& http = connection->http;
     http.addHeader(F("Content-Type"), F("application/json"));
     http.addHeader(F("Authorization"), api_key);
     
     int http_code;
     if (method == "POST") {
-        http_code = http.POST(frame);
-    } else if (method == "GET") {
-        http_code = http.GET();
+        http_code = api_connection_send(connection, "POST", (const uint8_t*)frame.c_str(), frame.length());
     } else {
-        log_error(ERROR_INVALID_HTTP_METHOD, "Unsupported HTTP method");
-        http.end();
-        return "";
+        http_code = api_connection_send(connection, "GET", nullptr, 0);
     }
 
     if (http_code == HTTP_CODE_OK) {
-        String response = http.getString();
+        String response = api_read_body_string(connection);
 
         if (response.length() > 0) {
-            http.end();
+            api_connection_end(connection);
             return response;
         } else {
-            http.end();
+            api_connection_end(connection);
             return "";
         }
     } else if (http_code > 0) {
@@ -301,49 +678,18 @@ String api_command_request(const String& url, const String& method, const String
         log_error(ERROR_HTTP_TIMEOUT, "HTTP request timeout");
     }
 
-    http.end();
+    api_connection_end(connection);
     return "";
 }
 
 void api_command_request_with_retry(const String& url, const String& method, const String& api_key, const String& frame) {
-    int retry_count = 0;
-    error_code_t last_error_code = ERROR_NONE;
-
-    while (retry_count <= MAX_RETRIES) {
+    api_retry_t retry;
+    api_retry_start(&retry, millis());
+    for (;;) {
         String response = api_command_request(url, method, api_key, frame);
-        if (response.length() > 0) {
-            // Success
+        if (api_retry_record(&retry, response.length() > 0, millis(), url.c_str()) != API_RETRY_WAITING) {
             return;
         }
-
-        // Get the last error for retry decision
-        if (WiFi.status() != WL_CONNECTED) {
-            last_error_code = ERROR_WIFI_DISCONNECTED;
-        } else {
-            last_error_code = ERROR_HTTP_FAILED;
-        }
-
-        if (!should_retry(last_error_code, retry_count)) {
-            char error_msg[64];
-            snprintf(error_msg, sizeof(error_msg), "Max retries exceeded for %s", url.c_str());
-            log_error(ERROR_MAX_RETRIES_EXCEEDED, error_msg);
-            break;
-        }
-
-        retry_count++;
-        unsigned long delay_ms = get_retry_delay(retry_count - 1);
-
-        Serial.print(F("Retrying API request in "));
-        Serial.print(delay_ms);
-        Serial.println(F(" ms..."));
-
-        delay(delay_ms);
-
-        // Try to reconnect WiFi if needed
-        if (last_error_code == ERROR_WIFI_DISCONNECTED) {
-            handle_wifi_reconnection();
-        }
+        api_retry_wait(&retry);
     }
-
-    return;
-}
\ No newline at end of file
+}
@@ -2,24 +2,92 @@
 #define API_CLIENT_H
 
 #include <Arduino.h>
+#include <HTTPClient.h>
+#include "error_handler.h"
+
+// Requests go out on one pooled HTTPClient per host. With HTTP_KEEP_ALIVE the connection
+// (and TLS session for https) stays open between requests and is reopened lazily when the
+// server has closed it; URLs on other hosts get a connection that is closed after each request.
+// After api_init() each connection has a mutex, so tasks sending to the same host take turns.
+typedef enum {
+    API_HOST_INVERTER,  // API_BASE_URL
+    API_HOST_CLOUD,     // UPLOAD_API_BASE_URL
+    API_HOST_OTHER,
+    API_HOST_COUNT
+} api_host_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t reused;    // Sent on a connection left open by an earlier request
+    uint32_t connects;  // Sent on a newly opened connection
+    uint32_t stale;     // Kept-alive connections found closed by the server, then reopened
+    uint32_t failures;  // Requests that failed at the transport level
+} api_connection_stats_t;
+
+// Per-request view of the most recent request
+typedef struct {
+    api_host_t host;
+    bool reused;
+    int http_code;
+    bool encryption_unsupported;  // A 400 whose body says the encryption mode is not supported
+    unsigned long duration_us;
+} api_request_info_t;
+
+// Retry state of one request. Instead of sleeping between attempts, the owner keeps this
+// and makes the next attempt once api_retry_poll() says it is due, so its loop keeps running
+// in between. Attempts and backoff follow should_retry() and get_retry_delay().
+typedef enum {
+    API_RETRY_IDLE,     // No request in flight
+    API_RETRY_WAITING,  // Next attempt due at next_attempt_ms
+    API_RETRY_DONE,     // Last attempt succeeded
+    API_RETRY_FAILED    // Retries exhausted
+} api_retry_state_t;
+
+typedef struct {
+    api_retry_state_t state;
+    uint8_t attempts;               // Attempts made so far
+    unsigned long next_attempt_ms;  // millis() deadline while WAITING
+    error_code_t last_error;        // Why the last attempt failed
+} api_retry_t;
 
 // Initialize the API client
 bool api_init(void);
 
+api_connection_stats_t api_get_connection_stats(api_host_t host);
+api_request_info_t api_get_last_request(void);
+// Most recent request to one host; with several tasks the overall latest may be another task's
+api_request_info_t api_get_last_request_to(api_host_t host);
+// Close every pooled connection, e.g. after the WiFi link was lost
+void api_close_connections(void);
+
+// First attempt is due at now_ms
+void api_retry_start(api_retry_t* retry, unsigned long now_ms);
+bool api_retry_due(const api_retry_t* retry, unsigned long now_ms);
+// Like api_retry_due(), but first reconnects WiFi if that is why the last attempt failed
+bool api_retry_poll(api_retry_t* retry, unsigned long now_ms);
+// Record an attempt. On failure the state stays WAITING with the backoff deadline, or
+// becomes FAILED once no retries are left (url is only used in the error message).
+api_retry_state_t api_retry_record(api_retry_t* retry, bool success, unsigned long now_ms, const char* url);
+
 // Send an API request
 String api_send_request(const String& url, const String& method, const String& api_key, const String& frame);
 
+// The *_with_retry functions block in delay() between attempts. The scheduler keeps an
+// api_retry_t per request instead.
+
 // Send an API request with retry logic
 String api_send_request_with_retry(const String& url, const String& method, const String& api_key, const String& frame);
 
-// Send an API request for uploading data
-String upload_api_send_request(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac);
+// Send a binary Modbus frame and receive the binary response frame.
+// The frame is hex-encoded only for the JSON body; returns false on failure.
+bool api_send_frame(const char* url, const char* api_key, const uint8_t* frame, size_t frame_length, uint8_t* response, size_t response_size, size_t* response_length);
 
-// Send an upload API request with retry logic
-String upload_api_send_request_with_retry(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac);
+// Send a binary Modbus frame with retry logic
+bool api_send_frame_with_retry(const char* url, const char* api_key, const uint8_t* frame, size_t frame_length, uint8_t* response, size_t response_size, size_t* response_length);
 
-// Send an upload API request with retry logic (with nonce and MAC)
-String upload_api_send_request_with_retry(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac);
+// Send an API request for uploading data. encryption names the upload cipher
+// ("aes-256-cbc" or "aes-256-gcm"); an empty mac is left out, as GCM frames carry a tag.
+String upload_api_send_request(const String& url, const String& method, const String& api_key, const uint8_t* frame, size_t frame_length, const String& nonce, const String& mac, const char* encryption);
 
 // Send a JSON API request (for config acknowledgments)
 String json_api_send_request(const String& url, const String& method, const String& api_key, const String& json_body);
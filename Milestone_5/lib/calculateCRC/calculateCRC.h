@@ -2,7 +2,25 @@
 #define CALCULATECRC_H
 
 #include <cstdint>
+#include <cstddef>
+
+// CRC-16/MODBUS: reflected polynomial 0xA001, initial value 0xFFFF, no final XOR
+#define CRC16_MODBUS_INIT 0xFFFF
 
 uint16_t calculateCRC(const uint8_t* data, int length);
 
+// Incremental API, for a CRC that spans several buffers:
+//   uint16_t crc = crc16_init();
+//   crc = crc16_update(crc, header, header_len);
+//   crc = crc16_update(crc, payload, payload_len);
+//   crc = crc16_final(crc);
+uint16_t crc16_init(void);
+uint16_t crc16_update(uint16_t crc, const uint8_t* data, size_t length);
+uint16_t crc16_final(uint16_t crc);
+
+// Individual engines. crc16_update() uses the one selected by CRC16_ENGINE in config.h
+uint16_t crc16_update_table(uint16_t crc, const uint8_t* data, size_t length);
+uint16_t crc16_update_slice4(uint16_t crc, const uint8_t* data, size_t length);
+uint16_t crc16_update_slice8(uint16_t crc, const uint8_t* data, size_t length);
+
 #endif
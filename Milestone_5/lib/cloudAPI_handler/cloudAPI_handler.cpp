@@ -37,6 +37,105 @@ bool validate_upload_response(const String& response) {
     return false;
 }
 
+bool parse_cloud_response(const String& response, cloud_response_t* parsed) {
+    parsed->doc.clear();
+    parsed->parsed = false;
+    parsed->status_ok = false;
+    parsed->command = JsonObject();
+    parsed->config_update = JsonObject();
+    parsed->fota = JsonObject();
+    parsed->parse_us = 0;
+    parsed->heap_bytes = 0;
+
+    if (response.length() == 0) {
+        Serial.println(F("Error: Empty response received from the cloud API."));
+        return false;
+    }
+
+    Serial.print(F("[DEBUG] Cloud API Response: "));
+    Serial.println(response);
+
+    uint32_t heap_before = ESP.getFreeHeap();
+    unsigned long start = micros();
+    DeserializationError error = deserializeJson(parsed->doc, response);
+    parsed->parse_us = micros() - start;
+    uint32_t heap_after = ESP.getFreeHeap();
+    parsed->heap_bytes = heap_before > heap_after ? heap_before - heap_after : 0;
+
+    if (error) {
+        // Not JSON; fall back to the plain-text check
+        Serial.print(F("[CLOUD] JSON parse error in response: "));
+        Serial.println(error.c_str());
+        parsed->status_ok = validate_upload_response(response);
+        return parsed->status_ok;
+    }
+    parsed->parsed = true;
+    Serial.printf("[CLOUD] Response parsed in %lu us, %lu bytes of heap\n",
+                  (unsigned long)parsed->parse_us, (unsigned long)parsed->heap_bytes);
+
+    if (parsed->doc["command"].is<JsonObject>()) {
+        parsed->command = parsed->doc["command"].as<JsonObject>();
+    }
+    if (parsed->doc["config_update"].is<JsonObject>()) {
+        parsed->config_update = parsed->doc["config_update"].as<JsonObject>();
+    }
+    if (parsed->doc["fota"].is<JsonObject>()) {
+        parsed->fota = parsed->doc["fota"].as<JsonObject>();
+    }
+
+    // Same acceptance as validate_upload_response(): a "status" key and the text "success"
+    if (response.indexOf(F("\"status\"")) >= 0 && response.indexOf(F("success")) >= 0) {
+        Serial.println(F("Upload response validated successfully."));
+        parsed->status_ok = true;
+        return true;
+    }
+
+    const char* error_message = parsed->doc["error"].as<const char*>();
+    if (error_message != nullptr) {
+        Serial.print(F("Error: Upload failed with status: "));
+        Serial.println(error_message);
+    } else {
+        Serial.println(F("Error: Unrecognized response format from the cloud API."));
+    }
+    return false;
+}
+
+// The cloud sends numbers either bare or quoted
+static uint16_t json_to_uint16(JsonVariant value) {
+    if (value.is<const char*>()) {
+        return (uint16_t)atoi(value.as<const char*>());
+    }
+    return value.as<uint16_t>();
+}
+
+bool parse_command_from_json(JsonObject command, String& action, uint16_t& target_register, uint16_t& value) {
+    if (command.isNull()) {
+        return false;
+    }
+    Serial.println(F("Command section detected in response."));
+
+    if (!command["action"].is<const char*>()) {
+        Serial.println(F("Error: Command without action"));
+        return false;
+    }
+    action = command["action"].as<String>();
+    if (!(action.equalsIgnoreCase("write_register") ||
+          action.equalsIgnoreCase("read_register"))) {
+        Serial.println(F("Error: Unsupported action command received"));
+        return false;
+    }
+    Serial.print(F("Command Action: "));
+    Serial.println(action);
+
+    if (!command["target_register"].isNull()) {
+        target_register = json_to_uint16(command["target_register"]);
+    }
+    if (action.equalsIgnoreCase("write_register") && !command["value"].isNull()) {
+        value = json_to_uint16(command["value"]);
+    }
+    return true;
+}
+
 bool parse_config_update_from_response(const String& response, String& config_update_json) {
     if (response.length() == 0) {
         return false;
@@ -119,8 +218,19 @@ bool parse_fota_manifest_from_response(const String& response,
         return false;
     }
 
-    JsonObject fota = doc["fota"];
-    
+    return parse_fota_manifest_from_json(doc["fota"].as<JsonObject>(), job_id, fwUrl, fwSize, shaExpected, signature);
+}
+
+bool parse_fota_manifest_from_json(JsonObject fota,
+                                   int& job_id,
+                                   String& fwUrl,
+                                   size_t& fwSize,
+                                   String& shaExpected,
+                                   String& signature) {
+    if (fota.isNull()) {
+        return false;
+    }
+
     // Extract FOTA parameters (using ArduinoJson v7 syntax)
     if (fota["job_id"].is<int>() && 
         fota["fwUrl"].is<const char*>() && 
@@ -4,6 +4,29 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+// An upload response parsed once. The section objects point into doc and are null when
+// the response does not carry that section.
+typedef struct {
+    JsonDocument doc;
+    bool parsed;             // Response was valid JSON
+    bool status_ok;          // Cloud accepted the upload
+    JsonObject command;
+    JsonObject config_update;
+    JsonObject fota;
+    uint32_t parse_us;       // Time spent in deserializeJson
+    uint32_t heap_bytes;     // Heap held by doc after parsing
+} cloud_response_t;
+
+// Parse an upload response and split it into sections; returns parsed->status_ok
+bool parse_cloud_response(const String& response, cloud_response_t* parsed);
+bool parse_command_from_json(JsonObject command, String& action, uint16_t& target_register, uint16_t& value);
+bool parse_fota_manifest_from_json(JsonObject fota,
+                                   int& job_id,
+                                   String& fwUrl,
+                                   size_t& fwSize,
+                                   String& shaExpected,
+                                   String& signature);
+
 bool validate_upload_response(const String& response);
 bool parse_config_update_from_response(const String& response, String& config_update_json);
 void send_config_ack_to_cloud(const String& ack_json);
@@ -1,75 +1,533 @@
 #include "compressor.h"
 #include "config.h"  // For READ_REGISTER_COUNT, MEMORY_BUFFER_SIZE
 
+static void write_header(uint8_t* output, size_t count, uint8_t method, size_t payload_size) {
+    output[0] = (uint8_t)((count >> 8) & 0xFF);
+    output[1] = (uint8_t)(count & 0xFF);
+    output[2] = (uint8_t)((method << 4) | (READ_REGISTER_COUNT & 0x0F));
+    output[3] = (uint8_t)((payload_size >> 8) & 0xFF);
+    output[4] = (uint8_t)(payload_size & 0xFF);
+}
+
+static void set_compression_ratio(compression_metrics_t* metrics) {
+    // Ratio of raw register bytes to payload bytes, header excluded
+    if (metrics->compressed_payload_size > 5) {
+        metrics->compression_ratio = (float)metrics->original_payload_size / (float)(metrics->compressed_payload_size - 5);
+    } else {
+        metrics->compression_ratio = 0.0f;
+    }
+}
+
+// Maps small signed deltas to small unsigned values: 0, -1, 1, -2, 2 -> 0, 1, 2, 3, 4
+static inline uint16_t zigzag_encode(int16_t value) {
+    return (uint16_t)(((uint16_t)value << 1) ^ (uint16_t)(value >> 15));
+}
+
+// LEB128: 7 bits per byte, low bits first, high bit set on all but the last byte
+static inline size_t write_varint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Worst case for one Delta+RLE or varint register stream: first value + a 3-byte token per sample
+static inline size_t register_bound(size_t count) {
+    return 2 + (count > 1 ? (count - 1) * 3 : 0);
+}
+
+static void measure_register_codecs(const register_reading_t* buffer, size_t count, size_t reg, size_t* sizes);
+
+// Whether a register stream fits in available bytes. The exact size is only measured
+// when the worst case does not fit.
+static bool register_fits(const register_reading_t* buffer, size_t count, size_t reg, uint8_t codec, size_t available) {
+    if (register_bound(count) <= available) {
+        return true;
+    }
+    size_t sizes[REGISTER_CODEC_COUNT];
+    measure_register_codecs(buffer, count, reg, sizes);
+    return sizes[codec] <= available;
+}
+
+// Truncation is a status, not an error: callers probe with small buffers to size chunks
+static compression_metrics_t truncated_metrics(compression_metrics_t metrics, unsigned long start) {
+    metrics.truncated = true;
+    metrics.cpu_time_us = micros() - start;
+    return metrics;
+}
+
+// Per-register stream writers. Each writes the 2-byte first value followed by its tokens
+// and returns the number of bytes written.
+
+// 0x00 run (max 255) | 0x01 delta_hi delta_lo
+static size_t write_delta_rle_stream(const register_reading_t* buffer, size_t count, size_t reg, uint8_t* out) {
+    size_t n = 0;
+    uint16_t prev_val = buffer[0].values[reg];
+    // Store first absolute value (no flag)
+    out[n++] = (uint8_t)(prev_val >> 8);
+    out[n++] = (uint8_t)(prev_val & 0xFF);
+
+    size_t run = 0;
+    for (size_t i = 1; i < count; i++) {
+        int16_t delta = (int16_t)(buffer[i].values[reg] - prev_val);
+        prev_val = buffer[i].values[reg];
+
+        if (delta == 0) {
+            run++;
+            if (run == 255) {
+                out[n++] = 0x00;
+                out[n++] = (uint8_t)run;
+                run = 0;
+            }
+        } else {
+            if (run > 0) {
+                // Flush run
+                out[n++] = 0x00;
+                out[n++] = (uint8_t)run;
+                run = 0;
+            }
+            // Write delta
+            out[n++] = 0x01;
+            out[n++] = (uint8_t)(delta >> 8);
+            out[n++] = (uint8_t)(delta & 0xFF);
+        }
+    }
+
+    // Flush remaining run if any
+    if (run > 0) {
+        out[n++] = 0x00;
+        out[n++] = (uint8_t)run;
+    }
+    return n;
+}
+
+// 0x00 varint(run) | varint(zigzag(d)), where d is the delta, or with second_order the
+// change in delta (delta-of-delta, first delta taken against 0)
+static size_t write_varint_stream(const register_reading_t* buffer, size_t count, size_t reg, uint8_t* out, bool second_order) {
+    size_t n = 0;
+    uint16_t prev_val = buffer[0].values[reg];
+    out[n++] = (uint8_t)(prev_val >> 8);
+    out[n++] = (uint8_t)(prev_val & 0xFF);
+
+    int16_t prev_delta = 0;
+    size_t run = 0;
+    for (size_t i = 1; i < count; i++) {
+        int16_t delta = (int16_t)(buffer[i].values[reg] - prev_val);
+        prev_val = buffer[i].values[reg];
+        int16_t value = second_order ? (int16_t)(delta - prev_delta) : delta;
+        prev_delta = delta;
+
+        if (value == 0) {
+            run++;
+        } else {
+            if (run > 0) {
+                out[n++] = 0x00;
+                n += write_varint(out + n, run);
+                run = 0;
+            }
+            n += write_varint(out + n, zigzag_encode(value));
+        }
+    }
+
+    if (run > 0) {
+        out[n++] = 0x00;
+        n += write_varint(out + n, run);
+    }
+    return n;
+}
+
+// Every sample as a 16-bit big-endian value
+static size_t write_raw_stream(const register_reading_t* buffer, size_t count, size_t reg, uint8_t* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        out[n++] = (uint8_t)(buffer[i].values[reg] >> 8);
+        out[n++] = (uint8_t)(buffer[i].values[reg] & 0xFF);
+    }
+    return n;
+}
+
 // ---------------- Compression: Delta + RLE ----------------
-compression_metrics_t compress_raw(const register_reading_t* buffer, size_t count, uint8_t* output) {
+compression_metrics_t compress_raw(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size) {
     compression_metrics_t metrics = {0};
     metrics.compression_method = "Delta+RLE";
+    metrics.method_id = COMPRESSION_METHOD_DELTA_RLE;
     metrics.num_samples = count;
     metrics.original_payload_size = count * READ_REGISTER_COUNT * sizeof(uint16_t);
 
     unsigned long start = micros();
 
-    uint8_t temp[MAX_COMPRESSION_SIZE];
-    size_t temp_index = 0;
+    size_t pos = 5;
 
     // Compress each register independently
     for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
-        uint16_t prev_val = buffer[0].values[reg];
-        // Store first absolute value (no flag)
-        temp[temp_index++] = (uint8_t)(prev_val >> 8);
-        temp[temp_index++] = (uint8_t)(prev_val & 0xFF);
+        if (pos > output_size || !register_fits(buffer, count, reg, REGISTER_CODEC_DELTA_RLE, output_size - pos)) {
+            return truncated_metrics(metrics, start);
+        }
+        size_t reg_bytes = write_delta_rle_stream(buffer, count, reg, output + pos);
+        pos += reg_bytes;
+        metrics.register_codecs[reg] = REGISTER_CODEC_DELTA_RLE;
+        metrics.register_bytes[reg] = (uint16_t)reg_bytes;
+    }
+
+    // Header (5 bytes: count + reg count + size)
+    write_header(output, count, COMPRESSION_METHOD_DELTA_RLE, pos - 5);
+
+    metrics.cpu_time_us = micros() - start;
+
+    metrics.compressed_payload_size = pos;
+    set_compression_ratio(&metrics);
+    return metrics;
+}
+
+// ---------------- Compression: Delta + zigzag varint ----------------
+// Per register: 2-byte absolute first value, then for each following sample either
+//   0x00 <run as LEB128>   a run of unchanged samples
+//   <zigzag(delta) as LEB128>  a nonzero delta; its first byte is never 0x00
+// Deltas of +-63 take one byte instead of three.
+compression_metrics_t compress_varint(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size) {
+    compression_metrics_t metrics = {0};
+    metrics.compression_method = "Delta+Varint";
+    metrics.method_id = COMPRESSION_METHOD_VARINT;
+    metrics.num_samples = count;
+    metrics.original_payload_size = count * READ_REGISTER_COUNT * sizeof(uint16_t);
+
+    unsigned long start = micros();
+
+    size_t pos = 5;
+
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        if (pos > output_size || !register_fits(buffer, count, reg, REGISTER_CODEC_VARINT, output_size - pos)) {
+            return truncated_metrics(metrics, start);
+        }
+
+        size_t reg_bytes = write_varint_stream(buffer, count, reg, output + pos, false);
+        pos += reg_bytes;
+        metrics.register_codecs[reg] = REGISTER_CODEC_VARINT;
+        metrics.register_bytes[reg] = (uint16_t)reg_bytes;
+    }
+
+    write_header(output, count, COMPRESSION_METHOD_VARINT, pos - 5);
+
+    metrics.cpu_time_us = micros() - start;
+
+    metrics.compressed_payload_size = pos;
+    set_compression_ratio(&metrics);
+    return metrics;
+}
+
+// ---------------- Compression: adaptive per register ----------------
+
+static inline size_t varint_size(uint32_t value) {
+    return value < 0x80 ? 1 : (value < 0x4000 ? 2 : 3);
+}
+
+// Encoded size of one register under every codec, from a single pass over the samples
+static void measure_register_codecs(const register_reading_t* buffer, size_t count, size_t reg, size_t* sizes) {
+    size_t rle_size = 2, varint_size_total = 2, dod_size = 2;
+    size_t rle_run = 0, varint_run = 0, dod_run = 0;
+    bool constant = true;
+    int16_t prev_delta = 0;
+
+    for (size_t i = 1; i < count; i++) {
+        int16_t delta = (int16_t)(buffer[i].values[reg] - buffer[i - 1].values[reg]);
+        int16_t dod = (int16_t)(delta - prev_delta);
+        prev_delta = delta;
+
+        if (delta == 0) {
+            varint_run++;
+            if (++rle_run == 255) {
+                rle_size += 2;
+                rle_run = 0;
+            }
+        } else {
+            constant = false;
+            if (rle_run > 0) {
+                rle_size += 2;
+                rle_run = 0;
+            }
+            rle_size += 3;
+            if (varint_run > 0) {
+                varint_size_total += 1 + varint_size(varint_run);
+                varint_run = 0;
+            }
+            varint_size_total += varint_size(zigzag_encode(delta));
+        }
+
+        if (dod == 0) {
+            dod_run++;
+        } else {
+            if (dod_run > 0) {
+                dod_size += 1 + varint_size(dod_run);
+                dod_run = 0;
+            }
+            dod_size += varint_size(zigzag_encode(dod));
+        }
+    }
+    if (rle_run > 0) rle_size += 2;
+    if (varint_run > 0) varint_size_total += 1 + varint_size(varint_run);
+    if (dod_run > 0) dod_size += 1 + varint_size(dod_run);
+
+    sizes[REGISTER_CODEC_DELTA_RLE] = rle_size;
+    sizes[REGISTER_CODEC_VARINT] = varint_size_total;
+    sizes[REGISTER_CODEC_RAW] = count * 2;
+    sizes[REGISTER_CODEC_DELTA_OF_DELTA] = dod_size;
+    sizes[REGISTER_CODEC_CONSTANT] = constant ? 2 : SIZE_MAX;
+}
+
+const char* register_codec_name(uint8_t codec) {
+    switch (codec) {
+        case REGISTER_CODEC_DELTA_RLE: return "delta+rle";
+        case REGISTER_CODEC_VARINT: return "varint";
+        case REGISTER_CODEC_RAW: return "raw";
+        case REGISTER_CODEC_DELTA_OF_DELTA: return "delta2";
+        case REGISTER_CODEC_CONSTANT: return "const";
+        default: return "?";
+    }
+}
+
+// Payload: one nibble per register (codec id, high nibble first), then each register's stream
+compression_metrics_t compress_adaptive(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size) {
+    // Ties go to the earlier entry
+    static const uint8_t preference[REGISTER_CODEC_COUNT] = {
+        REGISTER_CODEC_CONSTANT, REGISTER_CODEC_VARINT, REGISTER_CODEC_DELTA_OF_DELTA,
+        REGISTER_CODEC_DELTA_RLE, REGISTER_CODEC_RAW
+    };
+
+    compression_metrics_t metrics = {0};
+    metrics.compression_method = "Adaptive";
+    metrics.method_id = COMPRESSION_METHOD_ADAPTIVE;
+    metrics.num_samples = count;
+    metrics.original_payload_size = count * READ_REGISTER_COUNT * sizeof(uint16_t);
+
+    unsigned long start = micros();
+
+    const size_t nibble_bytes = (READ_REGISTER_COUNT + 1) / 2;
+    if (output_size < 5 + nibble_bytes) {
+        return truncated_metrics(metrics, start);
+    }
+    uint8_t* payload = output + 5;
+    size_t pos = nibble_bytes;  // Payload offset
+    memset(payload, 0, nibble_bytes);
+
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        size_t sizes[REGISTER_CODEC_COUNT];
+        measure_register_codecs(buffer, count, reg, sizes);
+
+        uint8_t codec = preference[0];
+        for (size_t p = 1; p < REGISTER_CODEC_COUNT; p++) {
+            if (sizes[preference[p]] < sizes[codec]) {
+                codec = preference[p];
+            }
+        }
+
+        if (5 + pos + sizes[codec] > output_size) {
+            return truncated_metrics(metrics, start);
+        }
+
+        size_t reg_bytes;
+        switch (codec) {
+            case REGISTER_CODEC_CONSTANT:
+                payload[pos] = (uint8_t)(buffer[0].values[reg] >> 8);
+                payload[pos + 1] = (uint8_t)(buffer[0].values[reg] & 0xFF);
+                reg_bytes = 2;
+                break;
+            case REGISTER_CODEC_VARINT:
+                reg_bytes = write_varint_stream(buffer, count, reg, payload + pos, false);
+                break;
+            case REGISTER_CODEC_DELTA_OF_DELTA:
+                reg_bytes = write_varint_stream(buffer, count, reg, payload + pos, true);
+                break;
+            case REGISTER_CODEC_DELTA_RLE:
+                reg_bytes = write_delta_rle_stream(buffer, count, reg, payload + pos);
+                break;
+            case REGISTER_CODEC_RAW:
+            default:
+                reg_bytes = write_raw_stream(buffer, count, reg, payload + pos);
+                break;
+        }
+        pos += reg_bytes;
+
+        payload[reg / 2] |= (reg % 2 == 0) ? (uint8_t)(codec << 4) : codec;
+        metrics.register_codecs[reg] = codec;
+        metrics.register_bytes[reg] = (uint16_t)reg_bytes;
+    }
+
+    write_header(output, count, COMPRESSION_METHOD_ADAPTIVE, pos);
+
+    metrics.cpu_time_us = micros() - start;
+
+    metrics.compressed_payload_size = 5 + pos;
+    set_compression_ratio(&metrics);
+    return metrics;
+}
+
+compression_metrics_t compress_with_method(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size, uint8_t method) {
+    switch (method) {
+        case COMPRESSION_METHOD_ADAPTIVE:
+            return compress_adaptive(buffer, count, output, output_size);
+        case COMPRESSION_METHOD_VARINT:
+            return compress_varint(buffer, count, output, output_size);
+        case COMPRESSION_METHOD_DELTA_RLE:
+        default:
+            return compress_raw(buffer, count, output, output_size);
+    }
+}
+
+size_t compress_bound(size_t count, uint8_t method) {
+    if (method == COMPRESSION_METHOD_ADAPTIVE) {
+        // Raw is always a candidate, so no register takes more than 2 bytes per sample
+        return 5 + (READ_REGISTER_COUNT + 1) / 2 + READ_REGISTER_COUNT * count * 2;
+    }
+    return 5 + READ_REGISTER_COUNT * register_bound(count);
+}
+
+// ---------------- Streaming compressor ----------------
+
+static size_t write_run_token(uint8_t method, uint8_t* out, size_t run) {
+    out[0] = 0x00;
+    if (method == COMPRESSION_METHOD_DELTA_RLE) {
+        out[1] = (uint8_t)run;
+        return 2;
+    }
+    return 1 + write_varint(out + 1, run);
+}
+
+static size_t write_delta_token(uint8_t method, uint8_t* out, int16_t delta) {
+    if (method == COMPRESSION_METHOD_DELTA_RLE) {
+        out[0] = 0x01;
+        out[1] = (uint8_t)(delta >> 8);
+        out[2] = (uint8_t)(delta & 0xFF);
+        return 3;
+    }
+    return write_varint(out, zigzag_encode(delta));
+}
+
+bool stream_compressor_init(stream_compressor_t* sc, size_t max_samples, uint8_t method) {
+    stream_compressor_free(sc);
+    sc->method = method;
+    sc->max_samples = max_samples;
+
+    if (method != COMPRESSION_METHOD_DELTA_RLE && method != COMPRESSION_METHOD_VARINT) {
+        return false;
+    }
+
+    // Worst case per register: first value + a 3-byte token per following sample
+    sc->register_capacity = 2 + (max_samples > 1 ? (max_samples - 1) * 3 : 0);
+    sc->streams = (uint8_t*)malloc(sc->register_capacity * READ_REGISTER_COUNT);
+    if (sc->streams == nullptr) {
+        sc->register_capacity = 0;
+        return false;
+    }
+
+    stream_compressor_reset(sc);
+    return true;
+}
 
-        size_t run = 0;
-        for (size_t i = 1; i < count; i++) {
-            int16_t delta = (int16_t)(buffer[i].values[reg] - prev_val);
-            prev_val = buffer[i].values[reg];
+void stream_compressor_free(stream_compressor_t* sc) {
+    if (sc->streams != nullptr) {
+        free(sc->streams);
+    }
+    memset(sc, 0, sizeof(*sc));
+}
+
+void stream_compressor_reset(stream_compressor_t* sc) {
+    sc->count = 0;
+    sc->valid = sc->streams != nullptr;
+    memset(sc->stream_lengths, 0, sizeof(sc->stream_lengths));
+    memset(sc->runs, 0, sizeof(sc->runs));
+}
+
+bool stream_compressor_add(stream_compressor_t* sc, const register_reading_t* reading) {
+    if (!sc->valid) {
+        return false;
+    }
+    if (sc->count >= sc->max_samples) {
+        // The sample buffer is overwriting its oldest entries; only a batch encode is correct now
+        sc->valid = false;
+        return false;
+    }
 
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        uint8_t* out = sc->streams + reg * sc->register_capacity;
+        size_t n = sc->stream_lengths[reg];
+        uint16_t value = reading->values[reg];
+
+        if (sc->count == 0) {
+            out[n++] = (uint8_t)(value >> 8);
+            out[n++] = (uint8_t)(value & 0xFF);
+        } else {
+            int16_t delta = (int16_t)(value - sc->prev_values[reg]);
             if (delta == 0) {
-                run++;
-                if (run == 255) {
-                    temp[temp_index++] = 0x00;
-                    temp[temp_index++] = (uint8_t)run;
-                    run = 0;
+                sc->runs[reg]++;
+                if (sc->method == COMPRESSION_METHOD_DELTA_RLE && sc->runs[reg] == 255) {
+                    n += write_run_token(sc->method, out + n, sc->runs[reg]);
+                    sc->runs[reg] = 0;
                 }
             } else {
-                if (run > 0) {
-                    // Flush run
-                    temp[temp_index++] = 0x00;
-                    temp[temp_index++] = (uint8_t)run;
-                    run = 0;
+                if (sc->runs[reg] > 0) {
+                    n += write_run_token(sc->method, out + n, sc->runs[reg]);
+                    sc->runs[reg] = 0;
                 }
-                // Write delta
-                temp[temp_index++] = 0x01;
-                temp[temp_index++] = (uint8_t)(delta >> 8);
-                temp[temp_index++] = (uint8_t)(delta & 0xFF);
+                n += write_delta_token(sc->method, out + n, delta);
             }
         }
 
-        // Flush remaining run if any
-        if (run > 0) {
-            temp[temp_index++] = 0x00;
-            temp[temp_index++] = (uint8_t)run;
-        }
+        sc->prev_values[reg] = value;
+        sc->stream_lengths[reg] = (uint16_t)n;
     }
 
-    // Header (5 bytes: count + reg count + size)
-    output[0] = (uint8_t)((count >> 8) & 0xFF);
-    output[1] = (uint8_t)(count & 0xFF);
-    output[2] = READ_REGISTER_COUNT;
-    output[3] = (uint8_t)((temp_index >> 8) & 0xFF);
-    output[4] = (uint8_t)(temp_index & 0xFF);
+    sc->count++;
+    return true;
+}
 
-    memcpy(output + 5, temp, temp_index);
+bool stream_compressor_matches(const stream_compressor_t* sc, size_t buffer_count) {
+    return sc->valid && sc->count > 0 && sc->count == buffer_count;
+}
 
-    metrics.cpu_time_us = micros() - start;
+compression_metrics_t stream_compressor_finish(const stream_compressor_t* sc, uint8_t* output, size_t output_size) {
+    compression_metrics_t metrics = {0};
+    metrics.compression_method = sc->method == COMPRESSION_METHOD_VARINT ? "Delta+Varint" : "Delta+RLE";
+    metrics.method_id = sc->method;
+    metrics.num_samples = sc->count;
+    metrics.original_payload_size = sc->count * READ_REGISTER_COUNT * sizeof(uint16_t);
 
-    metrics.compressed_payload_size = 5 + temp_index;
+    unsigned long start = micros();
 
-    if (metrics.compressed_payload_size > 0) {
-        metrics.compression_ratio = (float)metrics.original_payload_size / (float)(metrics.compressed_payload_size - 5);
-    } else {
-        metrics.compression_ratio = 0.0f;
+    if (!sc->valid || sc->count == 0) {
+        return metrics;
+    }
+
+    size_t pos = 5;
+    for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+        size_t length = sc->stream_lengths[reg];
+        size_t pending = 0;
+        if (sc->runs[reg] > 0) {
+            pending = sc->method == COMPRESSION_METHOD_DELTA_RLE ? 2 : 1 + varint_size(sc->runs[reg]);
+        }
+        if (pos + length + pending > output_size) {
+            return truncated_metrics(metrics, start);
+        }
+
+        memcpy(output + pos, sc->streams + reg * sc->register_capacity, length);
+        pos += length;
+        if (sc->runs[reg] > 0) {
+            size_t token = write_run_token(sc->method, output + pos, sc->runs[reg]);
+            pos += token;
+            length += token;
+        }
+
+        metrics.register_codecs[reg] = sc->method;
+        metrics.register_bytes[reg] = (uint16_t)length;
     }
+
+    write_header(output, sc->count, sc->method, pos - 5);
+
+    metrics.cpu_time_us = micros() - start;
+
+    metrics.compressed_payload_size = pos;
+    set_compression_ratio(&metrics);
     return metrics;
-}
\ No newline at end of file
+}
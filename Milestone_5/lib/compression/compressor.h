@@ -7,15 +7,63 @@
 // Compression metrics structure for benchmark reporting
 typedef struct {
     const char* compression_method;
+    uint8_t method_id;  // COMPRESSION_METHOD_* written into the header
     size_t num_samples;
     size_t original_payload_size;
     size_t compressed_payload_size;
     float compression_ratio;
     unsigned long cpu_time_us;
+    uint8_t register_codecs[READ_REGISTER_COUNT];  // REGISTER_CODEC_* used for each register
+    uint16_t register_bytes[READ_REGISTER_COUNT];  // Payload bytes spent on each register
+    bool truncated;  // Output did not fit the caller's buffer; nothing usable was written
 } compression_metrics_t;
 
+// Header layout (5 bytes): [count_hi, count_lo, (method << 4) | reg_count, size_hi, size_lo]
+// Method 0 keeps byte 2 equal to the register count, as older decoders expect.
+#define COMPRESSION_HEADER_SIZE 5
 
-// Compression functions
-compression_metrics_t compress_raw(const register_reading_t* buffer, size_t count, uint8_t* output);
+// Per-register codecs. COMPRESSION_METHOD_ADAPTIVE stores one of these per register as a
+// nibble (two registers per byte, high nibble first) ahead of the register streams.
+#define REGISTER_CODEC_DELTA_RLE 0       // Same stream as COMPRESSION_METHOD_DELTA_RLE
+#define REGISTER_CODEC_VARINT 1          // Same stream as COMPRESSION_METHOD_VARINT
+#define REGISTER_CODEC_RAW 2             // Every sample as 2 bytes
+#define REGISTER_CODEC_DELTA_OF_DELTA 3  // Varint stream of second differences
+#define REGISTER_CODEC_CONSTANT 4        // First value only, all samples equal
+#define REGISTER_CODEC_COUNT 5
 
-#endif // COMPRESSOR_H
\ No newline at end of file
+// Compression functions. Output goes straight into output[0..output_size); if it does not
+// fit, metrics.truncated is set and compressed_payload_size is 0.
+compression_metrics_t compress_raw(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size);
+compression_metrics_t compress_varint(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size);
+compression_metrics_t compress_adaptive(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size);
+compression_metrics_t compress_with_method(const register_reading_t* buffer, size_t count, uint8_t* output, size_t output_size, uint8_t method);
+
+// Worst-case frame size (header included) for count samples; an output this large never truncates
+size_t compress_bound(size_t count, uint8_t method);
+
+const char* register_codec_name(uint8_t codec);
+
+// Streaming compressor: samples are encoded as they arrive, so an upload only has to
+// flush pending runs and write the header. Output is byte-identical to the batch
+// encoder for the same method (Delta+RLE or varint; adaptive needs the whole buffer).
+typedef struct {
+    uint8_t method;
+    bool valid;                 // False once the stream no longer mirrors the sample buffer
+    size_t count;               // Samples encoded so far
+    size_t max_samples;
+    size_t register_capacity;   // Bytes reserved per register stream
+    uint8_t* streams;           // READ_REGISTER_COUNT streams of register_capacity bytes
+    uint16_t stream_lengths[READ_REGISTER_COUNT];
+    uint16_t prev_values[READ_REGISTER_COUNT];
+    uint16_t runs[READ_REGISTER_COUNT];  // Pending zero-delta run per register
+} stream_compressor_t;
+
+bool stream_compressor_init(stream_compressor_t* sc, size_t max_samples, uint8_t method);
+void stream_compressor_free(stream_compressor_t* sc);
+void stream_compressor_reset(stream_compressor_t* sc);
+bool stream_compressor_add(stream_compressor_t* sc, const register_reading_t* reading);
+bool stream_compressor_matches(const stream_compressor_t* sc, size_t buffer_count);
+// Does not modify the stream, so a failed upload can flush it again
+compression_metrics_t stream_compressor_finish(const stream_compressor_t* sc, uint8_t* output, size_t output_size);
+
+#endif // COMPRESSOR_H
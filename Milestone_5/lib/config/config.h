@@ -7,7 +7,6 @@
 #define POWER_MANAGMENT 1
 #define DVFS 1
 #define LIGHT_SLEEP 1
-#define IDLE_DELAY 0
 #define SERIAL_GATING 0
 
 // WiFi credentials
@@ -25,12 +24,30 @@
 #define UPLOAD_API_KEY "ColdPlay2025"
 #define NTP_SERVER "pool.ntp.org"
 #define UPLOAD_PSK "ColdPlay@EcoWatt2025"
+#define MAC_VERSION_BASE64 1  // HMAC over the Base64 text of IV + ciphertext
+#define MAC_VERSION_BINARY 2  // HMAC over IV + ciphertext exactly as sent
+#define UPLOAD_MAC_VERSION MAC_VERSION_BASE64  // MAC input format, sent in the mac-version header; 2 once the cloud accepts it
+#define UPLOAD_CIPHER_CBC 0  // AES-256-CBC with a CRC inside and an HMAC in the mac header
+#define UPLOAD_CIPHER_GCM 1  // AES-256-GCM: one pass, no padding; the tag replaces CRC and HMAC
+#define UPLOAD_CIPHER UPLOAD_CIPHER_GCM  // Preferred mode; falls back to CBC if the cloud refuses it
+#define UPLOAD_CIPHER_REPROBE_MS 3600000UL  // After a fallback to CBC, GCM is tried again this long later
+#define NONCE_BLOCK_SIZE 1000  // Nonces reserved per flash write; a reboot skips the rest of the block
+#define CRYPTO_RESEED_INTERVAL 1000  // IVs drawn from the DRBG between reseeds from the entropy source
 
 // Firmware version tracking for FOTA
 #define FIRMWARE_VERSION "1.0.0"
+#define FOTA_CHUNK_SIZE 4096  // Bytes read from the download and written to flash at a time
+#define FOTA_CHECKPOINT_CHUNKS 16  // Chunks between saves of the offset and SHA-256 state to NVS, so a reset resumes
+#define FOTA_PIPELINE_BUFFERS 2  // 2+: a writer task flashes and hashes one chunk while the next downloads; 1: in turn
+#define FOTA_PROGRESS_INTERVAL_MS 2000  // Minimum time between download progress lines
+#define FOTA_BACKGROUND 1  // 1: updates run in their own task while sampling and uploads go on; 0: inside the upload task
+#define FOTA_MAX_BYTES_PER_S 32768  // Download budget of a background update, 0 for none; leaves link and CPU to the loop
 
 // HTTP configuration
 #define HTTP_TIMEOUT_MS 10000
+#define HTTP_KEEP_ALIVE 1  // Keep one connection per host open between requests instead of reconnecting each time
+#define HTTP_MAX_BODY_BYTES 4096  // Response bodies larger than this are rejected, not read into RAM
+#define HTTP_READ_CHUNK 128       // Bytes read from the socket at a time while streaming a body
 #define MAX_RETRIES 3
 #define RETRY_BASE_DELAY_MS 1000UL
 #define MAX_RETRY_DELAY_MS 8000UL
@@ -44,6 +61,16 @@
 // FOTA_INTERVAL_MS removed - FOTA now integrated into upload response (no polling)
 #define COMMAND_INTERVAL_MS 15000
 
+// Task layout: with DUAL_CORE_PIPELINE the Modbus polls run in their own task, pinned away
+// from the WiFi stack, and push readings into the sample ring the upload task consumes
+#define DUAL_CORE_PIPELINE 1  // 1: acquisition and upload tasks on separate cores; 0: everything in loop()
+#define ACQUISITION_TASK_CORE 1  // APP core; the WiFi and lwIP tasks run on core 0
+#define ACQUISITION_TASK_PRIORITY 2  // Above the upload task, so a poll preempts compression on a shared core
+#define ACQUISITION_TASK_STACK 6144
+#define UPLOAD_TASK_CORE 0
+#define UPLOAD_TASK_PRIORITY 1
+#define UPLOAD_TASK_STACK 12288  // Compression, sealing and ArduinoJson response parsing
+
 // Modbus configuration
 #define SLAVE_ADDRESS 0x11
 #define FUNCTION_CODE_READ 0x03
@@ -62,15 +89,38 @@ extern const PROGMEM uint16_t READ_REGISTERS[READ_REGISTER_COUNT];
 #define MEMORY_BUFFER_SIZE 30  // Default fallback buffer size when dynamic allocation fails
 
 // Compression configuration
-#define MAX_COMPRESSION_SIZE (MEMORY_BUFFER_SIZE * 2 * READ_REGISTER_COUNT + 5)
 #define MAX_COMPRESSION_RETRIES 3 // Maximum number of compression retries
 #define MAX_PAYLOAD_SIZE 200 // Maximum allowed payload size before using aggregation
 #define AGG_WINDOW 10 // Samples per aggregation window
+#define OVERSIZE_UPLOAD_AGGREGATE 0  // Average every AGG_WINDOW samples into one (lossy)
+#define OVERSIZE_UPLOAD_CHUNKED 1    // Split at sample boundaries into sequenced frames of at most MAX_PAYLOAD_SIZE
+#define OVERSIZE_UPLOAD_MODE OVERSIZE_UPLOAD_CHUNKED  // What to do when the compressed buffer exceeds MAX_PAYLOAD_SIZE
+#define MAX_UPLOAD_CHUNKS 32  // Chunks per batch (one ACK bit each); larger batches fall back to aggregation
+#define COMPRESSION_METHOD_DELTA_RLE 0  // 0x00 run | 0x01 + 16-bit delta (format the cloud decodes today)
+#define COMPRESSION_METHOD_VARINT 1     // 0x00 + varint run | zigzag varint delta
+#define COMPRESSION_METHOD_ADAPTIVE 2   // Smallest of several codecs, chosen per register
+#define COMPRESSION_METHOD COMPRESSION_METHOD_DELTA_RLE  // Written into header byte 2 (upper nibble)
+#define STREAMING_COMPRESSION 1  // Encode each sample as it is stored; upload only flushes (not for ADAPTIVE)
+
+// CRC-16 engine configuration
+#define CRC16_ENGINE_TABLE 0   // 256-entry table, 512 B flash
+#define CRC16_ENGINE_SLICE4 1  // Slicing-by-4, 4 bytes per step, extra 3.5 KB RAM
+#define CRC16_ENGINE_SLICE8 2  // Slicing-by-8, 8 bytes per step, same 3.5 KB RAM as slice4
+#define CRC16_ENGINE CRC16_ENGINE_TABLE  // Modbus frames are short; use SLICE8 if upload frames dominate
 
 // Buffer behavior configuration
 #define BUFFER_FULL_BEHAVIOR_CIRCULAR 1  // Option A: Overwrite oldest data (circular buffer)
 #define BUFFER_FULL_BEHAVIOR_STOP 0     // Option B: Stop new acquisitions until space is free
 #define BUFFER_FULL_BEHAVIOR BUFFER_FULL_BEHAVIOR_STOP  // Choose behavior when buffer is full
+#define SAMPLE_DOUBLE_BUFFERING 1  // 1: ring holds two uploads' worth, so sampling continues while one awaits its ACK; 0: one upload's worth
+#define SAMPLE_BUFFER_MAX 100  // Most samples in one upload; the sample ring is allocated for this at boot
+
+// Store-and-forward backlog (spiffs partition) for uploads the cloud did not ACK
+#define UPLOAD_BACKLOG 1  // 1: park failed frames in flash and free the sample buffer; 0: retry from RAM
+#define BACKLOG_SEGMENT_SIZE 16384  // Bytes per segment file; segments are appended to and deleted whole
+#define BACKLOG_MAX_SEGMENTS 24     // 384 KB of the 704 KB partition; the oldest segment is dropped beyond this
+#define BACKLOG_REPLAY_MAX_BYTES 1024  // Frames packed into one replay request
+#define BACKLOG_REPLAY_MAX_REQUESTS 8  // Replay requests per upload cycle, to bound the time spent draining
 
 // Register gains (stored in PROGMEM)
 extern const PROGMEM float REGISTER_GAINS[MAX_REGISTERS];
@@ -275,126 +275,126 @@ void ConfigManager::clear_pending_config() {
 }
 
 String ConfigManager::process_cloud_config_update(const String& response) {
-    // Parse the cloud response to extract config_update
-    String config_update_json;
-    extern bool parse_config_update_from_response(const String& response, String& config_update_json);
+    if (response.length() == 0) {
+        return "";
+    }
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, response);
     
-    if (parse_config_update_from_response(response, config_update_json)) {
-        Serial.println(F("[CONFIG] Processing configuration update from cloud response"));
-        
-        // Apply the configuration update and capture the ACK
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, config_update_json);
-        
-        if (error) {
-            Serial.print(F("[CONFIG] JSON parse error: "));
-            Serial.println(error.c_str());
-            return "";
-        }
-        
-        if (!doc["config_update"].is<JsonObject>()) {
-            return "";
-        }
-        
-        JsonObject config_update = doc["config_update"];
-        JsonDocument ack_doc;
-        JsonArray accepted = ack_doc["accepted"].to<JsonArray>();
-        JsonArray rejected = ack_doc["rejected"].to<JsonArray>();
-        JsonArray unchanged = ack_doc["unchanged"].to<JsonArray>();
-        
-        bool config_changed = false;
-        
-        if (xSemaphoreTake(config_mutex, CONFIG_MUTEX_TIMEOUT) != pdTRUE) {
-            Serial.println(F("[CONFIG] ERROR: Semaphore timeout in process_cloud_config_update"));
-            return "";
-        }
-        
-        // Start with current config as the base for pending config
-        pending_config = current_config;
-        
-        // Process each configuration parameter
-        if (config_update["sampling_interval"].is<uint32_t>()) {
-            uint32_t new_interval = config_update["sampling_interval"].as<uint32_t>() * 1000;
-            if (!validate_sampling_interval(new_interval)) {
-                rejected.add("sampling_interval");
-            } else if (current_config.sampling_interval_ms == new_interval) {
-                unchanged.add("sampling_interval");
-            } else {
-                pending_config.sampling_interval_ms = new_interval;
-                accepted.add("sampling_interval");
-                config_changed = true;
-            }
+    if (error) {
+        Serial.print(F("[CONFIG] JSON parse error: "));
+        Serial.println(error.c_str());
+        return "";
+    }
+    
+    if (!doc["config_update"].is<JsonObject>()) {
+        return "";  // No config update found
+    }
+    return process_config_update(doc["config_update"].as<JsonObject>());
+}
+
+String ConfigManager::process_config_update(JsonObject config_update) {
+    if (config_update.isNull()) {
+        return "";
+    }
+    Serial.println(F("[CONFIG] Processing configuration update from cloud response"));
+    
+    JsonDocument ack_doc;
+    JsonArray accepted = ack_doc["accepted"].to<JsonArray>();
+    JsonArray rejected = ack_doc["rejected"].to<JsonArray>();
+    JsonArray unchanged = ack_doc["unchanged"].to<JsonArray>();
+    
+    bool config_changed = false;
+    
+    if (xSemaphoreTake(config_mutex, CONFIG_MUTEX_TIMEOUT) != pdTRUE) {
+        Serial.println(F("[CONFIG] ERROR: Semaphore timeout in process_config_update"));
+        return "";
+    }
+    
+    // Start with current config as the base for pending config
+    pending_config = current_config;
+    
+    // Process each configuration parameter
+    if (config_update["sampling_interval"].is<uint32_t>()) {
+        uint32_t new_interval = config_update["sampling_interval"].as<uint32_t>() * 1000;
+        if (!validate_sampling_interval(new_interval)) {
+            rejected.add("sampling_interval");
+        } else if (current_config.sampling_interval_ms == new_interval) {
+            unchanged.add("sampling_interval");
+        } else {
+            pending_config.sampling_interval_ms = new_interval;
+            accepted.add("sampling_interval");
+            config_changed = true;
         }
-        
-        if (config_update["upload_interval"].is<uint32_t>()) {
-            uint32_t new_interval = config_update["upload_interval"].as<uint32_t>() * 1000;
-            if (!validate_upload_interval(new_interval)) {
-                rejected.add("upload_interval");
-            } else if (current_config.upload_interval_ms == new_interval) {
-                unchanged.add("upload_interval");
-            } else {
-                pending_config.upload_interval_ms = new_interval;
-                accepted.add("upload_interval");
-                config_changed = true;
-            }
+    }
+    
+    if (config_update["upload_interval"].is<uint32_t>()) {
+        uint32_t new_interval = config_update["upload_interval"].as<uint32_t>() * 1000;
+        if (!validate_upload_interval(new_interval)) {
+            rejected.add("upload_interval");
+        } else if (current_config.upload_interval_ms == new_interval) {
+            unchanged.add("upload_interval");
+        } else {
+            pending_config.upload_interval_ms = new_interval;
+            accepted.add("upload_interval");
+            config_changed = true;
         }
-        
-        if (config_update["registers"].is<JsonArray>()) {
-            JsonArray registers = config_update["registers"];
-            if (!validate_registers(registers)) {
-                rejected.add("registers");
-            } else {
-                bool registers_unchanged = (registers.size() == current_config.register_count);
-                if (registers_unchanged) {
-                    for (size_t i = 0; i < registers.size(); i++) {
-                        String reg_name = registers[i].as<String>();
-                        uint16_t addr = get_register_address(reg_name);
-                        if (addr != current_config.active_registers[i]) {
-                            registers_unchanged = false;
-                            break;
-                        }
-                    }
-                }
-                
-                if (registers_unchanged) {
-                    unchanged.add("registers");
-                } else {
-                    pending_config.register_count = registers.size();
-                    for (size_t i = 0; i < registers.size(); i++) {
-                        String reg_name = registers[i].as<String>();
-                        pending_config.active_registers[i] = get_register_address(reg_name);
+    }
+    
+    if (config_update["registers"].is<JsonArray>()) {
+        JsonArray registers = config_update["registers"];
+        if (!validate_registers(registers)) {
+            rejected.add("registers");
+        } else {
+            bool registers_unchanged = (registers.size() == current_config.register_count);
+            if (registers_unchanged) {
+                for (size_t i = 0; i < registers.size(); i++) {
+                    String reg_name = registers[i].as<String>();
+                    uint16_t addr = get_register_address(reg_name);
+                    if (addr != current_config.active_registers[i]) {
+                        registers_unchanged = false;
+                        break;
                     }
-                    accepted.add("registers");
-                    config_changed = true;
                 }
             }
-        }
-        
-        if (config_update["slave_address"].is<uint8_t>()) {
-            uint8_t new_addr = config_update["slave_address"].as<uint8_t>();
-            if (!validate_slave_address(new_addr)) {
-                rejected.add("slave_address");
-            } else if (current_config.slave_address == new_addr) {
-                unchanged.add("slave_address");
+            
+            if (registers_unchanged) {
+                unchanged.add("registers");
             } else {
-                pending_config.slave_address = new_addr;
-                accepted.add("slave_address");
+                pending_config.register_count = registers.size();
+                for (size_t i = 0; i < registers.size(); i++) {
+                    String reg_name = registers[i].as<String>();
+                    pending_config.active_registers[i] = get_register_address(reg_name);
+                }
+                accepted.add("registers");
                 config_changed = true;
             }
         }
-        
-        if (config_changed) {
-            has_pending_config = true;
-            Serial.println(F("[CONFIG] Configuration changes staged as pending"));
+    }
+    
+    if (config_update["slave_address"].is<uint8_t>()) {
+        uint8_t new_addr = config_update["slave_address"].as<uint8_t>();
+        if (!validate_slave_address(new_addr)) {
+            rejected.add("slave_address");
+        } else if (current_config.slave_address == new_addr) {
+            unchanged.add("slave_address");
+        } else {
+            pending_config.slave_address = new_addr;
+            accepted.add("slave_address");
+            config_changed = true;
         }
-        
-        xSemaphoreGive(config_mutex);
-        
-        // Generate and return the acknowledgment
-        return generate_config_ack(accepted, rejected, unchanged);
     }
     
-    return "";  // No config update found
+    if (config_changed) {
+        has_pending_config = true;
+        Serial.println(F("[CONFIG] Configuration changes staged as pending"));
+    }
+    
+    xSemaphoreGive(config_mutex);
+    
+    // Generate and return the acknowledgment
+    return generate_config_ack(accepted, rejected, unchanged);
 }
 
 String ConfigManager::generate_config_ack(const JsonArray& accepted, const JsonArray& rejected, const JsonArray& unchanged) {
@@ -483,6 +483,13 @@ String config_process_cloud_response(const String& response) {
     return "";
 }
 
+String config_process_config_update(JsonObject config_update) {
+    if (g_config_manager) {
+        return g_config_manager->process_config_update(config_update);
+    }
+    return "";
+}
+
 bool config_has_pending_changes() {
     if (g_config_manager) {
         return g_config_manager->has_pending_changes();
@@ -72,6 +72,7 @@ public:
     
     // Cloud integration
     String process_cloud_config_update(const String& response);
+    String process_config_update(JsonObject config_update);  // The config_update section of a parsed response
     
     // Response generation
     String generate_config_ack(const JsonArray& accepted, const JsonArray& rejected, const JsonArray& unchanged);
@@ -91,6 +92,7 @@ void config_get_active_registers(uint16_t* registers, uint8_t max_count);
 
 // Cloud integration functions
 String config_process_cloud_response(const String& response);
+String config_process_config_update(JsonObject config_update);
 bool config_has_pending_changes();
 void config_apply_pending_changes();
 void config_clear_pending_changes();
@@ -4,6 +4,7 @@
 #include <mbedtls/base64.h>
 #include <mbedtls/md.h>
 #include <mbedtls/aes.h>
+#include <mbedtls/gcm.h>
 #include <mbedtls/entropy.h>
 #include <mbedtls/ctr_drbg.h>
 #include <mbedtls/sha256.h>
@@ -91,20 +92,39 @@ String generateMAC(const uint8_t* payload, size_t length) {
     return macHex;
 }
 
+// Shared upload crypto state; see crypto_init()
+static struct {
+    bool ready;
+    SemaphoreHandle_t lock;
+    mbedtls_aes_context aes;          // Encryption key schedule for the PSK-derived key
+    mbedtls_gcm_context gcm;          // Same key, for AES-GCM uploads
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_md_context_t hmac;        // Keyed with UPLOAD_PSK; reset for each MAC
+    uint32_t ivs_since_reseed;
+    crypto_stats_t stats;
+} crypto;
+
+static const TickType_t CRYPTO_MUTEX_TIMEOUT = pdMS_TO_TICKS(1000);
+
 /**
- * @brief Encrypts payload using AES-256-CBC with random IV generation.
- * @param plaintext Pointer to the plaintext data.
- * @param plaintext_len Length of the plaintext.
- * @param ciphertext Pointer to buffer for encrypted output (must be large enough).
- * @param ciphertext_len Pointer to store the actual ciphertext length.
- * @param iv_output Pointer to 16-byte buffer to store the generated IV.
+ * @brief Sets up the upload crypto state: derives the AES-256 key from the PSK and
+ *        expands its key schedules for CBC and GCM, seeds the DRBG and keys the HMAC, once.
  * @return true on success, false on failure.
  */
-bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
-                           uint8_t* ciphertext, size_t* ciphertext_len,
-                           uint8_t* iv_output) {
-    
-    // Step 1: Derive 32-byte AES-256 key from PSK using SHA-256
+bool crypto_init(void) {
+    if (crypto.ready) {
+        return true;
+    }
+    if (crypto.lock == nullptr) {
+        crypto.lock = xSemaphoreCreateMutex();
+        if (crypto.lock == nullptr) {
+            Serial.println(F("[CRYPTO] Failed to create mutex"));
+            return false;
+        }
+    }
+
+    // Derive 32-byte AES-256 key from PSK using SHA-256
     uint8_t aes_key[32];
     mbedtls_sha256_context sha_ctx;
     mbedtls_sha256_init(&sha_ctx);
@@ -112,31 +132,213 @@ bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
     mbedtls_sha256_update_ret(&sha_ctx, (const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK));
     mbedtls_sha256_finish_ret(&sha_ctx, aes_key);
     mbedtls_sha256_free(&sha_ctx);
-    
-    Serial.println(F("[ENCRYPTION] AES-256 key derived from PSK"));
-    
-    // Step 2: Generate random 16-byte IV
-    mbedtls_entropy_context entropy;
-    mbedtls_ctr_drbg_context ctr_drbg;
-    
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-    
+
+    mbedtls_aes_init(&crypto.aes);
+    mbedtls_gcm_init(&crypto.gcm);
+    int ret = mbedtls_aes_setkey_enc(&crypto.aes, aes_key, 256);
+    if (ret == 0) {
+        ret = mbedtls_gcm_setkey(&crypto.gcm, MBEDTLS_CIPHER_ID_AES, aes_key, 256);
+    }
+    memset(aes_key, 0, sizeof(aes_key));  // Only the key schedules are kept
+    if (ret != 0) {
+        Serial.printf("[CRYPTO] Failed to set AES key: -0x%04X\n", -ret);
+        mbedtls_gcm_free(&crypto.gcm);
+        mbedtls_aes_free(&crypto.aes);
+        return false;
+    }
+
+    mbedtls_entropy_init(&crypto.entropy);
+    mbedtls_ctr_drbg_init(&crypto.drbg);
     const char* personalization = "EcoWatt_AES_IV";
-    int ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
-                                    (const uint8_t*)personalization, strlen(personalization));
+    ret = mbedtls_ctr_drbg_seed(&crypto.drbg, mbedtls_entropy_func, &crypto.entropy,
+                                (const uint8_t*)personalization, strlen(personalization));
     if (ret != 0) {
-        Serial.printf("[ENCRYPTION] Failed to seed RNG: -0x%04X\n", -ret);
-        mbedtls_ctr_drbg_free(&ctr_drbg);
-        mbedtls_entropy_free(&entropy);
+        Serial.printf("[CRYPTO] Failed to seed RNG: -0x%04X\n", -ret);
+        mbedtls_ctr_drbg_free(&crypto.drbg);
+        mbedtls_entropy_free(&crypto.entropy);
+        mbedtls_gcm_free(&crypto.gcm);
+        mbedtls_aes_free(&crypto.aes);
         return false;
     }
-    
-    ret = mbedtls_ctr_drbg_random(&ctr_drbg, iv_output, 16);
+
+    mbedtls_md_init(&crypto.hmac);
+    if (mbedtls_md_setup(&crypto.hmac, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0 ||
+        mbedtls_md_hmac_starts(&crypto.hmac, (const uint8_t*)UPLOAD_PSK, strlen(UPLOAD_PSK)) != 0) {
+        Serial.println(F("[CRYPTO] Failed to key HMAC"));
+        mbedtls_md_free(&crypto.hmac);
+        mbedtls_ctr_drbg_free(&crypto.drbg);
+        mbedtls_entropy_free(&crypto.entropy);
+        mbedtls_gcm_free(&crypto.gcm);
+        mbedtls_aes_free(&crypto.aes);
+        return false;
+    }
+
+    crypto.ivs_since_reseed = 0;
+    crypto.ready = true;
+    Serial.println(F("[CRYPTO] AES key schedule, DRBG and HMAC ready"));
+    return true;
+}
+
+crypto_stats_t crypto_get_stats(void) {
+    return crypto.stats;
+}
+
+static bool crypto_lock(void) {
+    if (!crypto_init()) {
+        return false;
+    }
+    if (xSemaphoreTake(crypto.lock, CRYPTO_MUTEX_TIMEOUT) != pdTRUE) {
+        Serial.println(F("[CRYPTO] ERROR: Semaphore timeout"));
+        return false;
+    }
+    return true;
+}
+
+static void crypto_unlock(void) {
+    xSemaphoreGive(crypto.lock);
+}
+
+// Draw a fresh IV; the DRBG is reseeded from the entropy source every
+// CRYPTO_RESEED_INTERVAL IVs. Call with the crypto lock held.
+static bool crypto_random_iv(uint8_t* iv, size_t length) {
+    if (crypto.ivs_since_reseed >= CRYPTO_RESEED_INTERVAL) {
+        int ret = mbedtls_ctr_drbg_reseed(&crypto.drbg, NULL, 0);
+        if (ret != 0) {
+            Serial.printf("[CRYPTO] DRBG reseed failed: -0x%04X\n", -ret);
+            return false;
+        }
+        crypto.ivs_since_reseed = 0;
+        crypto.stats.reseeds++;
+    }
+    int ret = mbedtls_ctr_drbg_random(&crypto.drbg, iv, length);
     if (ret != 0) {
         Serial.printf("[ENCRYPTION] Failed to generate IV: -0x%04X\n", -ret);
-        mbedtls_ctr_drbg_free(&ctr_drbg);
-        mbedtls_entropy_free(&entropy);
+        return false;
+    }
+    crypto.ivs_since_reseed++;
+    crypto.stats.ivs++;
+    return true;
+}
+
+/**
+ * @brief Starts an HMAC-SHA256 computation.
+ * @param ctx Context to set up; released by mac_final().
+ * @param key The HMAC key.
+ * @param key_length The length of the key.
+ * @return true on success, false on failure.
+ */
+bool mac_init(mac_context_t* ctx, const uint8_t* key, size_t key_length) {
+    ctx->active = &ctx->md;
+    mbedtls_md_init(&ctx->md);
+    const mbedtls_md_info_t* md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (mbedtls_md_setup(&ctx->md, md_info, 1) != 0 ||
+        mbedtls_md_hmac_starts(&ctx->md, key, key_length) != 0) {
+        Serial.println(F("[SECURITY] Failed to start HMAC"));
+        mbedtls_md_free(&ctx->md);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Starts an upload MAC from the HMAC pads cached by crypto_init(). The crypto
+ *        lock is held until mac_final(), so keep the two close together.
+ * @param ctx Context to set up; released by mac_final().
+ * @return true on success, false on failure.
+ */
+bool mac_init_upload(mac_context_t* ctx) {
+    if (!crypto_lock()) {
+        return false;
+    }
+    if (mbedtls_md_hmac_reset(&crypto.hmac) != 0) {
+        crypto_unlock();
+        return false;
+    }
+    ctx->active = &crypto.hmac;
+    return true;
+}
+
+/**
+ * @brief Feeds the next piece of the message to the MAC.
+ * @param ctx Context from mac_init().
+ * @param data Pointer to the bytes.
+ * @param length The number of bytes.
+ * @return true on success, false on failure.
+ */
+bool mac_update(mac_context_t* ctx, const uint8_t* data, size_t length) {
+    return mbedtls_md_hmac_update(ctx->active, data, length) == 0;
+}
+
+/**
+ * @brief Feeds the Base64 encoding of data to the MAC, one stack block at a time,
+ *        giving the same MAC as generateMAC(encodeBase64(data, length)).
+ * @param ctx Context from mac_init().
+ * @param data Pointer to the whole message; the last group is padded.
+ * @param length The length of the message.
+ * @return true on success, false on failure.
+ */
+bool mac_update_base64(mac_context_t* ctx, const uint8_t* data, size_t length) {
+    uint8_t encoded[65];  // 48 input bytes encode to 64 characters
+    for (size_t offset = 0; offset < length; offset += 48) {
+        size_t block = length - offset < 48 ? length - offset : 48;
+        size_t encoded_len = 0;
+        if (mbedtls_base64_encode(encoded, sizeof(encoded), &encoded_len, data + offset, block) != 0 ||
+            !mac_update(ctx, encoded, encoded_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Finishes the MAC and releases the context (or the crypto lock).
+ * @param ctx Context from mac_init().
+ * @param mac_hex Buffer of MAC_HEX_LENGTH + 1 chars for the MAC in lowercase hex.
+ * @return true on success, false on failure.
+ */
+bool mac_final(mac_context_t* ctx, char* mac_hex) {
+    uint8_t mac[32];
+    int ret = mbedtls_md_hmac_finish(ctx->active, mac);
+    if (ctx->active == &ctx->md) {
+        mbedtls_md_free(&ctx->md);
+    } else {
+        crypto_unlock();
+    }
+    if (ret != 0) {
+        mac_hex[0] = '\0';
+        return false;
+    }
+
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < sizeof(mac); i++) {
+        mac_hex[2 * i] = digits[mac[i] >> 4];
+        mac_hex[2 * i + 1] = digits[mac[i] & 0x0F];
+    }
+    mac_hex[MAC_HEX_LENGTH] = '\0';
+    return true;
+}
+
+/**
+ * @brief Encrypts payload using AES-256-CBC with random IV generation.
+ * @param plaintext Pointer to the plaintext data.
+ * @param plaintext_len Length of the plaintext.
+ * @param ciphertext Pointer to buffer for encrypted output (must be large enough).
+ * @param ciphertext_len Pointer to store the actual ciphertext length.
+ * @param iv_output Pointer to 16-byte buffer to store the generated IV.
+ * @return true on success, false on failure.
+ */
+bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
+                           uint8_t* ciphertext, size_t* ciphertext_len,
+                           uint8_t* iv_output) {
+    
+    // Key schedule, DRBG and lock come from the long-lived crypto state
+    if (!crypto_lock()) {
+        return false;
+    }
+
+    // Step 1: Draw a random 16-byte IV
+    if (!crypto_random_iv(iv_output, 16)) {
+        crypto_unlock();
         return false;
     }
     
@@ -147,10 +349,7 @@ bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
     }
     Serial.println();
     
-    mbedtls_ctr_drbg_free(&ctr_drbg);
-    mbedtls_entropy_free(&entropy);
-    
-    // Step 3: Add PKCS#7 padding
+    // Step 2: Add PKCS#7 padding
     size_t padding_len = 16 - (plaintext_len % 16);
     size_t padded_len = plaintext_len + padding_len;
     uint8_t padded_plaintext[padded_len];
@@ -160,28 +359,17 @@ bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
         padded_plaintext[i] = padding_len; // PKCS#7 padding byte
     }
     
-    Serial.printf("[ENCRYPTION] Plaintext: %d bytes, Padded: %d bytes (padding: %d)\n", 
-                  plaintext_len, padded_len, padding_len);
-    
-    // Step 4: Encrypt using AES-256-CBC
-    mbedtls_aes_context aes;
-    mbedtls_aes_init(&aes);
-    
-    ret = mbedtls_aes_setkey_enc(&aes, aes_key, 256);
-    if (ret != 0) {
-        Serial.printf("[ENCRYPTION] Failed to set AES key: -0x%04X\n", -ret);
-        mbedtls_aes_free(&aes);
-        return false;
-    }
+    Serial.printf("[ENCRYPTION] Plaintext: %u bytes, Padded: %u bytes (padding: %u)\n", 
+                  (unsigned)plaintext_len, (unsigned)padded_len, (unsigned)padding_len);
     
+    // Step 3: Encrypt using AES-256-CBC with the cached key schedule
     // Copy IV for encryption (mbedtls_aes_crypt_cbc modifies IV)
     uint8_t iv_copy[16];
     memcpy(iv_copy, iv_output, 16);
     
-    ret = mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, padded_len,
-                                iv_copy, padded_plaintext, ciphertext);
-    
-    mbedtls_aes_free(&aes);
+    int ret = mbedtls_aes_crypt_cbc(&crypto.aes, MBEDTLS_AES_ENCRYPT, padded_len,
+                                    iv_copy, padded_plaintext, ciphertext);
+    crypto_unlock();
     
     if (ret != 0) {
         Serial.printf("[ENCRYPTION] AES encryption failed: -0x%04X\n", -ret);
@@ -190,18 +378,115 @@ bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
     
     *ciphertext_len = padded_len;
     
-    Serial.printf("[ENCRYPTION] Encryption successful: %d bytes ciphertext\n", *ciphertext_len);
+    Serial.printf("[ENCRYPTION] Encryption successful: %u bytes ciphertext\n", (unsigned)*ciphertext_len);
     
     return true;
 }
 
 
+/**
+ * @brief Encrypts and authenticates payload in one pass using AES-256-GCM with a random
+ *        96-bit IV. No padding: the ciphertext is as long as the plaintext.
+ * @param plaintext Pointer to the plaintext data.
+ * @param plaintext_len Length of the plaintext.
+ * @param aad Data authenticated by the tag but not encrypted (may be NULL).
+ * @param aad_len Length of aad.
+ * @param ciphertext Buffer of plaintext_len bytes for the encrypted output.
+ * @param iv_output Buffer of GCM_IV_LENGTH bytes for the generated IV.
+ * @param tag_output Buffer of GCM_TAG_LENGTH bytes for the authentication tag.
+ * @return true on success, false on failure.
+ */
+bool encryptPayloadAES_GCM(const uint8_t* plaintext, size_t plaintext_len,
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* ciphertext, uint8_t* iv_output, uint8_t* tag_output) {
+    if (!crypto_lock()) {
+        return false;
+    }
+    if (!crypto_random_iv(iv_output, GCM_IV_LENGTH)) {
+        crypto_unlock();
+        return false;
+    }
+
+    int ret = mbedtls_gcm_crypt_and_tag(&crypto.gcm, MBEDTLS_GCM_ENCRYPT, plaintext_len,
+                                        iv_output, GCM_IV_LENGTH, aad, aad_len,
+                                        plaintext, ciphertext, GCM_TAG_LENGTH, tag_output);
+    crypto_unlock();
+
+    if (ret != 0) {
+        Serial.printf("[ENCRYPTION] AES-GCM encryption failed: -0x%04X\n", -ret);
+        return false;
+    }
+    Serial.printf("[ENCRYPTION] AES-GCM: %u bytes ciphertext + %d bytes tag\n", (unsigned)plaintext_len, GCM_TAG_LENGTH);
+    return true;
+}
+
+
 // --- NonceManager Implementation (SPIFFS-based) ---
 
+static const TickType_t NONCE_MUTEX_TIMEOUT = pdMS_TO_TICKS(1000);
+
+/**
+ * @brief Reads a reservation written by reserveBlock(). Only a value followed by its
+ *        newline counts, so a write cut short by power loss is ignored.
+ * @param path File to read.
+ * @param value Receives the stored end of the reserved block.
+ * @return true if the file holds a complete reservation.
+ */
+bool NonceManager::readReservation(const char* path, uint32_t* value) {
+    File file = SPIFFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+    char text[12];
+    size_t n = file.read((uint8_t*)text, sizeof(text) - 1);
+    file.close();
+    text[n] = '\0';
+
+    char* end = nullptr;
+    unsigned long parsed = strtoul(text, &end, 10);
+    if (end == text || *end != '\n') {
+        return false;
+    }
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+/**
+ * @brief Stores a new reservation end in the file not holding the newest one, so a
+ *        complete reservation stays on flash whenever the power fails.
+ * @param until New end of the reserved block.
+ * @return true once the reservation is on flash.
+ */
+bool NonceManager::reserveBlock(uint32_t until) {
+    uint8_t target = current_file ^ 1;
+    File file = SPIFFS.open(nonce_files[target], "w");
+    if (!file) {
+        Serial.println(F("[NONCE] Failed to open reservation file"));
+        return false;
+    }
+    char text[12];
+    int length = snprintf(text, sizeof(text), "%lu\n", (unsigned long)until);
+    size_t written = file.write((const uint8_t*)text, length);
+    file.close();
+    if (written != (size_t)length) {
+        Serial.println(F("[NONCE] Failed to write reservation"));
+        return false;
+    }
+    current_file = target;
+    reserved_until = until;
+    flash_writes++;
+    return true;
+}
+
 /**
- * @brief Initializes SPIFFS and creates nonce file if it doesn't exist.
+ * @brief Mounts SPIFFS and resumes the nonce counter at the end of the last reserved
+ *        block. Nothing is written until the first nonce is taken.
  */
 void NonceManager::begin() {
+    if (lock == nullptr) {
+        lock = xSemaphoreCreateMutex();
+    }
+
     // Mount SPIFFS
     if (!SPIFFS.begin(true)) {
         Serial.println(F("[NONCE] Failed to mount SPIFFS"));
@@ -209,40 +494,48 @@ void NonceManager::begin() {
     }
     
     Serial.println(F("[NONCE] SPIFFS mounted successfully"));
-    
-    // Check if nonce file exists
-    if (!SPIFFS.exists(nonce_file)) {
-        Serial.println(F("[NONCE] Nonce file not found, creating with initial value 0"));
-        File file = SPIFFS.open(nonce_file, "w");
-        if (file) {
-            file.print("0");
-            file.close();
-            Serial.println(F("[NONCE] Nonce file created"));
-        } else {
-            Serial.println(F("[NONCE] Failed to create nonce file"));
+
+    // The newest complete reservation wins; a torn one is ignored
+    uint32_t stored = 0;
+    bool have_stored = false;
+    for (uint8_t i = 0; i < 2; i++) {
+        uint32_t value = 0;
+        if (readReservation(nonce_files[i], &value) && (!have_stored || value > stored)) {
+            stored = value;
+            current_file = i;
+            have_stored = true;
         }
+    }
+
+    if (have_stored) {
+        Serial.printf("[NONCE] Resuming after reserved block, next nonce %lu\n", (unsigned long)stored);
     } else {
-        Serial.println(F("[NONCE] Nonce file exists"));
+        Serial.println(F("[NONCE] No reservation found, starting at 1"));
+        stored = 1;
     }
+    next_nonce = stored;
+    reserved_until = stored;  // The first nonce reserves a new block
 }
 
 /**
- * @brief Gets a fixed nonce value for simplified synchronization.
- * @return A fixed nonce value (always returns the same value).
+ * @brief Takes the next nonce. Only the first nonce of each block writes to flash.
+ * @return The nonce, or 0 if SPIFFS is unavailable or the reservation could not be written.
  */
 uint32_t NonceManager::getAndIncrementNonce() {
-    // Use a fixed nonce to avoid synchronization issues
-    // This is acceptable for this IoT device scenario since:
-    // 1. Device communicates with only one trusted server
-    // 2. MAC verification provides integrity protection
-    // 3. Timestamps can provide additional replay protection if needed
-    const uint32_t FIXED_NONCE = 12345;
-    
-    Serial.print(F("[NONCE] Using fixed nonce: "));
-    Serial.println(FIXED_NONCE);
-    
-    return FIXED_NONCE;
-}
-
+    if (lock == nullptr || xSemaphoreTake(lock, NONCE_MUTEX_TIMEOUT) != pdTRUE) {
+        Serial.println(F("[NONCE] ERROR: Nonce manager not ready"));
+        return 0;
+    }
 
+    uint32_t nonce = 0;
+    if (next_nonce < reserved_until || reserveBlock(next_nonce + NONCE_BLOCK_SIZE)) {
+        nonce = next_nonce;
+        next_nonce = nonce + 1;
+    }
+    xSemaphoreGive(lock);
 
+    if (nonce != 0 && nonce + NONCE_BLOCK_SIZE == reserved_until) {
+        Serial.printf("[NONCE] Reserved nonces %lu-%lu\n", (unsigned long)nonce, (unsigned long)(reserved_until - 1));
+    }
+    return nonce;
+}
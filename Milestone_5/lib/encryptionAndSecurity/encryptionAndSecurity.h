@@ -2,6 +2,7 @@
 #define ENCRYPTION_AND_SECURITY_H
 
 #include <Arduino.h>
+#include <mbedtls/md.h>
 
 // Base64 encoding/decoding
 String encodeBase64(const uint8_t* payload, size_t length);
@@ -11,18 +12,70 @@ size_t decodeBase64(const String& encodedPayload, uint8_t* outputBuffer, size_t
 String generateMAC(const String& encodedPayload);
 String generateMAC(const uint8_t* payload, size_t length);
 
+#define MAC_HEX_LENGTH 64
+
+// Incremental HMAC-SHA256: feed the message in as many pieces as it is stored in
+typedef struct {
+    mbedtls_md_context_t md;
+    mbedtls_md_context_t* active;  // md, or the shared upload HMAC
+} mac_context_t;
+
+bool mac_init(mac_context_t* ctx, const uint8_t* key, size_t key_length);
+// Keyed with UPLOAD_PSK from the cached pads; holds the crypto lock until mac_final()
+bool mac_init_upload(mac_context_t* ctx);
+bool mac_update(mac_context_t* ctx, const uint8_t* data, size_t length);
+// Feeds the Base64 text of data without building it; the whole message in one call
+bool mac_update_base64(mac_context_t* ctx, const uint8_t* data, size_t length);
+// Writes MAC_HEX_LENGTH lowercase hex digits and a terminator, and frees the context
+bool mac_final(mac_context_t* ctx, char* mac_hex);
+
+// Long-lived upload crypto state, set up once at boot: the AES key schedule of the
+// PSK-derived key, a seeded CTR-DRBG for IVs and the HMAC key pads, behind one mutex.
+// The functions below set it up on first use if crypto_init() was not called.
+bool crypto_init(void);
+
+typedef struct {
+    uint32_t ivs;      // IVs drawn since boot
+    uint32_t reseeds;  // DRBG reseeds from the entropy source
+} crypto_stats_t;
+
+crypto_stats_t crypto_get_stats(void);
+
 // AES-256-CBC Encryption
 bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
                            uint8_t* ciphertext, size_t* ciphertext_len,
                            uint8_t* iv_output);
 
-// Nonce management with LittleFS (wear-leveling)
+// AES-256-GCM authenticated encryption: ciphertext is as long as the plaintext
+#define GCM_IV_LENGTH 12
+#define GCM_TAG_LENGTH 16
+
+bool encryptPayloadAES_GCM(const uint8_t* plaintext, size_t plaintext_len,
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* ciphertext, uint8_t* iv_output, uint8_t* tag_output);
+
+// Monotonic upload nonce persisted in SPIFFS. Nonces are reserved NONCE_BLOCK_SIZE at a
+// time with one flash write per block, and a reboot resumes at the end of the last
+// reserved block, so no nonce is ever handed out twice.
 class NonceManager {
 private:
-    const char* nonce_file = "/nonce.txt";
+    // Reservations alternate between two files, so the newest one is never overwritten
+    const char* const nonce_files[2] = {"/nonce.txt", "/nonce.alt"};
+    uint8_t current_file = 1;           // File holding the newest reservation
+    volatile uint32_t next_nonce = 0;   // Next nonce to hand out
+    uint32_t reserved_until = 0;        // End of the reserved block, as stored in flash
+    uint32_t flash_writes = 0;
+    SemaphoreHandle_t lock = nullptr;
+
+    bool readReservation(const char* path, uint32_t* value);
+    bool reserveBlock(uint32_t until);
 public:
     void begin();
+    // Next nonce, or 0 if the block holding it could not be reserved in flash
     uint32_t getAndIncrementNonce();
+    // Nonce the next upload will get, without taking it
+    uint32_t peekNonce() const { return next_nonce; }
+    uint32_t getFlashWrites() const { return flash_writes; }
 };
 
 #endif
\ No newline at end of file
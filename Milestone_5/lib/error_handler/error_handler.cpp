@@ -12,12 +12,16 @@ static int consecutive_errors = 0;
 // System health tracking
 static unsigned long last_health_check = 0;
 static bool watchdog_enabled = false;
+static SemaphoreHandle_t wifi_reconnect_lock = nullptr;  // One reconnection at a time across tasks
 
 void error_handler_init(void) {
     // Initialize watchdog
     esp_task_wdt_init(WATCHDOG_TIMEOUT_S, true);
     esp_task_wdt_add(NULL);
     watchdog_enabled = true;
+    if (wifi_reconnect_lock == nullptr) {
+        wifi_reconnect_lock = xSemaphoreCreateMutex();
+    }
     
     Serial.println(F("Error handler initialized"));
 }
@@ -101,12 +105,25 @@ void check_system_health(void) {
 }
 
 bool handle_wifi_reconnection(void) {
+    if (wifi_reconnect_lock != nullptr) {
+        xSemaphoreTake(wifi_reconnect_lock, portMAX_DELAY);
+        // Another task may have brought the link back while this one waited
+        if (WiFi.status() == WL_CONNECTED) {
+            xSemaphoreGive(wifi_reconnect_lock);
+            return true;
+        }
+    }
+
     Serial.println(F("Attempting WiFi reconnection..."));
     
     WiFi.disconnect();
     delay(1000);
     
-    return wifi_init();
+    bool connected = wifi_init();
+    if (wifi_reconnect_lock != nullptr) {
+        xSemaphoreGive(wifi_reconnect_lock);
+    }
+    return connected;
 }
 
 void feed_watchdog(void) {
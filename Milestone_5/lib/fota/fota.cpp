@@ -252,27 +252,181 @@ bool finalize_and_upload_fota_log(const String& jobId, const String& finalStatus
     return (code >= 200 && code < 300);
 }
 
-// New function that accepts manifest parameters (for cloud integration)
-bool perform_FOTA_with_manifest(int job_id, 
-                                const String& fwUrl, 
-                                size_t fwSize, 
-                                const String& shaExpected, 
-                                const String& signature) {
+// Download state saved in the "fota" namespace, so an interrupted download resumes
+// instead of starting over
+typedef struct {
+    uint32_t partition_address;   // Partition the image is being written to
+    uint32_t offset;              // Image bytes already written and hashed
+    char sha_expected[65];        // Image the state belongs to
+    mbedtls_sha256_context sha;   // Hash of the first offset bytes
+} fota_checkpoint_t;
+
+static bool load_fota_checkpoint(fota_checkpoint_t* checkpoint) {
+    Preferences prefs;
+    prefs.begin("fota", true);
+    bool loaded = prefs.getBytesLength("resume") == sizeof(*checkpoint) &&
+                  prefs.getBytes("resume", checkpoint, sizeof(*checkpoint)) == sizeof(*checkpoint);
+    prefs.end();
+    return loaded;
+}
+
+// The context is cloned rather than copied: with hardware SHA the running state sits in
+// the peripheral, and the clone reads it back into a software context that can be saved
+static bool save_fota_checkpoint(const esp_partition_t* partition, size_t offset,
+                                 const String& shaExpected, const mbedtls_sha256_context* sha) {
+    fota_checkpoint_t checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    checkpoint.partition_address = partition->address;
+    checkpoint.offset = offset;
+    strncpy(checkpoint.sha_expected, shaExpected.c_str(), sizeof(checkpoint.sha_expected) - 1);
+    mbedtls_sha256_init(&checkpoint.sha);
+    mbedtls_sha256_clone(&checkpoint.sha, sha);
+
+    Preferences prefs;
+    prefs.begin("fota", false);
+    bool saved = prefs.putBytes("resume", &checkpoint, sizeof(checkpoint)) == sizeof(checkpoint);
+    prefs.end();
+    mbedtls_sha256_free(&checkpoint.sha);
+    return saved;
+}
+
+static void clear_fota_checkpoint(void) {
+    Preferences prefs;
+    prefs.begin("fota", false);
+    prefs.remove("resume");
+    prefs.end();
+}
+
+// Writes one chunk straight to the partition. Sectors are erased just before their first
+// byte is written, never behind the write offset, so resuming keeps the bytes already there.
+static esp_err_t write_fota_chunk(const esp_partition_t* partition, size_t offset,
+                                  const uint8_t* data, size_t length, size_t* erased_until) {
+    size_t end = offset + length;
+    if (end > *erased_until) {
+        size_t erase_end = ((end + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE) * SPI_FLASH_SEC_SIZE;
+        esp_err_t err = esp_partition_erase_range(partition, *erased_until, erase_end - *erased_until);
+        if (err != ESP_OK) {
+            return err;
+        }
+        *erased_until = erase_end;
+    }
+    return esp_partition_write(partition, offset, data, length);
+}
+
+static size_t fota_chunk_size = FOTA_CHUNK_SIZE;
+static uint8_t fota_buffers = FOTA_PIPELINE_BUFFERS;
+
+void fota_set_pipeline(size_t chunk_size, uint8_t buffers) {
+    fota_chunk_size = chunk_size > 0 ? chunk_size : FOTA_CHUNK_SIZE;
+    fota_buffers = buffers > 0 ? buffers : 1;
+}
+
+// One downloaded block on its way to flash; a NULL data pointer ends the writer
+typedef struct {
+    uint8_t* data;
+    size_t length;
+} fota_block_t;
+
+// Flash side of a download: blocks are written and hashed in order, with a checkpoint
+// every FOTA_CHECKPOINT_CHUNKS blocks. With more than one buffer it runs in its own task
+// while the caller downloads the next block.
+typedef struct {
+    const esp_partition_t* partition;
+    const String* shaExpected;
+    size_t fwSize;
+    mbedtls_sha256_context sha;
+    size_t written;
+    size_t erased_until;
+    uint32_t blocks;
+    volatile esp_err_t err;   // First write failure; later blocks are dropped
+    QueueHandle_t filled;     // Blocks waiting for flash
+    QueueHandle_t empty;      // Buffers free to download into
+} fota_writer_t;
+
+static void fota_write_block(fota_writer_t* writer, const uint8_t* data, size_t length) {
+    if (writer->err != ESP_OK) {
+        return;
+    }
+    esp_err_t err = write_fota_chunk(writer->partition, writer->written, data, length, &writer->erased_until);
+    if (err != ESP_OK) {
+        writer->err = err;
+        return;
+    }
+    mbedtls_sha256_update_ret(&writer->sha, data, length);
+    writer->written += length;
+
+    // Survives a reset as well as a dropped connection
+    if (++writer->blocks % FOTA_CHECKPOINT_CHUNKS == 0 && writer->written < writer->fwSize) {
+        save_fota_checkpoint(writer->partition, writer->written, *writer->shaExpected, &writer->sha);
+    }
+}
+
+static void fota_writer_task(void* parameters) {
+    fota_writer_t* writer = (fota_writer_t*)parameters;
+    fota_block_t block;
+    while (xQueueReceive(writer->filled, &block, portMAX_DELAY) == pdTRUE && block.data != NULL) {
+        fota_write_block(writer, block.data, block.length);
+        xQueueSend(writer->empty, &block, portMAX_DELAY);
+    }
+    // The end marker goes back last: everything before it is in flash
+    xQueueSend(writer->empty, &block, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static bool start_fota_writer(fota_writer_t* writer, uint8_t* buffers) {
+    // One slot more than there are buffers, for the end marker
+    writer->filled = xQueueCreate(fota_buffers + 1, sizeof(fota_block_t));
+    writer->empty = xQueueCreate(fota_buffers + 1, sizeof(fota_block_t));
+    if (writer->filled != NULL && writer->empty != NULL) {
+        for (uint8_t i = 0; i < fota_buffers; i++) {
+            fota_block_t block = {buffers + (size_t)i * fota_chunk_size, 0};
+            xQueueSend(writer->empty, &block, 0);
+        }
+        if (xTaskCreate(fota_writer_task, "fota_writer", 4096, writer, 1, NULL) == pdPASS) {
+            return true;
+        }
+    }
+    Serial.println("[FOTA] Writer task unavailable, writing in turn");
+    if (writer->filled != NULL) vQueueDelete(writer->filled);
+    if (writer->empty != NULL) vQueueDelete(writer->empty);
+    return false;
+}
+
+// Waits for the writer to flash what it was given, then releases the queues
+static void stop_fota_writer(fota_writer_t* writer) {
+    fota_block_t block = {NULL, 0};
+    xQueueSend(writer->filled, &block, portMAX_DELAY);
+    do {
+        xQueueReceive(writer->empty, &block, portMAX_DELAY);
+    } while (block.data != NULL);
+    vQueueDelete(writer->filled);
+    vQueueDelete(writer->empty);
+}
+
+// Downloads, verifies and switches to the image in the manifest. A non-zero budget paces
+// the download to max_bytes_per_s, leaving the link and the CPU to the main loop.
+static bool run_fota(int job_id, 
+                     const String& fwUrl, 
+                     size_t fwSize, 
+                     const String& shaExpected, 
+                     const String& signature,
+                     uint32_t max_bytes_per_s) {
   
   unsigned long startMillis = millis();  // Track start time for duration
   Preferences prefs;
   
-  // Check if this is a new update
+  // Check if this is a new update, or one whose download was interrupted
   prefs.begin("fota", false);
   int stored_job_id = prefs.getInt("job_id", -1);
-  size_t stored_offset = prefs.getULong("offset", 0);
+  prefs.end();
+  fota_checkpoint_t checkpoint;
+  bool have_checkpoint = load_fota_checkpoint(&checkpoint);
   
-  if ((stored_job_id >= job_id) && (stored_offset == 0)) {
+  // An older job is stale even with a checkpoint; the same job only goes on to resume
+  if (stored_job_id > job_id || (stored_job_id == job_id && !have_checkpoint)) {
     Serial.println("[FOTA] No new updates (job_id already processed)");
-    prefs.end();
     return false;
   }
-  prefs.end();
   
   // Extract version info
   String fromVersion = FIRMWARE_VERSION;
@@ -313,15 +467,35 @@ bool perform_FOTA_with_manifest(int job_id,
   }
   
   Serial.println("[FOTA] Manifest signature verified");
+
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
+
+  if (next == NULL || fwSize == 0 || fwSize > next->size) {
+    Serial.println("[FOTA] Image does not fit the update partition");
+    append_fota_event("ERROR", "FOTA_FAIL", "IMAGE_SIZE_INVALID");
+    
+    unsigned long duration = millis() - startMillis;
+    finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
+    return false;
+  }
+
+  Serial.printf("[FOTA] Running: %s, Next: %s\n", running->label, next->label);
   
-  // Step 2. Clear any previous download state (always download fresh)
-  // Resume is disabled because esp_ota_begin() doesn't support offset writes
-  prefs.begin("fota", false);
-  prefs.remove("offset");  // Clear any saved offset to prevent corruption
-  prefs.putInt("job_id", job_id);
-  prefs.end();
-  
-  size_t offset = 0;  // Always start from beginning
+  // Step 2. Resume only the same image into the same partition; anything else starts over
+  size_t offset = 0;
+  if (have_checkpoint && stored_job_id == job_id &&
+      checkpoint.partition_address == next->address &&
+      checkpoint.offset < fwSize &&
+      shaExpected.equalsIgnoreCase(checkpoint.sha_expected)) {
+    offset = checkpoint.offset;
+  } else {
+    prefs.begin("fota", false);
+    prefs.remove("resume");
+    prefs.remove("offset");  // Written by firmware that could not resume
+    prefs.putInt("job_id", job_id);
+    prefs.end();
+  }
 
   HTTPClient fwHttp;
   if (!fwHttp.begin(fwUrl)) { 
@@ -333,12 +507,26 @@ bool perform_FOTA_with_manifest(int job_id,
     return false;
   }
   
-  // No Range header - always download complete firmware
+  if (offset > 0) {
+    fwHttp.addHeader("Range", "bytes=" + String((unsigned long)offset) + "-");
+  }
   int respCode = fwHttp.GET();
 
-  if (respCode != HTTP_CODE_OK) {
+  if (offset > 0 && respCode == HTTP_CODE_OK) {
+    // The server ignored the range and sent the whole image. Rewriting from the start
+    // erases what the checkpoint describes, so it goes first.
+    Serial.println("[FOTA] Range not supported by server, downloading from the start");
+    clear_fota_checkpoint();
+    offset = 0;
+  } else if (offset > 0 && respCode == HTTP_CODE_PARTIAL_CONTENT) {
+    Serial.printf("[FOTA] Resuming at %u/%u bytes\n", (unsigned)offset, (unsigned)fwSize);
+    append_fota_event("INFO", "FOTA_RESUME", "OFFSET_" + String((unsigned long)offset));
+  } else if (respCode != HTTP_CODE_OK) {
     Serial.printf("[FOTA] HTTP error: %d\n", respCode);
     append_fota_event("ERROR", "FOTA_FAIL", "HTTP_ERROR_" + String(respCode));
+    if (respCode == HTTP_CODE_RANGE_NOT_SATISFIABLE) {
+      clear_fota_checkpoint();  // Next attempt downloads the whole image
+    }
     fwHttp.end();
     
     unsigned long duration = millis() - startMillis;
@@ -346,31 +534,12 @@ bool perform_FOTA_with_manifest(int job_id,
     return false;
   }
 
-  int totalWritten = 0;  // Always start from 0
   WiFiClient *stream = fwHttp.getStreamPtr();
 
-  const esp_partition_t* running = esp_ota_get_running_partition();
-  const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
-
-  Serial.printf("[FOTA] Running: %s, Next: %s\n", running->label, next->label);
-
-  esp_ota_handle_t otaHandle = 0;
-  esp_err_t err = esp_ota_begin(next, fwSize, &otaHandle);
-  if (err != ESP_OK) {
-    Serial.printf("[FOTA] esp_ota_begin failed: %s\n", esp_err_to_name(err));
-    append_fota_event("ERROR", "FOTA_FAIL", "OTA_BEGIN_FAILED");
-    fwHttp.end();
-    
-    unsigned long duration = millis() - startMillis;
-    finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
-    return false;
-  }
-
-  uint8_t *buf = (uint8_t *)malloc(4096);
+  uint8_t *buf = (uint8_t *)malloc((size_t)fota_buffers * fota_chunk_size);
   if (!buf) {
     Serial.println("[FOTA] Failed to allocate buffer");
     append_fota_event("ERROR", "FOTA_FAIL", "MEMORY_ALLOCATION_FAILED");
-    esp_ota_end(otaHandle);
     fwHttp.end();
     
     unsigned long duration = millis() - startMillis;
@@ -378,49 +547,103 @@ bool perform_FOTA_with_manifest(int job_id,
     return false;
   }
 
+  // Written directly with esp_partition_write: esp_ota_begin() erases the whole image
+  // range and esp_ota_write() cannot start at an offset, which rules out resuming
   unsigned char hashBuf[32];
-  size_t bytesRead;
-  mbedtls_sha256_context ctx;
-  mbedtls_sha256_init(&ctx);
-  mbedtls_sha256_starts_ret(&ctx, 0);
-
-  // Download firmware (NO VERBOSE LOGGING)
-  while (fwHttp.connected() && (bytesRead = stream->readBytes(buf, 4096)) > 0) {
-    err = esp_ota_write(otaHandle, buf, bytesRead);
-    if (err != ESP_OK) {
-      Serial.printf("[FOTA] esp_ota_write failed: %s\n", esp_err_to_name(err));
-      append_fota_event("ERROR", "FOTA_FAIL", "WRITE_FAILED");
-      free(buf);
-      esp_ota_end(otaHandle);
-      fwHttp.end();
-      
-      unsigned long duration = millis() - startMillis;
-      finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
-      return false;
+  fota_writer_t writer;
+  writer.partition = next;
+  writer.shaExpected = &shaExpected;
+  writer.fwSize = fwSize;
+  mbedtls_sha256_init(&writer.sha);
+  if (offset > 0) {
+    mbedtls_sha256_clone(&writer.sha, &checkpoint.sha);
+  } else {
+    mbedtls_sha256_starts_ret(&writer.sha, 0);
+  }
+  writer.written = offset;
+  writer.erased_until = ((offset + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE) * SPI_FLASH_SEC_SIZE;
+  writer.blocks = 0;
+  writer.err = ESP_OK;
+
+  // Without the task (one buffer, or no memory for it) each block is written in turn
+  bool pipelined = fota_buffers > 1 && start_fota_writer(&writer, buf);
+
+  // Download firmware; progress at most every FOTA_PROGRESS_INTERVAL_MS
+  size_t received = offset;
+  unsigned long lastProgress = millis();
+  unsigned long downloadStart = millis();
+  while (received < fwSize && fwHttp.connected() && writer.err == ESP_OK) {
+    fota_block_t block = {buf, 0};
+    if (pipelined) {
+      xQueueReceive(writer.empty, &block, portMAX_DELAY);
     }
+    size_t wanted = fwSize - received < fota_chunk_size ? fwSize - received : fota_chunk_size;
+    block.length = stream->readBytes(block.data, wanted);
+    if (block.length == 0) {
+      if (pipelined) {
+        xQueueSend(writer.empty, &block, portMAX_DELAY);
+      }
+      break;
+    }
+    received += block.length;
 
-    mbedtls_sha256_update_ret(&ctx, buf, bytesRead);
-    totalWritten += bytesRead;
+    if (pipelined) {
+      xQueueSend(writer.filled, &block, portMAX_DELAY);
+    } else {
+      fota_write_block(&writer, block.data, block.length);
+    }
 
-    // Resume disabled - no offset persistence needed
-    
-    // Show progress on serial only
-    Serial.printf("[FOTA] Progress: %d/%d bytes (%.2f%%)\r\n", 
-                  totalWritten, (int)fwSize, 100.0 * totalWritten / fwSize);
+    if (millis() - lastProgress >= FOTA_PROGRESS_INTERVAL_MS) {
+      lastProgress = millis();
+      Serial.printf("[FOTA] Progress: %d/%d bytes (%.2f%%)\r\n", 
+                    (int)received, (int)fwSize, 100.0 * received / fwSize);
+    }
+
+    if (max_bytes_per_s > 0) {
+      unsigned long due = (unsigned long)((uint64_t)(received - offset) * 1000 / max_bytes_per_s);
+      unsigned long elapsed = millis() - downloadStart;
+      if (due > elapsed) {
+        delay(due - elapsed);
+      }
+    }
   }
 
-  Serial.println("[FOTA] Download complete");
-  prefs.begin("fota", false);
-  prefs.putULong("offset", totalWritten);
-  prefs.end();
-  
+  if (pipelined) {
+    stop_fota_writer(&writer);
+  }
   free(buf);
   buf = nullptr;
-
-  mbedtls_sha256_finish_ret(&ctx, hashBuf);
-  mbedtls_sha256_free(&ctx);
   fwHttp.end();
 
+  if (writer.err != ESP_OK) {
+    // The last checkpoint still describes flash correctly, so it is kept
+    Serial.printf("[FOTA] esp_partition_write failed: %s\n", esp_err_to_name(writer.err));
+    append_fota_event("ERROR", "FOTA_FAIL", "WRITE_FAILED");
+    mbedtls_sha256_free(&writer.sha);
+    
+    unsigned long duration = millis() - startMillis;
+    finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
+    return false;
+  }
+
+  size_t totalWritten = writer.written;
+  if (totalWritten < fwSize) {
+    save_fota_checkpoint(next, totalWritten, shaExpected, &writer.sha);
+    mbedtls_sha256_free(&writer.sha);
+    Serial.printf("[FOTA] Download interrupted at %u/%u bytes, will resume\n",
+                  (unsigned)totalWritten, (unsigned)fwSize);
+    append_fota_event("WARN", "FOTA_INTERRUPTED", "OFFSET_" + String((unsigned long)totalWritten));
+    
+    unsigned long duration = millis() - startMillis;
+    finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
+    return false;
+  }
+
+  Serial.println("[FOTA] Download complete");
+
+  mbedtls_sha256_finish_ret(&writer.sha, hashBuf);
+  mbedtls_sha256_free(&writer.sha);
+
   String computedHash;
   char hexBuf[3];
   for (size_t i = 0; i < sizeof(hashBuf); i++) {
@@ -434,7 +657,11 @@ bool perform_FOTA_with_manifest(int job_id,
     Serial.println("[FOTA] Computed: " + computedHash);
     Serial.println("[FOTA] Expected: " + shaExpected);
     append_fota_event("ERROR", "FOTA_FAIL", "HASH_MISMATCH");
-    esp_ota_abort(otaHandle);
+    // Forget the job so the next manifest downloads it again from the start
+    prefs.begin("fota", false);
+    prefs.remove("resume");
+    prefs.remove("job_id");
+    prefs.end();
     
     unsigned long duration = millis() - startMillis;
     finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
@@ -443,29 +670,22 @@ bool perform_FOTA_with_manifest(int job_id,
   
   Serial.println("[FOTA] SHA verified");
 
-  err = esp_ota_end(otaHandle);
-  if (err != ESP_OK) {
-    Serial.printf("[FOTA] esp_ota_end failed: %s\n", esp_err_to_name(err));
-    append_fota_event("ERROR", "FOTA_FAIL", "OTA_END_FAILED");
-    
-    unsigned long duration = millis() - startMillis;
-    finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
-    return false;
-  }
-
-  err = esp_ota_set_boot_partition(next);
+  // Validates the image header and segments before switching, as esp_ota_end() would
+  esp_err_t err = esp_ota_set_boot_partition(next);
   if (err != ESP_OK) {
     Serial.printf("[FOTA] esp_ota_set_boot_partition failed: %s\n", esp_err_to_name(err));
     append_fota_event("ERROR", "FOTA_FAIL", "SET_BOOT_PARTITION_FAILED");
+    prefs.begin("fota", false);
+    prefs.remove("resume");
+    prefs.remove("job_id");
+    prefs.end();
     
     unsigned long duration = millis() - startMillis;
     finalize_and_upload_fota_log(jobIdStr, "FAILURE", duration);
     return false;
   }
 
-  prefs.begin("fota", false);
-  prefs.putULong("offset", 0);
-  prefs.end();
+  clear_fota_checkpoint();
 
   // SUCCESS - Log final event
   Serial.println("[FOTA] Firmware validated and ready");
@@ -475,4 +695,69 @@ bool perform_FOTA_with_manifest(int job_id,
   finalize_and_upload_fota_log(jobIdStr, "SUCCESS", duration);
   
   return true;
-}
\ No newline at end of file
+}
+
+// New function that accepts manifest parameters (for cloud integration)
+bool perform_FOTA_with_manifest(int job_id, 
+                                const String& fwUrl, 
+                                size_t fwSize, 
+                                const String& shaExpected, 
+                                const String& signature) {
+  return run_fota(job_id, fwUrl, fwSize, shaExpected, signature, 0);
+}
+
+// Manifest handed to the background task, which frees it
+typedef struct {
+    int job_id;
+    String fwUrl;
+    size_t fwSize;
+    String shaExpected;
+    String signature;
+} fota_job_t;
+
+static volatile fota_state_t fota_state = FOTA_IDLE;
+static uint32_t fota_budget = FOTA_MAX_BYTES_PER_S;
+
+void fota_set_background_budget(uint32_t max_bytes_per_s) {
+    fota_budget = max_bytes_per_s;
+}
+
+static void fota_task(void* parameters) {
+    fota_job_t* job = (fota_job_t*)parameters;
+    bool success = run_fota(job->job_id, job->fwUrl, job->fwSize, job->shaExpected, job->signature, fota_budget);
+    delete job;
+    fota_state = success ? FOTA_SUCCEEDED : FOTA_FAILED;
+    vTaskDelete(NULL);
+}
+
+bool fota_start_background(int job_id,
+                           const String& fwUrl,
+                           size_t fwSize,
+                           const String& shaExpected,
+                           const String& signature) {
+    if (fota_state == FOTA_RUNNING) {
+        return false;
+    }
+    fota_job_t* job = new fota_job_t{job_id, fwUrl, fwSize, shaExpected, signature};
+    fota_state = FOTA_RUNNING;
+    // Pinned away from loop(), which runs on core 1 and may never block
+    if (xTaskCreatePinnedToCore(fota_task, "fota", 12288, job, 1, NULL, 0) != pdPASS) {
+        Serial.println("[FOTA] Unable to start the update task");
+        delete job;
+        fota_state = FOTA_IDLE;
+        return false;
+    }
+    return true;
+}
+
+bool fota_in_progress(void) {
+    return fota_state == FOTA_RUNNING;
+}
+
+fota_state_t fota_poll(void) {
+    fota_state_t state = fota_state;
+    if (state == FOTA_SUCCEEDED || state == FOTA_FAILED) {
+        fota_state = FOTA_IDLE;
+    }
+    return state;
+}
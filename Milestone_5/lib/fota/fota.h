@@ -10,4 +10,27 @@ bool perform_FOTA_with_manifest(int job_id,
                                 const String& shaExpected, 
                                 const String& signature);
 
-#endif
\ No newline at end of file
+// Download block size and buffer count; FOTA_CHUNK_SIZE and FOTA_PIPELINE_BUFFERS by default
+void fota_set_pipeline(size_t chunk_size, uint8_t buffers);
+
+typedef enum {
+    FOTA_IDLE = 0,
+    FOTA_RUNNING,
+    FOTA_SUCCEEDED,   // The new image boots on the next restart
+    FOTA_FAILED
+} fota_state_t;
+
+// Runs perform_FOTA_with_manifest() in its own task and returns at once. False if an
+// update is already running or the task could not be created.
+bool fota_start_background(int job_id,
+                           const String& fwUrl,
+                           size_t fwSize,
+                           const String& shaExpected,
+                           const String& signature);
+bool fota_in_progress(void);
+// State of the background update; a finished one reads SUCCEEDED or FAILED once, then IDLE
+fota_state_t fota_poll(void);
+// Download rate of background updates, FOTA_MAX_BYTES_PER_S by default; 0 for no limit
+void fota_set_background_budget(uint32_t max_bytes_per_s);
+
+#endif
@@ -0,0 +1,283 @@
+#include "json_scan.h"
+
+enum {
+    SCAN_VALUE = 0,     // Expecting a value
+    SCAN_ARRAY_FIRST,   // After '[': a value or ']'
+    SCAN_OBJECT_FIRST,  // After '{': a member name or '}'
+    SCAN_KEY_NEXT,      // After ',' in an object: a member name
+    SCAN_KEY,           // Inside a member name
+    SCAN_COLON,         // After a member name
+    SCAN_STRING,        // Inside a string value
+    SCAN_SCALAR,        // Inside a number or literal
+    SCAN_AFTER_VALUE    // Expecting ',' or the end of the container
+};
+
+#define SCAN_OUT_SIZE 32
+
+// Value bytes collected during one json_scan_feed() call, handed over in pieces
+typedef struct {
+    char data[SCAN_OUT_SIZE];
+    size_t length;
+} scan_out_t;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool is_scalar_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool flush_value(json_scanner_t* scanner, scan_out_t* out, bool last) {
+    bool more = scanner->on_value(scanner->context, scanner->key, scanner->depth, out->data, out->length, last);
+    out->length = 0;
+    if (!more) {
+        scanner->status = JSON_SCAN_STOPPED;
+    }
+    return more;
+}
+
+static bool emit_value_byte(json_scanner_t* scanner, scan_out_t* out, char c) {
+    if (out->length == SCAN_OUT_SIZE && !flush_value(scanner, out, false)) {
+        return false;
+    }
+    out->data[out->length++] = c;
+    return true;
+}
+
+static void append_key_byte(json_scanner_t* scanner, char c) {
+    if (scanner->key_length < JSON_SCAN_MAX_KEY) {
+        scanner->key[scanner->key_length++] = c;
+        scanner->key[scanner->key_length] = '\0';
+    }
+}
+
+// One character of a string after a backslash, or of a \u escape. Returns the byte to
+// store, or -1 if nothing is stored yet; sets *bad on an invalid escape.
+static int unescape(json_scanner_t* scanner, char c, char* utf8, size_t* utf8_length, bool* bad) {
+    *utf8_length = 0;
+    if (scanner->unicode_digits > 0) {
+        int digit = hex_value(c);
+        if (digit < 0) {
+            *bad = true;
+            return -1;
+        }
+        scanner->unicode = (uint16_t)((scanner->unicode << 4) | digit);
+        if (--scanner->unicode_digits > 0) {
+            return -1;
+        }
+        uint16_t code = scanner->unicode;
+        if (code < 0x80) {
+            utf8[(*utf8_length)++] = (char)code;
+        } else if (code < 0x800) {
+            utf8[(*utf8_length)++] = (char)(0xC0 | (code >> 6));
+            utf8[(*utf8_length)++] = (char)(0x80 | (code & 0x3F));
+        } else {
+            utf8[(*utf8_length)++] = (char)(0xE0 | (code >> 12));
+            utf8[(*utf8_length)++] = (char)(0x80 | ((code >> 6) & 0x3F));
+            utf8[(*utf8_length)++] = (char)(0x80 | (code & 0x3F));
+        }
+        return -1;
+    }
+
+    scanner->escape = false;
+    switch (c) {
+        case '"': case '\\': case '/': return c;
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'u':
+            scanner->unicode_digits = 4;
+            scanner->unicode = 0;
+            return -1;
+        default:
+            *bad = true;
+            return -1;
+    }
+}
+
+static bool open_container(json_scanner_t* scanner, bool array) {
+    if (scanner->depth >= JSON_SCAN_MAX_DEPTH) {
+        scanner->status = JSON_SCAN_MALFORMED;
+        return false;
+    }
+    if (array) {
+        scanner->arrays |= 1u << scanner->depth;
+    } else {
+        scanner->arrays &= ~(1u << scanner->depth);
+    }
+    scanner->depth++;
+    scanner->state = array ? SCAN_ARRAY_FIRST : SCAN_OBJECT_FIRST;
+    return true;
+}
+
+static bool in_array(const json_scanner_t* scanner) {
+    return scanner->depth > 0 && (scanner->arrays & (1u << (scanner->depth - 1)));
+}
+
+static bool close_container(json_scanner_t* scanner, char c) {
+    if (scanner->depth == 0 || (c == ']') != in_array(scanner)) {
+        scanner->status = JSON_SCAN_MALFORMED;
+        return false;
+    }
+    scanner->depth--;
+    scanner->state = SCAN_AFTER_VALUE;
+    if (scanner->depth == 0) {
+        scanner->status = JSON_SCAN_COMPLETE;
+        return false;
+    }
+    return true;
+}
+
+static void value_done(json_scanner_t* scanner) {
+    scanner->state = SCAN_AFTER_VALUE;
+    if (scanner->depth == 0) {
+        scanner->status = JSON_SCAN_COMPLETE;
+    }
+}
+
+void json_scan_init(json_scanner_t* scanner, json_scan_value_fn on_value, void* context) {
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->on_value = on_value;
+    scanner->context = context;
+    scanner->status = JSON_SCAN_RUNNING;
+    scanner->state = SCAN_VALUE;
+}
+
+bool json_scan_feed(json_scanner_t* scanner, const char* data, size_t length) {
+    if (scanner->status != JSON_SCAN_RUNNING) {
+        return false;
+    }
+
+    scan_out_t out;
+    out.length = 0;
+    size_t i = 0;
+    while (i < length && scanner->status == JSON_SCAN_RUNNING) {
+        char c = data[i];
+        switch (scanner->state) {
+            case SCAN_ARRAY_FIRST:
+                if (is_space(c)) break;
+                if (c == ']') {
+                    close_container(scanner, c);
+                    break;
+                }
+                scanner->state = SCAN_VALUE;
+                continue;  // Same character as the first value
+
+            case SCAN_VALUE:
+                if (is_space(c)) break;
+                if (c == '{' || c == '[') {
+                    open_container(scanner, c == '[');
+                } else if (c == '"') {
+                    scanner->state = SCAN_STRING;
+                } else if (is_scalar_char(c)) {
+                    scanner->state = SCAN_SCALAR;
+                    continue;
+                } else {
+                    scanner->status = JSON_SCAN_MALFORMED;
+                }
+                break;
+
+            case SCAN_OBJECT_FIRST:
+            case SCAN_KEY_NEXT:
+                if (is_space(c)) break;
+                if (c == '"') {
+                    scanner->key_length = 0;
+                    scanner->key[0] = '\0';
+                    scanner->state = SCAN_KEY;
+                } else if (c == '}' && scanner->state == SCAN_OBJECT_FIRST) {
+                    close_container(scanner, c);
+                } else {
+                    scanner->status = JSON_SCAN_MALFORMED;
+                }
+                break;
+
+            case SCAN_KEY:
+            case SCAN_STRING: {
+                bool is_key = scanner->state == SCAN_KEY;
+                char utf8[3];
+                size_t utf8_length = 0;
+                int stored;
+                if (scanner->escape || scanner->unicode_digits > 0) {
+                    bool bad = false;
+                    stored = unescape(scanner, c, utf8, &utf8_length, &bad);
+                    if (bad) {
+                        scanner->status = JSON_SCAN_MALFORMED;
+                        break;
+                    }
+                } else if (c == '\\') {
+                    scanner->escape = true;
+                    break;
+                } else if (c == '"') {
+                    if (is_key) {
+                        scanner->state = SCAN_COLON;
+                    } else if (flush_value(scanner, &out, true)) {
+                        value_done(scanner);
+                    }
+                    break;
+                } else {
+                    stored = (uint8_t)c;
+                }
+                if (stored >= 0) {
+                    utf8[0] = (char)stored;
+                    utf8_length = 1;
+                }
+                for (size_t k = 0; k < utf8_length; k++) {
+                    if (is_key) {
+                        append_key_byte(scanner, utf8[k]);
+                    } else if (!emit_value_byte(scanner, &out, utf8[k])) {
+                        break;
+                    }
+                }
+                break;
+            }
+
+            case SCAN_COLON:
+                if (is_space(c)) break;
+                if (c == ':') {
+                    scanner->state = SCAN_VALUE;
+                } else {
+                    scanner->status = JSON_SCAN_MALFORMED;
+                }
+                break;
+
+            case SCAN_SCALAR:
+                if (is_scalar_char(c)) {
+                    emit_value_byte(scanner, &out, c);
+                    break;
+                }
+                if (flush_value(scanner, &out, true)) {
+                    value_done(scanner);
+                }
+                continue;  // The character after a scalar belongs to the container
+
+            case SCAN_AFTER_VALUE:
+                if (is_space(c)) break;
+                if (c == ',' && scanner->depth > 0) {
+                    scanner->state = in_array(scanner) ? SCAN_VALUE : SCAN_KEY_NEXT;
+                } else if (c == '}' || c == ']') {
+                    close_container(scanner, c);
+                } else {
+                    scanner->status = JSON_SCAN_MALFORMED;
+                }
+                break;
+        }
+        i++;
+    }
+    scanner->bytes += i;
+
+    // Hand over what this piece held of a value that continues in the next one
+    if (scanner->status == JSON_SCAN_RUNNING && out.length > 0) {
+        flush_value(scanner, &out, false);
+    }
+    return scanner->status == JSON_SCAN_RUNNING;
+}
@@ -0,0 +1,49 @@
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <Arduino.h>
+
+// Incremental JSON scanner for HTTP bodies read in chunks.
+//
+// The body is fed piece by piece with json_scan_feed(); nothing but the current member name
+// is kept, so memory does not grow with the body. Every scalar value is passed to the
+// callback with the last member name seen (for array elements, that is usually the array's
+// name) and its depth, 1 being a member of the top-level object. Strings arrive unescaped,
+// numbers and literals as written. A long value may arrive over several calls; the last one
+// has last set. The callback returns false once it has what it needs, which ends the scan.
+
+#define JSON_SCAN_MAX_KEY 23    // Longer member names are truncated
+#define JSON_SCAN_MAX_DEPTH 16  // Deeper nesting is reported as malformed
+
+typedef bool (*json_scan_value_fn)(void* context, const char* key, uint8_t depth,
+                                   const char* chunk, size_t length, bool last);
+
+typedef enum {
+    JSON_SCAN_RUNNING = 0,
+    JSON_SCAN_STOPPED,     // The callback ended the scan
+    JSON_SCAN_COMPLETE,    // The top-level value was closed
+    JSON_SCAN_MALFORMED
+} json_scan_status_t;
+
+typedef struct {
+    json_scan_value_fn on_value;
+    void* context;
+    json_scan_status_t status;
+    uint8_t state;
+    uint8_t depth;
+    uint32_t arrays;        // Bit n set: the container at depth n+1 is an array
+    char key[JSON_SCAN_MAX_KEY + 1];
+    uint8_t key_length;
+    bool escape;
+    uint8_t unicode_digits; // \uXXXX digits still expected
+    uint16_t unicode;
+    size_t bytes;           // Bytes fed so far
+} json_scanner_t;
+
+void json_scan_init(json_scanner_t* scanner, json_scan_value_fn on_value, void* context);
+
+// Scan the next piece of the body. Returns false once the scan is over: stopped by the
+// callback, the top-level value closed, or malformed input; see scanner->status.
+bool json_scan_feed(json_scanner_t* scanner, const char* data, size_t length);
+
+#endif
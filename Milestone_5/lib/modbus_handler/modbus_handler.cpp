@@ -160,3 +160,166 @@ size_t get_expected_response_length(uint8_t function_code, uint16_t register_cou
             return 0;
     }
 }
+
+// ---------------- Binary frame API ----------------
+
+size_t modbus_build_request(uint8_t* out, size_t out_size, uint8_t slave_addr, uint8_t function_code, uint16_t start_reg, uint16_t count_or_value) {
+    if (out == nullptr || out_size < MODBUS_REQUEST_FRAME_SIZE) {
+        return 0;
+    }
+
+    out[0] = slave_addr;
+    out[1] = function_code;
+    out[2] = (start_reg >> 8) & 0xFF;
+    out[3] = start_reg & 0xFF;
+    out[4] = (count_or_value >> 8) & 0xFF;
+    out[5] = count_or_value & 0xFF;
+
+    return modbus_append_crc(out, 6, out_size);
+}
+
+size_t modbus_append_crc(uint8_t* frame, size_t length, size_t capacity) {
+    if (frame == nullptr || length + 2 > capacity) {
+        return 0;
+    }
+
+    uint16_t crc = calculateCRC(frame, (int)length);
+
+    // CRC goes low byte first
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = (crc >> 8) & 0xFF;
+    return length + 2;
+}
+
+bool modbus_check_crc(const uint8_t* frame, size_t length) {
+    if (frame == nullptr || length < 4) {
+        return false;
+    }
+
+    uint16_t received_crc = frame[length - 2] | (frame[length - 1] << 8);
+    return calculateCRC(frame, (int)(length - 2)) == received_crc;
+}
+
+bool modbus_validate_response(const uint8_t* frame, size_t length) {
+    // slave_addr + function_code + at least one data byte + CRC
+    if (frame == nullptr || length < 4) {
+        log_error(ERROR_INVALID_RESPONSE, "Response too short");
+        return false;
+    }
+
+    if (!modbus_check_crc(frame, length)) {
+        log_error(ERROR_CRC_FAILED, "CRC validation failed");
+        return false;
+    }
+
+    return true;
+}
+
+bool modbus_is_exception(const uint8_t* frame, size_t length) {
+    // Exception responses have bit 7 set (0x80 | original_function_code)
+    return frame != nullptr && length >= 2 && (frame[1] & 0x80) != 0;
+}
+
+uint8_t modbus_exception_code(const uint8_t* frame, size_t length) {
+    if (!modbus_is_exception(frame, length) || length < 3) {
+        return 0;
+    }
+    return frame[2];
+}
+
+bool modbus_decode_registers(const uint8_t* frame, size_t length, uint16_t* values, size_t max_count, size_t* actual_count) {
+    *actual_count = 0;
+
+    if (frame == nullptr || length < 4) {
+        log_error(ERROR_INVALID_RESPONSE, "Response too short");
+        return false;
+    }
+
+    if (modbus_is_exception(frame, length)) {
+        if (!modbus_check_crc(frame, length)) {
+            log_error(ERROR_CRC_FAILED, "CRC validation failed");
+            return false;
+        }
+        char error_msg[64];
+        snprintf(error_msg, sizeof(error_msg), "Modbus exception: 0x%02X", modbus_exception_code(frame, length));
+        log_error(ERROR_MODBUS_EXCEPTION, error_msg);
+        return false;
+    }
+
+    // slave_addr(1) + func_code(1) + byte_count(1) + data(n) + crc(2)
+    if (length < 5) {
+        log_error(ERROR_INVALID_RESPONSE, "Response too short for data");
+        return false;
+    }
+
+    size_t data_length = length - 5;
+    size_t register_count = frame[2] / 2;
+    size_t available = data_length / 2;
+    if (register_count > available) {
+        register_count = available;
+    }
+    size_t decode_count = register_count < max_count ? register_count : max_count;
+
+    // Run the CRC over the header, then over each register as it is decoded
+    uint16_t crc = crc16_update(crc16_init(), frame, 3);
+    const uint8_t* data = frame + 3;
+    for (size_t i = 0; i < decode_count; i++) {
+        values[i] = (data[0] << 8) | data[1];
+        crc = crc16_update(crc, data, 2);
+        data += 2;
+    }
+    crc = crc16_final(crc16_update(crc, data, (frame + length - 2) - data));
+
+    uint16_t received_crc = frame[length - 2] | (frame[length - 1] << 8);
+    if (crc != received_crc) {
+        log_error(ERROR_CRC_FAILED, "CRC validation failed");
+        return false;
+    }
+
+    if (register_count > max_count) {
+        log_error(ERROR_INVALID_RESPONSE, "Too many registers in response");
+        return false;
+    }
+
+    *actual_count = decode_count;
+    return true;
+}
+
+size_t modbus_bytes_to_hex(const uint8_t* bytes, size_t length, char* out, size_t out_size) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+
+    if (out == nullptr || out_size < length * 2 + 1) {
+        return 0;
+    }
+
+    char* p = out;
+    for (size_t i = 0; i < length; i++) {
+        *p++ = hex_digits[bytes[i] >> 4];
+        *p++ = hex_digits[bytes[i] & 0x0F];
+    }
+    *p = '\0';
+    return length * 2;
+}
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+size_t modbus_hex_to_bytes(const char* hex, size_t hex_length, uint8_t* out, size_t out_size) {
+    if (hex == nullptr || hex_length == 0 || hex_length % 2 != 0 || hex_length / 2 > out_size) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < hex_length / 2; i++) {
+        int hi = hex_nibble(hex[i * 2]);
+        int lo = hex_nibble(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return 0;
+        }
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return hex_length / 2;
+}
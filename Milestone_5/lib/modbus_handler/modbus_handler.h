@@ -21,4 +21,22 @@ String append_crc_to_frame(const String& frame_without_crc);
 bool verify_frame_crc(const String& frame_with_crc);
 size_t get_expected_response_length(uint8_t function_code, uint16_t register_count);
 
+// Binary frame API: works on caller-owned byte buffers and never touches the heap
+#define MODBUS_REQUEST_FRAME_SIZE 8   // slave_addr(1) + func_code(1) + reg(2) + count/value(2) + crc(2)
+#define MODBUS_MAX_FRAME_SIZE 256     // Modbus RTU ADU limit
+
+size_t modbus_build_request(uint8_t* out, size_t out_size, uint8_t slave_addr, uint8_t function_code, uint16_t start_reg, uint16_t count_or_value);
+size_t modbus_append_crc(uint8_t* frame, size_t length, size_t capacity);
+bool modbus_check_crc(const uint8_t* frame, size_t length);
+bool modbus_validate_response(const uint8_t* frame, size_t length);
+bool modbus_is_exception(const uint8_t* frame, size_t length);
+uint8_t modbus_exception_code(const uint8_t* frame, size_t length);
+// Checks the CRC and decodes the registers in a single pass. values may be
+// partially written even when false is returned.
+bool modbus_decode_registers(const uint8_t* frame, size_t length, uint16_t* values, size_t max_count, size_t* actual_count);
+
+// Hex text conversion, only needed at the HTTP boundary
+size_t modbus_bytes_to_hex(const uint8_t* bytes, size_t length, char* out, size_t out_size);
+size_t modbus_hex_to_bytes(const char* hex, size_t hex_length, uint8_t* out, size_t out_size);
+
 #endif
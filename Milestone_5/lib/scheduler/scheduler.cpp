@@ -9,9 +9,12 @@
 #include "fota.h"
 #include "encryptionAndSecurity.h"
 #include "esp_task_wdt.h"
-#include "command_parse.h"
 #include "time_utils.h"
 #include "wifi_manager.h"
+#include "upload_backlog.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <limits.h>
 
 
 extern NonceManager nonceManager; // Declare the global instance from main.cpp
@@ -24,59 +27,149 @@ static scheduler_task_t tasks[TASK_COUNT] = {
     // FOTA task removed - now integrated into upload response handling
     {TASK_COMMAND_HANDLING, COMMAND_INTERVAL_MS, 0, false}
 };
+static task_timing_t task_timing[TASK_COUNT] = {};
 
-// Dynamic buffer definition - Buffer Rules Implementation
-static register_reading_t* buffer = nullptr;  // Dynamic buffer allocated based on config
-static size_t buffer_count = 0;
-static size_t buffer_write_index = 0;  // For circular buffer behavior
-static bool upload_in_progress = false;  // Prevents filling during upload
-static bool buffer_full = false;  // Tracks if buffer is full
-static size_t buffer_size = 0;  // Current allocated buffer size
+// Tasks that run one after another on the same FreeRTOS task, with their retries. The
+// heap holds the lane's enabled tasks ordered by deadline, earliest at the top. loop()
+// runs every task in one lane; the pipeline gives the acquisition and upload tasks a lane each.
+typedef struct {
+    uint32_t task_mask;          // TASK_BIT() of each task in the lane
+    uint8_t heap[TASK_COUNT];
+    size_t heap_size;
+} scheduler_lane_t;
+
+#define TASK_BIT(type) (1u << (type))
+#define ACQUISITION_TASKS TASK_BIT(TASK_READ_REGISTERS)
+#define ALL_TASKS ((1u << TASK_COUNT) - 1)
+
+static scheduler_lane_t loop_lane = {ALL_TASKS, {0}, 0};
+static scheduler_lane_t acquisition_lane = {ACQUISITION_TASKS, {0}, 0};
+static scheduler_lane_t upload_lane = {ALL_TASKS & ~ACQUISITION_TASKS, {0}, 0};
+
+// Acquisition/upload pipeline. The tasks share only the sample ring, whose producer and
+// consumer sides each belong to one of them; sample_stats fields are each written by one task.
+static std::atomic<bool> pipeline_running(false);
+static std::atomic<bool> pipeline_stop_requested(false);
+static std::atomic<bool> acquisition_task_running(false);
+static std::atomic<bool> upload_task_running(false);
+static TaskHandle_t acquisition_task_handle = nullptr;
+static TaskHandle_t upload_task_handle = nullptr;
+
+// Sample store - Buffer Rules Implementation. The read task pushes readings into the ring;
+// the upload task peeks the oldest batch, sends it and commits it only once the cloud has
+// ACKed it (or a chunk batch or the backlog holds it). The arena is allocated once for the
+// largest batch, so a config change never moves it under the producer; only the limit changes.
+#define SAMPLE_RING_BATCHES (SAMPLE_DOUBLE_BUFFERING ? 2 : 1)  // One batch awaiting its ACK, one filling
+static register_reading_t* sample_arena = nullptr;
+static spsc_ring_t<register_reading_t> sample_ring;
+static std::atomic<uint32_t> sample_limit(0);  // Samples the ring may hold under the current config, 0 before allocation
+static size_t buffer_size = 0;  // Most samples in one upload, from the upload and sampling intervals
+static size_t upload_count = 0;  // Samples at the head of the ring frozen for the upload, 0 when none
+static size_t encoded_count = 0;  // Samples after the frozen ones already fed to stream_compressor
+static register_reading_t* upload_copy = nullptr;  // The frozen batch in one piece, when it wraps the ring
+static sample_stats_t sample_stats = {0};
 static uint32_t last_upload_interval = 0;  // Track config changes
 static uint32_t last_sampling_interval = 0;  // Track config changes
-static unsigned long last_upload_attempt = 0;  // For retry delays
-static int upload_retry_count = 0;  // Track retry attempts
 
 // Write command tracking
 static command_state_t current_command = {false, 0, 0};
 static String write_status = ""; // Track if last write was successful
 static String write_executed_timestamp = ""; // Timestamp of last write execution
 
-uint8_t compressed_data[MAX_COMPRESSION_SIZE] = {0}; // Output buffer for compression
+uint8_t* compressed_data = nullptr; // Output buffer for compression, sized with the sample buffer
+size_t compressed_data_capacity = 0; // compress_bound() of the sample buffer
 size_t compressed_data_len = 0; // Length of compressed data
 compression_metrics_t compression_metrics = {0}; // Metrics of last compression
+static stream_compressor_t stream_compressors[2] = {}; // One per batch
+static stream_compressor_t* stream_compressor = &stream_compressors[0]; // Encodes the filling batch as samples arrive
+static stream_compressor_t* upload_stream = &stream_compressors[1]; // Stream of the frozen batch
+static upload_batch_t upload_batch = {0}; // Chunked upload waiting for ACKs
+static int upload_cipher = UPLOAD_CIPHER;  // Drops to CBC while the cloud refuses GCM
+static unsigned long upload_cipher_reprobe_ms = 0;  // When GCM is tried again after a fallback
 
-// Internal buffer allocation with specific size
+// Requests that failed and wait for their next attempt. scheduler_run() makes that attempt
+// once the backoff deadline has passed, so a retry never stalls the loop in delay().
+static api_retry_t read_retry = {API_RETRY_IDLE, 0, 0, ERROR_NONE};
+static api_retry_t write_retry = {API_RETRY_IDLE, 0, 0, ERROR_NONE};
+static api_retry_t upload_retry = {API_RETRY_IDLE, 0, 0, ERROR_NONE};
+static api_retry_t command_retry = {API_RETRY_IDLE, 0, 0, ERROR_NONE};
+static uint8_t pending_upload_frame[MAX_PAYLOAD_SIZE + 1];  // [flag][compressed], sealed per attempt
+static size_t pending_upload_length = 0;
+static uint8_t pending_read_frame[MODBUS_REQUEST_FRAME_SIZE];
+static size_t pending_read_length = 0;
+static uint8_t pending_write_frame[MODBUS_REQUEST_FRAME_SIZE];
+static size_t pending_write_length = 0;
+static String pending_command_result;  // Command result frame being delivered
+static unsigned long last_read_ms = 0;  // Start of the previous read poll, for the gap stats
+
+static void attempt_read(void);
+static void attempt_write(void);
+static void attempt_upload(void);
+static void attempt_command_result(void);
+static void rebuild_deadline_heap(scheduler_lane_t* lane);
+static void set_task_enabled(task_type_t type, bool enabled);
+
+// Internal buffer allocation with specific size. Samples already in the ring are kept,
+// including a batch frozen for an upload; only the per-upload buffers are resized.
 static bool allocate_buffer_internal(size_t new_size) {
     if (new_size == 0) {
         Serial.println(F("[BUFFER] Cannot allocate buffer with size 0"));
         return false;
     }
-    
-    // Free existing buffer if it exists
-    if (buffer != nullptr) {
-        free(buffer);
-        buffer = nullptr;
+    if (new_size > SAMPLE_BUFFER_MAX) {
+        new_size = SAMPLE_BUFFER_MAX;
     }
-    
-    // Allocate new buffer
-    buffer = (register_reading_t*)malloc(new_size * sizeof(register_reading_t));
-    if (buffer == nullptr) {
-        Serial.printf("[BUFFER] ERROR: Failed to allocate %zu bytes for buffer\n", 
-                     new_size * sizeof(register_reading_t));
+
+    // The ring itself is allocated once, at its largest
+    if (sample_arena == nullptr) {
+        size_t capacity = SAMPLE_BUFFER_MAX * SAMPLE_RING_BATCHES;
+        sample_arena = (register_reading_t*)malloc(capacity * sizeof(register_reading_t));
+        if (sample_arena == nullptr) {
+            Serial.printf("[BUFFER] ERROR: Failed to allocate %zu bytes for sample ring\n", 
+                         capacity * sizeof(register_reading_t));
+            buffer_size = 0;
+            return false;
+        }
+        memset(sample_arena, 0, capacity * sizeof(register_reading_t));
+        spsc_ring_init(&sample_ring, sample_arena, (uint32_t)capacity);
+    }
+
+    if (compressed_data != nullptr) {
+        free(compressed_data);
+        compressed_data = nullptr;
+        compressed_data_capacity = 0;
+        compressed_data_len = 0;
+    }
+
+    // Compression output for a full buffer, so a noisy buffer can never overrun it
+    size_t output_size = compress_bound(new_size, COMPRESSION_METHOD);
+    compressed_data = (uint8_t*)malloc(output_size);
+    if (compressed_data == nullptr) {
+        Serial.printf("[BUFFER] ERROR: Failed to allocate %zu bytes for compression output\n", output_size);
+        sample_limit = 0;
         buffer_size = 0;
         return false;
     }
-    
-    // Initialize buffer to zero
-    memset(buffer, 0, new_size * sizeof(register_reading_t));
+    compressed_data_capacity = output_size;
     buffer_size = new_size;
-    buffer_count = 0;
-    buffer_write_index = 0;
-    buffer_full = false;
+
+    // The streams are sized for one batch; what is already waiting is encoded again
+    stream_compressor = &stream_compressors[0];
+    upload_stream = &stream_compressors[1];
+    encoded_count = 0;
+    if (STREAMING_COMPRESSION) {
+        bool streaming = stream_compressor_init(stream_compressor, new_size, COMPRESSION_METHOD);
+        if (SAMPLE_DOUBLE_BUFFERING) {
+            streaming = stream_compressor_init(upload_stream, new_size, COMPRESSION_METHOD) && streaming;
+        }
+        if (!streaming) {
+            Serial.println(F("[BUFFER] Streaming compression unavailable, compressing at upload time"));
+        }
+    }
+    sample_limit = (uint32_t)(new_size * SAMPLE_RING_BATCHES);
     
-    Serial.printf("[BUFFER] Allocated dynamic buffer: %zu samples (%zu bytes)\n", 
-                 buffer_size, buffer_size * sizeof(register_reading_t));
+    Serial.printf("[BUFFER] Allocated dynamic buffer: %zu samples per upload, %u in the ring (%zu bytes), compression output %zu bytes\n", 
+                 buffer_size, (unsigned)sample_limit, sample_ring.capacity * sizeof(register_reading_t), compressed_data_capacity);
     return true;
 }
 
@@ -102,8 +195,8 @@ void allocate_buffer() {
     // Enforce reasonable limits
     if (calculated_buffer_size < 5) {
         calculated_buffer_size = 5;
-    } else if (calculated_buffer_size > 100) {
-        calculated_buffer_size = 100;
+    } else if (calculated_buffer_size > SAMPLE_BUFFER_MAX) {
+        calculated_buffer_size = SAMPLE_BUFFER_MAX;
     }
     
     Serial.printf("[BUFFER] Calculating buffer size: %ums / %ums + 1 = %zu samples\n", 
@@ -113,13 +206,22 @@ void allocate_buffer() {
 }
 
 void free_buffer() {
-    if (buffer != nullptr) {
-        free(buffer);
-        buffer = nullptr;
+    if (sample_arena != nullptr) {
+        sample_limit = 0;
+        spsc_ring_init<register_reading_t>(&sample_ring, nullptr, 0);
+        free(sample_arena);
+        sample_arena = nullptr;
         buffer_size = 0;
-        buffer_count = 0;
-        buffer_write_index = 0;
-        buffer_full = false;
+        upload_count = 0;
+        encoded_count = 0;
+        free(upload_copy);
+        upload_copy = nullptr;
+        stream_compressor_free(&stream_compressors[0]);
+        stream_compressor_free(&stream_compressors[1]);
+        free(compressed_data);
+        compressed_data = nullptr;
+        compressed_data_capacity = 0;
+        compressed_data_len = 0;
         Serial.println(F("[BUFFER] Dynamic buffer freed"));
     }
 }
@@ -130,6 +232,7 @@ void scheduler_init() {
     
     // Allocate initial buffer based on current configuration
     allocate_buffer();
+    rebuild_deadline_heap(&loop_lane);
     
     Serial.println("[SCHEDULER] Scheduler initialization complete");
 }
@@ -139,213 +242,505 @@ const PROGMEM float REGISTER_GAINS[MAX_REGISTERS] = {10.0, 10.0, 100.0, 10.0, 10
 const PROGMEM char* REGISTER_UNITS[MAX_REGISTERS] = {"V", "A", "Hz", "V", "V", "A", "A", "°C", "%", "W"};
 const PROGMEM uint16_t READ_REGISTERS[READ_REGISTER_COUNT] = {0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009};
 
-void scheduler_run(void) {
+static bool lane_has(const scheduler_lane_t* lane, task_type_t type) {
+    return (lane->task_mask & TASK_BIT(type)) != 0;
+}
+
+static scheduler_lane_t* lane_for(task_type_t type) {
+    if (!pipeline_running) {
+        return &loop_lane;
+    }
+    return (ACQUISITION_TASKS & TASK_BIT(type)) ? &acquisition_lane : &upload_lane;
+}
+
+// Make the next attempt of every failed request of the lane whose backoff has passed
+static void advance_pending_requests(scheduler_lane_t* lane, unsigned long now) {
+    if (lane_has(lane, TASK_READ_REGISTERS) && api_retry_poll(&read_retry, now)) {
+        attempt_read();
+    }
+    if (lane_has(lane, TASK_WRITE_REGISTER) && api_retry_poll(&write_retry, now)) {
+        attempt_write();
+    }
+    if (lane_has(lane, TASK_UPLOAD_DATA) && api_retry_poll(&upload_retry, now)) {
+        attempt_upload();
+    }
+    if (lane_has(lane, TASK_COMMAND_HANDLING) && api_retry_poll(&command_retry, now)) {
+        attempt_command_result();
+    }
+}
+
+static unsigned long retry_slack(const api_retry_t* retry, unsigned long now, unsigned long slack) {
+    if (retry->state != API_RETRY_WAITING) {
+        return slack;
+    }
+    long remaining = (long)(retry->next_attempt_ms - now);
+    unsigned long wait = remaining > 0 ? (unsigned long)remaining : 0;
+    return wait < slack ? wait : slack;
+}
+
+// Earlier deadline first; on a tie the task listed first in tasks[] runs first
+static bool due_before(uint8_t a, uint8_t b) {
+    long diff = (long)(tasks[a].next_due_ms - tasks[b].next_due_ms);
+    return diff < 0 || (diff == 0 && a < b);
+}
+
+static void deadline_heap_sift_down(scheduler_lane_t* lane, size_t i) {
+    while (true) {
+        size_t first = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < lane->heap_size && due_before(lane->heap[left], lane->heap[first])) {
+            first = left;
+        }
+        if (right < lane->heap_size && due_before(lane->heap[right], lane->heap[first])) {
+            first = right;
+        }
+        if (first == i) {
+            return;
+        }
+        uint8_t swap = lane->heap[i];
+        lane->heap[i] = lane->heap[first];
+        lane->heap[first] = swap;
+        i = first;
+    }
+}
+
+static void rebuild_deadline_heap(scheduler_lane_t* lane) {
+    lane->heap_size = 0;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        if (tasks[i].enabled && lane_has(lane, (task_type_t)i)) {
+            lane->heap[lane->heap_size++] = (uint8_t)i;
+        }
+    }
+    for (size_t i = lane->heap_size / 2; i-- > 0;) {
+        deadline_heap_sift_down(lane, i);
+    }
+}
+
+// Tasks switched on at run time (command result reporting) join the heap; one whose
+// deadline went by while it was off runs on the next pass
+static void set_task_enabled(task_type_t type, bool enabled) {
+    scheduler_task_t* task = &tasks[type];
+    if (task->enabled == enabled) {
+        return;
+    }
+    task->enabled = enabled;
+    unsigned long now = millis();
+    if (enabled && (long)(now - task->next_due_ms) > 0) {
+        task->next_due_ms = now;
+    }
+    rebuild_deadline_heap(lane_for(type));
+}
+
+// A new period takes effect from the latest deadline, so the phase is kept
+static void set_task_interval(task_type_t type, unsigned long interval_ms) {
+    scheduler_task_t* task = &tasks[type];
+    if (task->interval_ms == interval_ms) {
+        return;
+    }
+    task->next_due_ms = task->next_due_ms - task->interval_ms + interval_ms;
+    task->interval_ms = interval_ms;
+    rebuild_deadline_heap(lane_for(type));
+}
+
+// Records how late the task at the top of the lane's heap starts, then moves its deadline on
+// by whole periods: past the ones it is too late for, to the first one still ahead.
+static void advance_task_deadline(scheduler_lane_t* lane, unsigned long start) {
+    uint8_t i = lane->heap[0];
+    scheduler_task_t* task = &tasks[i];
+    task_timing_t* timing = &task_timing[i];
+
+    unsigned long lateness = start - task->next_due_ms;
+    if (timing->runs > 0) {
+        unsigned long jitter = lateness > timing->last_lateness_ms ? lateness - timing->last_lateness_ms
+                                                                   : timing->last_lateness_ms - lateness;
+        if (jitter > timing->max_jitter_ms) {
+            timing->max_jitter_ms = jitter;
+        }
+    }
+    if (lateness > timing->max_lateness_ms) {
+        timing->max_lateness_ms = lateness;
+    }
+    timing->last_lateness_ms = lateness;
+    timing->total_lateness_ms += lateness;
+    timing->runs++;
+
+    task->last_run_ms = start;
+    if (task->interval_ms == 0) {
+        task->next_due_ms = start;
+    } else {
+        // A blocking task (e.g. an upload retrying) can hold the loop past whole periods
+        unsigned long skipped = lateness / task->interval_ms;
+        timing->skipped_periods += skipped;
+        if (task->type == TASK_READ_REGISTERS) {
+            sample_stats.missed_polls += skipped;
+        }
+        task->next_due_ms += (skipped + 1) * task->interval_ms;
+    }
+    deadline_heap_sift_down(lane, 0);
+}
+
+// Time until the lane's earliest task or pending retry is due; 0 if one is already overdue
+static unsigned long next_deadline_slack(const scheduler_lane_t* lane, unsigned long now) {
+    unsigned long slack = ULONG_MAX;
+    if (lane->heap_size > 0) {
+        long remaining = (long)(tasks[lane->heap[0]].next_due_ms - now);
+        slack = remaining > 0 ? (unsigned long)remaining : 0;
+    }
+    if (lane_has(lane, TASK_READ_REGISTERS)) {
+        slack = retry_slack(&read_retry, now, slack);
+    }
+    if (lane_has(lane, TASK_WRITE_REGISTER)) {
+        slack = retry_slack(&write_retry, now, slack);
+    }
+    if (lane_has(lane, TASK_UPLOAD_DATA)) {
+        slack = retry_slack(&upload_retry, now, slack);
+    }
+    if (lane_has(lane, TASK_COMMAND_HANDLING)) {
+        slack = retry_slack(&command_retry, now, slack);
+    }
+    return slack == ULONG_MAX ? 0 : slack;
+}
+
+// Longest wait between watchdog feeds: half the task watchdog timeout
+static unsigned long watchdog_capped(unsigned long slack) {
+    const unsigned long watchdog_slack = WATCHDOG_TIMEOUT_S * 1000UL / 2;
+    return slack > watchdog_slack ? watchdog_slack : slack;
+}
+
+// Sleep until the next deadline, so no poll or retry is overslept. Light sleep ends early
+// by the time the last wake-up took to bring WiFi back, and the rest is waited out awake.
+// Awake waits stop in time to feed the watchdog; scheduler_run() then comes back here.
+static void idle_until_next_deadline(void) {
+    static unsigned long wake_allowance_ms = 0;
     unsigned long current_time = millis();
+    unsigned long slack = next_deadline_slack(&loop_lane, current_time);
+    if (slack == 0) {
+        return;
+    }
+    // Light sleep stops every task, so a background update is waited out awake
+    if (POWER_MANAGMENT && LIGHT_SLEEP && !fota_in_progress() && slack > wake_allowance_ms) {
+        esp_err_t timer_result = esp_sleep_enable_timer_wakeup((slack - wake_allowance_ms) * 1000); // micro_seconds
+        if (timer_result == ESP_OK){
+            Serial.println("Timer Success");
+        };
+        Serial.flush();
+        esp_err_t wakeup_result = esp_light_sleep_start(); 
+        if (wakeup_result == ESP_OK) {
+            Serial.printf("Slack: %lu\n\r", slack);
+            unsigned long wakeup_time = millis();
+            Serial.printf("Light Sleep Time: %lu\n\r", wakeup_time - current_time);
+            Serial.begin(SERIAL_BAUD_RATE);
+            wifi_init();
+            wake_allowance_ms = millis() - wakeup_time;
+            Serial.printf("Wifi Reconnection Time: %lu\n\r", wake_allowance_ms);
+        };
+        feed_watchdog();
+        slack = watchdog_capped(next_deadline_slack(&loop_lane, millis()));
+        if (slack > 0) {
+            delay(slack);
+        }
+    } else {
+        delay(watchdog_capped(slack));
+    };
+}
+
+// Resize the sample buffer when the cloud changed the upload or sampling interval
+static void reallocate_buffer_on_config_change(void) {
+    uint32_t upload_interval = config_get_upload_interval_ms();
+    uint32_t sampling_interval = config_get_sampling_interval_ms();
     
-    // Update task intervals from ConfigManager if available
-    if (g_config_manager && g_config_manager->is_initialized()) {
-        tasks[TASK_READ_REGISTERS].interval_ms = config_get_sampling_interval_ms();
-        tasks[TASK_UPLOAD_DATA].interval_ms = config_get_upload_interval_ms();
-        // Couple command interval to upload interval for synchronized timing
-        tasks[TASK_COMMAND_HANDLING].interval_ms = config_get_upload_interval_ms();
+    if (upload_interval != last_upload_interval || sampling_interval != last_sampling_interval || sample_arena == nullptr) {
+        // Configuration changed or buffer not allocated - reallocate buffer
+        Serial.printf("[BUFFER] Config changed: upload %u->%u, sampling %u->%u\n", 
+                     last_upload_interval, upload_interval, last_sampling_interval, sampling_interval);
         
-        // Recalculate buffer size only when configuration changes
-        uint32_t upload_interval = config_get_upload_interval_ms();
-        uint32_t sampling_interval = config_get_sampling_interval_ms();
+        size_t calculated_buffer_size = (upload_interval / sampling_interval) + 2; // +2 for safety margin
         
-        if (upload_interval != last_upload_interval || sampling_interval != last_sampling_interval || buffer == nullptr) {
-            // Configuration changed or buffer not allocated - reallocate buffer
-            Serial.printf("[BUFFER] Config changed: upload %u->%u, sampling %u->%u\n", 
-                         last_upload_interval, upload_interval, last_sampling_interval, sampling_interval);
-            
-            size_t calculated_buffer_size = (upload_interval / sampling_interval) + 2; // +2 for safety margin
-            
-            // Set reasonable limits
-            if (calculated_buffer_size < 5) calculated_buffer_size = 5;   // Minimum 5 samples
-            if (calculated_buffer_size > 100) calculated_buffer_size = 100; // Maximum 100 samples
-            
-            Serial.printf("[BUFFER] Calculation: %u / %u + 2 = %zu\n", 
-                         upload_interval, sampling_interval, calculated_buffer_size);
-            
-            // Reallocate buffer with new size
-            if (allocate_buffer_internal(calculated_buffer_size)) {
-                last_upload_interval = upload_interval;
-                last_sampling_interval = sampling_interval;
-                Serial.printf("[BUFFER] Dynamic buffer allocated: %zu samples (upload: %us, sampling: %us)\n\r", 
-                             buffer_size, upload_interval/1000, sampling_interval/1000);
-            } else {
-                Serial.println(F("[BUFFER] ERROR: Failed to allocate dynamic buffer, using fallback"));
-                // Keep old values to prevent infinite reallocation attempts
-            }
+        // Set reasonable limits
+        if (calculated_buffer_size < 5) calculated_buffer_size = 5;   // Minimum 5 samples
+        if (calculated_buffer_size > SAMPLE_BUFFER_MAX) calculated_buffer_size = SAMPLE_BUFFER_MAX; // Maximum samples per upload
+        
+        Serial.printf("[BUFFER] Calculation: %u / %u + 2 = %zu\n", 
+                     upload_interval, sampling_interval, calculated_buffer_size);
+        
+        // Reallocate buffer with new size
+        if (allocate_buffer_internal(calculated_buffer_size)) {
+            last_upload_interval = upload_interval;
+            last_sampling_interval = sampling_interval;
+            Serial.printf("[BUFFER] Dynamic buffer allocated: %zu samples (upload: %us, sampling: %us)\n\r", 
+                         buffer_size, upload_interval/1000, sampling_interval/1000);
+        } else {
+            Serial.println(F("[BUFFER] ERROR: Failed to allocate dynamic buffer, using fallback"));
+            // Keep old values to prevent infinite reallocation attempts
         }
     }
+}
 
-    for (int i = 0; i < TASK_COUNT; i++) {
-        if (!tasks[i].enabled) {
-            continue;
+// Feed the samples that arrived since the last call to the stream of the filling batch, so
+// an upload only has to flush it. A batch is at most buffer_size samples; later ones wait
+// for the next stream. Without double buffering the one stream belongs to the frozen batch.
+static void encode_new_samples(void) {
+    if ((!SAMPLE_DOUBLE_BUFFERING && upload_count > 0) || encoded_count >= buffer_size) {
+        return;
+    }
+    const register_reading_t* first;
+    const register_reading_t* second;
+    size_t first_count;
+    size_t count = spsc_ring_peek(&sample_ring, upload_count + encoded_count, buffer_size - encoded_count,
+                                  &first, &first_count, &second);
+    for (size_t i = 0; i < count; i++) {
+        stream_compressor_add(stream_compressor, i < first_count ? &first[i] : &second[i - first_count]);
+    }
+    encoded_count += count;
+}
+
+// One pass over a lane: interval changes from the config, due retries, then the tasks
+// whose deadline has passed. The lane with the upload task is also the consumer of the
+// sample ring and owns the FOTA result.
+static void run_lane(scheduler_lane_t* lane) {
+    unsigned long current_time = millis();
+    bool owns_samples = lane_has(lane, TASK_UPLOAD_DATA);
+    
+    // Update task intervals from ConfigManager if available
+    if (g_config_manager && g_config_manager->is_initialized()) {
+        if (lane_has(lane, TASK_READ_REGISTERS)) {
+            set_task_interval(TASK_READ_REGISTERS, config_get_sampling_interval_ms());
         }
-        
-        if (current_time - tasks[i].last_run_ms >= tasks[i].interval_ms) {
-            // Update last_run_ms BEFORE executing task to prevent re-triggering
-            tasks[i].last_run_ms = current_time;
+        if (owns_samples) {
+            set_task_interval(TASK_UPLOAD_DATA, config_get_upload_interval_ms());
+            // Couple command interval to upload interval for synchronized timing
+            set_task_interval(TASK_COMMAND_HANDLING, config_get_upload_interval_ms());
             
-            switch (tasks[i].type) {
-                case TASK_READ_REGISTERS:
-                    execute_read_task();
-                    if (POWER_MANAGMENT) {
-                        current_time = millis();
-                        unsigned long read_slack = tasks[i].interval_ms - (current_time - tasks[i].last_run_ms);
-                        unsigned long upload_slack = tasks[2].interval_ms - (current_time - tasks[2].last_run_ms);
-                        if (read_slack > 0 && upload_slack > 0) {
-                            if (read_slack < upload_slack) {
-                                if (LIGHT_SLEEP) {
-                                    esp_err_t timer_result = esp_sleep_enable_timer_wakeup(read_slack * 1000); // micro_seconds
-                                    if (timer_result == ESP_OK){
-                                        Serial.println("Timer Success");
-                                    };
-                                    Serial.flush();
-                                    esp_err_t wakeup_result = esp_light_sleep_start(); 
-                                    if (wakeup_result == ESP_OK) {
-                                        Serial.printf("Read Slack: %lu\n\r", read_slack);
-                                        unsigned long wakeup_time = millis();
-                                        Serial.printf("Light Sleep Time: %lu\n\r", wakeup_time - current_time);
-                                        Serial.begin(SERIAL_BAUD_RATE);
-                                        wifi_init();
-                                        Serial.printf("Wifi Reconnection Time: %lu\n\r", millis() - wakeup_time);
-                                    };
-                                } else if (IDLE_DELAY) {
-                                    delay(read_slack);
-                                };
-                            } else {
-                                if (LIGHT_SLEEP) {
-                                    esp_sleep_enable_timer_wakeup(upload_slack * 1000); // micro_seconds
-                                    Serial.flush();
-                                    esp_light_sleep_start();
-                                    Serial.begin(SERIAL_BAUD_RATE);
-                                    wifi_init();
-                                } else if (IDLE_DELAY) {
-                                    delay(upload_slack);
-                                };
-                            };                        
-                        };
-                    };
-                    break;
-                case TASK_COMMAND_HANDLING:
-                    execute_command_task();
-                    break;
-                case TASK_UPLOAD_DATA:
-                    execute_upload_task();
-                    if (POWER_MANAGMENT) {
-                        current_time = millis();
-                        unsigned long read_slack = tasks[i].interval_ms - (current_time - tasks[i].last_run_ms);
-                        if (read_slack > 0) {
-                            if (LIGHT_SLEEP) {
-                                esp_sleep_enable_timer_wakeup(read_slack * 1000); // micro_seconds
-                                Serial.flush();
-                                esp_light_sleep_start();
-                                Serial.begin(SERIAL_BAUD_RATE);
-                                wifi_init();
-                            } else if (IDLE_DELAY) {
-                                delay(read_slack);
-                            };                     
-                        };
-                    };
-                    break;
-                // FOTA task removed - now handled in upload response
-                // WRITE task removed - now executes immediately when command received
-                default:
-                    break;
-            }
+            // Recalculate buffer size only when configuration changes
+            reallocate_buffer_on_config_change();
+        }
+    }
+
+    if (owns_samples) {
+        encode_new_samples();
+    }
+
+    advance_pending_requests(lane, current_time);
+
+    if (owns_samples) {
+        switch (fota_poll()) {
+            case FOTA_SUCCEEDED:
+                Serial.println(F("[FOTA] Update successful - restarting in 2 seconds..."));
+                delay(2000);
+                ESP.restart();
+                break;
+            case FOTA_FAILED:
+                Serial.println(F("[FOTA] Update failed - continuing normal operation"));
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Run the tasks whose deadline has passed, earliest first; each at most once per call,
+    // so tasks that overrun their period still let the loop feed the watchdog
+    for (size_t runs = 0; runs < lane->heap_size; runs++) {
+        scheduler_task_t* task = &tasks[lane->heap[0]];
+        if ((long)(current_time - task->next_due_ms) < 0) {
+            break;
         }
+        // Move the deadline on BEFORE executing the task to prevent re-triggering
+        advance_task_deadline(lane, current_time);
+
+        switch (task->type) {
+            case TASK_READ_REGISTERS:
+                execute_read_task();
+                break;
+            case TASK_COMMAND_HANDLING:
+                execute_command_task();
+                break;
+            case TASK_UPLOAD_DATA:
+                execute_upload_task();
+                break;
+            // FOTA task removed - now handled in upload response
+            // WRITE task removed - now executes immediately when command received
+            default:
+                break;
+        }
+        current_time = millis();
     }
     
     // Feed watchdog
     feed_watchdog();
 }
 
+void scheduler_run(void) {
+    run_lane(&loop_lane);
 
-void store_register_reading(const uint16_t* values, size_t count) {
-    // Check if buffer is allocated
-    if (buffer == nullptr || buffer_size == 0) {
-        Serial.println(F("[BUFFER] ERROR: Buffer not allocated, skipping sample"));
+    // Nothing is due before the earliest deadline, so sleep until then
+    idle_until_next_deadline();
+}
+
+// Block until the lane's next deadline or a notification (a new reading, or a stop).
+// Light sleep is left to the power manager, which enters it once both cores are idle.
+static void wait_for_next_deadline(const scheduler_lane_t* lane) {
+    unsigned long slack = watchdog_capped(next_deadline_slack(lane, millis()));
+    if (slack > 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(slack));
+    }
+}
+
+static void acquisition_task(void* parameters) {
+    (void)parameters;
+    esp_task_wdt_add(NULL);
+    while (!pipeline_stop_requested) {
+        run_lane(&acquisition_lane);
+        wait_for_next_deadline(&acquisition_lane);
+    }
+    esp_task_wdt_delete(NULL);
+    acquisition_task_running = false;
+    vTaskDelete(NULL);
+}
+
+static void upload_task(void* parameters) {
+    (void)parameters;
+    esp_task_wdt_add(NULL);
+    while (!pipeline_stop_requested) {
+        run_lane(&upload_lane);
+        wait_for_next_deadline(&upload_lane);
+    }
+    esp_task_wdt_delete(NULL);
+    upload_task_running = false;
+    vTaskDelete(NULL);
+}
+
+bool scheduler_start_pipeline(void) {
+    if (pipeline_running) {
+        return true;
+    }
+    pipeline_stop_requested = false;
+    pipeline_running = true;
+    rebuild_deadline_heap(&acquisition_lane);
+    rebuild_deadline_heap(&upload_lane);
+
+    // The upload task goes first, so its handle is set before the first reading is stored
+    upload_task_running = true;
+    if (xTaskCreatePinnedToCore(upload_task, "upload", UPLOAD_TASK_STACK, NULL, UPLOAD_TASK_PRIORITY,
+                                &upload_task_handle, UPLOAD_TASK_CORE) != pdPASS) {
+        Serial.println(F("[SCHEDULER] Unable to start the upload task"));
+        upload_task_running = false;
+        pipeline_running = false;
+        rebuild_deadline_heap(&loop_lane);
+        return false;
+    }
+    acquisition_task_running = true;
+    if (xTaskCreatePinnedToCore(acquisition_task, "acquisition", ACQUISITION_TASK_STACK, NULL, ACQUISITION_TASK_PRIORITY,
+                                &acquisition_task_handle, ACQUISITION_TASK_CORE) != pdPASS) {
+        Serial.println(F("[SCHEDULER] Unable to start the acquisition task"));
+        acquisition_task_running = false;
+        scheduler_stop_pipeline();
+        return false;
+    }
+    Serial.printf("[SCHEDULER] Pipeline started: acquisition on core %d, upload on core %d, ring of %u samples\n",
+                  ACQUISITION_TASK_CORE, UPLOAD_TASK_CORE, (unsigned)sample_limit);
+    return true;
+}
+
+bool scheduler_pipeline_running(void) {
+    return pipeline_running;
+}
+
+void scheduler_stop_pipeline(void) {
+    if (!pipeline_running) {
         return;
     }
-    
-    // Always stop filling buffer during upload (workflow requirement)
-    if (upload_in_progress) {
-        Serial.println(F("[BUFFER] Skipping sample - upload in progress"));
+    pipeline_stop_requested = true;
+    if (acquisition_task_running) {
+        xTaskNotifyGive(acquisition_task_handle);
+    }
+    if (upload_task_running) {
+        xTaskNotifyGive(upload_task_handle);
+    }
+    // Each task finishes the request it is making first
+    while (acquisition_task_running || upload_task_running) {
+        delay(10);
+    }
+    pipeline_running = false;
+    rebuild_deadline_heap(&loop_lane);
+    Serial.println(F("[SCHEDULER] Pipeline stopped, tasks run from scheduler_run()"));
+}
+
+
+// Producer side of the sample ring: the read task, from scheduler_run() or the acquisition task
+void store_register_reading(const uint16_t* values, size_t count) {
+    uint32_t limit = sample_limit;
+    if (limit == 0) {
+        Serial.println(F("[BUFFER] ERROR: Buffer not allocated, skipping sample"));
         return;
     }
     
-    // Check buffer full behavior when not uploading
-    if (buffer_full) {
+    // The oldest samples may belong to an upload awaiting its ACK, so they are never
+    // overwritten here; with CIRCULAR the next upload skips them instead
+    if (spsc_ring_size(&sample_ring) >= limit) {
         #if BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_STOP
             Serial.println(F("[BUFFER] Buffer full - stopping new acquisitions until upload"));
-            return;
         #elif BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_CIRCULAR
-            Serial.println(F("[BUFFER] Buffer full - overwriting oldest data (circular buffer)"));
-            // Continue with circular buffer behavior
+            Serial.println(F("[BUFFER] Buffer full - dropping reading until the pending upload is ACKed"));
         #endif
+        sample_stats.dropped_full++;
+        return;
     }
     
     if (count > READ_REGISTER_COUNT) {
         count = READ_REGISTER_COUNT;
     }
 
-    register_reading_t* reading = &buffer[buffer_write_index];
+    register_reading_t reading;
 
     // Copy values to the current reading
     for (size_t i = 0; i < count; i++) {
-        reading->values[i] = values[i];
+        reading.values[i] = values[i];
     }
     
     // Fill remaining with zeros
     for (size_t i = count; i < READ_REGISTER_COUNT; i++) {
-        reading->values[i] = 0;
+        reading.values[i] = 0;
     }
 
-    // Advance write index (circular buffer)
-    buffer_write_index = (buffer_write_index + 1) % buffer_size;
-
-    // Track buffer usage
-    if (!buffer_full) {
-        buffer_count++;
-        if (buffer_count >= buffer_size) {
-            buffer_full = true;
-            #if BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_CIRCULAR
-                Serial.println(F("[BUFFER] Buffer full - using circular overwrite"));
-            #elif BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_STOP
-                Serial.println(F("[BUFFER] Buffer full - will stop acquisitions"));
-            #endif
-        }
-    }
+    // Only this side pushes, so the space checked above is still free
+    spsc_ring_push(&sample_ring, &reading);
+    sample_stats.stored++;
 
-    if (buffer_count % buffer_size == 0 || buffer_full) {  // Log every buffer_size samples or when full
+    size_t waiting = spsc_ring_size(&sample_ring);
+    if (waiting >= limit) {  // Log when full
         Serial.print(F("[BUFFER] Samples: "));
-        Serial.print(buffer_count);
+        Serial.print(waiting);
         Serial.print(F("/"));
-        Serial.print(buffer_size);
-        Serial.print(F(" (write_index: "));
-        Serial.print(buffer_write_index);
+        Serial.print(limit);
         #if BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_CIRCULAR
-            Serial.println(F(", behavior: CIRCULAR"));
+            Serial.println(F(" (behavior: CIRCULAR)"));
         #elif BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_STOP
-            Serial.println(F(", behavior: STOP"));
+            Serial.println(F(" (behavior: STOP)"));
         #endif
-        // Serial.println(F(")"));
-        // for (size_t i = 0; i < buffer_count; i++) {
-        //         for (size_t j = 0; j < READ_REGISTER_COUNT; j++) {
-        //             Serial.print(buffer[i].values[j]);
-        //             Serial.print(F(" "));
-        //         }
-        //         Serial.println(F("|"));
-        //     }
     }
 }
 
 
 void execute_read_task(void) {
     Serial.println(F("Executing read task..."));
+
+    unsigned long now = millis();
+    sample_stats.polls++;
+    if (last_read_ms != 0) {
+        unsigned long gap = now - last_read_ms;
+        if (gap > sample_stats.max_read_gap_ms) {
+            sample_stats.max_read_gap_ms = gap;
+        }
+        if (gap > tasks[TASK_READ_REGISTERS].interval_ms + tasks[TASK_READ_REGISTERS].interval_ms / 2) {
+            sample_stats.late_reads++;
+        }
+    }
+    last_read_ms = now;
+
+    if (read_retry.state == API_RETRY_WAITING) {
+        Serial.println(F("[READ] Previous poll still retrying, replacing it"));
+    }
     
     // Get current configuration
     uint8_t slave_addr = config_get_slave_address();
@@ -357,42 +752,57 @@ void execute_read_task(void) {
     uint16_t start_register = (register_count > 0) ? active_registers[0] : pgm_read_word(&READ_REGISTERS[0]);
     
     // Generate read frame
-    String frame = format_request_frame(slave_addr, FUNCTION_CODE_READ, start_register, register_count);
-    frame = append_crc_to_frame(frame);
-    
-    String url;
-    url.reserve(128);
-    url = API_BASE_URL;
-    url += "/api/inverter/read";
-    String method = "POST";
-    String api_key = API_KEY;
-    String response = api_send_request_with_retry(url, method, api_key, frame);
-    
-    if (response.length() > 0) {
-        uint16_t read_values[READ_REGISTER_COUNT];
-        size_t actual_count;
+    pending_read_length = modbus_build_request(pending_read_frame, sizeof(pending_read_frame), slave_addr, FUNCTION_CODE_READ, start_register, register_count);
 
-        if (decode_response_registers(response, read_values, READ_REGISTER_COUNT, &actual_count)) {
-            // Store raw values
-            store_register_reading(read_values, actual_count);
-            
-            // Display processed values
-            for (size_t i = 0; i < actual_count; i++) {
-                float gain = pgm_read_float(&REGISTER_GAINS[i]);
-                const char* unit = (const char*)pgm_read_ptr(&REGISTER_UNITS[i]);
-                float processed_value = read_values[i] / gain;
-                
-                Serial.print(F("R"));
-                Serial.print(i);
-                Serial.print(F(":"));
-                Serial.print(processed_value);
-                Serial.print(unit);
-                Serial.print(F(" "));
-            }
-            Serial.println();
+    api_retry_start(&read_retry, now);
+    attempt_read();
+}
+
+// One attempt at the pending read poll. A failed attempt is repeated from scheduler_run()
+// after the backoff, unless that would run into the next poll.
+static void attempt_read(void) {
+    uint8_t response[MODBUS_MAX_FRAME_SIZE];
+    size_t response_length = 0;
+    bool ok = api_send_frame(API_BASE_URL "/api/inverter/read", API_KEY, pending_read_frame, pending_read_length, response, sizeof(response), &response_length);
+    api_retry_state_t state = api_retry_record(&read_retry, ok, millis(), API_BASE_URL "/api/inverter/read");
+    if (state == API_RETRY_WAITING) {
+        unsigned long next_poll = tasks[TASK_READ_REGISTERS].next_due_ms;
+        if ((long)(read_retry.next_attempt_ms - next_poll) >= 0) {
+            Serial.println(F("[READ] Next poll is due first, dropping retry"));
+            read_retry.state = API_RETRY_FAILED;
+        }
+        return;
+    }
+    if (state != API_RETRY_DONE) {
+        return;
+    }
+
+    uint16_t read_values[READ_REGISTER_COUNT];
+    size_t actual_count;
+
+    if (modbus_decode_registers(response, response_length, read_values, READ_REGISTER_COUNT, &actual_count)) {
+        // Store raw values; in the pipeline the upload task encodes them as they arrive
+        store_register_reading(read_values, actual_count);
+        if (pipeline_running) {
+            xTaskNotifyGive(upload_task_handle);
+        }
+        
+        // Display processed values
+        for (size_t i = 0; i < actual_count; i++) {
+            float gain = pgm_read_float(&REGISTER_GAINS[i]);
+            const char* unit = (const char*)pgm_read_ptr(&REGISTER_UNITS[i]);
+            float processed_value = read_values[i] / gain;
             
-            reset_error_state();
+            Serial.print(F("R"));
+            Serial.print(i);
+            Serial.print(F(":"));
+            Serial.print(processed_value);
+            Serial.print(unit);
+            Serial.print(F(" "));
         }
+        Serial.println();
+        
+        reset_error_state();
     }
 }
 
@@ -401,7 +811,11 @@ void execute_write_task(void) {
     
     if (!current_command.pending) {
         Serial.println(F("[WRITE] No pending command - skipping"));
-        tasks[TASK_WRITE_REGISTER].enabled = false;
+        set_task_enabled(TASK_WRITE_REGISTER, false);
+        return;
+    }
+    if (write_retry.state == API_RETRY_WAITING) {
+        Serial.println(F("[WRITE] Write still retrying - skipping"));
         return;
     }
     
@@ -414,31 +828,35 @@ void execute_write_task(void) {
         return;
     }
 
-    String frame = format_request_frame(SLAVE_ADDRESS, FUNCTION_CODE_WRITE, target_register, export_power_value);
+    pending_write_length = modbus_build_request(pending_write_frame, sizeof(pending_write_frame), SLAVE_ADDRESS, FUNCTION_CODE_WRITE, target_register, export_power_value);
 
-    frame = append_crc_to_frame(frame);
-    
-    String url;
-    url.reserve(128);
-    url = API_BASE_URL;
-    url += "/api/inverter/write";
-    String method = "POST";
-    String api_key = API_KEY;
-    String response = api_send_request_with_retry(url, method, api_key, frame);
-    
-    if (response.length() > 0) {
-        if (validate_modbus_response(response)) {
-            if (is_exception_response(response)) {
-                uint8_t exception_code = get_exception_code(response);
+    api_retry_start(&write_retry, millis());
+    attempt_write();
+}
+
+// One attempt at the pending register write; retried from scheduler_run() after the backoff
+static void attempt_write(void) {
+    uint8_t response[MODBUS_MAX_FRAME_SIZE];
+    size_t response_length = 0;
+    bool ok = api_send_frame(API_BASE_URL "/api/inverter/write", API_KEY, pending_write_frame, pending_write_length, response, sizeof(response), &response_length);
+    api_retry_state_t state = api_retry_record(&write_retry, ok, millis(), API_BASE_URL "/api/inverter/write");
+    if (state == API_RETRY_WAITING) {
+        return;
+    }
+
+    if (state == API_RETRY_DONE) {
+        if (modbus_validate_response(response, response_length)) {
+            if (modbus_is_exception(response, response_length)) {
+                uint8_t exception_code = modbus_exception_code(response, response_length);
                 char error_msg[64];
                 snprintf(error_msg, sizeof(error_msg), "Write failed with exception: 0x%02X", exception_code);
                 log_error(ERROR_MODBUS_EXCEPTION, error_msg);
                 finalize_command("Failed - Exception");
             } else {
                 Serial.print(F("Write successful: Register "));
-                Serial.print(target_register);
+                Serial.print(current_command.register_address);
                 Serial.print(F(" set to "));
-                Serial.println(export_power_value);
+                Serial.println(current_command.value);
                 finalize_command("Success");
             }
         } else {
@@ -449,78 +867,474 @@ void execute_write_task(void) {
     }
 }
 
-void execute_upload_task(void) {
-    upload_in_progress = true;  // Prevent buffer filling during upload
+// Bytes seal_upload_frame adds to a frame, at most: CRC (2), PKCS#7 padding (up to 16) and
+// the IV (16) in CBC mode; IV (12) and tag (16) in GCM mode
+#define UPLOAD_SEAL_OVERHEAD 34
 
-    bool use_aggregation = false;
+// Nonce, encryption and authentication for one upload frame, in the current upload_cipher.
+// sealed must hold frame_length + UPLOAD_SEAL_OVERHEAD bytes. CBC: it receives IV +
+// ciphertext of frame + CRC, and mac the HMAC. GCM: it receives IV + ciphertext + tag, with
+// the nonce header text as associated data, and mac is left empty. *encryption is set to
+// the encryption header value.
+static bool seal_upload_frame(const uint8_t* frame, size_t frame_length, uint8_t* sealed, size_t* sealed_length, uint32_t* nonce, String& mac, const char** encryption) {
+    if (upload_cipher != UPLOAD_CIPHER && (long)(millis() - upload_cipher_reprobe_ms) >= 0) {
+        // The cloud may support GCM by now; a refusal falls back again
+        upload_cipher = UPLOAD_CIPHER;
+        Serial.println(F("[ENCRYPTION] Trying AES-GCM again"));
+    }
+    if (upload_cipher == UPLOAD_CIPHER_GCM) {
+        *nonce = nonceManager.getAndIncrementNonce();
+        if (*nonce == 0) {
+            return false;
+        }
+        char aad[11];
+        snprintf(aad, sizeof(aad), "%lu", (unsigned long)*nonce);
+
+        // IV, then ciphertext, then tag: a single pass, no CRC, padding or HMAC
+        if (!encryptPayloadAES_GCM(frame, frame_length, (const uint8_t*)aad, strlen(aad),
+                                   sealed + GCM_IV_LENGTH, sealed, sealed + GCM_IV_LENGTH + frame_length)) {
+            return false;
+        }
+        *sealed_length = GCM_IV_LENGTH + frame_length + GCM_TAG_LENGTH;
+        mac = "";
+        *encryption = "aes-256-gcm";
+        Serial.printf("[ENCRYPTION] Final payload: IV(%d) + Ciphertext(%u) + Tag(%d) = %u bytes\n",
+                      GCM_IV_LENGTH, (unsigned)frame_length, GCM_TAG_LENGTH, (unsigned)*sealed_length);
+        return true;
+    }
+
+    *encryption = "aes-256-cbc";
+    // Add CRC for entire frame
+    uint8_t upload_frame_with_crc[frame_length + 2]; // metadata + data + CRC
+    append_crc_to_upload_frame(frame, frame_length, upload_frame_with_crc);
     
-    // Check if we have data to upload
-    if (buffer_count == 0) {
-        Serial.println(F("[COMPRESSION] No data to compress and upload"));
-        upload_in_progress = false;  // Re-enable filling
+    Serial.print(F("[UPLOAD] Frame with CRC: "));
+    Serial.print(frame_length);
+    Serial.print(F(" bytes + 2 bytes CRC = "));
+    Serial.print(frame_length + 2);
+    Serial.println(F(" bytes total"));
+    
+    // === AES-256-CBC ENCRYPTION ===
+    uint8_t iv[16]; // 16-byte IV for AES
+    size_t encrypted_len = 0;
+    
+    Serial.println(F("[ENCRYPTION] Encrypting payload with AES-256-CBC..."));
+    
+    if (!encryptPayloadAES_CBC(upload_frame_with_crc, frame_length + 2,
+                              sealed + 16, &encrypted_len, iv)) {
+        return false;
+    }
+    
+    // Final payload: IV followed by the ciphertext
+    memcpy(sealed, iv, 16); // First 16 bytes: IV
+    *sealed_length = 16 + encrypted_len;
+    
+    Serial.printf("[ENCRYPTION] Final encrypted payload: IV(16) + Ciphertext(%u) = %u bytes\n",
+                 (unsigned)encrypted_len, (unsigned)*sealed_length);
+
+    // Get a unique nonce for this transaction
+    *nonce = nonceManager.getAndIncrementNonce();
+    if (*nonce == 0) {
+        return false;
+    }
+    Serial.print(F("[SECURITY] Using Nonce: "));
+    Serial.println(*nonce);
+
+    // MAC over the payload in place; the format is announced in the mac-version header
+    mac_context_t mac_ctx;
+    char mac_hex[MAC_HEX_LENGTH + 1];
+    if (!mac_init_upload(&mac_ctx)) {
+        return false;
+    }
+#if UPLOAD_MAC_VERSION == MAC_VERSION_BASE64
+    bool fed = mac_update_base64(&mac_ctx, sealed, *sealed_length);
+#else
+    bool fed = mac_update(&mac_ctx, sealed, 16) &&                    // IV
+               mac_update(&mac_ctx, sealed + 16, encrypted_len);      // Ciphertext
+#endif
+    if (!mac_final(&mac_ctx, mac_hex) || !fed) {
+        Serial.println(F("[SECURITY] MAC generation failed"));
+        return false;
+    }
+    mac = mac_hex;
+    Serial.print(F("[SECURITY] Generated MAC (v"));
+    Serial.print(UPLOAD_MAC_VERSION);
+    Serial.print(F("): "));
+    Serial.println(mac);
+    return true;
+}
+
+// The cloud answers 415, or 400 with "unsupported encryption" in the body, to an encryption
+// mode it does not support; any other 400 is about the request itself. After such an answer
+// to a GCM frame uploads fall back to CBC, starting with the retry, for
+// UPLOAD_CIPHER_REPROBE_MS.
+static void check_upload_cipher_refused(const String& response) {
+    if (response.length() > 0 || upload_cipher != UPLOAD_CIPHER_GCM) {
+        return;
+    }
+    api_request_info_t info = api_get_last_request_to(API_HOST_CLOUD);
+    if (info.http_code == 415 || (info.http_code == 400 && info.encryption_unsupported)) {
+        upload_cipher = UPLOAD_CIPHER_CBC;
+        upload_cipher_reprobe_ms = millis() + UPLOAD_CIPHER_REPROBE_MS;
+        Serial.printf("[ENCRYPTION] Cloud refused AES-GCM (HTTP %d), falling back to AES-256-CBC\n", info.http_code);
+    }
+}
+
+// Pick the samples this upload sends: the oldest batch in the ring, at most buffer_size.
+// They stay in the ring until release_upload_samples(), so a failed upload keeps its frozen
+// batch for the retry. With double buffering the filled stream goes with the batch and later
+// samples start the other one.
+static void freeze_upload_samples(void) {
+    if (upload_count > 0) {
+        return;  // Retry of the frozen batch
+    }
+
+#if BUFFER_FULL_BEHAVIOR == BUFFER_FULL_BEHAVIOR_CIRCULAR
+    size_t waiting = spsc_ring_size(&sample_ring);
+    if (waiting > buffer_size) {
+        // Keep the newest samples, as overwriting the oldest would have
+        size_t skipped = waiting - buffer_size;
+        spsc_ring_commit(&sample_ring, skipped);
+        sample_stats.overwritten += skipped;
+        Serial.printf("[BUFFER] Buffer full - skipping %zu oldest samples (circular buffer)\n", skipped);
+        stream_compressor_reset(stream_compressor);
+        encoded_count = 0;
+    }
+#endif
+
+    // Everything encoded so far is the batch; later samples belong to the next one
+    encode_new_samples();
+    upload_count = encoded_count;
+    if (upload_count == 0) {
         return;
     }
+#if SAMPLE_DOUBLE_BUFFERING
+    stream_compressor_t* filled_stream = stream_compressor;
+    stream_compressor = upload_stream;
+    upload_stream = filled_stream;
+    encoded_count = 0;
+#else
+    upload_stream = stream_compressor;
+#endif
+}
+
+// The frozen batch as one array, for the batch encoder and chunking. It is used in place
+// unless it wraps the end of the ring; then it is copied out once for all attempts.
+static const register_reading_t* upload_samples(void) {
+    const register_reading_t* first;
+    const register_reading_t* second;
+    size_t first_count;
+    spsc_ring_peek(&sample_ring, 0, upload_count, &first, &first_count, &second);
+    if (first_count == upload_count) {
+        return first;
+    }
+    if (upload_copy == nullptr) {
+        upload_copy = (register_reading_t*)malloc(upload_count * sizeof(register_reading_t));
+        if (upload_copy == nullptr) {
+            Serial.println(F("[BUFFER] ERROR: Failed to allocate a copy of the upload batch"));
+            return nullptr;
+        }
+        memcpy(upload_copy, first, first_count * sizeof(register_reading_t));
+        memcpy(upload_copy + first_count, second, (upload_count - first_count) * sizeof(register_reading_t));
+    }
+    return upload_copy;
+}
+
+// Drop the frozen samples once they are safely with the cloud (or held by a chunk batch)
+static void release_upload_samples(void) {
+    spsc_ring_commit(&sample_ring, upload_count);
+    stream_compressor_reset(upload_stream);
+    upload_count = 0;
+#if !SAMPLE_DOUBLE_BUFFERING
+    encoded_count = 0;  // The stream was the batch's; it starts over on what has arrived since
+#endif
+    free(upload_copy);
+    upload_copy = nullptr;
+}
+
+// Execute a command the cloud piggybacked on an upload response
+static void handle_cloud_command(const cloud_response_t& parsed) {
+    String action;
+    uint16_t reg = 0;
+    uint16_t val = 0;
+
+    if (parse_command_from_json(parsed.command, action, reg, val)) {
+        Serial.println(F("[COMMAND] Command detected in cloud response"));
+        
+        if (action.equalsIgnoreCase("write_register")) {
+            Serial.println(F("[COMMAND] Executing WRITE command immediately"));
+
+            // Store command atomically
+            current_command.pending = true;
+            current_command.register_address = reg;
+            current_command.value = val;
+            
+            // Execute write immediately (no need to wait for scheduler interval)
+            execute_write_task();
+            
+            // Command task will report result on next interval
+            set_task_enabled(TASK_COMMAND_HANDLING, true);
+
+        } else if (action.equalsIgnoreCase("read_register")) {
+            Serial.println(F("[COMMAND] Preparing to execute READ task"));
+
+        } else {
+            Serial.println(F("[COMMAND] Unknown action command received"));
+        }
+    }
+}
+
+// Config updates and FOTA manifest carried by an upload ACK
+static void handle_upload_ack(const cloud_response_t& parsed) {
+    // STEP 1: Process configuration updates from cloud response
+    String config_ack = config_process_config_update(parsed.config_update);
+    if (config_ack.length() > 0) {
+        // Send configuration acknowledgment to cloud
+        extern void send_config_ack_to_cloud(const String& ack_json);
+        send_config_ack_to_cloud(config_ack);
+        // Note: ACK failure doesn't prevent config application
+    }
     
-    // Check retry delay if previous upload failed
-    unsigned long current_time = millis();
-    if (upload_retry_count > 0) {
-        unsigned long retry_delay = RETRY_BASE_DELAY_MS * (1 << (upload_retry_count - 1));
-        if (retry_delay > MAX_RETRY_DELAY_MS) retry_delay = MAX_RETRY_DELAY_MS;
+    // STEP 2: Apply any pending configuration changes after successful upload
+    if (config_has_pending_changes()) {
+        Serial.println(F("[CONFIG] Applying pending configuration changes"));
         
-        if (current_time - last_upload_attempt < retry_delay) {
-            Serial.print(F("[UPLOAD] Waiting for retry delay: "));
-            Serial.print((retry_delay - (current_time - last_upload_attempt)) / 1000);
-            Serial.println(F("s remaining"));
-            return;
+        // Feed watchdog before potentially blocking operation
+        esp_task_wdt_reset();
+        
+        // Apply with timeout protection
+        bool apply_success = false;
+        unsigned long apply_start = millis();
+        const unsigned long APPLY_TIMEOUT = 5000; // 5 seconds max
+        
+        try {
+            config_apply_pending_changes();
+            apply_success = true;
+            Serial.println(F("[CONFIG] Configuration applied successfully"));
+        } catch (...) {
+            Serial.println(F("[CONFIG] ERROR: Exception during config application"));
+        }
+        
+        // Check for timeout
+        if (millis() - apply_start > APPLY_TIMEOUT) {
+            Serial.println(F("[CONFIG] WARNING: Config application took too long"));
+        }
+        
+        // Feed watchdog after config operation
+        esp_task_wdt_reset();
+        
+        if (!apply_success) {
+            Serial.println(F("[CONFIG] ERROR: Failed to apply configuration changes"));
+            // Clear pending config to prevent retry loops
+            config_clear_pending_changes();
         }
     }
     
-    Serial.print(F("[UPLOAD] Starting upload - Buffer has "));
-    Serial.print(buffer_count);
-    Serial.println(F(" samples"));
+    // STEP 3: Check for FOTA manifest in cloud response
+    int job_id;
+    String fwUrl, shaExpected, signature;
+    size_t fwSize;
+    
+    if (parse_fota_manifest_from_json(parsed.fota, job_id, fwUrl, fwSize, shaExpected, signature)) {
+#if FOTA_BACKGROUND
+        // The cloud repeats the manifest in every ACK until the update is done
+        if (!fota_in_progress() && fota_start_background(job_id, fwUrl, fwSize, shaExpected, signature)) {
+            Serial.println(F("[FOTA] Firmware update available - downloading in the background"));
+        }
+#else
+        Serial.println(F("[FOTA] Firmware update available - initiating download"));
+        
+        bool fota_success = perform_FOTA_with_manifest(job_id, fwUrl, fwSize, shaExpected, signature);
+        
+        if (fota_success) {
+            Serial.println(F("[FOTA] Update successful - restarting in 2 seconds..."));
+            delay(2000);
+            ESP.restart();
+        } else {
+            Serial.println(F("[FOTA] Update failed - continuing normal operation"));
+        }
+#endif
+    }
+}
+
+// One pass over the pending chunks; what is left is sent again on the next upload run
+static void send_upload_batch_attempt(void) {
+    if (send_upload_batch()) {
+        Serial.println(F("[UPLOAD] Chunked batch complete"));
+        reset_error_state();
+    } else {
+        Serial.println(F("[UPLOAD] Chunks pending until the next upload"));
+#if UPLOAD_BACKLOG
+        park_upload_batch();
+#endif
+    }
+}
+
+// One attempt at the pending single-frame upload. Every attempt is sealed afresh with a new
+// nonce. The samples stay frozen until the cloud ACKs the frame or the retries run out.
+static void attempt_upload(void) {
+    uint8_t final_payload[pending_upload_length + UPLOAD_SEAL_OVERHEAD];
+    size_t final_payload_len = 0;
+    uint32_t nonce = 0;
+    String mac;
+    const char* encryption = nullptr;
+    if (!seal_upload_frame(pending_upload_frame, pending_upload_length, final_payload, &final_payload_len, &nonce, mac, &encryption)) {
+        Serial.println(F("[ENCRYPTION] Encryption failed! Aborting upload."));
+        upload_retry.state = API_RETRY_IDLE;
+        pending_upload_length = 0;
+        return;
+    }
+
+    String url;
+    url.reserve(128);
+    url = UPLOAD_API_BASE_URL;
+    url += "/api/cloud/write";
+    String method = "POST";
+    String api_key = UPLOAD_API_KEY;
+
+    String response = upload_api_send_request(url, method, api_key, final_payload, final_payload_len, String(nonce), mac, encryption);
+    check_upload_cipher_refused(response);
+    if (api_retry_record(&upload_retry, response.length() > 0, millis(), url.c_str()) == API_RETRY_WAITING) {
+        return;
+    }
+    upload_retry.state = API_RETRY_IDLE;
+
+    // Parsed once; command, status, config_update and fota are all read from it
+    cloud_response_t parsed;
+    bool acked = parse_cloud_response(response, &parsed);
+    handle_cloud_command(parsed);
+    
+    if (acked) {
+        Serial.print(F("[UPLOAD] Success: "));
+        Serial.print(pending_upload_length + 2);
+        Serial.println(F(" bytes uploaded"));
+        
+        // STEPS 1-3: Configuration updates and FOTA from the cloud response
+        handle_upload_ack(parsed);
+        
+        // STEP 4: After successful ACK from cloud → clear buffer
+        Serial.println(F("[WORKFLOW] Successful ACK → clear buffer"));
+        release_upload_samples();
+        
+        // WORKFLOW STEP 5: Buffer becomes free again for next cycle
+        Serial.println(F("[WORKFLOW] Buffer free for next cycle"));
+        
+        reset_error_state();
+    } else {
+        // No response - upload failed
+        Serial.println(F("[UPLOAD] Failed - no response from cloud"));
+#if UPLOAD_BACKLOG
+        // Park the frame in flash so the sample buffer is free for new readings
+        if (upload_backlog_append(pending_upload_frame, pending_upload_length)) {
+            Serial.printf("[BACKLOG] Frame stored for replay (%zu pending)\n", upload_backlog_pending());
+            release_upload_samples();
+        }
+#endif
+    }
+    pending_upload_length = 0;
+}
+
+void execute_upload_task(void) {
+    // A frame whose retries are still running is finished first
+    if (upload_retry.state == API_RETRY_WAITING) {
+        Serial.println(F("[UPLOAD] Previous upload still retrying"));
+        return;
+    }
+
+    bool use_aggregation = false;
+    
+    // Check if we have data to upload
+    if (spsc_ring_size(&sample_ring) == 0 && upload_batch.total == 0 && upload_backlog_pending() == 0) {
+        Serial.println(F("[COMPRESSION] No data to compress and upload"));
+        return;
+    }
     
+    // A chunked batch is finished before anything new is compressed
+    if (upload_batch.total > 0) {
+        Serial.println(F("[UPLOAD] Resending unacknowledged chunks"));
+        send_upload_batch_attempt();
+        return;
+    }
+
+    // Frames parked during an outage go first. Until they are all ACKed, new data queues
+    // behind them in the backlog, so the cloud receives everything oldest-first.
+    bool backlog_drained = true;
+#if UPLOAD_BACKLOG
+    if (upload_backlog_pending() > 0) {
+        backlog_drained = replay_upload_backlog();
+    }
+    if (spsc_ring_size(&sample_ring) == 0) {
+        return;
+    }
+#endif
+
     // WORKFLOW STEP 1: Stop filling → finalize buffer
-    upload_in_progress = true;
+    freeze_upload_samples();
     Serial.println(F("[WORKFLOW] Stop filling → finalize buffer"));
+
+    Serial.print(F("[UPLOAD] Starting upload - Buffer has "));
+    Serial.print(upload_count);
+    Serial.println(F(" samples"));
+    Serial.printf("[BUFFER] Stored %u, dropped when full %u, overwritten %u, missed polls %u, late reads %u (max gap %u ms)\n",
+                  sample_stats.stored, sample_stats.dropped_full,
+                  sample_stats.overwritten, sample_stats.missed_polls, sample_stats.late_reads,
+                  sample_stats.max_read_gap_ms);
     
     // WORKFLOW STEP 2: Compress + packetize
     Serial.println(F("[WORKFLOW] Compress + packetize"));
 
-    if (!attempt_compression(buffer, &buffer_count)) {
-        memset(compressed_data, 0, sizeof(compressed_data));
+    const register_reading_t* samples = upload_samples();
+    if (samples == nullptr) {
+        return;
+    }
+    bool compressed = compress_from_stream() || attempt_compression(samples, &upload_count);
+    if (!compressed && !compression_metrics.truncated) {
+        memset(compressed_data, 0, compressed_data_capacity);
         memset(&compression_metrics, 0, sizeof(compression_metrics));
         compressed_data_len = 0;
-        upload_retry_count++;
-        last_upload_attempt = current_time;
-        Serial.print(F("[UPLOAD] Compression failed - retry count: "));
-        Serial.println(upload_retry_count);
-        upload_in_progress = false;  // Re-enable filling on failure
+        Serial.println(F("[UPLOAD] Compression failed, samples kept for the next upload"));
         return;
     }
     
-    // Check if compressed data exceeds payload limit
-    if (compressed_data_len > MAX_PAYLOAD_SIZE) {
+    // Check if compressed data exceeds payload limit or did not fit the output buffer
+    if (compression_metrics.truncated) {
+        Serial.println(F("Compressed data exceeds output buffer."));
+        use_aggregation = true;
+    } else if (compressed_data_len > MAX_PAYLOAD_SIZE) {
         Serial.print(F("Compressed data ("));
         Serial.print(compressed_data_len);
         Serial.print(F(" bytes) exceeds limit ("));
         Serial.print(MAX_PAYLOAD_SIZE);
-        Serial.println(F(" bytes). Using aggregation..."));
+        Serial.println(F(" bytes)."));
         use_aggregation = true;
-        
+    }
+
+#if OVERSIZE_UPLOAD_MODE == OVERSIZE_UPLOAD_CHUNKED
+    if (use_aggregation && build_upload_batch(samples, upload_count)) {
+        // The chunks now hold every sample, so the buffer can refill while they are ACKed
+        release_upload_samples();
+        memset(compressed_data, 0, compressed_data_len);
+        compressed_data_len = 0;
+
+        if (backlog_drained || !park_upload_batch()) {
+            send_upload_batch_attempt();
+        }
+        return;
+    }
+#endif
+
+    if (use_aggregation) {
+        Serial.println(F("[UPLOAD] Using aggregation..."));
         size_t aggregated_count = 0;
         register_reading_t* aggregated_buffer = NULL;
-        aggregated_count = aggregate_buffer_avg(buffer, buffer_count, &aggregated_buffer);
+        aggregated_count = aggregate_buffer_avg(samples, upload_count, &aggregated_buffer);
 
         if (!attempt_compression(aggregated_buffer, &aggregated_count)) {
             memset(&compression_metrics, 0, sizeof(compression_metrics));
-            memset(compressed_data, 0, sizeof(compressed_data));
+            memset(compressed_data, 0, compressed_data_capacity);
             compressed_data_len = 0;
-            upload_retry_count++;
-            last_upload_attempt = current_time;
-            Serial.print(F("[UPLOAD] Aggregated Compression failed - retry count: "));
-            Serial.println(upload_retry_count);
+            Serial.println(F("[UPLOAD] Aggregated compression failed, samples kept for the next upload"));
             free(aggregated_buffer);
-            upload_in_progress = false;  // Re-enable filling on failure
             return;
         }
         
@@ -556,218 +1370,28 @@ void execute_upload_task(void) {
             Serial.print(F(" "));
         }
         Serial.println();
-        
-        // Add CRC for entire frame
-        uint8_t upload_frame_with_crc[compressed_data_len + 3]; // metadata + data + CRC
-        append_crc_to_upload_frame(compressed_data_frame, compressed_data_len + 1, upload_frame_with_crc);
-        
-        Serial.print(F("[UPLOAD] Frame with CRC: "));
-        Serial.print(compressed_data_len + 1);
-        Serial.print(F(" bytes + 2 bytes CRC = "));
-        Serial.print(compressed_data_len + 3);
-        Serial.println(F(" bytes total"));
-        
-        // === AES-256-CBC ENCRYPTION ===
-        uint8_t iv[16]; // 16-byte IV for AES
-        uint8_t encrypted_payload[compressed_data_len + 32]; // Extra space for PKCS#7 padding
-        size_t encrypted_len = 0;
-        
-        Serial.println(F("[ENCRYPTION] Encrypting payload with AES-256-CBC..."));
-        
-        extern bool encryptPayloadAES_CBC(const uint8_t* plaintext, size_t plaintext_len,
-                                         uint8_t* ciphertext, size_t* ciphertext_len,
-                                         uint8_t* iv_output);
-        
-        if (!encryptPayloadAES_CBC(upload_frame_with_crc, compressed_data_len + 3,
-                                  encrypted_payload, &encrypted_len, iv)) {
-            Serial.println(F("[ENCRYPTION] Encryption failed! Aborting upload."));
-            upload_in_progress = false;
+
+#if UPLOAD_BACKLOG
+        if (!backlog_drained && upload_backlog_append(compressed_data_frame, compressed_data_len + 1)) {
+            Serial.println(F("[BACKLOG] Frame queued behind the backlog"));
+            release_upload_samples();
+            memset(compressed_data, 0, compressed_data_len);
+            compressed_data_len = 0;
             return;
         }
+#endif
         
-        // Combine IV + Ciphertext for final payload
-        uint8_t final_payload[16 + encrypted_len];
-        memcpy(final_payload, iv, 16); // First 16 bytes: IV
-        memcpy(final_payload + 16, encrypted_payload, encrypted_len); // Rest: Ciphertext
-        size_t final_payload_len = 16 + encrypted_len;
-        
-        Serial.printf("[ENCRYPTION] Final encrypted payload: IV(16) + Ciphertext(%d) = %d bytes\n",
-                     encrypted_len, final_payload_len);
-
-        String url;
-        url.reserve(128);
-        url = UPLOAD_API_BASE_URL;
-        url += "/api/cloud/write";
-        String method = "POST";
-        String api_key = UPLOAD_API_KEY;
-
-        // Get a unique nonce for this transaction
-        uint32_t nonce = nonceManager.getAndIncrementNonce();
-        Serial.print(F("[SECURITY] Using Nonce: "));
-        Serial.println(nonce);
-
-        // Encode encrypted payload (IV + Ciphertext) to Base64
-        String upload_frame_base64 = encodeBase64(final_payload, final_payload_len);
-        Serial.print(F("[SECURITY] Base64 encoded length: "));
-        Serial.println(upload_frame_base64.length());
-
-        // Generate MAC for the encrypted Base64 payload
-        String mac = generateMAC(upload_frame_base64);
-        Serial.print(F("[SECURITY] Generated MAC: "));
-        Serial.println(mac);
-
-        String response = upload_api_send_request_with_retry(url, method, api_key, final_payload, final_payload_len, String(nonce), mac);
-
-        if (response.length() > 0) {
-            String action;
-            uint16_t reg = 0;
-            uint16_t val = 0;
-
-            if (extract_command(response, action, reg, val)) {
-                Serial.println(F("[COMMAND] Command detected in cloud response"));
-                
-                if (action.equalsIgnoreCase("write_register")) {
-                    Serial.println(F("[COMMAND] Executing WRITE command immediately"));
-
-                    // Store command atomically
-                    current_command.pending = true;
-                    current_command.register_address = reg;
-                    current_command.value = val;
-                    
-                    // Execute write immediately (no need to wait for scheduler interval)
-                    execute_write_task();
-                    
-                    // Command task will report result on next interval
-                    tasks[TASK_COMMAND_HANDLING].enabled = true;
-
-                } else if (action.equalsIgnoreCase("read_register")) {
-                    Serial.println(F("[COMMAND] Preparing to execute READ task"));
-
-                } else {
-                    Serial.println(F("[COMMAND] Unknown action command received"));
-                }
-            }
-        }
-        
-        if (validate_upload_response(response)) {
-            Serial.print(F("[UPLOAD] Success: "));
-            Serial.print(compressed_data_len + 3);
-            Serial.println(F(" bytes uploaded"));
-            
-            // STEP 1: Process configuration updates from cloud response
-            String config_ack = config_process_cloud_response(response);
-            if (config_ack.length() > 0) {
-                // Send configuration acknowledgment to cloud
-                extern void send_config_ack_to_cloud(const String& ack_json);
-                send_config_ack_to_cloud(config_ack);
-                // Note: ACK failure doesn't prevent config application
-            }
-            
-            // STEP 2: Apply any pending configuration changes after successful upload
-            if (config_has_pending_changes()) {
-                Serial.println(F("[CONFIG] Applying pending configuration changes"));
-                
-                // Feed watchdog before potentially blocking operation
-                esp_task_wdt_reset();
-                
-                // Apply with timeout protection
-                bool apply_success = false;
-                unsigned long apply_start = millis();
-                const unsigned long APPLY_TIMEOUT = 5000; // 5 seconds max
-                
-                try {
-                    config_apply_pending_changes();
-                    apply_success = true;
-                    Serial.println(F("[CONFIG] Configuration applied successfully"));
-                } catch (...) {
-                    Serial.println(F("[CONFIG] ERROR: Exception during config application"));
-                }
-                
-                // Check for timeout
-                if (millis() - apply_start > APPLY_TIMEOUT) {
-                    Serial.println(F("[CONFIG] WARNING: Config application took too long"));
-                }
-                
-                // Feed watchdog after config operation
-                esp_task_wdt_reset();
-                
-                if (!apply_success) {
-                    Serial.println(F("[CONFIG] ERROR: Failed to apply configuration changes"));
-                    // Clear pending config to prevent retry loops
-                    config_clear_pending_changes();
-                }
-            }
-            
-            // STEP 3: Check for FOTA manifest in cloud response
-            int job_id;
-            String fwUrl, shaExpected, signature;
-            size_t fwSize;
-            
-            extern bool parse_fota_manifest_from_response(const String& response, 
-                                                         int& job_id, 
-                                                         String& fwUrl, 
-                                                         size_t& fwSize, 
-                                                         String& shaExpected, 
-                                                         String& signature);
-            
-            if (parse_fota_manifest_from_response(response, job_id, fwUrl, fwSize, shaExpected, signature)) {
-                Serial.println(F("[FOTA] Firmware update available - initiating download"));
-                
-                extern bool perform_FOTA_with_manifest(int job_id, 
-                                                      const String& fwUrl, 
-                                                      size_t fwSize, 
-                                                      const String& shaExpected, 
-                                                      const String& signature);
-                
-                bool fota_success = perform_FOTA_with_manifest(job_id, fwUrl, fwSize, shaExpected, signature);
-                
-                if (fota_success) {
-                    Serial.println(F("[FOTA] Update successful - restarting in 2 seconds..."));
-                    delay(2000);
-                    ESP.restart();
-                } else {
-                    Serial.println(F("[FOTA] Update failed - continuing normal operation"));
-                }
-            }
-            
-            // STEP 4: After successful ACK from cloud → clear buffer
-            Serial.println(F("[WORKFLOW] Successful ACK → clear buffer"));
-                buffer_count = 0;
-                buffer_write_index = 0;
-                buffer_full = false;
-                if (buffer != nullptr) {
-                    memset(buffer, 0, sizeof(register_reading_t) * buffer_size);
-                }
-                
-                // Reset retry counters on success
-                upload_retry_count = 0;
-                last_upload_attempt = 0;
-                
-                // WORKFLOW STEP 5: Buffer becomes free again for next cycle
-                upload_in_progress = false;
-                Serial.println(F("[WORKFLOW] Buffer free for next cycle"));
-                
-                reset_error_state();
-        } else {
-            // No response - upload failed
-            Serial.println(F("[UPLOAD] Failed - no response from cloud"));
-            upload_in_progress = false;  // Re-enable filling on upload failure
-            upload_retry_count++;
-            last_upload_attempt = current_time;
-            Serial.print(F("[UPLOAD] Network failure - retry count: "));
-            Serial.println(upload_retry_count);
-        }
-        
+        // Sent from the pending slot, so a failed attempt can be repeated from scheduler_run()
+        memcpy(pending_upload_frame, compressed_data_frame, compressed_data_len + 1);
+        pending_upload_length = compressed_data_len + 1;
         memset(compressed_data, 0, compressed_data_len);
         compressed_data_len = 0;
+
+        api_retry_start(&upload_retry, millis());
+        attempt_upload();
         
     } else {
         log_error(ERROR_COMPRESSION_FAILED, "No compressed data available for upload");
-        upload_in_progress = false;  // Re-enable filling on failure
-        upload_retry_count++;
-        last_upload_attempt = current_time;
-        Serial.print(F("[UPLOAD] No data after compression - retry count: "));
-        Serial.println(upload_retry_count);
         return;
     }
 }
@@ -816,10 +1440,15 @@ void send_write_command_ack(const String& status, const String& error_code, cons
 void execute_command_task(void) {
     Serial.println(F("Executing command task..."));
 
+    if (command_retry.state == API_RETRY_WAITING) {
+        Serial.println(F("[COMMAND] Result still retrying"));
+        return;
+    }
+
     // FIXED: Always attempt to send result if available
     if (write_status.length() == 0) {
         Serial.println(F("[COMMAND] No result to report"));
-        tasks[TASK_COMMAND_HANDLING].enabled = false;
+        set_task_enabled(TASK_COMMAND_HANDLING, false);
         return;
     }
 
@@ -832,8 +1461,14 @@ void execute_command_task(void) {
     frame += write_executed_timestamp;
     frame += F("\"}}");
 
-    frame = append_crc_to_frame(frame);
-    
+    pending_command_result = append_crc_to_frame(frame);
+
+    api_retry_start(&command_retry, millis());
+    attempt_command_result();
+}
+
+// One attempt at delivering the command result; retried from scheduler_run() after the backoff
+static void attempt_command_result(void) {
     String url;
     url.reserve(128);
     url = UPLOAD_API_BASE_URL;
@@ -841,30 +1476,66 @@ void execute_command_task(void) {
     String api_key = UPLOAD_API_KEY;
     String method = "POST";
     
-    api_command_request_with_retry(url, method, api_key, frame);
+    String response = api_command_request(url, method, api_key, pending_command_result);
+    if (api_retry_record(&command_retry, response.length() > 0, millis(), url.c_str()) == API_RETRY_WAITING) {
+        return;
+    }
 
+    pending_command_result = "";
     write_status = "";
     write_executed_timestamp = "";
-    tasks[TASK_COMMAND_HANDLING].enabled = false;
+    set_task_enabled(TASK_COMMAND_HANDLING, false);
 }
 
 // FOTA task removed - now integrated into upload response handling
 // The cloud sends FOTA manifest in the upload acknowledgment response
 // See execute_upload_task() for FOTA integration
 
+// Flush the streaming compressor if it still mirrors the frozen upload samples
+bool compress_from_stream(void) {
+    if (!stream_compressor_matches(upload_stream, upload_count)) {
+        return false;
+    }
+
+    compression_metrics = stream_compressor_finish(upload_stream, compressed_data, compressed_data_capacity);
+    compressed_data_len = compression_metrics.compressed_payload_size;
+    Serial.print(F("[COMPRESSION] "));
+    Serial.print(compression_metrics.compression_method);
+    Serial.print(F(" (streamed) Time: "));
+    Serial.print(compression_metrics.cpu_time_us);
+    Serial.println(F(" us"));
+
+    return compressed_data_len >= 5;
+}
+
 // Compress the buffer and add header
-bool attempt_compression(register_reading_t* buffer, size_t* buffer_count) {
+bool attempt_compression(const register_reading_t* buffer, size_t* buffer_count) {
     int retry_count = 0;
     while (retry_count < MAX_COMPRESSION_RETRIES) {
-        compression_metrics = compress_raw(buffer, *buffer_count, compressed_data);
+        compression_metrics = compress_with_method(buffer, *buffer_count, compressed_data, compressed_data_capacity, COMPRESSION_METHOD);
         compressed_data_len = compression_metrics.compressed_payload_size;
-        Serial.print(F("[COMPRESSION] Time: "));
+        Serial.print(F("[COMPRESSION] "));
+        Serial.print(compression_metrics.compression_method);
+        Serial.print(F(" Time: "));
         Serial.print(compression_metrics.cpu_time_us);
         Serial.println(F(" us"));
+        if (compression_metrics.method_id == COMPRESSION_METHOD_ADAPTIVE) {
+            // Codec and payload bytes per register, to see where the MAX_PAYLOAD_SIZE budget goes
+            Serial.print(F("[COMPRESSION] Codecs:"));
+            for (size_t reg = 0; reg < READ_REGISTER_COUNT; reg++) {
+                Serial.printf(" R%u=%s/%uB", (unsigned)reg, register_codec_name(compression_metrics.register_codecs[reg]),
+                              (unsigned)compression_metrics.register_bytes[reg]);
+            }
+            Serial.println();
+        }
 
         if (compressed_data_len >= 5) {
             Serial.println(F("[COMPRESSION] Raw buffer compressed successfully"));
             return true;
+        } else if (compression_metrics.truncated) {
+            // Same input gives the same size; the caller has to aggregate instead
+            Serial.println(F("[COMPRESSION] Output truncated, not retrying"));
+            return false;
         } else {
             retry_count++;
             Serial.print(F("[COMPRESSION] Failed. Retry "));
@@ -878,10 +1549,245 @@ bool attempt_compression(register_reading_t* buffer, size_t* buffer_count) {
     return false;
 }
 
+// Split samples into chunk frames that each fit MAX_PAYLOAD_SIZE. Every chunk is compressed
+// on its own; the largest sample count per chunk is found by bisection on the truncation status.
+bool build_upload_batch(const register_reading_t* samples, size_t count) {
+    free_upload_batch();
+    if (count == 0) {
+        return false;
+    }
+
+    size_t starts[MAX_UPLOAD_CHUNKS];
+    size_t counts[MAX_UPLOAD_CHUNKS];
+    size_t sizes[MAX_UPLOAD_CHUNKS];
+    uint8_t scratch[MAX_PAYLOAD_SIZE - 2];  // seq and total take the other two bytes
+    size_t chunks = 0;
+    size_t total_bytes = 0;
+
+    for (size_t start = 0; start < count; start += counts[chunks - 1]) {
+        if (chunks == MAX_UPLOAD_CHUNKS) {
+            Serial.printf("[UPLOAD] %zu samples need more than %d chunks\n", count, MAX_UPLOAD_CHUNKS);
+            return false;
+        }
+
+        size_t fits = 0;  // Largest sample count known to fit
+        size_t fits_size = 0;
+        size_t too_many = count - start + 1;
+        while (too_many - fits > 1) {
+            size_t probe = fits + (too_many - fits) / 2;
+            compression_metrics_t metrics = compress_with_method(samples + start, probe, scratch, sizeof(scratch), COMPRESSION_METHOD);
+            if (metrics.compressed_payload_size >= 5) {
+                fits = probe;
+                fits_size = metrics.compressed_payload_size;
+            } else {
+                too_many = probe;
+            }
+        }
+        if (fits == 0) {
+            log_error(ERROR_COMPRESSION_FAILED, "Single sample exceeds chunk size");
+            return false;
+        }
+
+        starts[chunks] = start;
+        counts[chunks] = fits;
+        sizes[chunks] = 3 + fits_size;
+        total_bytes += sizes[chunks];
+        chunks++;
+    }
+
+    upload_batch.data = (uint8_t*)malloc(total_bytes);
+    if (upload_batch.data == nullptr) {
+        Serial.printf("[UPLOAD] ERROR: Failed to allocate %zu bytes for chunks\n", total_bytes);
+        return false;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < chunks; i++) {
+        uint8_t* chunk = upload_batch.data + offset;
+        chunk[0] = 0x02; // Chunk flag
+        chunk[1] = (uint8_t)i;
+        chunk[2] = (uint8_t)chunks;
+        compress_with_method(samples + starts[i], counts[i], chunk + 3, sizes[i] - 3, COMPRESSION_METHOD);
+        upload_batch.offsets[i] = offset;
+        offset += sizes[i];
+    }
+    upload_batch.offsets[chunks] = offset;
+    upload_batch.total = (uint8_t)chunks;
+    upload_batch.acked_mask = 0;
+
+    Serial.printf("[UPLOAD] Split %zu samples into %zu chunks (%zu bytes)\n", count, chunks, total_bytes);
+    return true;
+}
+
+// Send every chunk not yet ACKed, back to back over one connection.
+// Returns true once the whole batch is ACKed; failed chunks stay pending for the next attempt.
+bool send_upload_batch(void) {
+    if (upload_batch.total == 0) {
+        return true;
+    }
+
+    String url;
+    url.reserve(128);
+    url = UPLOAD_API_BASE_URL;
+    url += "/api/cloud/write";
+    String method = "POST";
+    String api_key = UPLOAD_API_KEY;
+
+    for (uint8_t seq = 0; seq < upload_batch.total; seq++) {
+        if (upload_batch.acked_mask & (1u << seq)) {
+            continue;
+        }
+
+        const uint8_t* chunk = upload_batch.data + upload_batch.offsets[seq];
+        size_t chunk_len = upload_batch.offsets[seq + 1] - upload_batch.offsets[seq];
+
+        Serial.printf("[UPLOAD] Chunk %u/%u: %zu bytes\n", (unsigned)(seq + 1), (unsigned)upload_batch.total, chunk_len);
+
+        uint8_t final_payload[chunk_len + UPLOAD_SEAL_OVERHEAD];
+        size_t final_payload_len = 0;
+        uint32_t nonce = 0;
+        String mac;
+        const char* encryption = nullptr;
+        if (!seal_upload_frame(chunk, chunk_len, final_payload, &final_payload_len, &nonce, mac, &encryption)) {
+            Serial.println(F("[ENCRYPTION] Encryption failed! Chunk left pending."));
+            continue;
+        }
+
+        String response = upload_api_send_request(url, method, api_key, final_payload, final_payload_len, String(nonce), mac, encryption);
+        check_upload_cipher_refused(response);
+
+        cloud_response_t parsed;
+        bool chunk_acked = parse_cloud_response(response, &parsed);
+        handle_cloud_command(parsed);
+
+        if (chunk_acked) {
+            upload_batch.acked_mask |= 1u << seq;
+            handle_upload_ack(parsed);
+        } else {
+            Serial.printf("[UPLOAD] Chunk %u/%u not acknowledged\n", (unsigned)(seq + 1), (unsigned)upload_batch.total);
+        }
+
+        esp_task_wdt_reset();
+    }
+
+    size_t acked = 0;
+    for (uint8_t seq = 0; seq < upload_batch.total; seq++) {
+        if (upload_batch.acked_mask & (1u << seq)) {
+            acked++;
+        }
+    }
+    Serial.printf("[UPLOAD] Chunks acknowledged: %zu/%u\n", acked, (unsigned)upload_batch.total);
+
+    if (acked < upload_batch.total) {
+        return false;
+    }
+    free_upload_batch();
+    return true;
+}
+
+void free_upload_batch(void) {
+    if (upload_batch.data != nullptr) {
+        free(upload_batch.data);
+    }
+    memset(&upload_batch, 0, sizeof(upload_batch));
+}
+
+// Move the chunks the cloud has not ACKed into the backlog. Returns true once the batch
+// is gone; chunks that could not be stored stay pending in RAM.
+bool park_upload_batch(void) {
+    for (uint8_t seq = 0; seq < upload_batch.total; seq++) {
+        if (upload_batch.acked_mask & (1u << seq)) {
+            continue;
+        }
+        const uint8_t* chunk = upload_batch.data + upload_batch.offsets[seq];
+        size_t chunk_len = upload_batch.offsets[seq + 1] - upload_batch.offsets[seq];
+        if (!upload_backlog_append(chunk, chunk_len)) {
+            return false;
+        }
+        upload_batch.acked_mask |= 1u << seq;  // Held by the backlog now
+    }
+    Serial.printf("[BACKLOG] Chunks stored for replay (%zu pending)\n", upload_backlog_pending());
+    free_upload_batch();
+    return true;
+}
+
+// Replay the backlog oldest-first, several frames per request over one connection.
+// Returns true once it is empty; stops at the first request the cloud does not ACK.
+bool replay_upload_backlog(void) {
+    static uint8_t batch[BACKLOG_REPLAY_MAX_BYTES];
+    static uint8_t final_payload[BACKLOG_REPLAY_MAX_BYTES + UPLOAD_SEAL_OVERHEAD];
+
+    String url;
+    url.reserve(128);
+    url = UPLOAD_API_BASE_URL;
+    url += "/api/cloud/write";
+    String method = "POST";
+    String api_key = UPLOAD_API_KEY;
+
+    bool acked = true;
+    for (int request = 0; request < BACKLOG_REPLAY_MAX_REQUESTS && upload_backlog_pending() > 0; request++) {
+        size_t batch_len = 0;
+        size_t frames = 0;
+        backlog_cursor_t next;
+        size_t records = upload_backlog_read(batch + 2, sizeof(batch) - 2, 255, &batch_len, &frames, &next);
+        if (records == 0) {
+            break;
+        }
+        if (frames == 0) {
+            upload_backlog_commit(&next, records);  // Only corrupt records; nothing to send
+            continue;
+        }
+        batch[0] = 0x03; // Backlog batch flag
+        batch[1] = (uint8_t)frames;
+        batch_len += 2;
+
+        Serial.printf("[BACKLOG] Replaying %zu frames (%zu bytes), %zu pending\n", frames, batch_len, upload_backlog_pending());
+
+        size_t final_payload_len = 0;
+        uint32_t nonce = 0;
+        String mac;
+        const char* encryption = nullptr;
+        if (!seal_upload_frame(batch, batch_len, final_payload, &final_payload_len, &nonce, mac, &encryption)) {
+            Serial.println(F("[ENCRYPTION] Encryption failed! Backlog left pending."));
+            acked = false;
+            break;
+        }
+
+        String response = upload_api_send_request(url, method, api_key, final_payload, final_payload_len, String(nonce), mac, encryption);
+        check_upload_cipher_refused(response);
+
+        cloud_response_t parsed;
+        bool replay_acked = parse_cloud_response(response, &parsed);
+        handle_cloud_command(parsed);
+
+        if (!replay_acked) {
+            Serial.println(F("[BACKLOG] Replay not acknowledged, keeping frames"));
+            acked = false;
+            break;
+        }
+        upload_backlog_commit(&next, records);
+        handle_upload_ack(parsed);
+
+        esp_task_wdt_reset();
+    }
+
+    return acked && upload_backlog_pending() == 0;
+}
+
+sample_stats_t scheduler_get_sample_stats(void) {
+    return sample_stats;
+}
+
+task_timing_t scheduler_get_task_timing(task_type_t type) {
+    return task_timing[type];
+}
+
 void init_tasks_last_run(unsigned long start_time) {
     for (int i = 0; i < TASK_COUNT; i++) {
         tasks[i].last_run_ms = start_time;
+        tasks[i].next_due_ms = start_time + tasks[i].interval_ms;
     }
+    rebuild_deadline_heap(&loop_lane);
 }
 
 size_t aggregate_buffer_avg(const register_reading_t* buffer, size_t count, register_reading_t** out_buffer) {
@@ -916,8 +1822,8 @@ void finalize_command(const String& status) {
     write_status = status;
     write_executed_timestamp = get_current_timestamp();
     current_command.pending = false;
-    tasks[TASK_WRITE_REGISTER].enabled = false;
-    tasks[TASK_COMMAND_HANDLING].enabled = true;  // Enable result reporting
+    set_task_enabled(TASK_WRITE_REGISTER, false);
+    set_task_enabled(TASK_COMMAND_HANDLING, true);  // Enable result reporting
     
     Serial.print(F("[COMMAND] Finalized with status: "));
     Serial.println(status);
@@ -14,14 +14,26 @@ typedef enum {
     TASK_COUNT    
 } task_type_t;
 
-// Task structure
+// Task structure. Deadlines are absolute and advance by whole periods, so a task stays
+// phase-locked to its start however long each run takes.
 typedef struct {
     task_type_t type;
     unsigned long interval_ms;
-    unsigned long last_run_ms;
+    unsigned long last_run_ms;   // Start of the latest run
     bool enabled;
+    unsigned long next_due_ms;   // Deadline of the next run
 } scheduler_task_t;
 
+// Start times of a task against its deadlines
+typedef struct {
+    uint32_t runs;
+    uint32_t skipped_periods;    // Deadlines that passed while the task was late for an earlier one
+    uint32_t last_lateness_ms;   // Start of the latest run after its deadline
+    uint32_t max_lateness_ms;
+    uint64_t total_lateness_ms;  // Over all runs, for the mean
+    uint32_t max_jitter_ms;      // Largest change in lateness from one run to the next
+} task_timing_t;
+
 // Circular buffer for storing readings
 typedef struct {
     uint16_t values[READ_REGISTER_COUNT];
@@ -35,8 +47,43 @@ typedef struct {
     uint16_t value;
 } command_state_t;
 
+// Sample accounting for the acquisition path
+typedef struct {
+    uint32_t stored;             // Readings written to the sample buffer
+    uint32_t dropped_full;       // Rejected because the sample ring was full
+    uint32_t overwritten;        // Oldest readings skipped by an upload (CIRCULAR behavior)
+    uint32_t polls;              // Read polls started
+    uint32_t missed_polls;       // Read polls that never ran because the loop was blocked
+    uint32_t late_reads;         // Polls that started more than 1.5 intervals after the previous one
+    uint32_t max_read_gap_ms;    // Longest time between two polls
+} sample_stats_t;
+
+// Oversize upload split into chunk frames: [0x02][seq][total][compressed samples].
+// Each chunk holds a complete compression frame after its three-byte header; the layout is
+// in README.md.
+typedef struct {
+    uint8_t* data;                              // Chunk frames back to back
+    size_t offsets[MAX_UPLOAD_CHUNKS + 1];      // Chunk i is data[offsets[i]..offsets[i + 1])
+    uint8_t total;                              // Chunks in the batch, 0 when none is pending
+    uint32_t acked_mask;                        // Bit i set once chunk i was ACKed
+} upload_batch_t;
+
+// Frames replayed from the flash backlog travel together as
+// [0x03][n] followed by n x [len_hi][len_lo][frame], each frame as it was first sent
+// (0x00 raw, 0x01 aggregated or 0x02 chunk), under one CRC, encryption and MAC.
+
 // Scheduler functions
+// One pass over every task, then sleeps until the next deadline; for loop()
 void scheduler_run(void);
+// Splits the tasks over two FreeRTOS tasks: acquisition (Modbus polls, on
+// ACQUISITION_TASK_CORE) and upload (compress, seal, POST, commands, config and FOTA, on
+// UPLOAD_TASK_CORE), sharing the lock-free sample ring. scheduler_run() must not be
+// called while the pipeline runs. Returns false if the tasks could not be created.
+bool scheduler_start_pipeline(void);
+bool scheduler_pipeline_running(void);
+// Waits for both tasks to finish their current request and end, then hands the tasks back
+// to scheduler_run()
+void scheduler_stop_pipeline(void);
 
 // Buffer management functions
 void allocate_buffer();
@@ -45,6 +92,8 @@ void scheduler_init();
 
 // Data storage functions
 void store_register_reading(const uint16_t* values, size_t count);
+sample_stats_t scheduler_get_sample_stats(void);
+task_timing_t scheduler_get_task_timing(task_type_t type);
 
 // Task execution functions
 void execute_read_task(void);
@@ -56,8 +105,15 @@ void execute_command_task(void);
 // Command acknowledgment functions
 void send_write_command_ack(const String& status, const String& error_code = "", const String& error_message = "");
 
-bool attempt_compression(register_reading_t* buffer, size_t* buffer_count);
+bool compress_from_stream(void);
+bool attempt_compression(const register_reading_t* buffer, size_t* buffer_count);
+bool build_upload_batch(const register_reading_t* samples, size_t count);
+bool send_upload_batch(void);
+void free_upload_batch(void);
+bool park_upload_batch(void);
+bool replay_upload_backlog(void);
 size_t aggregate_buffer_avg(const register_reading_t* buffer, size_t count, register_reading_t** out_buffer);
+// Anchors every task's deadlines at start_time; the first run is one period later
 void init_tasks_last_run(unsigned long start_time);
 void finalize_command(const String& status);
 
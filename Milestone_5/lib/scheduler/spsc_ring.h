@@ -0,0 +1,109 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+// Single-producer, single-consumer ring over a caller-supplied arena. One side pushes and
+// the other peeks, commits or pops, so no lock is needed: each side writes only its own
+// index and publishes it with a release store, which the other side reads with an acquire
+// load before touching the slots. The consumer can peek a batch, work on it in place and
+// commit it later (after an upload is ACKed); until then the producer cannot reuse its slots.
+//
+// Indices run over [0, 2 * capacity), so full and empty differ without a spare slot and
+// the capacity need not be a power of two.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T>
+struct spsc_ring_t {
+    T* slots;
+    uint32_t capacity;
+    std::atomic<uint32_t> head;  // Next item to consume, written by the consumer only
+    std::atomic<uint32_t> tail;  // Next slot to fill, written by the producer only
+};
+
+template <typename T>
+static inline uint32_t spsc_ring_advance(const spsc_ring_t<T>* ring, uint32_t index, uint32_t count) {
+    index += count;
+    return index >= 2 * ring->capacity ? index - 2 * ring->capacity : index;
+}
+
+template <typename T>
+static inline uint32_t spsc_ring_distance(const spsc_ring_t<T>* ring, uint32_t from, uint32_t to) {
+    return to >= from ? to - from : to + 2 * ring->capacity - from;
+}
+
+template <typename T>
+static inline T* spsc_ring_slot(const spsc_ring_t<T>* ring, uint32_t index) {
+    return &ring->slots[index >= ring->capacity ? index - ring->capacity : index];
+}
+
+// Binds the ring to capacity slots at arena and empties it; neither side may be using it
+template <typename T>
+void spsc_ring_init(spsc_ring_t<T>* ring, T* arena, uint32_t capacity) {
+    ring->slots = arena;
+    ring->capacity = capacity;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+}
+
+// Items waiting; exact from either side, a snapshot from anywhere else
+template <typename T>
+size_t spsc_ring_size(const spsc_ring_t<T>* ring) {
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    return spsc_ring_distance(ring, head, ring->tail.load(std::memory_order_acquire));
+}
+
+// Producer side; false when the ring is full
+template <typename T>
+bool spsc_ring_push(spsc_ring_t<T>* ring, const T* item) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (spsc_ring_distance(ring, ring->head.load(std::memory_order_acquire), tail) >= ring->capacity) {
+        return false;
+    }
+    *spsc_ring_slot(ring, tail) = *item;
+    ring->tail.store(spsc_ring_advance(ring, tail, 1), std::memory_order_release);  // The slot is visible before the index
+    return true;
+}
+
+// Consumer side: up to max items starting offset items past the oldest, left in the ring.
+// They may wrap, so they come back as two runs: first[0..first_count) then second[..].
+// Returns how many items the runs hold together.
+template <typename T>
+size_t spsc_ring_peek(const spsc_ring_t<T>* ring, size_t offset, size_t max,
+                      const T** first, size_t* first_count, const T** second) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    size_t waiting = spsc_ring_distance(ring, head, ring->tail.load(std::memory_order_acquire));
+    size_t count = waiting > offset ? waiting - offset : 0;
+    if (count > max) {
+        count = max;
+    }
+    uint32_t start = spsc_ring_advance(ring, head, (uint32_t)offset);
+    size_t start_slot = start >= ring->capacity ? start - ring->capacity : start;
+    size_t contiguous = ring->capacity - start_slot;
+    *first = &ring->slots[start_slot];
+    *first_count = count < contiguous ? count : contiguous;
+    *second = ring->slots;
+    return count;
+}
+
+// Consumer side: releases the count oldest items, which must have been peeked
+template <typename T>
+void spsc_ring_commit(spsc_ring_t<T>* ring, size_t count) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    ring->head.store(spsc_ring_advance(ring, head, (uint32_t)count), std::memory_order_release);  // The slots are read before the producer may reuse them
+}
+
+// Consumer side; false when the ring is empty
+template <typename T>
+bool spsc_ring_pop(spsc_ring_t<T>* ring, T* item) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (ring->tail.load(std::memory_order_acquire) == head) {
+        return false;
+    }
+    *item = *spsc_ring_slot(ring, head);
+    ring->head.store(spsc_ring_advance(ring, head, 1), std::memory_order_release);
+    return true;
+}
+
+#endif
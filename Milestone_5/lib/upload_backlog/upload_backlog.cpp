@@ -0,0 +1,350 @@
+#include "upload_backlog.h"
+#include "config.h"
+#include "calculateCRC.h"
+#include <SPIFFS.h>
+#include <Preferences.h>
+
+#define BACKLOG_RECORD_HEADER 4  // [len_hi][len_lo][crc_hi][crc_lo]
+
+static const char* BACKLOG_NVS_NAMESPACE = "backlog";
+
+static Preferences backlog_nvs;
+static bool backlog_ready = false;
+static uint32_t head_segment = 0;   // Oldest segment, replayed first
+static uint32_t head_offset = 0;    // Bytes of the head segment already replayed
+static uint32_t tail_segment = 0;   // Segment new frames are appended to
+static uint32_t tail_size = 0;      // Bytes of complete records in the tail segment
+static size_t pending_frames = 0;
+static size_t read_corrupted = 0;   // Corrupt records covered by the last upload_backlog_read()
+static backlog_stats_t backlog_stats = {0};
+
+static void segment_path(uint32_t segment, char* path, size_t path_size) {
+    snprintf(path, path_size, "/backlog_%08lx.bin", (unsigned long)segment);
+}
+
+static void remove_segment(uint32_t segment) {
+    char path[24];
+    segment_path(segment, path, sizeof(path));
+    if (SPIFFS.exists(path)) {
+        SPIFFS.remove(path);
+    }
+}
+
+static void save_head(void) {
+    backlog_nvs.putUInt("head", head_segment);
+    backlog_nvs.putUInt("head_off", head_offset);
+}
+
+static void save_tail(void) {
+    backlog_nvs.putUInt("tail", tail_segment);
+}
+
+// Walk the records of a segment from offset. Returns how many are complete and sets *end
+// to the byte after the last one; a torn record at the end of the file is left out.
+static size_t scan_segment(uint32_t segment, uint32_t offset, uint32_t* end, uint32_t* file_size) {
+    char path[24];
+    segment_path(segment, path, sizeof(path));
+    *end = offset;
+    *file_size = 0;
+
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) {
+        return 0;
+    }
+    size_t size = file.size();
+    size_t records = 0;
+    uint8_t header[BACKLOG_RECORD_HEADER];
+    while (*end + BACKLOG_RECORD_HEADER <= size) {
+        file.seek(*end);
+        if (file.read(header, BACKLOG_RECORD_HEADER) != BACKLOG_RECORD_HEADER) {
+            break;
+        }
+        size_t length = ((size_t)header[0] << 8) | header[1];
+        if (length == 0 || *end + BACKLOG_RECORD_HEADER + length > size) {
+            break;
+        }
+        *end += BACKLOG_RECORD_HEADER + length;
+        records++;
+    }
+    file.close();
+    *file_size = (uint32_t)size;
+    return records;
+}
+
+// Rotation: the oldest segment goes, with whatever it still held
+static void drop_oldest_segment(void) {
+    uint32_t end = 0;
+    uint32_t size = 0;
+    size_t records = scan_segment(head_segment, head_offset, &end, &size);
+
+    remove_segment(head_segment);
+    pending_frames -= records < pending_frames ? records : pending_frames;
+    backlog_stats.frames_dropped += records;
+    backlog_stats.segments_rotated++;
+    Serial.printf("[BACKLOG] Backlog full, dropped segment %lu (%zu frames)\n", (unsigned long)head_segment, records);
+
+    head_segment++;
+    head_offset = 0;
+    save_head();
+}
+
+static void start_tail_segment(void) {
+    tail_segment++;
+    tail_size = 0;
+    save_tail();
+    backlog_stats.segments_opened++;
+
+    while (tail_segment - head_segment + 1 > BACKLOG_MAX_SEGMENTS) {
+        drop_oldest_segment();
+    }
+}
+
+static bool write_record(const uint8_t* header, const uint8_t* frame, size_t length) {
+    char path[24];
+    segment_path(tail_segment, path, sizeof(path));
+
+    File file = SPIFFS.open(path, FILE_APPEND);
+    if (!file) {
+        return false;
+    }
+    size_t written = file.write(header, BACKLOG_RECORD_HEADER);
+    if (written == BACKLOG_RECORD_HEADER) {
+        written += file.write(frame, length);
+    }
+    file.close();
+    return written == BACKLOG_RECORD_HEADER + length;
+}
+
+bool upload_backlog_init(void) {
+    backlog_ready = false;
+
+    if (!SPIFFS.begin(true)) {
+        Serial.println(F("[BACKLOG] Failed to mount SPIFFS"));
+        return false;
+    }
+    backlog_nvs.end();
+    if (!backlog_nvs.begin(BACKLOG_NVS_NAMESPACE, false)) {
+        Serial.println(F("[BACKLOG] Failed to open NVS"));
+        return false;
+    }
+
+    head_segment = backlog_nvs.getUInt("head", 0);
+    head_offset = backlog_nvs.getUInt("head_off", 0);
+    tail_segment = backlog_nvs.getUInt("tail", head_segment);
+    if (tail_segment < head_segment) {
+        tail_segment = head_segment;
+    }
+
+    pending_frames = 0;
+    read_corrupted = 0;
+    tail_size = 0;
+    bool torn_tail = false;
+    for (uint32_t segment = head_segment; segment <= tail_segment; segment++) {
+        uint32_t end = 0;
+        uint32_t size = 0;
+        pending_frames += scan_segment(segment, segment == head_segment ? head_offset : 0, &end, &size);
+        if (segment == tail_segment) {
+            tail_size = end;
+            torn_tail = end < size;
+        }
+    }
+    backlog_ready = true;
+
+    while (tail_segment - head_segment + 1 > BACKLOG_MAX_SEGMENTS) {
+        drop_oldest_segment();
+    }
+    if (torn_tail) {
+        // Power was cut mid-append; new records must not follow the torn one
+        Serial.println(F("[BACKLOG] Torn record at end of backlog, starting a new segment"));
+        start_tail_segment();
+    }
+
+    Serial.printf("[BACKLOG] %zu frames pending in %zu segments\n", pending_frames, upload_backlog_segments());
+    return true;
+}
+
+bool upload_backlog_append(const uint8_t* frame, size_t length) {
+    if (!backlog_ready || frame == nullptr || length == 0 || length > 0xFFFF ||
+        BACKLOG_RECORD_HEADER + length > BACKLOG_SEGMENT_SIZE) {
+        return false;
+    }
+
+    size_t record_size = BACKLOG_RECORD_HEADER + length;
+    if (tail_size > 0 && tail_size + record_size > BACKLOG_SEGMENT_SIZE) {
+        start_tail_segment();
+    }
+
+    uint16_t crc = calculateCRC(frame, (int)length);
+    uint8_t header[BACKLOG_RECORD_HEADER] = {
+        (uint8_t)(length >> 8), (uint8_t)(length & 0xFF), (uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF)
+    };
+
+    for (;;) {
+        if (write_record(header, frame, length)) {
+            tail_size += record_size;
+            pending_frames++;
+            backlog_stats.frames_stored++;
+            return true;
+        }
+
+        // Partition full. A partial record may now end the tail segment, so continue in a
+        // fresh one and free space by dropping the oldest.
+        if (tail_size > 0) {
+            start_tail_segment();
+        } else {
+            remove_segment(tail_segment);
+        }
+        if (head_segment == tail_segment) {
+            Serial.println(F("[BACKLOG] ERROR: No space left for frame"));
+            return false;
+        }
+        drop_oldest_segment();
+    }
+}
+
+size_t upload_backlog_read(uint8_t* out, size_t out_size, size_t max_frames, size_t* out_length,
+                           size_t* frames, backlog_cursor_t* next) {
+    *out_length = 0;
+    *frames = 0;
+    next->segment = head_segment;
+    next->offset = head_offset;
+    read_corrupted = 0;
+    if (!backlog_ready || pending_frames == 0) {
+        return 0;
+    }
+
+    size_t records = 0;
+    bool reached_end = false;
+    uint8_t header[BACKLOG_RECORD_HEADER];
+
+    while (*frames < max_frames) {
+        char path[24];
+        segment_path(next->segment, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_READ);
+        size_t size = file ? file.size() : 0;
+
+        bool segment_done = false;
+        while (*frames < max_frames) {
+            if (next->offset + BACKLOG_RECORD_HEADER > size) {
+                segment_done = true;
+                break;
+            }
+            file.seek(next->offset);
+            if (file.read(header, BACKLOG_RECORD_HEADER) != BACKLOG_RECORD_HEADER) {
+                segment_done = true;
+                break;
+            }
+            size_t length = ((size_t)header[0] << 8) | header[1];
+            if (length == 0 || next->offset + BACKLOG_RECORD_HEADER + length > size) {
+                segment_done = true;  // Torn record; nothing valid follows it in this segment
+                break;
+            }
+            if (*out_length + 2 + length > out_size) {
+                break;
+            }
+
+            uint8_t* dest = out + *out_length;
+            uint16_t crc = ((uint16_t)header[2] << 8) | header[3];
+            if (file.read(dest + 2, length) == length && calculateCRC(dest + 2, (int)length) == crc) {
+                dest[0] = header[0];
+                dest[1] = header[1];
+                *out_length += 2 + length;
+                (*frames)++;
+            } else {
+                read_corrupted++;
+            }
+            next->offset += BACKLOG_RECORD_HEADER + length;
+            records++;
+        }
+        file.close();
+
+        if (!segment_done) {
+            break;  // out is full or max_frames reached
+        }
+        if (next->segment == tail_segment) {
+            reached_end = true;
+            break;
+        }
+        next->segment++;
+        next->offset = 0;
+    }
+
+    if (records == 0 && reached_end) {
+        // The count picked up at boot was wrong; nothing is left to replay
+        Serial.println(F("[BACKLOG] No readable frames left, resetting backlog"));
+        upload_backlog_clear();
+    }
+    return records;
+}
+
+void upload_backlog_commit(const backlog_cursor_t* next, size_t records) {
+    if (!backlog_ready || records == 0) {
+        return;
+    }
+
+    while (head_segment < next->segment) {
+        remove_segment(head_segment);
+        head_segment++;
+    }
+    head_offset = next->offset;
+
+    pending_frames -= records < pending_frames ? records : pending_frames;
+    backlog_stats.frames_replayed += (uint32_t)(records - read_corrupted);
+    backlog_stats.frames_corrupted += (uint32_t)read_corrupted;
+    read_corrupted = 0;
+
+    if (pending_frames == 0) {
+        upload_backlog_clear();
+        return;
+    }
+    save_head();
+}
+
+void upload_backlog_clear(void) {
+    if (!backlog_ready) {
+        return;
+    }
+    for (uint32_t segment = head_segment; segment <= tail_segment; segment++) {
+        remove_segment(segment);
+    }
+    // Keep counting segment ids upwards, so a new outage starts in a new file
+    tail_segment++;
+    head_segment = tail_segment;
+    head_offset = 0;
+    tail_size = 0;
+    pending_frames = 0;
+    save_head();
+    save_tail();
+}
+
+size_t upload_backlog_pending(void) {
+    return pending_frames;
+}
+
+size_t upload_backlog_bytes(void) {
+    if (!backlog_ready) {
+        return 0;
+    }
+    size_t bytes = 0;
+    for (uint32_t segment = head_segment; segment <= tail_segment; segment++) {
+        char path[24];
+        segment_path(segment, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_READ);
+        if (file) {
+            bytes += file.size();
+            file.close();
+        }
+    }
+    return bytes > head_offset ? bytes - head_offset : 0;
+}
+
+size_t upload_backlog_segments(void) {
+    if (!backlog_ready || (pending_frames == 0 && tail_size == 0)) {
+        return 0;
+    }
+    return tail_segment - head_segment + 1;
+}
+
+backlog_stats_t upload_backlog_get_stats(void) {
+    return backlog_stats;
+}
@@ -0,0 +1,54 @@
+#ifndef UPLOAD_BACKLOG_H
+#define UPLOAD_BACKLOG_H
+
+#include <Arduino.h>
+
+// Store-and-forward backlog for upload frames the cloud did not ACK.
+//
+// Frames are appended to segment files /backlog_<id>.bin in the spiffs partition as
+// [len_hi][len_lo][crc_hi][crc_lo][frame]. Segments are only ever appended to and deleted
+// whole, oldest first, so nothing is rewritten in place. The oldest and newest segment ids
+// and the replay offset into the oldest one live in NVS. When BACKLOG_MAX_SEGMENTS are in
+// use, the oldest segment is dropped to make room.
+//
+// Frames are stored before CRC and encryption: a replay is sealed afresh with a new IV and nonce.
+
+// Replay position: segment id and byte offset of the next record
+typedef struct {
+    uint32_t segment;
+    uint32_t offset;
+} backlog_cursor_t;
+
+typedef struct {
+    uint32_t frames_stored;      // Frames appended
+    uint32_t frames_replayed;    // Frames removed after the cloud ACKed them
+    uint32_t frames_dropped;     // Frames lost to segment rotation when the backlog was full
+    uint32_t frames_corrupted;   // Records skipped because of a bad length or CRC (torn writes)
+    uint32_t segments_rotated;   // Segments dropped to stay within BACKLOG_MAX_SEGMENTS
+    uint32_t segments_opened;    // Segment files started
+} backlog_stats_t;
+
+// Mount SPIFFS and pick up a backlog left by a previous boot
+bool upload_backlog_init(void);
+
+// Append one upload frame ([flag][compressed frame]); false if it could not be stored
+bool upload_backlog_append(const uint8_t* frame, size_t length);
+
+// Pack the oldest frames into out as [len_hi][len_lo][frame]... without removing them.
+// Stops at max_frames or when the next frame does not fit. Returns the records covered
+// (corrupt ones are skipped but counted); pass that and *next to upload_backlog_commit().
+size_t upload_backlog_read(uint8_t* out, size_t out_size, size_t max_frames, size_t* out_length,
+                           size_t* frames, backlog_cursor_t* next);
+
+// Drop the records returned by upload_backlog_read() once the cloud ACKed them
+void upload_backlog_commit(const backlog_cursor_t* next, size_t records);
+
+// Remove every stored frame
+void upload_backlog_clear(void);
+
+size_t upload_backlog_pending(void);     // Frames waiting for replay
+size_t upload_backlog_bytes(void);       // Flash used by pending segments
+size_t upload_backlog_segments(void);    // Segment files in use
+backlog_stats_t upload_backlog_get_stats(void);
+
+#endif
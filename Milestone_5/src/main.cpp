@@ -7,8 +7,10 @@
 #include <scheduler.h>
 #include <modbus_handler.h>
 #include <encryptionAndSecurity.h>
+#include <upload_backlog.h>
 #include "sdkconfig.h"
 #include "esp_pm.h"
+#include "esp_task_wdt.h"
 #include "driver/uart.h"
 
 #if !CONFIG_AUTOSTART_ARDUINO
@@ -47,6 +49,14 @@ void setup() {
     // Initialize modules
     error_handler_init();
     nonceManager.begin();
+    if (!crypto_init()) {
+        Serial.println(F("Crypto context unavailable, uploads will retry setting it up"));
+    }
+#if UPLOAD_BACKLOG
+    if (!upload_backlog_init()) {
+        Serial.println(F("Upload backlog unavailable, failed uploads are retried from RAM"));
+    }
+#endif
     
     // Initialize WiFi
     if (!wifi_init()) {
@@ -81,6 +91,16 @@ void setup() {
     unsigned long now = millis();
     init_tasks_last_run(now);
 
+#if DUAL_CORE_PIPELINE
+    if (!scheduler_start_pipeline()) {
+        Serial.println(F("Pipeline tasks unavailable, running the scheduler from loop()"));
+    }
+#endif
+
+    // The pipeline tasks block between deadlines instead of calling esp_light_sleep_start();
+    // with tickless idle the power manager enters light sleep once both cores are idle
+    bool auto_light_sleep = POWER_MANAGMENT && LIGHT_SLEEP && scheduler_pipeline_running();
+
     if (POWER_MANAGMENT && DVFS && !pm_applied) {
         Serial.print("Initial CPU Frequency:");
         Serial.print(getCpuFrequencyMhz());
@@ -89,7 +109,7 @@ void setup() {
         Serial.print("Initial APB Frequency:");
         Serial.print(getApbFrequency());
         Serial.println(" Hz");
-        applyPMConfig(80, 160, false);
+        applyPMConfig(80, 160, auto_light_sleep);
     };
 
     if (POWER_MANAGMENT && SERIAL_GATING) {
@@ -99,13 +119,16 @@ void setup() {
 }
 
 void loop() {
-    // Run the scheduler (handles all periodic tasks)
+    if (scheduler_pipeline_running()) {
+        // The acquisition and upload tasks do the work; the loop task is not needed
+        esp_task_wdt_delete(NULL);
+        vTaskDelete(NULL);
+    }
+
+    // Run the scheduler (handles all periodic tasks); it returns at the next deadline
     scheduler_run();
     
     // Process HTTP configuration requests
     // Configuration processing is now integrated with cloud upload responses
-    
-    // Small delay to prevent tight looping
-    delay(100);
 }
 #endif
\ No newline at end of file